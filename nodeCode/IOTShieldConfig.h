@@ -64,8 +64,7 @@ extern iotShieldLED leftGreenLED;
  */
 extern iotShieldLED rightGreenLED;
 
-// Heartbeat interval for event/periodic sending (default: 24h, set to 10s for testing)
-#define HEARTBEAT_INTERVAL_MS 10000UL
+// The heartbeat interval for event/periodic sending is HEARTBEAT_INTERVAL_MS in sendPolicy.h
 
 
 /*!
@@ -2,13 +2,7 @@
 /// #include <iostream> // cout, endl // debugging only
 
 /// @brief Constructs a new payloadDecoder object.
-payloadDecoder::payloadDecoder() : _id{0},
-                                   _version{0},
-                                   _doorStatus{0},
-                                   _catchDetect{0},
-                                   _trapDisplacement{0},
-                                   _batteryStatus{0},
-                                   _unixTime{0},
+payloadDecoder::payloadDecoder() : _fields{},
                                    _buffer{nullptr},
                                    _bufferSize{0}
 {
@@ -21,111 +15,85 @@ payloadDecoder::~payloadDecoder()
     // Destructor
 }
 
+void payloadDecoder::decodePayload(const uint8_t *buffer, uint8_t size)
+{
+    _buffer = buffer;
+    _bufferSize = size;
+    decodePayload();
+}
+
 void payloadDecoder::decodePayload()
 {
     /**
-     * Decodes the payload data.
-     * This function prints the payload in binary format and extracts various data fields from the payload buffer.
-
-    std::cout << "Decoder payload binary: ";
-    for (int i = 0; i < _bufferSize; i++)
+     * Decodes the payload data using the layout of its version byte (see payloadSchema.h):
+     * PAYLOAD_VERSION_COMPACT frames with the compact layout, all others with the full layout.
+     * Payloads shorter than their layout are ignored and leave the fields unchanged.
+     */
+    if (_buffer == nullptr || _bufferSize <= PAYLOAD_VERSION_INDEX)
     {
-        for (int j = 7; j >= 0; j--)
+        return;
+    }
+    if (_buffer[PAYLOAD_VERSION_INDEX] == PAYLOAD_VERSION_COMPACT)
+    {
+        if (_bufferSize >= payloadCodecV2::size)
         {
-            std::cout << ((_buffer[i] >> j) & 1);
+            payloadCodecV2::decode(_buffer, _fields);
         }
-        std::cout << " ";
+        return;
     }
-    std::cout << std::endl;
-    */
-
-    _id = static_cast<int>(extract_uint32(_buffer, 0));
-    _version = static_cast<int>(extract_uint8(_buffer, 4));
-    _doorStatus = extract_bool(_buffer, 5, 2);
-    _catchDetect = extract_bool(_buffer, 5, 1);
-    _trapDisplacement = extract_bool(_buffer, 5, 0);
-    _batteryStatus = static_cast<int>(extract_uint8(_buffer, 6));
-    _unixTime = static_cast<int>(extract_uint32(_buffer, 7));
+    if (_bufferSize < payloadCodecV1::size)
+    {
+        return;
+    }
+    payloadCodecV1::decode(_buffer, _fields);
 }
 
-uint8_t payloadDecoder::extract_uint8(const uint8_t *buf, const unsigned char idx)
+/* // print payload decoded
+void payloadDecoder::printPayloadDecoded()
 {
-    /**
-     * Extracts a uint8_t value from the given buffer at the specified index.
-     *
-     * @param buf The buffer containing the data.
-     * @param idx The index of the value to extract.
-     * @return The extracted uint8_t value.
-     */
-    return static_cast<uint8_t>(buf[idx]);
+    
+    /// Prints the decoded payload information.
+    std::cout << "Payload decoded: " << std::endl;
+    std::cout << "ID: " << _fields.id << std::endl;
+    std::cout << "Version: " << static_cast<int>(_fields.version) << std::endl;
+    std::cout << "Door status: " << _fields.doorStatus << std::endl;
+    std::cout << "Catch detect: " << _fields.catchDetect << std::endl;
+    std::cout << "Trap displacement: " << _fields.trapDisplacement << std::endl;
+    std::cout << "Battery status: " << static_cast<int>(_fields.batteryStatus) << std::endl;
+    std::cout << "Unix time: " << _fields.unixTime << std::endl;
+} */
+
+uint32_t payloadDecoder::get_id() const
+{
+    return _fields.id;
 }
 
-uint16_t payloadDecoder::extract_uint16(const uint8_t *buf, const unsigned char idx)
+uint8_t payloadDecoder::get_version() const
 {
-    /**
-     * @brief Extracts a 16-bit unsigned integer from a buffer at the specified index.
-     *
-     * This function takes a buffer `buf` and an index `idx` and extracts a 16-bit unsigned integer
-     * from the buffer starting at the specified index. The most significant byte is located at `buf[idx]`
-     * and the least significant byte is located at `buf[idx + 1]`.
-     *
-     * @param buf Pointer to the buffer containing the data.
-     * @param idx Index of the most significant byte in the buffer.
-     * @return The extracted 16-bit unsigned integer value.
-     */
+    return _fields.version;
+}
 
-    uint16_t value{0};
-    value = static_cast<uint16_t>(buf[idx] << 8); // msb
-    value |= static_cast<uint16_t>(buf[idx + 1]); // lsb
-    return value;
+bool payloadDecoder::get_doorStatus() const
+{
+    return _fields.doorStatus;
 }
 
-uint32_t payloadDecoder::extract_uint32(const uint8_t *buf, const unsigned char idx)
+bool payloadDecoder::get_catchDetect() const
 {
-    /**
-     * Extracts a 32-bit unsigned integer from a buffer at the specified index.
-     * This function takes a buffer `buf` and an index `idx` and extracts a 32-bit unsigned integer
-     * from the buffer starting at the specified index. The most significant byte is located at `buf[idx]`
-     * and the least significant byte is located at `buf[idx + 3]`.
-     * @param buf The buffer containing the data.
-     * @param idx The index in the buffer where the 32-bit integer starts.
-     * @return The extracted 32-bit unsigned integer.
-     */
+    return _fields.catchDetect;
+}
 
-    uint32_t value{0};
-    for (uint8_t i = 0; i < 4; i++)
-    {
-        value |= static_cast<uint32_t>(buf[idx + i] << (24 - (i * 8))); // msb
-    }
-    return value;
+bool payloadDecoder::get_trapDisplacement() const
+{
+    return _fields.trapDisplacement;
 }
 
-bool payloadDecoder::extract_bool(const uint8_t *buf, const unsigned char idx, unsigned int pos)
+uint8_t payloadDecoder::get_batteryStatus() const
 {
-    /**
-     * Extracts a boolean value from a buffer at a specified index and position.
-     *
-     * @param buf The buffer containing the data.
-     * @param idx The index of the byte in the buffer.
-     * @param pos The position of the bit within the byte.
-     * @return The extracted boolean value.
-     */
-    bool value;
-    value = (buf[idx] >> pos) & 1;
-    return value;
+    return _fields.batteryStatus;
 }
 
-/* // print payload decoded
-void payloadDecoder::printPayloadDecoded()
+uint32_t payloadDecoder::get_unixTime() const
 {
-    
-    /// Prints the decoded payload information.
-    std::cout << "Payload decoded: " << std::endl;
-    std::cout << "ID: " << _id << std::endl;
-    std::cout << "Version: " << static_cast<int>(_version) << std::endl;
-    std::cout << "Door status: " << _doorStatus << std::endl;
-    std::cout << "Catch detect: " << _catchDetect << std::endl;
-    std::cout << "Trap displacement: " << _trapDisplacement << std::endl;
-    std::cout << "Battery status: " << static_cast<int>(_batteryStatus) << std::endl;
-    std::cout << "Unix time: " << _unixTime << std::endl;
-} */
\ No newline at end of file
+    return _fields.unixTime;
+}
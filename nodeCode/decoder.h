@@ -3,6 +3,8 @@
 
 #include <stdint.h> // uint8_t, uint16_t, and uint32_t type
 
+#include "payloadSchema.h"
+
 /**
  * @file decoder.h
  * @brief Payload decoder for muskrat trap LoRaWAN node. Decodes compact binary payloads into sensor and status fields.
@@ -13,46 +15,17 @@
 
 /// \brief payload decode class
 /// This class wil decode variables out of a payload for use in a LoRaWAN application.
+/// The byte layout is generated from payloadLayoutV1 in payloadSchema.h, or from payloadLayoutV2
+/// for frames whose version byte is PAYLOAD_VERSION_COMPACT.
 /// The class is setup using both .h and .cpp files where the setters and getters are
 /// placed in to the .h file.
 class payloadDecoder
 {
 private:
-    uint32_t _id;           ///< Identification number (4 bytes)
-    uint8_t _version;       ///< Payload version number (1 byte)
-    bool _doorStatus;       ///< Door status (1 bit)
-    bool _catchDetect;      ///< Catch detection (1 bit)
-    bool _trapDisplacement; ///< Trap displacement (1 bit)
-    uint8_t _batteryStatus; ///< Battery status (1 byte)
-    uint32_t _unixTime;     ///< Date and time (4 bytes)
-    uint8_t *_buffer;       ///< buffer containing payload with sensor data
+    payloadFields _fields;  ///< Decoded field values (layout in payloadSchema.h)
+    const uint8_t *_buffer; ///< buffer containing payload with sensor data
     uint8_t _bufferSize;    ///< Size of payload for housekeeping.
 
-    /// \brief extract uint8 from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \return uint8_t value
-    uint8_t extract_uint8(const uint8_t *buf, const unsigned char idx = 0);
-
-    /// \brief extract uint16 from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \return uint16_t value
-    uint16_t extract_uint16(const uint8_t *buf, const unsigned char idx = 0);
-
-    /// \brief extract uint32 from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \return uint32_t value
-    uint32_t extract_uint32(const uint8_t *buf, const unsigned char idx = 0);
-
-    /// \brief extract boolean from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \param pos position in byte
-    /// \return boolean value
-    bool extract_bool(const uint8_t *buf, const unsigned char idx = 0, unsigned int pos = 0);
-
 public:
     payloadDecoder();                                           ///< Constructor
     ~payloadDecoder();                                          ///< Destuctor
@@ -62,13 +35,18 @@ public:
     /// \brief set payload
     /// Copy the payload to the buffer
     /// \param payload pointer to buffer
-    void setPayload(uint8_t *payload) { _buffer = payload; }
+    void setPayload(const uint8_t *payload) { _buffer = payload; }
 
     /// \brief set payload size
     /// Set the size of the payload
     /// \param size size of payload
     void setPayloadSize(uint8_t size) { _bufferSize = size; }
 
+    /**
+     * @brief Decode the payload set with setPayload() into fields.
+     */
+    void decodePayload();
+
     /**
      * @brief Decode the payload buffer into fields.
      * @param buffer Pointer to payload buffer
@@ -114,6 +92,7 @@ public:
 
     /**
      * @brief Get the unix time from the payload.
+     * Compact frames only carry the low PAYLOAD_TIME_BITS_V2 bits; see payloadExpandTime().
      * @return Unix timestamp (uint32_t)
      */
     uint32_t get_unixTime() const;
@@ -1,30 +1,19 @@
 #include "encoder.h"
-#include <stdlib.h> // malloc()
 
 /**
  * @brief Constructs a new payloadEncoder object.
  *
- * This constructor initializes the member variables of the payloadEncoder class,
- * including _id, _version, _doorStatus, _catchDetect, _trapDisplacement,
- * _batteryStatus, and _unixTime. It also allocates memory for the _buffer using
- * malloc() and sets _bufferSize to 0.
+ * This constructor initializes all payload fields to zero. The payload buffer is a
+ * fixed-size member, so constructing an encoder never touches the heap.
  */
-payloadEncoder::payloadEncoder() : _id{0},
-                                   _version{0},
-                                   _doorStatus{0},
-                                   _catchDetect{0},
-                                   _trapDisplacement{0},
-                                   _batteryStatus{0},
-                                   _unixTime{0},
-                                   _buffer{NULL},
+payloadEncoder::payloadEncoder() : _fields{},
+                                   _buffer{},
                                    _bufferSize{0}
 {
-    _buffer = reinterpret_cast<uint8_t *>(malloc(SENSOR_PAYLOAD_SIZE));
 }
 
 payloadEncoder::~payloadEncoder()
 {
-    free(_buffer);
 }
 
 void payloadEncoder::composePayload()
@@ -33,99 +22,39 @@ void payloadEncoder::composePayload()
      * @brief Composes the payload by adding various data elements to the buffer.
      *
      * This function initializes the buffer size and adds data elements such as ID, version, door status, catch detection,
-     * trap displacement, battery status, and UNIX time to the buffer. It also prints the payload size in bytes for debugging purposes.
+     * trap displacement, battery status, and UNIX time to the buffer.
      */
 
-    _bufferSize = 0; // init
-
-    _bufferSize = add_uint32(_bufferSize, _id);
-    _bufferSize = add_uint8(_bufferSize, _version);
-
-    _bufferSize = add_bool(_bufferSize, _doorStatus, 2);
-    _bufferSize = add_bool(_bufferSize, _catchDetect, 1);
-    _bufferSize = add_bool(_bufferSize, _trapDisplacement, 0);
-
-    _bufferSize = add_uint8(_bufferSize, _batteryStatus);
-    _bufferSize = add_uint32(_bufferSize, _unixTime);
-}
-
-unsigned char payloadEncoder::add_uint8(unsigned char idx_in, const uint8_t value)
-{
-    /**
-     * Adds a uint8_t value to the buffer at the specified index.
-     *
-     * @param idx_in The index in the buffer where the value should be added.
-     * @param value The uint8_t value to be added to the buffer.
-     * @return The updated index after adding the value.
-     */
-    _buffer[idx_in++] = value;
-    return (idx_in);
-}
-
-unsigned char payloadEncoder::add_uint16(unsigned char idx_in, const uint16_t value)
-{
-    /**
-     * Adds a 16-bit unsigned integer to the buffer at the specified index.
-     *
-     * @param idx_in The index in the buffer where the value should be added.
-     * @param value The 16-bit unsigned integer value to be added.
-     * @return The updated index after adding the value to the buffer.
-     */
-
-    _buffer[idx_in++] = (value >> 8) & 0xFF; // msb
-    _buffer[idx_in++] = (value) & 0xFF;      // lsb
-
-    return (idx_in);
+    _bufferSize = encodeInto(_buffer, SENSOR_PAYLOAD_SIZE);
 }
 
-unsigned char payloadEncoder::add_uint32(unsigned char idx_in, uint32_t value)
+uint8_t payloadEncoder::encodeInto(uint8_t *out, uint8_t capacity) const
 {
     /**
-     * Adds a 32-bit unsigned integer to the buffer.
+     * @brief Encodes all fields into `out` using the layout of the version set with set_version().
      *
-     * @param idx_in The starting index in the buffer.
-     * @param value The value to be added.
-     * @return The updated index after adding the value.
+     * PAYLOAD_VERSION_COMPACT gives the 8-byte layout; every other version the full layout.
+     * Unused bits are always zero, even when `out` holds stale data.
      */
 
-    for (uint8_t i = 0; i < 4; i++)
+    if (_fields.version == PAYLOAD_VERSION_COMPACT)
     {
-        _buffer[idx_in++] = (value >> 24) & 0xFF; // msb
-        value = value << 8;                       // shift-left
+        if (capacity < payloadCodecV2::size)
+        {
+            return 0;
+        }
+        payloadCodecV2::encode(_fields, out);
+        return payloadCodecV2::size;
     }
-    return (idx_in);
-}
 
-unsigned char payloadEncoder::add_bool(unsigned char idx_in, bool value, unsigned int pos)
-{
-    /**
-     * @brief Adds a boolean value to the payload buffer at the specified position.
-     *
-     * This function sets or clears a specific bit in the buffer based on the given boolean value.
-     * If the value is true, the bit at the specified position is set to 1.
-     * If the value is false, the bit at the specified position is set to 0.
-     *
-     * @param idx_in The index of the buffer where the boolean value will be added.
-     * @param value The boolean value to be added to the buffer.
-     * @param pos The position of the bit in the buffer where the boolean value will be added.
-     * @return The updated index of the buffer.
-     */
-
-    if (value)
-    {
-        _buffer[idx_in] |= (1 << pos);
-    }
-    else
+    if (capacity < SENSOR_PAYLOAD_SIZE)
     {
-        _buffer[idx_in] &= ~(1 << pos);
+        return 0;
     }
-    if (pos == 0)
-    {
-        idx_in++;
-    }
-    return (idx_in);
-}
 
+    payloadCodecV1::encode(_fields, out);
+    return SENSOR_PAYLOAD_SIZE;
+}
 
 void payloadEncoder::setTestValues()
 {
@@ -136,4 +65,39 @@ void payloadEncoder::setTestValues()
     set_trapDisplacement(false);
     set_batteryStatus(4);
     set_unixTime(5);
-}
\ No newline at end of file
+}
+
+void payloadEncoder::set_id(uint32_t id)
+{
+    _fields.id = id;
+}
+
+void payloadEncoder::set_version(uint8_t version)
+{
+    _fields.version = version;
+}
+
+void payloadEncoder::set_doorStatus(bool doorStatus)
+{
+    _fields.doorStatus = doorStatus;
+}
+
+void payloadEncoder::set_catchDetect(bool catchDetect)
+{
+    _fields.catchDetect = catchDetect;
+}
+
+void payloadEncoder::set_trapDisplacement(bool trapDisplacement)
+{
+    _fields.trapDisplacement = trapDisplacement;
+}
+
+void payloadEncoder::set_batteryStatus(uint8_t batteryStatus)
+{
+    _fields.batteryStatus = batteryStatus;
+}
+
+void payloadEncoder::set_unixTime(uint32_t unixTime)
+{
+    _fields.unixTime = unixTime;
+}
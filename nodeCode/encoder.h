@@ -11,13 +11,17 @@
 
 #include <stdint.h> /// uint8_t, uint16_t, and uint32_t type
 
-const uint8_t SENSOR_PAYLOAD_SIZE = 11; ///< Payload size for sensor
+#include "payloadSchema.h"
+
+const uint8_t SENSOR_PAYLOAD_SIZE = payloadCodecV1::size; ///< Payload size for sensor (full layout, the largest)
 
 /**
  * @class payloadEncoder
  * @brief payload endoder class
  *
  * This class wil encode variables for the LoRaWAN application in to a single payload
+ * The byte layout is generated from payloadLayoutV1 in payloadSchema.h, or from the compact
+ * payloadLayoutV2 when the version is set to PAYLOAD_VERSION_COMPACT.
  * The class is setup using both .h and .cpp files where the setters and getters are
  * placed in to the .cpp file.
  * The `payloadEncoder` class is responsible for encoding payload data that includes various sensor readings and status information.
@@ -30,40 +34,9 @@ const uint8_t SENSOR_PAYLOAD_SIZE = 11; ///< Payload size for sensor
 class payloadEncoder
 {
 private:
-    uint32_t _id;           ///< Identification number (4 bytes)
-    uint8_t _version;       ///< Payload version number (1 byte)
-    bool _doorStatus;       ///< Door status (1 bit)
-    bool _catchDetect;      ///< Catch detection (1 bit)
-    bool _trapDisplacement; ///< Trap displacement (1 bit)
-    uint8_t _batteryStatus; ///< Battery status (1 byte)
-    uint32_t _unixTime;     ///< Date and time (4 bytes)
-    uint8_t *_buffer;       ///< buffer containing payload with sensor data
-    uint8_t _bufferSize;    ///< Size of payload for housekeeping.
-
-    /// @brief add uint8_t value to the buffer at the specified index.
-    /// @param idx_in The index in the buffer where the value should be added.
-    /// @param value The uint8_t value to be added to the buffer.
-    /// @return First free location at which new dat acan be stored in _buffer
-    unsigned char add_uint8(unsigned char idx_in, const uint8_t value);
-
-    /// @brief  add uint16 to payload
-    /// @param idx_in start location in _buffer
-    /// @param value uint16_t value
-    /// @return First free location at which new dat acan be stored in _buffer
-    unsigned char add_uint16(unsigned char idx_in, const uint16_t value);
-
-    /// @brief add uint32 to payload
-    /// @param idx_in start location in _buffer
-    /// @param value uint32_t value
-    /// @return First free location at which new dat acan be stored in _buffer
-    unsigned char add_uint32(unsigned char idx_in, uint32_t value);
-
-    /// @brief add boolean value to the buffer at the specified index.
-    /// @param idx_in The index in the buffer where the value should be added.
-    /// @param value The boolean value to be added to the buffer.
-    /// @param pos The position in the byte where the boolean value should be added.
-    /// @return First free location at which new dat acan be stored in _buffer
-    unsigned char add_bool(unsigned char idx_in, bool value, unsigned int pos);
+    payloadFields _fields;                ///< Field values to encode (layout in payloadSchema.h)
+    uint8_t _buffer[SENSOR_PAYLOAD_SIZE]; ///< buffer containing payload with sensor data (no heap allocation)
+    uint8_t _bufferSize;                  ///< Size of payload for housekeeping.
 
 public:
     payloadEncoder();                                           ///< Constructor
@@ -79,6 +52,15 @@ public:
     /// This function composes the payload by adding all the sensor data and status information to the buffer.
     void composePayload();
 
+    /// @brief encode payload into a caller-supplied buffer
+    /// Writes the same bytes as composePayload() without touching the internal buffer,
+    /// so a single encoder can fill many buffers without any heap use or I/O.
+    /// @param out buffer receiving the payload
+    /// @param capacity size of `out` in bytes
+    /// @return number of bytes written (8 for PAYLOAD_VERSION_COMPACT, else SENSOR_PAYLOAD_SIZE),
+    ///         or 0 if `capacity` is smaller than that
+    uint8_t encodeInto(uint8_t *out, uint8_t capacity) const;
+
     /// @brief get payload size
     /// This function returns the size of the payload in bytes.
     /// @return The size of the payload in bytes.
@@ -120,13 +102,13 @@ public:
     void set_trapDisplacement(bool trapDisplacement);
 
     /**
-     * @brief Set the battery status (0-255).
+     * @brief Set the battery status (0-255; the compact layout stores at most 127).
      * @param batteryStatus Battery level (uint8_t)
      */
     void set_batteryStatus(uint8_t batteryStatus);
 
     /**
-     * @brief Set the unix time for the payload.
+     * @brief Set the unix time for the payload (the compact layout sends its low 14 bits).
      * @param unixTime Unix timestamp (uint32_t)
      */
     void set_unixTime(uint32_t unixTime);
@@ -12,6 +12,7 @@
 #include "catchSensor.h"
 #include "displacementSensor.h"
 #include "batterySensor.h"
+#include "sendPolicy.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
@@ -36,23 +37,17 @@
  */
 
 // --- Configuration ---
-/**
- * @def MIN_SEND_INTERVAL_MS
- * @brief Minimum interval (ms) between transmissions (duty cycle compliance).
- * @details Set to 12s for demo; increase for production.
- */
-#define MIN_SEND_INTERVAL_MS 10000UL ///< Minimum interval (ms) between transmissions (set to 10s for testing)
-/**
- * @def EVENT_DEBOUNCE_MS
- * @brief Debounce time (ms) for event-triggered sends.
- */
-#define EVENT_DEBOUNCE_MS 2000UL
-/**
- * @def HEARTBEAT_INTERVAL_MS
- * @brief Heartbeat interval (ms) for periodic transmission.
- * @details Set to 10s for testing; adjust as needed.
- */
-#define HEARTBEAT_INTERVAL_MS 10000UL
+// MIN_SEND_INTERVAL_MS, EVENT_DEBOUNCE_MS and HEARTBEAT_INTERVAL_MS are defined in sendPolicy.h,
+// which is shared with the fleet simulator in payloadCoder.
+
+// Define PAYLOAD_COMPACT to send the 8-byte version 2 payload. The receiver restores its time
+// from the receive time, so only enable it once unixTime comes from a synced clock; the
+// simulated clock below starts in 2024 and would be widened to the wrong period.
+#ifdef PAYLOAD_COMPACT
+const uint8_t NODE_PAYLOAD_VERSION = PAYLOAD_VERSION_COMPACT; ///< 8-byte bit-packed layout
+#else
+const uint8_t NODE_PAYLOAD_VERSION = PAYLOAD_VERSION;         ///< Full 11-byte layout
+#endif
 
 // --- Global Flags ---
 volatile bool eventTriggered = false;         ///< Generic event flag, can be repurposed or used alongside specific ones
@@ -161,10 +156,8 @@ void setup()
     WDTCSR = (1 << WDIE) | (1 << WDP3); // 8s interval, interrupt only
 }
 
-static uint32_t lastHeartbeat = 0; ///< Last time a heartbeat was sent (ms)
 static uint32_t unixTime = 1717891200; ///< Simulated UNIX time (for demo/testing)
-static unsigned long lastSendTime = 0; ///< Last time a payload was sent (ms)
-static unsigned long lastEventTime = 0; ///< Last time an event was sent (ms)
+static sendPolicyState sendState = {0, 0, 0}; ///< Last send, event send and heartbeat send times (ms)
 
 /**
  * @brief Main loop: Handles event/heartbeat detection, debounce, state change, and LoRaWAN transmission.
@@ -177,21 +170,20 @@ static unsigned long lastEventTime = 0; ///< Last time an event was sent (ms)
  *    - Resets all event flags to false, then re-enables interrupts (`sei()`).
  *    - This ensures no ISR event is missed or double-counted.
  *
- * 2. **Duty Cycle Enforcement:**
+ * 2. **Duty Cycle Enforcement:** (sendPolicyDecide() in sendPolicy.h)
  *    - Checks if the minimum interval (`MIN_SEND_INTERVAL_MS`) has elapsed since the last transmission.
  *    - Prevents any send (event or heartbeat) if the duty cycle would be violated.
  *
- * 3. **Event-Driven Transmission Logic:**
- *    - If any event flag is set (generic or specific sensor), and debounce and duty cycle conditions are met, sets `shouldSend` to true.
+ * 3. **Event-Driven Transmission Logic:** (sendPolicyDecide())
+ *    - If any event flag is set (generic or specific sensor), and debounce and duty cycle conditions are met, a send is due.
  *    - Updates `lastEventTime` to enforce debounce for event-driven sends.
  *
- * 4. **Periodic Heartbeat Transmission Logic:**
- *    - If a heartbeat event (WDT or timed interval) is triggered and duty cycle allows, sets `shouldSend` to true.
+ * 4. **Periodic Heartbeat Transmission Logic:** (sendPolicyDecide())
+ *    - If a heartbeat event (WDT or timed interval) is triggered and duty cycle allows, a send is due.
  *    - Updates `lastHeartbeat` to track last heartbeat send.
  *
  * 5. **Payload Assembly and Transmission:**
- *    - If `shouldSend` is true:
- *      - Updates `lastSendTime`.
+ *    - If `shouldSend` is true (sendPolicyDecide() has already updated `lastSendTime`):
  *      - Simulates sensor state changes with button presses (for demo/testing).
  *      - Reads current sensor states (door, catch, displacement).
  *      - Detects if any state has changed since the last send.
@@ -226,30 +218,22 @@ void loop()
     sei(); // Re-enable interrupts
 
     unsigned long now = millis(); ///< Current time in milliseconds
-    /// Check if enough time has passed since the last transmission to comply with duty cycle
-    bool canSend = (now - lastSendTime) > MIN_SEND_INTERVAL_MS;
 
-    // --- Event-Driven Transmission Logic ---
-    // Check if any sensor event was triggered, if we are allowed to send (duty cycle),
-    // and if enough time has passed since the last event (debounce).
-    if ((genericEvent || specificDoorEvent || specificCatchEvent || specificDisplacementEvent) && canSend && (now - lastEventTime > EVENT_DEBOUNCE_MS)) {
+    // --- Event-Driven and Periodic Heartbeat Transmission Logic ---
+    // Duty cycle, event debounce and heartbeat interval are checked in sendPolicyDecide(),
+    // which also updates the send timers (see sendPolicy.h).
+    bool anyEvent = genericEvent || specificDoorEvent || specificCatchEvent || specificDisplacementEvent;
+    uint8_t sendReason = sendPolicyDecide(sendState, now, anyEvent, WDTHeartbeat);
+    if (sendReason & SEND_EVENT) {
         debugSerial.println("DEBUG: Event-driven send triggered.");
-        shouldSend = true;
-        lastEventTime = now; ///< Update the time of the last event-driven send attempt
     }
-
-    // --- Periodic Heartbeat Transmission Logic ---
-    // Check if a WDT heartbeat occurred OR if the timed heartbeat interval has elapsed,
-    // AND if we are allowed to send (duty cycle).
-    if ((WDTHeartbeat || (now - lastHeartbeat > HEARTBEAT_INTERVAL_MS)) && canSend) {
+    if (sendReason & SEND_HEARTBEAT) {
         debugSerial.println(WDTHeartbeat ? "DEBUG: WDT Heartbeat triggered send." : "DEBUG: Timed Heartbeat triggered send.");
-        shouldSend = true;
-        lastHeartbeat = now; ///< Update the time of the last heartbeat send attempt
     }
+    shouldSend = sendReason != 0;
 
     // --- Payload Assembly and Transmission ---
     if (shouldSend) {
-        lastSendTime = now; ///< Update the time of the last transmission
 
         // Simulate sensor state changes with buttons for testing/demo
         // These would typically be replaced with actual sensor readings or ISR-driven flags in a real deployment.
@@ -301,9 +285,9 @@ void loop()
         unixTime++;
 
         // Assemble and send payload
-        payloadEncoder encoder; ///< Payload encoder object
+        payloadEncoder encoder; ///< Payload encoder object (fixed-size, no heap use)
         uint32_t id = 12345;    ///< Device ID for payload (example)
-        uint8_t version = 1;    ///< Payload format version (example)
+        uint8_t version = NODE_PAYLOAD_VERSION; ///< Payload format version (see payloadSchema.h)
 
         // Set payload fields
         encoder.set_id(id);
@@ -314,9 +298,8 @@ void loop()
         encoder.set_batteryStatus(myBatterySensor.getBatteryLevel());
         encoder.set_unixTime(unixTime);
 
-        encoder.composePayload(); ///< Assemble the binary payload
-        uint8_t *payloadBuffer = encoder.getPayload(); ///< Get pointer to the payload buffer
-        uint8_t payloadSize = encoder.getPayloadSize();   ///< Get the size of the payload
+        uint8_t payloadBuffer[SENSOR_PAYLOAD_SIZE]; ///< Payload buffer on the stack (fits every layout)
+        uint8_t payloadSize = encoder.encodeInto(payloadBuffer, sizeof(payloadBuffer)); ///< Assemble the binary payload
 
         // --- Debug Output: Sensor and Payload Status ---
         debugSerial.println("================ SENSOR & PAYLOAD STATUS ================");
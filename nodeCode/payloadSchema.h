@@ -0,0 +1,312 @@
+/**
+ * @file payloadSchema.h
+ * @brief Single definition of the muskrat trap payload layout, shared by nodeCode and payloadCoder.
+ *
+ * The layout is declared once as a compile-time list of fields. Each field has a width in bits;
+ * fields are packed back-to-back, most significant bit first, so multi-byte integers end up
+ * big-endian. payloadCodec generates the encode and decode functions from that list. All
+ * offsets are template constants, so both the AVR and host builds compile to straight-line
+ * byte stores and loads without any runtime offset bookkeeping.
+ *
+ * Adding a field: add a member to payloadFields, a value to payloadFieldId and one
+ * payloadField<> entry to the layout. Encoders and decoders pick it up automatically.
+ *
+ * Adding a layout version: declare the new layout and specialise payloadVersionLayout for its
+ * version number. The version byte stays at PAYLOAD_VERSION_INDEX, so a receiver can always
+ * find the layout of a frame; payloadCoder builds its per-version decoder table from these
+ * specialisations.
+ *
+ * Version 2 is a compact layout for the uplink: 8 bytes instead of 11, which shortens the
+ * time-on-air of every uplink and leaves more of the duty cycle at high spreading factors. The
+ * flags are single bits, the battery percentage takes 7 bits and only the low
+ * PAYLOAD_TIME_BITS_V2 bits of unixTime are sent. The receiver knows when the uplink arrived
+ * and restores the full time with payloadExpandTime(), which works as long as node and
+ * receiver clocks differ by less than half the 2^14 s (4.5 h) period.
+ *
+ * This header only needs <stdint.h> and C++11, so it builds with the Arduino AVR toolchain.
+ */
+
+#ifndef PAYLOADSCHEMA_H
+#define PAYLOADSCHEMA_H
+
+#include <stdint.h> // uint8_t, uint16_t, and uint32_t type
+
+const uint8_t PAYLOAD_VERSION = 1;         ///< Full payload layout, the form in which receivers keep frames
+const uint8_t PAYLOAD_VERSION_COMPACT = 2; ///< Bit-packed payload layout, sent by nodes built with PAYLOAD_COMPACT
+const uint8_t PAYLOAD_VERSION_INDEX = 4;   ///< Byte index of the version field in every layout
+const uint8_t PAYLOAD_TIME_BITS_V2 = 14;   ///< Low bits of unixTime carried by version 2
+
+/// \brief values carried by a payload
+struct payloadFields
+{
+    uint32_t id;           ///< Identification number
+    uint8_t version;       ///< Payload version number
+    bool doorStatus;       ///< Door status (true if closed)
+    bool catchDetect;      ///< Catch detection
+    bool trapDisplacement; ///< Trap displacement
+    uint8_t batteryStatus; ///< Battery status
+    uint32_t unixTime;     ///< Date and time
+};
+
+/// \brief names of the payload fields, used to look up offsets at compile time
+enum class payloadFieldId : uint8_t
+{
+    id,
+    version,
+    doorStatus,
+    catchDetect,
+    trapDisplacement,
+    batteryStatus,
+    unixTime,
+    padding
+};
+
+/// \brief read or write `Bits` bits starting at bit `Offset` (MSB first)
+/// Each instance handles the part of the value that falls into one byte and forwards the
+/// remaining bits to the next byte.
+template <uint16_t Offset, uint8_t Bits, bool Done = (Bits == 0)>
+struct payloadBits
+{
+    static constexpr uint16_t index = Offset / 8;                                 ///< byte holding the first bit
+    static constexpr uint8_t room = 8 - Offset % 8;                               ///< bits left in that byte
+    static constexpr uint8_t take = Bits < room ? Bits : room;                    ///< bits stored in that byte
+    static constexpr uint8_t shift = room - take;                                 ///< position of those bits in the byte
+    static constexpr uint8_t mask = static_cast<uint8_t>(((1u << take) - 1) << shift); ///< mask of those bits
+    typedef payloadBits<Offset + take, Bits - take> next;                        ///< remaining bits
+
+    /// \brief OR the value into a zeroed buffer
+    static inline void write(uint8_t *buf, uint32_t value)
+    {
+        buf[index] |= static_cast<uint8_t>((value >> (Bits - take)) << shift) & mask;
+        next::write(buf, value);
+    }
+
+    /// \brief read the value, appending it to `acc`
+    static inline uint32_t read(const uint8_t *buf, uint32_t acc = 0)
+    {
+        return next::read(buf, (acc << take) | static_cast<uint32_t>((buf[index] & mask) >> shift));
+    }
+};
+
+/// \brief end of recursion: no bits left
+template <uint16_t Offset, uint8_t Bits>
+struct payloadBits<Offset, Bits, true>
+{
+    static inline void write(uint8_t *, uint32_t) {}
+    static inline uint32_t read(const uint8_t *, uint32_t acc = 0) { return acc; }
+};
+
+/// \brief field of `Bits` bits stored in payloadFields::*Member
+/// Values too large for the field are stored as the largest value that fits.
+template <payloadFieldId Id, typename T, T payloadFields::*Member, uint8_t Bits>
+struct payloadField
+{
+    static constexpr payloadFieldId fieldId = Id;                                      ///< field name
+    static constexpr uint8_t bits = Bits;                                              ///< width in bits
+    static constexpr uint32_t largest = static_cast<uint32_t>((2ULL << (Bits - 1)) - 1); ///< largest value that fits
+
+    template <uint16_t Offset>
+    static inline void encode(const payloadFields &fields, uint8_t *buf)
+    {
+        const uint32_t value = static_cast<uint32_t>(fields.*Member);
+        payloadBits<Offset, Bits>::write(buf, value > largest ? largest : value);
+    }
+
+    template <uint16_t Offset>
+    static inline void decode(const uint8_t *buf, payloadFields &fields)
+    {
+        fields.*Member = static_cast<T>(payloadBits<Offset, Bits>::read(buf));
+    }
+};
+
+/// \brief low `Bits` bits of payloadFields::unixTime
+/// Decoding yields only those bits; payloadExpandTime() restores the full time.
+template <uint8_t Bits>
+struct payloadTimeField
+{
+    static constexpr payloadFieldId fieldId = payloadFieldId::unixTime; ///< field name
+    static constexpr uint8_t bits = Bits;                               ///< width in bits
+
+    template <uint16_t Offset>
+    static inline void encode(const payloadFields &fields, uint8_t *buf)
+    {
+        payloadBits<Offset, Bits>::write(buf, fields.unixTime & ((1UL << Bits) - 1));
+    }
+
+    template <uint16_t Offset>
+    static inline void decode(const uint8_t *buf, payloadFields &fields)
+    {
+        fields.unixTime = payloadBits<Offset, Bits>::read(buf);
+    }
+};
+
+/// \brief unused bits, always encoded as zero
+template <uint8_t Bits>
+struct payloadPadding
+{
+    static constexpr payloadFieldId fieldId = payloadFieldId::padding; ///< field name
+    static constexpr uint8_t bits = Bits;                              ///< width in bits
+
+    template <uint16_t Offset>
+    static inline void encode(const payloadFields &, uint8_t *) {}
+
+    template <uint16_t Offset>
+    static inline void decode(const uint8_t *, payloadFields &) {}
+};
+
+/// \brief ordered list of fields making up a payload
+template <typename... Fields>
+struct payloadLayout;
+
+/// \brief empty layout (end of recursion)
+template <>
+struct payloadLayout<>
+{
+    static constexpr uint16_t bits = 0; ///< total width in bits
+
+    /// \brief bit offset of a field, or 0xFFFF if the layout does not contain it
+    static constexpr uint16_t offsetOf(payloadFieldId, uint16_t = 0) { return 0xFFFF; }
+
+    /// \brief width in bits of a field, or 0 if the layout does not contain it
+    static constexpr uint8_t bitsOf(payloadFieldId) { return 0; }
+
+    template <uint16_t Offset>
+    static inline void encodeAt(const payloadFields &, uint8_t *) {}
+
+    template <uint16_t Offset>
+    static inline void decodeAt(const uint8_t *, payloadFields &) {}
+};
+
+/// \brief layout starting with `Field`, followed by `Rest`
+template <typename Field, typename... Rest>
+struct payloadLayout<Field, Rest...>
+{
+    static constexpr uint16_t bits = Field::bits + payloadLayout<Rest...>::bits; ///< total width in bits
+
+    /// \brief bit offset of a field, or 0xFFFF if the layout does not contain it
+    static constexpr uint16_t offsetOf(payloadFieldId id, uint16_t base = 0)
+    {
+        return Field::fieldId == id ? base : payloadLayout<Rest...>::offsetOf(id, base + Field::bits);
+    }
+
+    /// \brief width in bits of a field, or 0 if the layout does not contain it
+    static constexpr uint8_t bitsOf(payloadFieldId id)
+    {
+        return Field::fieldId == id ? Field::bits : payloadLayout<Rest...>::bitsOf(id);
+    }
+
+    template <uint16_t Offset>
+    static inline void encodeAt(const payloadFields &fields, uint8_t *buf)
+    {
+        Field::template encode<Offset>(fields, buf);
+        payloadLayout<Rest...>::template encodeAt<Offset + Field::bits>(fields, buf);
+    }
+
+    template <uint16_t Offset>
+    static inline void decodeAt(const uint8_t *buf, payloadFields &fields)
+    {
+        Field::template decode<Offset>(buf, fields);
+        payloadLayout<Rest...>::template decodeAt<Offset + Field::bits>(buf, fields);
+    }
+};
+
+/// \brief encoder and decoder generated from a layout
+template <typename Layout>
+struct payloadCodec
+{
+    static constexpr uint8_t size = (Layout::bits + 7) / 8; ///< encoded size in bytes
+
+    /// \brief encode all fields into `buf` (at least `size` bytes)
+    static inline void encode(const payloadFields &fields, uint8_t *buf)
+    {
+        for (uint8_t i = 0; i < size; i++)
+        {
+            buf[i] = 0;
+        }
+        Layout::template encodeAt<0>(fields, buf);
+    }
+
+    /// \brief decode all fields from `buf` (at least `size` bytes)
+    static inline void decode(const uint8_t *buf, payloadFields &fields)
+    {
+        Layout::template decodeAt<0>(buf, fields);
+    }
+};
+
+/// \brief payload version 1: 11 bytes
+/// | id (32) | version (8) | padding (5) | door (1) | catch (1) | displacement (1) | battery (8) | unixTime (32) |
+typedef payloadLayout<
+    payloadField<payloadFieldId::id, uint32_t, &payloadFields::id, 32>,
+    payloadField<payloadFieldId::version, uint8_t, &payloadFields::version, 8>,
+    payloadPadding<5>,
+    payloadField<payloadFieldId::doorStatus, bool, &payloadFields::doorStatus, 1>,
+    payloadField<payloadFieldId::catchDetect, bool, &payloadFields::catchDetect, 1>,
+    payloadField<payloadFieldId::trapDisplacement, bool, &payloadFields::trapDisplacement, 1>,
+    payloadField<payloadFieldId::batteryStatus, uint8_t, &payloadFields::batteryStatus, 8>,
+    payloadField<payloadFieldId::unixTime, uint32_t, &payloadFields::unixTime, 32>>
+    payloadLayoutV1;
+
+typedef payloadCodec<payloadLayoutV1> payloadCodecV1; ///< Version 1 encoder/decoder
+
+/// \brief payload version 2: 8 bytes, bit-packed
+/// | id (32) | version (8) | door (1) | catch (1) | displacement (1) | battery (7) | unixTime low bits (14) |
+typedef payloadLayout<
+    payloadField<payloadFieldId::id, uint32_t, &payloadFields::id, 32>,
+    payloadField<payloadFieldId::version, uint8_t, &payloadFields::version, 8>,
+    payloadField<payloadFieldId::doorStatus, bool, &payloadFields::doorStatus, 1>,
+    payloadField<payloadFieldId::catchDetect, bool, &payloadFields::catchDetect, 1>,
+    payloadField<payloadFieldId::trapDisplacement, bool, &payloadFields::trapDisplacement, 1>,
+    payloadField<payloadFieldId::batteryStatus, uint8_t, &payloadFields::batteryStatus, 7>,
+    payloadTimeField<PAYLOAD_TIME_BITS_V2>>
+    payloadLayoutV2;
+
+typedef payloadCodec<payloadLayoutV2> payloadCodecV2; ///< Version 2 encoder/decoder
+
+/// \brief restore a unix time of which only the low `bits` bits were sent
+/// \param low the low bits, as decoded
+/// \param bits number of bits sent (32: the full time, returned as it is)
+/// \param reference time the uplink was received
+/// \return the time with these low bits that lies nearest to `reference`
+inline uint32_t payloadExpandTime(uint32_t low, uint8_t bits, uint32_t reference)
+{
+    if (bits >= 32)
+    {
+        return low;
+    }
+    const uint32_t period = 1UL << bits;
+    const uint32_t ahead = (low - reference) & (period - 1); // seconds from reference forward to the next match
+    return ahead < period / 2 ? reference + ahead : reference + ahead - period;
+}
+
+/// \brief layout of payload version `Version`; `known` is false for versions without a layout
+template <uint8_t Version>
+struct payloadVersionLayout
+{
+    static constexpr bool known = false; ///< no layout for this version
+};
+
+/// \brief version 1 layout
+template <>
+struct payloadVersionLayout<1>
+{
+    static constexpr bool known = true; ///< layout available
+    typedef payloadLayoutV1 layout;     ///< field list
+};
+
+/// \brief version 2 layout
+template <>
+struct payloadVersionLayout<2>
+{
+    static constexpr bool known = true; ///< layout available
+    typedef payloadLayoutV2 layout;     ///< field list
+};
+
+static_assert(payloadLayoutV1::offsetOf(payloadFieldId::version) == PAYLOAD_VERSION_INDEX * 8,
+              "the version byte must stay at PAYLOAD_VERSION_INDEX in every layout");
+static_assert(payloadLayoutV2::offsetOf(payloadFieldId::version) == PAYLOAD_VERSION_INDEX * 8,
+              "the version byte must stay at PAYLOAD_VERSION_INDEX in every layout");
+static_assert(payloadVersionLayout<PAYLOAD_VERSION>::known && payloadVersionLayout<PAYLOAD_VERSION_COMPACT>::known,
+              "the versions produced by the node need a layout");
+static_assert(payloadCodecV2::size <= payloadCodecV1::size, "the full layout must be the largest");
+
+#endif // PAYLOADSCHEMA_H
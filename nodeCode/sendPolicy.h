@@ -0,0 +1,76 @@
+/**
+ * @file sendPolicy.h
+ * @brief When the node transmits: duty cycle, event debounce and heartbeat timing.
+ *
+ * loop() in nodeCode.ino asks sendPolicyDecide() on every pass whether to send. The fleet
+ * simulator in payloadCoder uses the same function, so simulated traffic follows the
+ * firmware's rules exactly, including the wrap-around of the 32-bit millisecond clock.
+ *
+ * This header only needs <stdint.h> and C++11, so it builds with the Arduino AVR toolchain.
+ */
+
+#ifndef SENDPOLICY_H
+#define SENDPOLICY_H
+
+#include <stdint.h> // uint8_t and uint32_t type
+
+/**
+ * @def MIN_SEND_INTERVAL_MS
+ * @brief Minimum interval (ms) between transmissions (duty cycle compliance).
+ * @details Set to 10s for testing; increase for production.
+ */
+#define MIN_SEND_INTERVAL_MS 10000UL
+/**
+ * @def EVENT_DEBOUNCE_MS
+ * @brief Debounce time (ms) for event-triggered sends.
+ */
+#define EVENT_DEBOUNCE_MS 2000UL
+/**
+ * @def HEARTBEAT_INTERVAL_MS
+ * @brief Heartbeat interval (ms) for periodic transmission.
+ * @details Set to 10s for testing; adjust as needed.
+ */
+#define HEARTBEAT_INTERVAL_MS 10000UL
+
+const uint8_t SEND_EVENT = 1 << 0;     ///< Send triggered by a sensor event
+const uint8_t SEND_HEARTBEAT = 1 << 1; ///< Send triggered by a heartbeat (watchdog or timed)
+
+/// \brief send timers kept by the node between passes of loop()
+struct sendPolicyState
+{
+    uint32_t lastSendTime;  ///< Last time a payload was sent (ms)
+    uint32_t lastEventTime; ///< Last time an event was sent (ms)
+    uint32_t lastHeartbeat; ///< Last time a heartbeat was sent (ms)
+};
+
+/// \brief decide whether to send on this pass of loop(), and update the timers if so
+/// An event is sent when the duty cycle allows it and the previous event send is older than
+/// EVENT_DEBOUNCE_MS. A heartbeat is sent when the watchdog fired or HEARTBEAT_INTERVAL_MS has
+/// passed, again only when the duty cycle allows it. Flags that cannot be sent are dropped.
+/// \param state timers of the node
+/// \param now current time in ms (millis())
+/// \param event a sensor event occurred since the previous pass
+/// \param heartbeatTick the watchdog heartbeat fired since the previous pass
+/// \return SEND_EVENT and/or SEND_HEARTBEAT, or 0 if nothing is sent
+inline uint8_t sendPolicyDecide(sendPolicyState &state, uint32_t now, bool event, bool heartbeatTick)
+{
+    const bool canSend = (now - state.lastSendTime) > MIN_SEND_INTERVAL_MS;
+    uint8_t reason = 0;
+    if (event && canSend && (now - state.lastEventTime > EVENT_DEBOUNCE_MS))
+    {
+        reason |= SEND_EVENT;
+        state.lastEventTime = now;
+    }
+    if ((heartbeatTick || (now - state.lastHeartbeat > HEARTBEAT_INTERVAL_MS)) && canSend)
+    {
+        reason |= SEND_HEARTBEAT;
+        state.lastHeartbeat = now;
+    }
+    if (reason != 0)
+    {
+        state.lastSendTime = now;
+    }
+    return reason;
+}
+
+#endif // SENDPOLICY_H
@@ -0,0 +1,314 @@
+#include "archiveSegment.h"
+#include "decoder.h"
+
+#include <algorithm> // std::sort, std::lower_bound
+#include <string.h>  // memcmp, memcpy, memset
+
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+uint32_t archiveRecord::id() const
+{
+    return payloadBits<0, 32>::read(frame);
+}
+
+uint32_t archiveRecord::unixTime() const
+{
+    return payloadBits<payloadLayoutV1::offsetOf(payloadFieldId::unixTime), 32>::read(frame);
+}
+
+segmentWriter::segmentWriter() : _file(nullptr), _pending(), _failed(false)
+{
+}
+
+segmentWriter::~segmentWriter()
+{
+    close();
+}
+
+bool segmentWriter::create(const char *path)
+{
+    close();
+    _pending.clear();
+    _failed = false;
+
+    _file = fopen(path, "wb");
+    if (_file == nullptr)
+    {
+        return false;
+    }
+
+    archiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_SEGMENT_MAGIC, sizeof(header.magic));
+    header.formatVersion = ARCHIVE_FORMAT_VERSION;
+    header.recordSize = sizeof(archiveRecord);
+    header.frameSize = SENSOR_PAYLOAD_SIZE;
+    if (fwrite(&header, sizeof(header), 1, _file) != 1)
+    {
+        _failed = true;
+    }
+    return !_failed;
+}
+
+bool segmentWriter::append(const uint8_t *frame, const uplinkMeta &meta)
+{
+    return append(makeArchiveRecord(frame, meta));
+}
+
+bool segmentWriter::append(const archiveRecord &record)
+{
+    if (_file == nullptr)
+    {
+        return false;
+    }
+
+    if (fwrite(&record, sizeof(record), 1, _file) != 1)
+    {
+        _failed = true;
+        return false;
+    }
+
+    _pending.push_back(pending{record.id(), record.unixTime(), static_cast<uint32_t>(_pending.size())});
+    return true;
+}
+
+bool segmentWriter::close()
+{
+    if (_file == nullptr)
+    {
+        return !_failed;
+    }
+
+    /** Group the records by trap; ties are broken on record number so postings stay in arrival order. */
+    std::sort(_pending.begin(), _pending.end(), [](const pending &a, const pending &b)
+              { return a.id != b.id ? a.id < b.id : a.record < b.record; });
+
+    std::vector<archiveIndexEntry> entries;
+    std::vector<uint32_t> postings;
+    postings.reserve(_pending.size());
+    for (size_t i = 0; i < _pending.size(); i++)
+    {
+        const pending &p = _pending[i];
+        if (entries.empty() || entries.back().id != p.id)
+        {
+            entries.push_back(archiveIndexEntry{p.id, p.unixTime, p.unixTime, static_cast<uint32_t>(i), 0});
+        }
+        archiveIndexEntry &entry = entries.back();
+        entry.minTime = std::min(entry.minTime, p.unixTime);
+        entry.maxTime = std::max(entry.maxTime, p.unixTime);
+        entry.count++;
+        postings.push_back(p.record);
+    }
+
+    archiveTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.recordCount = _pending.size();
+    trailer.indexOffset = sizeof(archiveHeader) + _pending.size() * sizeof(archiveRecord);
+    trailer.entryCount = static_cast<uint32_t>(entries.size());
+    memcpy(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(trailer.magic));
+
+    if (fwrite(entries.data(), sizeof(archiveIndexEntry), entries.size(), _file) != entries.size() ||
+        fwrite(postings.data(), sizeof(uint32_t), postings.size(), _file) != postings.size() ||
+        fwrite(&trailer, sizeof(trailer), 1, _file) != 1)
+    {
+        _failed = true;
+    }
+    if (fclose(_file) != 0)
+    {
+        _failed = true;
+    }
+    _file = nullptr;
+    return !_failed;
+}
+
+segmentReader::segmentReader()
+    : _map(nullptr), _mapSize(0), _records(nullptr), _recordCount(0),
+      _index(nullptr), _entryCount(0), _postings(nullptr)
+{
+}
+
+segmentReader::~segmentReader()
+{
+    close();
+}
+
+bool segmentReader::open(const char *path)
+{
+    close();
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(archiveHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file referenced
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+    _map = static_cast<const uint8_t *>(map);
+    _mapSize = size;
+
+    const archiveHeader *header = reinterpret_cast<const archiveHeader *>(_map);
+    if (memcmp(header->magic, ARCHIVE_SEGMENT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->formatVersion != ARCHIVE_FORMAT_VERSION ||
+        header->recordSize != sizeof(archiveRecord) || header->frameSize != SENSOR_PAYLOAD_SIZE)
+    {
+        close();
+        return false;
+    }
+    _records = reinterpret_cast<const archiveRecord *>(_map + sizeof(archiveHeader));
+
+    /** Use the footer if the trailer is valid and consistent with the file size. */
+    if (size >= sizeof(archiveHeader) + sizeof(archiveTrailer))
+    {
+        archiveTrailer trailer; // copied: the trailer is only 4-byte aligned in the file
+        memcpy(&trailer, _map + size - sizeof(archiveTrailer), sizeof(trailer));
+        const uint64_t indexOffset = sizeof(archiveHeader) + trailer.recordCount * sizeof(archiveRecord);
+        if (memcmp(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(trailer.magic)) == 0 &&
+            trailer.indexOffset == indexOffset &&
+            indexOffset + static_cast<uint64_t>(trailer.entryCount) * sizeof(archiveIndexEntry) +
+                    trailer.recordCount * sizeof(uint32_t) + sizeof(archiveTrailer) == size)
+        {
+            _recordCount = static_cast<size_t>(trailer.recordCount);
+            _index = reinterpret_cast<const archiveIndexEntry *>(_map + indexOffset);
+            _entryCount = trailer.entryCount;
+            _postings = reinterpret_cast<const uint32_t *>(_index + _entryCount);
+            return true;
+        }
+    }
+
+    /** Unsealed segment: every whole record after the header. */
+    _recordCount = (size - sizeof(archiveHeader)) / sizeof(archiveRecord);
+    return true;
+}
+
+void segmentReader::close()
+{
+    if (_map != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(_map), _mapSize);
+    }
+    _map = nullptr;
+    _mapSize = 0;
+    _records = nullptr;
+    _recordCount = 0;
+    _index = nullptr;
+    _entryCount = 0;
+    _postings = nullptr;
+}
+
+const archiveIndexEntry *segmentReader::findTrap(uint32_t id) const
+{
+    const archiveIndexEntry *entry = std::lower_bound(indexBegin(), indexEnd(), id,
+                                                      [](const archiveIndexEntry &e, uint32_t key)
+                                                      { return e.id < key; });
+    return (entry != indexEnd() && entry->id == id) ? entry : nullptr;
+}
+
+size_t segmentReader::collectTrap(uint32_t id, std::vector<const archiveRecord *> &out) const
+{
+    const size_t before = out.size();
+    if (sealed())
+    {
+        const archiveIndexEntry *entry = findTrap(id);
+        if (entry != nullptr && static_cast<size_t>(entry->firstPosting) + entry->count <= _recordCount)
+        {
+            const uint32_t *numbers = postings(*entry);
+            for (uint32_t i = 0; i < entry->count; i++)
+            {
+                if (numbers[i] < _recordCount) // never follow a damaged posting out of the mapping
+                {
+                    out.push_back(&_records[numbers[i]]);
+                }
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < _recordCount; i++)
+        {
+            if (_records[i].id() == id)
+            {
+                out.push_back(&_records[i]);
+            }
+        }
+    }
+    return out.size() - before;
+}
+
+archiveRecord makeArchiveRecord(const uint8_t *frame, const uplinkMeta &meta)
+{
+    archiveRecord record;
+    memcpy(record.frame, frame, sizeof(record.frame));
+    record.snr = meta.snr;
+    record.rxTime = meta.rxTime;
+    record.fcnt = meta.fcnt;
+    record.rssi = meta.rssi;
+    record.reserved = 0;
+    return record;
+}
+
+uplinkMeta uplinkMetaOf(const uint8_t *frame, const ttnUplink *uplink)
+{
+    uplinkMeta meta = {payloadBits<payloadLayoutV1::offsetOf(payloadFieldId::unixTime), 32>::read(frame), 0, 0, 0};
+    if (uplink != nullptr)
+    {
+        const uint32_t rxTime = ttnTimeToUnix(uplink->receivedAt);
+        meta.rxTime = rxTime != 0 ? rxTime : meta.rxTime;
+        meta.fcnt = uplink->fcnt;
+        meta.rssi = uplink->rssi;
+        /** Round to the nearest dB and clamp to the range of the field before narrowing. */
+        const float snr = uplink->snr < 0 ? uplink->snr - 0.5f : uplink->snr + 0.5f;
+        meta.snr = snr > INT8_MIN ? (snr < INT8_MAX ? static_cast<int8_t>(snr) : INT8_MAX) : INT8_MIN;
+    }
+    return meta;
+}
+
+size_t appendArchiveRecords(const uint8_t *frames, size_t length, const std::vector<ttnUplink> &uplinks,
+                            std::vector<archiveRecord> &out)
+{
+    const size_t count = length / SENSOR_PAYLOAD_SIZE;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *frame = frames + i * SENSOR_PAYLOAD_SIZE;
+        out.push_back(makeArchiveRecord(frame, uplinkMetaOf(frame, uplinks.empty() ? nullptr : &uplinks[i])));
+    }
+    return count;
+}
+
+size_t trapHistory(const segmentReader *const *segments, size_t count, uint32_t id, payloadBatch &out)
+{
+    std::vector<const archiveRecord *> records;
+    for (size_t i = 0; i < count; i++)
+    {
+        segments[i]->collectTrap(id, records);
+    }
+
+    /** Segments may overlap in time; order by payload time, then by receive time. */
+    std::stable_sort(records.begin(), records.end(), [](const archiveRecord *a, const archiveRecord *b)
+                     {
+                         const uint32_t ta = a->unixTime();
+                         const uint32_t tb = b->unixTime();
+                         return ta != tb ? ta < tb : a->rxTime < b->rxTime;
+                     });
+
+    std::vector<const uint8_t *> frames(records.size());
+    const std::vector<size_t> sizes(records.size(), SENSOR_PAYLOAD_SIZE);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        frames[i] = records[i]->frame;
+    }
+    return payloadDecoder::decodeBatch(frames.data(), sizes.data(), frames.size(), out);
+}
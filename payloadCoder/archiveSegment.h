@@ -0,0 +1,230 @@
+/**
+ * @file archiveSegment.h
+ * @brief Append-only uplink archive segments with a per-trap index, read through mmap.
+ *
+ * A segment file stores raw frames with their receive metadata so that trap history can be
+ * rebuilt without the database. Layout (all integers little-endian, all sections 4-byte aligned):
+ *
+ * | header (32 bytes) | record 0 | record 1 | ... | index entries | postings | trailer (32 bytes) |
+ *
+ * - Records (24 bytes each) are appended in arrival order while the segment is open.
+ * - When the writer is closed, it seals the segment by appending the footer: one index entry per
+ *   trap id (sorted by id) with the min/max payload unixTime, and a postings array that lists the
+ *   record numbers of each trap in arrival order. The trailer points at the footer.
+ * - A segment without a valid trailer (writer crashed) is still readable; the reader then scans
+ *   the records instead of using the index.
+ *
+ * Readers map the whole file and hand out pointers into the mapping; nothing is copied or parsed.
+ */
+
+#ifndef ARCHIVESEGMENT_H
+#define ARCHIVESEGMENT_H
+
+#include <stdint.h> // uint8_t, int8_t, int16_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+#include <vector>
+
+#include "encoder.h"
+#include "payloadBatch.h"
+#include "ttnUplink.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "archive segments are mapped as little-endian structures");
+
+const char ARCHIVE_SEGMENT_MAGIC[8] = {'M', 'R', 'T', 'S', 'E', 'G', '0', '1'}; ///< First bytes of every segment
+const char ARCHIVE_INDEX_MAGIC[8] = {'M', 'R', 'T', 'I', 'D', 'X', '0', '1'};   ///< Last bytes of a sealed segment
+const uint32_t ARCHIVE_FORMAT_VERSION = 1;                                        ///< Segment format version
+
+/// \brief receive metadata stored with each frame
+struct uplinkMeta
+{
+    uint32_t rxTime; ///< Receive time at the network server (unix time)
+    uint32_t fcnt;   ///< LoRaWAN frame counter
+    int16_t rssi;    ///< Received signal strength in dBm
+    int8_t snr;      ///< Signal to noise ratio in dB (rounded)
+};
+
+/// \brief one archived uplink (24 bytes)
+struct archiveRecord
+{
+    uint8_t frame[SENSOR_PAYLOAD_SIZE]; ///< Raw payload as received
+    int8_t snr;                         ///< Signal to noise ratio in dB (rounded)
+    uint32_t rxTime;                    ///< Receive time at the network server (unix time)
+    uint32_t fcnt;                      ///< LoRaWAN frame counter
+    int16_t rssi;                       ///< Received signal strength in dBm
+    uint16_t reserved;                  ///< Always 0
+
+    /// \brief trap id from the frame
+    uint32_t id() const;
+
+    /// \brief payload unixTime from the frame
+    uint32_t unixTime() const;
+};
+
+/// \brief segment file header (32 bytes)
+struct archiveHeader
+{
+    char magic[8];          ///< ARCHIVE_SEGMENT_MAGIC
+    uint32_t formatVersion; ///< ARCHIVE_FORMAT_VERSION
+    uint32_t recordSize;    ///< sizeof(archiveRecord)
+    uint32_t frameSize;     ///< SENSOR_PAYLOAD_SIZE
+    uint32_t reserved[3];   ///< Always 0
+};
+
+/// \brief footer index entry: all records of one trap (20 bytes)
+struct archiveIndexEntry
+{
+    uint32_t id;          ///< Trap id
+    uint32_t minTime;     ///< Lowest payload unixTime of the trap in this segment
+    uint32_t maxTime;     ///< Highest payload unixTime of the trap in this segment
+    uint32_t firstPosting; ///< Index of the first record number in the postings array
+    uint32_t count;       ///< Number of records of the trap
+};
+
+/// \brief segment trailer (32 bytes), last bytes of a sealed segment
+struct archiveTrailer
+{
+    uint64_t recordCount; ///< Number of records
+    uint64_t indexOffset; ///< File offset of the first index entry; postings follow the entries
+    uint32_t entryCount;  ///< Number of index entries
+    uint32_t reserved;    ///< Always 0
+    char magic[8];        ///< ARCHIVE_INDEX_MAGIC
+};
+
+static_assert(sizeof(archiveRecord) == 24, "archive record layout changed");
+static_assert(sizeof(archiveHeader) == 32, "archive header layout changed");
+static_assert(sizeof(archiveIndexEntry) == 20, "archive index entry layout changed");
+static_assert(sizeof(archiveTrailer) == 32, "archive trailer layout changed");
+
+/// \brief writes one segment file
+class segmentWriter
+{
+private:
+    /// \brief index information kept in memory until the segment is sealed
+    struct pending
+    {
+        uint32_t id;       ///< Trap id
+        uint32_t unixTime; ///< Payload unixTime
+        uint32_t record;   ///< Record number
+    };
+
+    FILE *_file;                   ///< Segment file, nullptr when closed
+    std::vector<pending> _pending; ///< One entry per appended record
+    bool _failed;                  ///< A write failed
+
+public:
+    segmentWriter();                                        ///< Constructor
+    ~segmentWriter();                                       ///< Destructor, seals an open segment
+    segmentWriter(const segmentWriter &) = delete;            ///< Copy constructor disabled
+    segmentWriter &operator=(const segmentWriter &) = delete; ///< Assignment operator disabled
+
+    /// \brief create a new segment, replacing an existing file
+    /// \param path file name
+    /// \return false if the file cannot be created
+    bool create(const char *path);
+
+    /// \brief append one uplink
+    /// \param frame payload of SENSOR_PAYLOAD_SIZE bytes
+    /// \param meta receive metadata
+    /// \return false if the segment is not open or the write failed
+    bool append(const uint8_t *frame, const uplinkMeta &meta);
+
+    /// \brief append one uplink that is already in record form
+    /// \param record uplink and receive metadata
+    /// \return false if the segment is not open or the write failed
+    bool append(const archiveRecord &record);
+
+    /// \brief write the footer index and close the file
+    /// \return false if any write failed
+    bool close();
+
+    /// \brief number of records appended so far
+    size_t size() const { return _pending.size(); }
+};
+
+/// \brief read-only view of a segment file through mmap
+class segmentReader
+{
+private:
+    const uint8_t *_map;              ///< Start of the mapping, nullptr when closed
+    size_t _mapSize;                  ///< Size of the mapping in bytes
+    const archiveRecord *_records;    ///< First record
+    size_t _recordCount;              ///< Number of records
+    const archiveIndexEntry *_index;  ///< First index entry, nullptr if the segment is not sealed
+    size_t _entryCount;               ///< Number of index entries
+    const uint32_t *_postings;        ///< Record numbers grouped by trap
+
+public:
+    segmentReader();                                        ///< Constructor
+    ~segmentReader();                                       ///< Destructor, unmaps the file
+    segmentReader(const segmentReader &) = delete;            ///< Copy constructor disabled
+    segmentReader &operator=(const segmentReader &) = delete; ///< Assignment operator disabled
+
+    /// \brief map a segment file
+    /// \param path file name
+    /// \return false if the file cannot be mapped or is not a segment
+    bool open(const char *path);
+
+    /// \brief unmap the file; pointers obtained from this reader become invalid
+    void close();
+
+    /// \brief true if the segment has a valid footer index
+    bool sealed() const { return _index != nullptr; }
+
+    /// \brief number of records
+    size_t size() const { return _recordCount; }
+
+    /// \brief all records, in arrival order
+    const archiveRecord *records() const { return _records; }
+
+    /// \brief index entries sorted by id (empty if the segment is not sealed)
+    const archiveIndexEntry *indexBegin() const { return _index; }
+    const archiveIndexEntry *indexEnd() const { return _index + _entryCount; } ///< End of the index entries
+
+    /// \brief look up a trap in the footer index (binary search)
+    /// \param id trap id
+    /// \return index entry, or nullptr if the trap is not in the segment or the segment is not sealed
+    const archiveIndexEntry *findTrap(uint32_t id) const;
+
+    /// \brief record numbers of a trap, in arrival order
+    /// \param entry index entry returned by findTrap()
+    const uint32_t *postings(const archiveIndexEntry &entry) const { return _postings + entry.firstPosting; }
+
+    /// \brief append pointers to all records of a trap, using the index if the segment is sealed
+    /// \param id trap id
+    /// \param out receives the records in arrival order
+    /// \return number of records appended
+    size_t collectTrap(uint32_t id, std::vector<const archiveRecord *> &out) const;
+};
+
+/// \brief archive record of a frame and its receive metadata
+/// \param frame payload of SENSOR_PAYLOAD_SIZE bytes
+/// \param meta receive metadata
+archiveRecord makeArchiveRecord(const uint8_t *frame, const uplinkMeta &meta);
+
+/// \brief receive metadata of a frame
+/// TTN messages carry receive metadata; plain frames do not, so the payload time is used as receive time.
+/// \param frame payload of SENSOR_PAYLOAD_SIZE bytes
+/// \param uplink TTN message the frame came from, or nullptr
+uplinkMeta uplinkMetaOf(const uint8_t *frame, const ttnUplink *uplink);
+
+/// \brief turn a block of frames from frameReader into archive records
+/// \param frames SENSOR_PAYLOAD_SIZE-byte frames
+/// \param length number of bytes (a trailing partial frame is ignored)
+/// \param uplinks TTN messages of the frames (one per frame), or empty
+/// \param out receives one record per frame
+/// \return number of records appended
+size_t appendArchiveRecords(const uint8_t *frames, size_t length, const std::vector<ttnUplink> &uplinks,
+                            std::vector<archiveRecord> &out);
+
+/// \brief rebuild the history of one trap from several segments
+/// Collects the trap's records from all segments, orders them by payload unixTime (then receive
+/// time) and decodes them into `out`.
+/// \param segments array of `count` open segments
+/// \param count number of segments
+/// \param id trap id
+/// \param out batch receiving the decoded rows
+/// \return number of decoded rows
+size_t trapHistory(const segmentReader *const *segments, size_t count, uint32_t id, payloadBatch &out);
+
+#endif // ARCHIVESEGMENT_H
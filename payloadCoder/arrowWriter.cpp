@@ -0,0 +1,439 @@
+#include "arrowWriter.h"
+
+#include <algorithm> // std::min
+#include <string.h>  // memcpy, strlen
+
+namespace
+{
+    const uint32_t CONTINUATION = 0xFFFFFFFF; ///< Marks the start of an encapsulated IPC message
+    const int16_t METADATA_V5 = 4;            ///< MetadataVersion::V5
+    const uint8_t HEADER_SCHEMA = 1;          ///< MessageHeader::Schema
+    const uint8_t HEADER_RECORD_BATCH = 3;    ///< MessageHeader::RecordBatch
+    const uint8_t TYPE_INT = 2;               ///< Type::Int
+    const uint8_t TYPE_BOOL = 6;              ///< Type::Bool
+    const size_t BUFFER_ALIGNMENT = 64;       ///< Alignment of every body buffer in the file
+
+    /// @brief One column of the schema.
+    struct column
+    {
+        const char *name; ///< Field name
+        uint8_t type;     ///< TYPE_INT or TYPE_BOOL
+        int32_t bitWidth; ///< Width of an integer column
+    };
+
+    const column COLUMNS[] = {
+        {"id", TYPE_INT, 32},
+        {"version", TYPE_INT, 8},
+        {"doorStatus", TYPE_BOOL, 0},
+        {"catchDetect", TYPE_BOOL, 0},
+        {"trapDisplacement", TYPE_BOOL, 0},
+        {"batteryStatus", TYPE_INT, 8},
+        {"unixTime", TYPE_INT, 32},
+    };
+    const size_t COLUMN_COUNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+    /// @brief Round up to a multiple of `alignment`.
+    inline size_t roundUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    /// @brief Minimal FlatBuffers builder that writes front to back.
+    /// A parent is written before its children, so every offset points forward as FlatBuffers
+    /// requires; offsets are patched with link() once the child is written. Each vtable is put
+    /// directly in front of its table, and tables start on an 8-byte boundary.
+    class flatBuilder
+    {
+    public:
+        /// @brief Inline field of a table.
+        struct field
+        {
+            uint16_t slot;  ///< Field number in the schema
+            uint8_t size;   ///< Size in bytes: 1, 2, 4 or 8
+            uint64_t value; ///< Scalar value (ignored for offsets)
+            bool offset;    ///< True for an offset to a string, vector or table (patched with link())
+        };
+
+        std::vector<uint8_t> data; ///< The buffer; starts with the root offset
+
+        flatBuilder() : data(4, 0) {} ///< Constructor, reserves the root offset
+
+        /// @brief Append a little-endian value of `size` bytes.
+        void put(uint64_t value, size_t size)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        /// @brief Overwrite four bytes at `at`.
+        void patch32(size_t at, uint32_t value)
+        {
+            for (size_t i = 0; i < 4; i++)
+            {
+                data[at + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        }
+
+        /// @brief Point the offset stored at `at` to `target` (which must lie after it).
+        void link(size_t at, size_t target) { patch32(at, static_cast<uint32_t>(target - at)); }
+
+        /// @brief Make the buffer's root the table at `table`.
+        void root(size_t table) { link(0, table); }
+
+        /// @brief Append a table; `offsets[slot]` receives the position of each offset field.
+        size_t table(std::initializer_list<field> fields, size_t *offsets = nullptr)
+        {
+            uint16_t slots = 0;
+            uint16_t fieldAt[8] = {};
+            size_t inlineSize = 4; // soffset to the vtable
+            for (const field &f : fields)
+            {
+                slots = static_cast<uint16_t>(f.slot + 1 > slots ? f.slot + 1 : slots);
+                inlineSize = roundUp(inlineSize, f.size);
+                fieldAt[f.slot] = static_cast<uint16_t>(inlineSize);
+                inlineSize += f.size;
+            }
+
+            const size_t vtableSize = 4 + 2 * static_cast<size_t>(slots);
+            while ((data.size() + vtableSize) % 8 != 0)
+            {
+                data.push_back(0);
+            }
+            const size_t vtable = data.size();
+            put(vtableSize, 2);
+            put(inlineSize, 2);
+            for (uint16_t slot = 0; slot < slots; slot++)
+            {
+                put(fieldAt[slot], 2);
+            }
+
+            const size_t start = data.size();
+            data.resize(start + inlineSize, 0);
+            patch32(start, static_cast<uint32_t>(start - vtable));
+            for (const field &f : fields)
+            {
+                for (size_t i = 0; i < f.size && !f.offset; i++)
+                {
+                    data[start + fieldAt[f.slot] + i] = static_cast<uint8_t>(f.value >> (8 * i));
+                }
+                if (f.offset && offsets != nullptr)
+                {
+                    offsets[f.slot] = start + fieldAt[f.slot];
+                }
+            }
+            return start;
+        }
+
+        /// @brief Append a string.
+        size_t string(const char *text)
+        {
+            while (data.size() % 4 != 0)
+            {
+                data.push_back(0);
+            }
+            const size_t at = data.size();
+            const size_t length = strlen(text);
+            put(length, 4);
+            data.insert(data.end(), text, text + length + 1);
+            return at;
+        }
+
+        /// @brief Append a vector of `count` offsets; element i is at the returned position + 4 + 4 * i.
+        size_t offsetVector(size_t count)
+        {
+            while (data.size() % 4 != 0)
+            {
+                data.push_back(0);
+            }
+            const size_t at = data.size();
+            put(count, 4);
+            data.resize(data.size() + 4 * count, 0);
+            return at;
+        }
+
+        /// @brief Append a vector of structs whose elements need 8-byte alignment.
+        size_t structVector(const std::vector<uint64_t> &words, size_t count)
+        {
+            while ((data.size() + 4) % 8 != 0)
+            {
+                data.push_back(0);
+            }
+            const size_t at = data.size();
+            put(count, 4);
+            for (uint64_t word : words)
+            {
+                put(word, 8);
+            }
+            return at;
+        }
+    };
+
+    /// @brief Append the Schema table (and its fields) and return its position.
+    size_t appendSchema(flatBuilder &fb)
+    {
+        size_t offsets[8] = {};
+        const size_t schema = fb.table({{0, 2, 0, false}, {1, 4, 0, true}}, offsets); // endianness Little, fields
+        const size_t fields = fb.offsetVector(COLUMN_COUNT);
+        fb.link(offsets[1], fields);
+        for (size_t i = 0; i < COLUMN_COUNT; i++)
+        {
+            size_t fieldOffsets[8] = {};
+            // name, nullable = false, type_type, type, children
+            const size_t field = fb.table({{0, 4, 0, true}, {1, 1, 0, false}, {2, 1, COLUMNS[i].type, false},
+                                           {3, 4, 0, true}, {5, 4, 0, true}},
+                                          fieldOffsets);
+            fb.link(fields + 4 + 4 * i, field);
+            fb.link(fieldOffsets[0], fb.string(COLUMNS[i].name));
+            const size_t type = COLUMNS[i].type == TYPE_INT
+                                    ? fb.table({{0, 4, static_cast<uint64_t>(COLUMNS[i].bitWidth), false}, {1, 1, 0, false}}) // unsigned
+                                    : fb.table({});
+            fb.link(fieldOffsets[3], type);
+            fb.link(fieldOffsets[5], fb.offsetVector(0));
+        }
+        return schema;
+    }
+
+    /// @brief Append the values of a column to `out`, padded to BUFFER_ALIGNMENT; return the unpadded length.
+    size_t appendColumn(const payloadBatch &batch, size_t index, size_t first, size_t count, std::pmr::vector<uint8_t> &out)
+    {
+        const size_t at = out.size();
+        size_t length = 0;
+        const std::pmr::vector<uint8_t> *bits = nullptr;
+        switch (index)
+        {
+        case 0:
+        case 6:
+            length = 4 * count;
+            out.resize(at + roundUp(length, BUFFER_ALIGNMENT), 0);
+            memcpy(out.data() + at, (index == 0 ? batch.id.data() : batch.unixTime.data()) + first, length);
+            return length;
+        case 1:
+        case 5:
+            length = count;
+            out.resize(at + roundUp(length, BUFFER_ALIGNMENT), 0);
+            memcpy(out.data() + at, (index == 1 ? batch.version.data() : batch.battery.data()) + first, length);
+            return length;
+        case 2:
+            bits = &batch.doorStatus;
+            break;
+        case 3:
+            bits = &batch.catchDetect;
+            break;
+        default:
+            bits = &batch.trapDisplacement;
+            break;
+        }
+
+        /** Bit i of byte i / 8 holds row i; the 0/1 bytes are gathered eight at a time. */
+        length = (count + 7) / 8;
+        out.resize(at + roundUp(length, BUFFER_ALIGNMENT), 0);
+        const uint8_t *in = bits->data() + first;
+        uint8_t *packed = out.data() + at;
+        size_t row = 0;
+        for (; row + 8 <= count; row += 8)
+        {
+            uint64_t eight;
+            memcpy(&eight, in + row, 8);
+            packed[row / 8] = static_cast<uint8_t>(((eight & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56);
+        }
+        for (; row < count; row++)
+        {
+            packed[row / 8] = static_cast<uint8_t>(packed[row / 8] | (in[row] & 1) << (row % 8));
+        }
+        return length;
+    }
+}
+
+arrowWriter::arrowWriter(FILE *file, size_t batchRows, std::pmr::memory_resource *memory)
+    : _file(file),
+      _batchRows(batchRows == 0 ? 1 : batchRows),
+      _pending(memory),
+      _blocks(),
+      _bytes(memory),
+      _position(0),
+      _rows(0),
+      _started(false),
+      _closed(false),
+      _failed(false)
+{
+}
+
+arrowWriter::~arrowWriter()
+{
+    close();
+}
+
+void arrowWriter::emit()
+{
+    if (!_bytes.empty() && fwrite(_bytes.data(), 1, _bytes.size(), _file) != _bytes.size())
+    {
+        _failed = true;
+    }
+    _position += _bytes.size();
+    _bytes.clear();
+}
+
+void arrowWriter::start()
+{
+    _started = true;
+    flatBuilder fb;
+    size_t offsets[8] = {};
+    const size_t message = fb.table({{0, 2, static_cast<uint64_t>(METADATA_V5), false}, {1, 1, HEADER_SCHEMA, false},
+                                     {2, 4, 0, true}, {3, 8, 0, false}},
+                                    offsets);
+    fb.root(message);
+    fb.link(offsets[2], appendSchema(fb));
+
+    const uint8_t magic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+    _bytes.assign(magic, magic + sizeof(magic));
+    const size_t metadata = roundUp(fb.data.size(), 8);
+    const uint32_t prefix[2] = {CONTINUATION, static_cast<uint32_t>(metadata)};
+    _bytes.insert(_bytes.end(), reinterpret_cast<const uint8_t *>(prefix), reinterpret_cast<const uint8_t *>(prefix) + 8);
+    _bytes.insert(_bytes.end(), fb.data.begin(), fb.data.end());
+    _bytes.resize(roundUp(_bytes.size(), 8), 0);
+    emit();
+}
+
+void arrowWriter::writeBatch(const payloadBatch &batch, size_t first, size_t count)
+{
+    if (!_started)
+    {
+        start();
+    }
+
+    /** Body first, so that the metadata can list the buffers; it goes to the file after the metadata. */
+    std::vector<uint64_t> nodes;
+    std::vector<uint64_t> buffers;
+    _bytes.clear();
+    for (size_t i = 0; i < COLUMN_COUNT; i++)
+    {
+        nodes.push_back(count); // length
+        nodes.push_back(0);     // null_count
+        const size_t at = _bytes.size();
+        const size_t length = appendColumn(batch, i, first, count, _bytes);
+        buffers.push_back(at); // validity: absent, no nulls
+        buffers.push_back(0);
+        buffers.push_back(at); // values
+        buffers.push_back(length);
+    }
+    const size_t bodyLength = _bytes.size();
+
+    flatBuilder fb;
+    size_t offsets[8] = {};
+    const size_t message = fb.table({{0, 2, static_cast<uint64_t>(METADATA_V5), false}, {1, 1, HEADER_RECORD_BATCH, false},
+                                     {2, 4, 0, true}, {3, 8, bodyLength, false}},
+                                    offsets);
+    fb.root(message);
+    size_t batchOffsets[8] = {};
+    fb.link(offsets[2], fb.table({{0, 8, count, false}, {1, 4, 0, true}, {2, 4, 0, true}}, batchOffsets));
+    fb.link(batchOffsets[1], fb.structVector(nodes, COLUMN_COUNT));
+    fb.link(batchOffsets[2], fb.structVector(buffers, 2 * COLUMN_COUNT));
+
+    /** Pad the metadata so that the body, and with it every buffer, starts on a 64-byte boundary. */
+    const uint64_t offset = _position;
+    const size_t metadata = roundUp(static_cast<size_t>(offset) + 8 + fb.data.size(), BUFFER_ALIGNMENT) - static_cast<size_t>(offset) - 8;
+    std::vector<uint8_t> head(8 + metadata, 0);
+    const uint32_t prefix[2] = {CONTINUATION, static_cast<uint32_t>(metadata)};
+    memcpy(head.data(), prefix, 8);
+    memcpy(head.data() + 8, fb.data.data(), fb.data.size());
+    if (fwrite(head.data(), 1, head.size(), _file) != head.size())
+    {
+        _failed = true;
+    }
+    _position += head.size();
+    emit();
+
+    _blocks.push_back(block{offset, static_cast<uint32_t>(head.size()), bodyLength});
+    _rows += count;
+}
+
+void arrowWriter::write(const payloadBatch &batch)
+{
+    size_t first = 0;
+    if (_pending.size() != 0)
+    {
+        /** Top up the pending rows to a full batch. */
+        const size_t take = std::min(_batchRows - _pending.size(), batch.size());
+        const size_t have = _pending.size();
+        _pending.resize(have + take);
+        memcpy(_pending.id.data() + have, batch.id.data(), 4 * take);
+        memcpy(_pending.version.data() + have, batch.version.data(), take);
+        memcpy(_pending.flags.data() + have, batch.flags.data(), take);
+        memcpy(_pending.battery.data() + have, batch.battery.data(), take);
+        memcpy(_pending.unixTime.data() + have, batch.unixTime.data(), 4 * take);
+        memcpy(_pending.doorStatus.data() + have, batch.doorStatus.data(), take);
+        memcpy(_pending.catchDetect.data() + have, batch.catchDetect.data(), take);
+        memcpy(_pending.trapDisplacement.data() + have, batch.trapDisplacement.data(), take);
+        first = take;
+        if (_pending.size() < _batchRows)
+        {
+            return;
+        }
+        writeBatch(_pending, 0, _pending.size());
+        _pending.clear();
+    }
+
+    /** Full batches straight from the caller's columns; keep the rest for the next call. */
+    for (; first + _batchRows <= batch.size(); first += _batchRows)
+    {
+        writeBatch(batch, first, _batchRows);
+    }
+    if (first < batch.size())
+    {
+        const size_t rest = batch.size() - first;
+        _pending.resize(rest);
+        memcpy(_pending.id.data(), batch.id.data() + first, 4 * rest);
+        memcpy(_pending.version.data(), batch.version.data() + first, rest);
+        memcpy(_pending.flags.data(), batch.flags.data() + first, rest);
+        memcpy(_pending.battery.data(), batch.battery.data() + first, rest);
+        memcpy(_pending.unixTime.data(), batch.unixTime.data() + first, 4 * rest);
+        memcpy(_pending.doorStatus.data(), batch.doorStatus.data() + first, rest);
+        memcpy(_pending.catchDetect.data(), batch.catchDetect.data() + first, rest);
+        memcpy(_pending.trapDisplacement.data(), batch.trapDisplacement.data() + first, rest);
+    }
+}
+
+bool arrowWriter::close()
+{
+    if (_closed)
+    {
+        return !_failed;
+    }
+    _closed = true;
+    if (_pending.size() != 0 || !_started)
+    {
+        /** An empty export still gets its schema; a batch of zero rows is valid Arrow. */
+        writeBatch(_pending, 0, _pending.size());
+        _pending.clear();
+    }
+
+    flatBuilder fb;
+    size_t offsets[8] = {};
+    fb.root(fb.table({{0, 2, static_cast<uint64_t>(METADATA_V5), false}, {1, 4, 0, true}, {2, 4, 0, true}, {3, 4, 0, true}}, offsets));
+    fb.link(offsets[1], appendSchema(fb));
+    fb.link(offsets[2], fb.structVector(std::vector<uint64_t>(), 0));
+    std::vector<uint64_t> words;
+    for (const block &b : _blocks)
+    {
+        words.push_back(b.offset);
+        words.push_back(b.metadataLength); // followed by 4 bytes of padding
+        words.push_back(b.bodyLength);
+    }
+    fb.link(offsets[3], fb.structVector(words, _blocks.size()));
+
+    const uint32_t endOfStream[2] = {CONTINUATION, 0};
+    _bytes.assign(reinterpret_cast<const uint8_t *>(endOfStream), reinterpret_cast<const uint8_t *>(endOfStream) + 8);
+    _bytes.insert(_bytes.end(), fb.data.begin(), fb.data.end());
+    const uint32_t footerLength = static_cast<uint32_t>(fb.data.size());
+    _bytes.insert(_bytes.end(), reinterpret_cast<const uint8_t *>(&footerLength), reinterpret_cast<const uint8_t *>(&footerLength) + 4);
+    const uint8_t magic[6] = {'A', 'R', 'R', 'O', 'W', '1'};
+    _bytes.insert(_bytes.end(), magic, magic + sizeof(magic));
+    emit();
+    if (fflush(_file) != 0)
+    {
+        _failed = true;
+    }
+    return !_failed;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file arrowWriter.h
+ * @brief Apache Arrow IPC file (Feather v2) writer for decoded payloads, without dependencies.
+ *
+ * Dataframe libraries (pyarrow, pandas, polars, R arrow, DuckDB) open an Arrow file by mapping
+ * it: no parsing and no copies, so even an export of the whole archive opens at once. The
+ * writer produces the IPC file format by hand: the "ARROW1" magic, a schema message, one record
+ * batch message per `batchRows` rows, an end-of-stream marker and the footer that lists the
+ * batches. The metadata is encoded with a minimal forward FlatBuffers builder; the bodies are
+ * the columns themselves.
+ *
+ * Columns, in the order of the CSV output (see recordWriter.h), none nullable:
+ * | id (uint32) | version (uint8) | doorStatus (bool) | catchDetect (bool) | trapDisplacement (bool) |
+ * | batteryStatus (uint8) | unixTime (uint32) |
+ *
+ * Booleans are bit-packed (least significant bit first), as Arrow stores them; integer columns
+ * are copied as they are. Every buffer starts on a 64-byte boundary of the file, so readers
+ * that map the file can use the columns in place. Rows are written out as soon as a batch is
+ * full, so memory stays at one batch however large the export. The file is written strictly
+ * sequentially and can go to a pipe.
+ *
+ * Usage: create an arrowWriter on an open file, call write() with decoded batches and close()
+ * at the end (the destructor closes too). Read it with, for example,
+ * `pyarrow.feather.read_table(path, memory_map=True)`.
+ */
+
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+#include <memory_resource>
+#include <vector>
+
+#include "payloadBatch.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Arrow columns are written as little-endian memory");
+
+/// \brief writes decoded rows as an Arrow IPC file
+class arrowWriter
+{
+private:
+    /// \brief position of one record batch in the file (Arrow Block)
+    struct block
+    {
+        uint64_t offset;         ///< File offset of the message
+        uint32_t metadataLength; ///< Length of the message prefix and metadata
+        uint64_t bodyLength;     ///< Length of the message body
+    };
+
+    FILE *_file;                      ///< Output file (not owned)
+    size_t _batchRows;                ///< Rows per record batch
+    payloadBatch _pending;            ///< Rows waiting for a full batch
+    std::vector<block> _blocks;       ///< Record batches written so far, for the footer
+    std::pmr::vector<uint8_t> _bytes; ///< Reused buffer for metadata and bodies
+    uint64_t _position;               ///< Bytes written to the file
+    uint64_t _rows;                   ///< Rows written to the file
+    bool _started;                    ///< Magic and schema written
+    bool _closed;                     ///< Footer written
+    bool _failed;                     ///< A write failed
+
+    /// \brief write `_bytes` to the file
+    void emit();
+
+    /// \brief write the magic and the schema message
+    void start();
+
+    /// \brief write rows first .. first + count - 1 of `batch` as one record batch
+    void writeBatch(const payloadBatch &batch, size_t first, size_t count);
+
+public:
+    /// \brief constructor
+    /// \param file output file, for example stdout
+    /// \param batchRows rows per record batch
+    /// \param memory resource for the pending rows and the message buffer
+    explicit arrowWriter(FILE *file, size_t batchRows = 1 << 16, std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    ~arrowWriter();                                     ///< Destructor, closes the file format
+    arrowWriter(const arrowWriter &) = delete;            ///< Copy constructor disabled
+    arrowWriter &operator=(const arrowWriter &) = delete; ///< Assignment operator disabled
+
+    /// \brief append all rows of a batch
+    /// \param batch decoded rows
+    void write(const payloadBatch &batch);
+
+    /// \brief write the remaining rows, the end-of-stream marker and the footer, and flush the file
+    /// \return false if a write failed (now or earlier)
+    bool close();
+
+    /// \brief number of rows written to the file so far
+    uint64_t get_rows() const { return _rows; }
+
+    /// \brief number of record batches written so far
+    size_t get_batches() const { return _blocks.size(); }
+};
+
+#endif // ARROWWRITER_H
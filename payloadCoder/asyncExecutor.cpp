@@ -0,0 +1,458 @@
+#include "asyncExecutor.h"
+
+#include <deque>
+#include <errno.h> // errno
+#include <mutex>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/epoll.h>   // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/eventfd.h> // eventfd
+#include <sys/socket.h>  // send, MSG_NOSIGNAL
+#include <unistd.h>      // read, write, close
+#endif
+
+/// @brief State of one event loop; the queues are only touched by its own thread, except `inbox`.
+struct asyncExecutor::loop
+{
+    asyncExecutor *owner = nullptr;                     ///< Executor of the loop
+    unsigned index = 0;                                 ///< Number of the loop
+    int epollFd = -1;                                   ///< epoll instance
+    int wakeFd = -1;                                    ///< eventfd written when `inbox` gets work
+    std::deque<std::coroutine_handle<>> ready = {};     ///< Coroutines to resume, in order
+    std::mutex lock = {};                               ///< Guards `inbox`, `woken`, `tasks` and the spawn counters
+    std::vector<std::coroutine_handle<>> inbox = {};    ///< Coroutines handed over by other threads
+    bool woken = false;                                 ///< `wakeFd` written and not yet read
+    std::unordered_set<void *> tasks = {};              ///< Frames of the spawned tasks that did not finish
+    asyncStats stats = {};                              ///< Counters
+};
+
+/// @brief Wrapper coroutine of a spawned task: starts suspended, frees its frame when it ends.
+struct asyncExecutor::detached
+{
+    /// @brief Promise of the wrapper.
+    struct promise_type
+    {
+        detached get_return_object() { return detached{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle; ///< Frame of the wrapper
+};
+
+namespace
+{
+    const int MAX_EVENTS = 256; ///< Events taken per epoll_wait (one round)
+
+    /// @brief Loop running on this thread, nullptr outside the loops.
+    thread_local asyncExecutor::loop *currentState = nullptr;
+
+    /// @brief Hands the awaiting coroutine its own handle, without suspending.
+    struct selfAwaiter
+    {
+        std::coroutine_handle<> self = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            self = awaiting;
+            return false;
+        }
+        std::coroutine_handle<> await_resume() const noexcept { return self; }
+    };
+}
+
+asyncExecutor::detached asyncExecutor::runDetached(asyncExecutor *executor, loop *home, task<void> work)
+{
+    co_await work;
+    const std::coroutine_handle<> self = co_await selfAwaiter{};
+    executor->finished(*home, self);
+}
+
+int asyncExecutor::currentLoop()
+{
+    return currentState != nullptr ? static_cast<int>(currentState->index) : -1;
+}
+
+asyncExecutor::fdAwaiter asyncExecutor::readable(int fd)
+{
+#ifdef __linux__
+    return fdAwaiter{fd, EPOLLIN | EPOLLRDHUP, nullptr, false};
+#else
+    return fdAwaiter{fd, 1, nullptr, false};
+#endif
+}
+
+asyncExecutor::fdAwaiter asyncExecutor::writable(int fd)
+{
+#ifdef __linux__
+    return fdAwaiter{fd, EPOLLOUT, nullptr, false};
+#else
+    return fdAwaiter{fd, 4, nullptr, false};
+#endif
+}
+
+bool asyncExecutor::yieldAwaiter::await_suspend(std::coroutine_handle<> awaiting)
+{
+    if (currentState == nullptr)
+    {
+        return false;
+    }
+    currentState->ready.push_back(awaiting);
+    return true;
+}
+
+void asyncExecutor::spawn(task<void> work)
+{
+    if (_loops.empty())
+    {
+        return;
+    }
+    const unsigned index = currentState != nullptr && currentState->owner == this
+                               ? currentState->index
+                               : _next.fetch_add(1, std::memory_order_relaxed) % get_threads();
+    spawn(index, std::move(work));
+}
+
+void asyncExecutor::spawn(unsigned index, task<void> work)
+{
+    if (_loops.empty())
+    {
+        return;
+    }
+    loop &state = *_loops[index % _loops.size()];
+    const std::coroutine_handle<> handle = runDetached(this, &state, std::move(work)).handle;
+    _active.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.tasks.insert(handle.address());
+        state.stats.spawned++;
+    }
+    schedule(state, handle);
+}
+
+void asyncExecutor::finished(loop &state, std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.tasks.erase(handle.address());
+        state.stats.finished++;
+    }
+    if (_active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        stop();
+    }
+}
+
+asyncStats asyncExecutor::get_stats() const
+{
+    asyncStats total;
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        total.spawned += state->stats.spawned;
+        total.finished += state->stats.finished;
+        total.resumes += state->stats.resumes;
+        total.waits += state->stats.waits;
+        total.rounds += state->stats.rounds;
+    }
+    return total;
+}
+
+asyncExecutor::~asyncExecutor()
+{
+    /** Suspended frames own the frames of the tasks they await, so destroying the wrappers frees everything. */
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        for (void *frame : state->tasks)
+        {
+            std::coroutine_handle<>::from_address(frame).destroy();
+        }
+        state->tasks.clear();
+#ifdef __linux__
+        if (state->epollFd >= 0)
+        {
+            close(state->epollFd);
+        }
+        if (state->wakeFd >= 0)
+        {
+            close(state->wakeFd);
+        }
+#endif
+    }
+#ifdef __linux__
+    if (_stopFd >= 0)
+    {
+        close(_stopFd);
+    }
+#endif
+}
+
+#ifdef __linux__
+
+asyncExecutor::asyncExecutor(unsigned threads)
+    : _loops(), _threads(), _active(0), _next(0), _stopping(false), _stopFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+        _loops.emplace_back(new loop());
+        loop &state = *_loops.back();
+        state.owner = this;
+        state.index = i;
+        state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+        state.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        /** data.ptr tells the events apart: nullptr is the stop eventfd, the loop itself its wake
+            eventfd, anything else a waiting fdAwaiter. */
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        if (_stopFd >= 0 && state.epollFd >= 0)
+        {
+            epoll_ctl(state.epollFd, EPOLL_CTL_ADD, _stopFd, &event);
+        }
+        event.data.ptr = &state;
+        if (state.wakeFd >= 0 && state.epollFd >= 0)
+        {
+            epoll_ctl(state.epollFd, EPOLL_CTL_ADD, state.wakeFd, &event);
+        }
+    }
+}
+
+bool asyncExecutor::fdAwaiter::await_suspend(std::coroutine_handle<> awaiting)
+{
+    loop *state = currentState;
+    if (state == nullptr)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    handle = awaiting;
+
+    /** One-shot: the event disarms the descriptor, so it fires once per wait and never for a
+        coroutine that stopped waiting. A closed descriptor leaves the epoll set by itself. */
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = this;
+    if (epoll_ctl(state->epollFd, EPOLL_CTL_MOD, fd, &event) != 0 &&
+        (errno != ENOENT || epoll_ctl(state->epollFd, EPOLL_CTL_ADD, fd, &event) != 0))
+    {
+        return false;
+    }
+    armed = true;
+    state->stats.waits++;
+    return true;
+}
+
+void asyncExecutor::schedule(loop &state, std::coroutine_handle<> handle)
+{
+    if (currentState == &state)
+    {
+        state.ready.push_back(handle);
+        return;
+    }
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.inbox.push_back(handle);
+        wake = !state.woken;
+        state.woken = true;
+    }
+    if (wake)
+    {
+        const uint64_t one = 1;
+        const ssize_t written = write(state.wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+bool asyncExecutor::run()
+{
+    if (_stopFd < 0)
+    {
+        return false;
+    }
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        if (state->epollFd < 0 || state->wakeFd < 0)
+        {
+            return false;
+        }
+    }
+    if (_active.load(std::memory_order_acquire) == 0)
+    {
+        return true;
+    }
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        _threads.emplace_back(&asyncExecutor::runLoop, this, std::ref(*state));
+    }
+    for (std::thread &thread : _threads)
+    {
+        thread.join();
+    }
+    _threads.clear();
+    return true;
+}
+
+void asyncExecutor::stop()
+{
+    /** Only an atomic store and write(): safe in a signal handler. The eventfd stays readable, so every loop sees it. */
+    _stopping.store(true, std::memory_order_release);
+    if (_stopFd >= 0)
+    {
+        const uint64_t one = 1;
+        const ssize_t written = write(_stopFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void asyncExecutor::runLoop(loop &state)
+{
+    currentState = &state;
+    epoll_event events[MAX_EVENTS];
+    while (!_stopping.load(std::memory_order_acquire))
+    {
+        /** Do not sleep while coroutines are ready; otherwise wait for an event. */
+        const int count = epoll_wait(state.epollFd, events, MAX_EVENTS, state.ready.empty() ? -1 : 0);
+        state.stats.rounds++;
+        for (int i = 0; i < count; i++)
+        {
+            void *data = events[i].data.ptr;
+            if (data == nullptr)
+            {
+                continue; // stop: the loop condition sees it
+            }
+            if (data == &state)
+            {
+                uint64_t value = 0;
+                const ssize_t got = read(state.wakeFd, &value, sizeof(value));
+                (void)got;
+                std::lock_guard<std::mutex> guard(state.lock);
+                state.ready.insert(state.ready.end(), state.inbox.begin(), state.inbox.end());
+                state.inbox.clear();
+                state.woken = false;
+                continue;
+            }
+            state.ready.push_back(static_cast<fdAwaiter *>(data)->handle);
+        }
+
+        /** Resume only what was ready at the start of the round: a coroutine that yields runs again
+            after the next epoll_wait, so it cannot starve the descriptors. */
+        for (size_t n = state.ready.size(); n > 0 && !_stopping.load(std::memory_order_relaxed); n--)
+        {
+            const std::coroutine_handle<> handle = state.ready.front();
+            state.ready.pop_front();
+            state.stats.resumes++;
+            handle.resume();
+        }
+    }
+    currentState = nullptr;
+}
+
+task<ssize_t> readSome(int fd, void *buffer, size_t size)
+{
+    for (;;)
+    {
+        const ssize_t count = read(fd, buffer, size);
+        if (count >= 0)
+        {
+            co_return count;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno != EAGAIN || !co_await asyncExecutor::readable(fd))
+        {
+            co_return -1;
+        }
+    }
+}
+
+task<bool> writeAll(int fd, const void *data, size_t size, size_t *written)
+{
+    const char *next = static_cast<const char *>(data);
+    bool socket = true;
+    while (size > 0)
+    {
+        /** send() so that a closed connection fails with EPIPE instead of raising SIGPIPE. */
+        ssize_t count = socket ? send(fd, next, size, MSG_NOSIGNAL) : write(fd, next, size);
+        if (count < 0 && socket && errno == ENOTSOCK)
+        {
+            socket = false;
+            continue;
+        }
+        if (count > 0)
+        {
+            next += count;
+            size -= static_cast<size_t>(count);
+            if (written != nullptr)
+            {
+                *written += static_cast<size_t>(count);
+            }
+            continue;
+        }
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count == 0 || errno != EAGAIN || !co_await asyncExecutor::writable(fd))
+        {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+#else // no epoll: nothing runs
+
+asyncExecutor::asyncExecutor(unsigned)
+    : _loops(), _threads(), _active(0), _next(0), _stopping(false), _stopFd(-1)
+{
+}
+
+bool asyncExecutor::fdAwaiter::await_suspend(std::coroutine_handle<>)
+{
+    errno = ENOSYS;
+    return false;
+}
+
+void asyncExecutor::schedule(loop &, std::coroutine_handle<>)
+{
+}
+
+bool asyncExecutor::run()
+{
+    errno = ENOSYS;
+    return false;
+}
+
+void asyncExecutor::stop()
+{
+    _stopping.store(true, std::memory_order_release);
+}
+
+void asyncExecutor::runLoop(loop &)
+{
+}
+
+task<ssize_t> readSome(int, void *, size_t)
+{
+    errno = ENOSYS;
+    co_return -1;
+}
+
+task<bool> writeAll(int, const void *, size_t, size_t *)
+{
+    errno = ENOSYS;
+    co_return false;
+}
+
+#endif // __linux__
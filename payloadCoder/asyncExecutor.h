@@ -0,0 +1,316 @@
+/**
+ * @file asyncExecutor.h
+ * @brief C++20 coroutine tasks on a small pool of epoll event loops.
+ *
+ * Every ingest source used to need its own threading glue: a thread per input, or a hand-written
+ * state machine per connection (see webhookServer.h). With coroutines a decode flow is written as
+ * straight-line code,
+ *
+ *     while (co_await source.nextBatch(batch))
+ *     {
+ *         co_await sink.write(batch);
+ *     }
+ *
+ * and wherever the input is not there yet, the coroutine is suspended and its thread runs other
+ * coroutines. Thousands of connections then share a few threads, without a thread per connection.
+ *
+ * task<T> is a lazily started coroutine that returns a T to the coroutine that awaits it; when
+ * it finishes, it resumes that coroutine directly (symmetric transfer), so chains of tasks do not
+ * grow the stack. A task that nobody awaits is started with asyncExecutor::spawn().
+ *
+ * asyncExecutor runs one event loop per thread. Each loop has its own epoll instance and its own
+ * queue of coroutines ready to run; a coroutine stays on the loop it was spawned on, so the
+ * coroutines of one loop never run concurrently. readable() and writable() suspend the calling
+ * coroutine until a file descriptor is ready (a one-shot epoll registration on the caller's loop);
+ * readSome() and writeAll() wrap non-blocking read() and write() around them. yield() lets the
+ * other coroutines of the loop run. Files on disk are not pollable; read them through a bulkReader
+ * (io_uring read-ahead) instead, see asyncIngest.h.
+ *
+ * Only one coroutine at a time may wait for the same file descriptor on a loop.
+ *
+ * Coroutines must not throw: an exception that leaves a task terminates the program, as elsewhere
+ * in this project errors are reported through return values.
+ *
+ * The executor uses epoll and is only available on Linux; elsewhere run() returns at once.
+ *
+ * Usage: create an asyncExecutor, spawn() tasks, call run(). run() returns when all spawned
+ * tasks are done, or after stop().
+ */
+
+#ifndef ASYNCEXECUTOR_H
+#define ASYNCEXECUTOR_H
+
+#include <stdint.h>    // uint32_t and uint64_t type
+#include <stddef.h>    // size_t
+#include <sys/types.h> // ssize_t
+#include <atomic>
+#include <coroutine>
+#include <exception> // std::terminate
+#include <memory>
+#include <thread>
+#include <utility> // std::exchange, std::move
+#include <vector>
+
+/// \brief promise parts shared by all task types
+struct taskPromiseBase
+{
+    std::coroutine_handle<> continuation = nullptr; ///< Coroutine that awaits the task
+
+    /// \brief at the end, resume the awaiting coroutine in place of this one
+    struct finalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            const std::coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; } ///< Tasks start when awaited
+    finalAwaiter final_suspend() noexcept { return {}; }          ///< Continue with the awaiting coroutine
+    void unhandled_exception() noexcept { std::terminate(); }     ///< Tasks report errors by value
+};
+
+/// \brief coroutine that produces a T for the coroutine that awaits it
+/// T must be default constructible. A task is started by co_await (or asyncExecutor::spawn()) and
+/// owns its coroutine frame.
+template <typename T = void>
+class task
+{
+public:
+    /// \brief promise of a task returning T
+    struct promise_type : taskPromiseBase
+    {
+        T value{}; ///< Result, set by co_return
+
+        task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T result) { value = std::move(result); }
+    };
+
+private:
+    friend struct promise_type;
+    std::coroutine_handle<promise_type> _handle; ///< Coroutine frame, nullptr once moved from
+
+    explicit task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+public:
+    task(task &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) {} ///< Move constructor
+    task &operator=(task &&other) noexcept                                          ///< Move assignment
+    {
+        if (this != &other)
+        {
+            if (_handle)
+            {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    ~task() ///< Destructor, destroys the coroutine frame
+    {
+        if (_handle)
+        {
+            _handle.destroy();
+        }
+    }
+    task(const task &) = delete;            ///< Copy constructor disabled
+    task &operator=(const task &) = delete; ///< Assignment operator disabled
+
+    bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+    /// \brief start the task; it resumes `awaiting` when it is done
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+    }
+
+    T await_resume() { return std::move(_handle.promise().value); }
+};
+
+/// \brief coroutine that returns nothing to the coroutine that awaits it
+template <>
+class task<void>
+{
+public:
+    /// \brief promise of a task returning nothing
+    struct promise_type : taskPromiseBase
+    {
+        task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() {}
+    };
+
+private:
+    friend struct promise_type;
+    std::coroutine_handle<promise_type> _handle; ///< Coroutine frame, nullptr once moved from
+
+    explicit task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+public:
+    task(task &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) {} ///< Move constructor
+    task &operator=(task &&other) noexcept                                          ///< Move assignment
+    {
+        if (this != &other)
+        {
+            if (_handle)
+            {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    ~task() ///< Destructor, destroys the coroutine frame
+    {
+        if (_handle)
+        {
+            _handle.destroy();
+        }
+    }
+    task(const task &) = delete;            ///< Copy constructor disabled
+    task &operator=(const task &) = delete; ///< Assignment operator disabled
+
+    bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+    /// \brief start the task; it resumes `awaiting` when it is done
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+    }
+
+    void await_resume() noexcept {}
+};
+
+/// \brief counters of the executor, summed over the loops
+struct asyncStats
+{
+    uint64_t spawned = 0;  ///< Tasks spawned
+    uint64_t finished = 0; ///< Spawned tasks that ran to the end
+    uint64_t resumes = 0;  ///< Coroutines resumed by the loops
+    uint64_t waits = 0;    ///< Suspensions on a file descriptor
+    uint64_t rounds = 0;   ///< Calls of epoll_wait
+};
+
+/// \brief event loops, one per thread, that run coroutines
+class asyncExecutor
+{
+public:
+    struct loop; ///< State of one event loop (defined in asyncExecutor.cpp)
+
+    /// \brief suspends until a file descriptor is ready
+    struct fdAwaiter
+    {
+        int fd;                         ///< File descriptor to wait for
+        uint32_t events;                ///< EPOLLIN or EPOLLOUT
+        std::coroutine_handle<> handle; ///< Waiting coroutine, resumed by the loop
+        bool armed;                     ///< Registered with the loop
+
+        bool await_ready() const noexcept { return false; }
+
+        /// \brief arm the descriptor on the caller's loop; if that fails, do not suspend
+        bool await_suspend(std::coroutine_handle<> awaiting);
+
+        /// \brief false if the caller could not wait: not on a loop, or epoll refused the descriptor (errno)
+        bool await_resume() const noexcept { return armed; }
+    };
+
+    /// \brief puts the caller at the back of its loop's ready queue
+    struct yieldAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        /// \brief queue the caller; outside the loops it simply continues
+        bool await_suspend(std::coroutine_handle<> awaiting);
+
+        void await_resume() const noexcept {}
+    };
+
+private:
+    std::vector<std::unique_ptr<loop>> _loops; ///< Event loops
+    std::vector<std::thread> _threads;         ///< Threads running the loops during run()
+    std::atomic<uint64_t> _active;             ///< Spawned tasks not yet finished
+    std::atomic<unsigned> _next;               ///< Loop of the next spawn() from outside the loops
+    std::atomic<bool> _stopping;               ///< Set by stop() or when the last task finished
+    int _stopFd;                               ///< eventfd that wakes all loops to stop, -1 if none
+
+    /// \brief run one loop until the executor stops
+    void runLoop(loop &state);
+
+    /// \brief hand a coroutine to a loop (any thread)
+    void schedule(loop &state, std::coroutine_handle<> handle);
+
+    /// \brief wrapper coroutine of a spawned task
+    struct detached;
+
+    /// \brief run a spawned task and count it as finished
+    static detached runDetached(asyncExecutor *executor, loop *home, task<void> work);
+
+    /// \brief bookkeeping after a spawned task finished, on its loop
+    void finished(loop &state, std::coroutine_handle<> handle);
+
+public:
+    /// \brief constructor
+    /// \param threads event loops (0: one per hardware thread)
+    explicit asyncExecutor(unsigned threads = 0);
+    ~asyncExecutor();                                         ///< Destructor, destroys tasks that did not finish
+    asyncExecutor(const asyncExecutor &) = delete;            ///< Copy constructor disabled
+    asyncExecutor &operator=(const asyncExecutor &) = delete; ///< Assignment operator disabled
+
+    /// \brief start a task that nobody awaits
+    /// From a coroutine of this executor the task runs on the caller's loop, otherwise the loops
+    /// take turns. May be called from any thread, also during run().
+    /// \param work task to run
+    void spawn(task<void> work);
+
+    /// \brief start a task on a given loop
+    /// \param index loop (0 .. get_threads() - 1)
+    /// \param work task to run
+    void spawn(unsigned index, task<void> work);
+
+    /// \brief run the loops until every spawned task finished, or until stop()
+    /// Tasks still suspended after stop() are destroyed when the executor is.
+    /// \return false if the loops could not be set up (the reason is in errno)
+    bool run();
+
+    /// \brief ask all loops to stop; safe to call from a signal handler
+    void stop();
+
+    /// \brief number of event loops
+    unsigned get_threads() const { return static_cast<unsigned>(_loops.size()); }
+
+    /// \brief counters; read after run()
+    asyncStats get_stats() const;
+
+    /// \brief index of the loop running the caller, or -1 outside the loops
+    static int currentLoop();
+
+    /// \brief suspend until `fd` can be read (or has an error or hang-up)
+    /// co_await yields false if the caller could not wait.
+    static fdAwaiter readable(int fd);
+
+    /// \brief suspend until `fd` can be written (or has an error)
+    /// co_await yields false if the caller could not wait.
+    static fdAwaiter writable(int fd);
+
+    /// \brief let the other ready coroutines of the loop run first
+    static yieldAwaiter yield() { return yieldAwaiter(); }
+};
+
+/// \brief read at most `size` bytes from a non-blocking descriptor, waiting until some are there
+/// \return bytes read, 0 at end of file, -1 on an error (the reason is in errno)
+task<ssize_t> readSome(int fd, void *buffer, size_t size);
+
+/// \brief write all `size` bytes to a descriptor, waiting whenever it is full
+/// \param written if not nullptr, increased by the bytes written as they are written, so the caller
+///        still knows how far the write got if the coroutine is destroyed while it waits
+/// \return false on an error (the reason is in errno)
+task<bool> writeAll(int fd, const void *data, size_t size, size_t *written = nullptr);
+
+#endif // ASYNCEXECUTOR_H
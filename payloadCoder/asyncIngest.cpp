@@ -0,0 +1,334 @@
+#include "asyncIngest.h"
+#include "decoder.h"
+#include "encoder.h"
+
+#include <errno.h> // errno
+
+#ifdef __linux__
+#include <arpa/inet.h>  // inet_pton
+#include <fcntl.h>      // fcntl, O_NONBLOCK
+#include <netinet/in.h> // sockaddr_in
+#include <poll.h>       // poll
+#include <sys/socket.h> // socket, bind, listen, accept4
+#include <unistd.h>     // write, close
+#endif
+
+asyncSource::asyncSource(inputFormat format, size_t bufferSize)
+    : _format(format),
+      _file(),
+      _reader(new frameReader(format, bufferSize)),
+      _fd(-1),
+      _buffer(bufferSize < 4 * SENSOR_PAYLOAD_SIZE ? 4 * SENSOR_PAYLOAD_SIZE : bufferSize),
+      _done(false),
+      _failed(false),
+      _bytes(0),
+      _frames(0)
+{
+}
+
+asyncSource::~asyncSource()
+{
+#ifdef __linux__
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+#endif
+}
+
+bool asyncSource::open(const char *path, const bulkReadConfig &config)
+{
+    std::unique_ptr<bulkReader> file(new bulkReader(config));
+    if (!file->open(path))
+    {
+        return false;
+    }
+    _file = std::move(file);
+    _reader.reset(new frameReader(*_file, _format, _buffer.size()));
+    return true;
+}
+
+task<bool> asyncSource::nextBatch(payloadBatch &batch)
+{
+    /** Every batch gives the other coroutines of the loop a turn, also when input is always there. */
+    co_await asyncExecutor::yield();
+    batch.clear();
+
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    if (_file)
+    {
+        if (!_reader->next(frames, length))
+        {
+            co_return false;
+        }
+        _frames += (length + SENSOR_PAYLOAD_SIZE - 1) / SENSOR_PAYLOAD_SIZE;
+        payloadDecoder::decodeBatch(frames, length, batch);
+        co_return true;
+    }
+
+    while (!_done && _fd >= 0)
+    {
+        const ssize_t count = co_await readSome(_fd, _buffer.data(), _buffer.size());
+        if (count < 0)
+        {
+            _failed = true;
+        }
+        _done = count <= 0;
+        _bytes += count > 0 ? static_cast<uint64_t>(count) : 0;
+        if (!_reader->convert(_buffer.data(), count > 0 ? static_cast<size_t>(count) : 0, !_done, frames, length))
+        {
+            break;
+        }
+        if (length > 0)
+        {
+            _frames += (length + SENSOR_PAYLOAD_SIZE - 1) / SENSOR_PAYLOAD_SIZE;
+            payloadDecoder::decodeBatch(frames, length, batch);
+            co_return true;
+        }
+        /** Only part of a frame or line so far: read on. */
+    }
+    co_return false;
+}
+
+asyncSink::asyncSink(int fd, outputFormat format, size_t highWater)
+    : _fd(fd), _pending(nullptr, format), _sending(), _sent(0), _highWater(highWater), _lock(), _draining(false), _failed(false), _bytes(0)
+{
+}
+
+task<bool> asyncSink::write(const payloadBatch &batch)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _pending.write(batch);
+    }
+    co_return co_await settle(false);
+}
+
+task<bool> asyncSink::flush()
+{
+    co_return co_await settle(true);
+}
+
+task<bool> asyncSink::settle(bool all)
+{
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            if (_failed)
+            {
+                co_return false;
+            }
+            if (!_draining)
+            {
+                if (_pending.size() == 0)
+                {
+                    co_return true;
+                }
+                _draining = true;
+                break;
+            }
+            if (!all && _pending.size() <= _highWater)
+            {
+                co_return true;
+            }
+        }
+        /** Another coroutine is writing: let it (or, on another loop, the others here) go on. */
+        co_await asyncExecutor::yield();
+    }
+
+    /** This coroutine writes until nothing is pending; the others keep appending meanwhile. */
+    bool ok = true;
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            if (!ok)
+            {
+                _failed = true;
+            }
+            if (_failed || _pending.size() == 0)
+            {
+                _draining = false;
+                co_return !_failed;
+            }
+            _sending.assign(_pending.data(), _pending.data() + _pending.size());
+            _sent = 0;
+            _pending.clear();
+        }
+        ok = co_await writeAll(_fd, _sending.data(), _sending.size(), &_sent);
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _bytes += _sent;
+            _sending.clear();
+            _sent = 0;
+        }
+    }
+}
+
+bool asyncSink::failed() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _failed;
+}
+
+uint64_t asyncSink::get_bytes() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _bytes;
+}
+
+#ifdef __linux__
+
+bool asyncSource::open(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)
+    {
+        return false;
+    }
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+    _fd = fd;
+    return true;
+}
+
+bool asyncSink::finish()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    const auto drain = [this](const char *next, size_t size)
+    {
+        while (!_failed && size > 0)
+        {
+            const ssize_t count = ::write(_fd, next, size);
+            if (count > 0)
+            {
+                next += count;
+                size -= static_cast<size_t>(count);
+                _bytes += static_cast<uint64_t>(count);
+            }
+            else if (count < 0 && errno == EAGAIN)
+            {
+                pollfd wait{_fd, POLLOUT, 0};
+                poll(&wait, 1, -1);
+            }
+            else if (count == 0 || errno != EINTR)
+            {
+                _failed = true;
+            }
+        }
+    };
+
+    /** The coroutine writing _sending may have been destroyed part way; its rest goes before _pending. */
+    _bytes += _sent;
+    drain(_sending.data() + _sent, _sending.size() - _sent);
+    drain(_pending.data(), _pending.size());
+    _sending.clear();
+    _sent = 0;
+    _pending.clear();
+    return !_failed;
+}
+
+asyncListener::~asyncListener()
+{
+    close();
+}
+
+bool asyncListener::listen(const std::string &address, uint16_t port)
+{
+    sockaddr_in bound{};
+    bound.sin_family = AF_INET;
+    bound.sin_port = htons(port);
+    if (_fd >= 0 || inet_pton(AF_INET, address.c_str(), &bound.sin_addr) != 1)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    const int one = 1;
+    socklen_t length = sizeof(bound);
+    const bool ok = _fd >= 0 &&
+                    setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+                    setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == 0 &&
+                    bind(_fd, reinterpret_cast<const sockaddr *>(&bound), sizeof(bound)) == 0 &&
+                    ::listen(_fd, SOMAXCONN) == 0 &&
+                    getsockname(_fd, reinterpret_cast<sockaddr *>(&bound), &length) == 0;
+    if (!ok)
+    {
+        const int error = errno;
+        close();
+        errno = error;
+        return false;
+    }
+    _port = ntohs(bound.sin_port);
+    return true;
+}
+
+task<int> asyncListener::accept()
+{
+    while (_fd >= 0)
+    {
+        const int fd = accept4(_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0)
+        {
+            co_return fd;
+        }
+        if (errno == EINTR || errno == ECONNABORTED)
+        {
+            continue;
+        }
+        if (errno != EAGAIN || !co_await asyncExecutor::readable(_fd))
+        {
+            co_return -1;
+        }
+    }
+    errno = EBADF;
+    co_return -1;
+}
+
+void asyncListener::close()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+#else // no sockets
+
+bool asyncSource::open(int)
+{
+    errno = ENOSYS;
+    return false;
+}
+
+bool asyncSink::finish()
+{
+    return false;
+}
+
+asyncListener::~asyncListener()
+{
+}
+
+bool asyncListener::listen(const std::string &, uint16_t)
+{
+    errno = ENOSYS;
+    return false;
+}
+
+task<int> asyncListener::accept()
+{
+    errno = ENOSYS;
+    co_return -1;
+}
+
+void asyncListener::close()
+{
+}
+
+#endif // __linux__
@@ -0,0 +1,190 @@
+/**
+ * @file asyncIngest.h
+ * @brief Coroutine sources, sinks and listener for decode flows on an asyncExecutor.
+ *
+ * An ingest flow is a coroutine that takes decoded batches from an asyncSource and hands them to
+ * an asyncSink (see asyncExecutor.h):
+ *
+ *     task<void> ingest(int fd, asyncSink &sink)
+ *     {
+ *         asyncSource source(inputFormat::ttn);
+ *         source.open(fd);
+ *         payloadBatch batch;
+ *         while (co_await source.nextBatch(batch))
+ *         {
+ *             co_await sink.write(batch);
+ *         }
+ *     }
+ *
+ * asyncSource reads a socket or pipe with non-blocking reads; while no bytes are there, the
+ * coroutine is suspended and the loop runs other flows. Named files are read through a
+ * bulkReader (io_uring read-ahead, see bulkReader.h) and never suspend for input; every batch
+ * still lets the other coroutines of the loop run once. All input formats of frameReader are
+ * accepted, and frames or lines may be split over reads in any way.
+ *
+ * asyncSink formats records with a recordWriter and writes them to a file descriptor. Flows on
+ * any loop may share one sink: records are appended under a lock, one batch at a time, and the
+ * coroutine that finds the sink idle writes everything pending, suspending while a non-blocking
+ * descriptor is full. Other writers only wait once more than `highWater` bytes are pending. A
+ * blocking descriptor (stdout) blocks the writing loop while the kernel takes the bytes.
+ *
+ * asyncListener accepts TCP connections, for example from a bridge that forwards MQTT uplinks as
+ * newline-delimited TTN messages. With SO_REUSEPORT each loop listens on its own socket for the
+ * same port and the kernel spreads the connections, as in webhookServer.h.
+ *
+ * Usage: see the ingest command in main.cpp.
+ */
+
+#ifndef ASYNCINGEST_H
+#define ASYNCINGEST_H
+
+#include <stdint.h> // uint16_t and uint64_t type
+#include <stddef.h> // size_t
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "asyncExecutor.h"
+#include "bulkReader.h"
+#include "frameReader.h"
+#include "payloadBatch.h"
+#include "recordWriter.h"
+
+/// \brief decoded batches from a socket, pipe or file
+class asyncSource
+{
+private:
+    inputFormat _format;                  ///< Format of the input
+    std::unique_ptr<bulkReader> _file;    ///< Named file, nullptr for a descriptor
+    std::unique_ptr<frameReader> _reader; ///< Turns the input into frames
+    int _fd;                              ///< Socket or pipe (owned), -1 if none
+    std::vector<uint8_t> _buffer;         ///< Bytes of the last read from _fd
+    bool _done;                           ///< Input exhausted
+    bool _failed;                         ///< A read failed
+    uint64_t _bytes;                      ///< Bytes read
+    uint64_t _frames;                     ///< Frames passed to the decoder
+
+public:
+    /// \brief constructor; nothing is read until open()
+    /// \param format format of the input
+    /// \param bufferSize bytes per read from a descriptor, also the longest text line
+    explicit asyncSource(inputFormat format, size_t bufferSize = 64 << 10);
+    ~asyncSource();                                       ///< Destructor, closes the descriptor
+    asyncSource(const asyncSource &) = delete;            ///< Copy constructor disabled
+    asyncSource &operator=(const asyncSource &) = delete; ///< Assignment operator disabled
+
+    /// \brief read a named file, through io_uring where available
+    /// \param path file name
+    /// \param config buffers of the bulk reader
+    /// \return false if the file cannot be opened (the reason is in errno)
+    bool open(const char *path, const bulkReadConfig &config = bulkReadConfig());
+
+    /// \brief read a socket or pipe; the source takes it over, makes it non-blocking and closes it
+    /// \param fd file descriptor
+    /// \return false if the descriptor cannot be made non-blocking (the reason is in errno)
+    bool open(int fd);
+
+    /// \brief decode the next block of input
+    /// Suspends until input is there. Text lines are converted as they arrive, so a batch may be
+    /// small on a slow connection.
+    /// \param batch cleared, then receives the decoded rows and rejected frames
+    /// \return false at the end of the input or after a read error (see failed())
+    task<bool> nextBatch(payloadBatch &batch);
+
+    /// \brief uplink fields of the frames of the last batch (ttn input only), see frameReader
+    const std::vector<ttnUplink> &get_uplinks() const { return _reader->get_uplinks(); }
+
+    /// \brief true if a read failed
+    bool failed() const { return _failed || (_file && _file->failed()); }
+
+    /// \brief bytes read so far
+    uint64_t get_bytes() const { return _file ? _file->get_bytes() : _bytes; }
+
+    /// \brief frames passed to the decoder so far
+    uint64_t get_frames() const { return _frames; }
+
+    /// \brief text lines that did not hold exactly one frame
+    uint64_t get_rejectedLines() const { return _reader->get_rejectedLines(); }
+};
+
+/// \brief formats decoded rows and writes them to a descriptor; may be shared by all loops
+class asyncSink
+{
+private:
+    int _fd;                    ///< Output (not owned)
+    recordWriter _pending;      ///< Records formatted and not yet taken by the writing coroutine
+    std::vector<char> _sending; ///< Records being written (by the coroutine that set _draining)
+    size_t _sent;               ///< Bytes of _sending written so far
+    size_t _highWater;          ///< Pending bytes above which write() waits
+    mutable std::mutex _lock;   ///< Guards everything but _sending and _sent
+    bool _draining;             ///< A coroutine is writing
+    bool _failed;               ///< A write failed
+    uint64_t _bytes;            ///< Bytes written
+
+    /// \brief write pending records, or wait for the coroutine that does
+    /// \param all wait until everything is written, instead of until at most `highWater` is pending
+    task<bool> settle(bool all);
+
+public:
+    /// \brief constructor
+    /// \param fd output, for example 1 (stdout) or a socket
+    /// \param format format of the records
+    /// \param highWater pending bytes above which write() waits for the writing coroutine
+    asyncSink(int fd, outputFormat format, size_t highWater = 1 << 20);
+    asyncSink(const asyncSink &) = delete;            ///< Copy constructor disabled
+    asyncSink &operator=(const asyncSink &) = delete; ///< Assignment operator disabled
+
+    /// \brief format all rows of a batch and write them (or leave them to the coroutine writing)
+    /// \param batch decoded rows; may be reused once the co_await returned
+    /// \return false if a write failed (now or earlier)
+    task<bool> write(const payloadBatch &batch);
+
+    /// \brief wait until everything written so far is in the descriptor
+    /// \return false if a write failed
+    task<bool> flush();
+
+    /// \brief write what is still pending, blocking the calling thread
+    /// For the end of a run, after the executor stopped and no coroutine writes any more. A write
+    /// cut short by stopping the executor is completed first, so no records are lost or reordered.
+    /// \return false if a write failed
+    bool finish();
+
+    /// \brief true if a write failed
+    bool failed() const;
+
+    /// \brief bytes written so far
+    uint64_t get_bytes() const;
+};
+
+/// \brief listening TCP socket whose connections are accepted by a coroutine
+class asyncListener
+{
+private:
+    int _fd;        ///< Listening socket, -1 if none
+    uint16_t _port; ///< Port the socket is bound to
+
+public:
+    asyncListener() : _fd(-1), _port(0) {}                   ///< Constructor
+    ~asyncListener();                                         ///< Destructor, closes the socket
+    asyncListener(const asyncListener &) = delete;            ///< Copy constructor disabled
+    asyncListener &operator=(const asyncListener &) = delete; ///< Assignment operator disabled
+
+    /// \brief bind and listen, with SO_REUSEPORT so that every loop can have its own listener
+    /// \param address IPv4 address
+    /// \param port TCP port (0: any free port, see get_port())
+    /// \return false if the socket cannot be opened or bound (the reason is in errno)
+    bool listen(const std::string &address, uint16_t port);
+
+    /// \brief wait for the next connection
+    /// \return non-blocking socket of the connection, owned by the caller; -1 on an error (errno)
+    task<int> accept();
+
+    /// \brief close the socket; accept() then fails
+    void close();
+
+    /// \brief port the socket is bound to, after listen()
+    uint16_t get_port() const { return _port; }
+};
+
+#endif // ASYNCINGEST_H
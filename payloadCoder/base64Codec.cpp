@@ -0,0 +1,371 @@
+#include "base64Codec.h"
+#include "encoder.h"
+
+#include <algorithm> // std::min
+#include <string.h>  // memcpy
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BASE64_CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    /// @brief Value of a base64 character, or 0xFF for any other character.
+    inline uint8_t base64Value(char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+        {
+            return static_cast<uint8_t>(c - 'A');
+        }
+        if (c >= 'a' && c <= 'z')
+        {
+            return static_cast<uint8_t>(c - 'a' + 26);
+        }
+        if (c >= '0' && c <= '9')
+        {
+            return static_cast<uint8_t>(c - '0' + 52);
+        }
+        if (c == '+')
+        {
+            return 62;
+        }
+        if (c == '/')
+        {
+            return 63;
+        }
+        return 0xFF;
+    }
+
+    /// @brief Length of the text without trailing '=' padding (at most two characters).
+    inline size_t unpaddedLength(const char *in, size_t length)
+    {
+        if (length % 4 == 0)
+        {
+            for (int i = 0; i < 2 && length > 0 && in[length - 1] == '='; i++)
+            {
+                length--;
+            }
+        }
+        return length;
+    }
+
+    typedef size_t (*base64FramesFn)(const char *in, size_t count, size_t stride, uint8_t *frames);
+    typedef bool (*base64BlocksFn)(const char *in, size_t blocks, uint8_t *out);
+
+    /// @brief Portable frame decoder.
+    size_t base64ToFramesScalar(const char *in, size_t count, size_t stride, uint8_t *frames)
+    {
+        for (size_t k = 0; k < count; k++)
+        {
+            const char *text = in + k * stride;
+            if (text[BASE64_FRAME_LENGTH - 1] != '=' ||
+                base64ToBinary(text, BASE64_FRAME_LENGTH, frames + k * SENSOR_PAYLOAD_SIZE) != SENSOR_PAYLOAD_SIZE)
+            {
+                return k;
+            }
+        }
+        return count;
+    }
+
+#ifdef BASE64_CODEC_X86
+    /**
+     * The vector decoders use the nibble lookup scheme of Muła and Lemire: two table lookups
+     * (low and high nibble of each character) flag characters outside the alphabet, a third
+     * lookup on the high nibble gives the offset from character to 6-bit value ('/' is the only
+     * character whose offset differs from the rest of its nibble row). Two multiply-adds
+     * merge four 6-bit values into three bytes, and a byte shuffle puts them in output order.
+     * A block of 16 characters becomes 12 bytes; stores are 16 bytes wide, so the caller
+     * leaves room behind the output or the next block overwrites the surplus.
+     */
+
+    /// @brief 6-bit values of 16 characters; sets bits in `invalid` for characters outside the alphabet.
+    __attribute__((target("sse4.1"))) inline __m128i base64Values16(__m128i c, int &invalid)
+    {
+        const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi32(c, 4), nibble);
+        const __m128i lo = _mm_and_si128(c, nibble);
+        const __m128i bad = _mm_and_si128(_mm_shuffle_epi8(lutLo, lo), _mm_shuffle_epi8(lutHi, hi));
+        invalid |= _mm_movemask_epi8(_mm_cmpgt_epi8(bad, _mm_setzero_si128()));
+        const __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+        return _mm_add_epi8(c, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(slash, hi)));
+    }
+
+    /// @brief Merge 16 6-bit values into 12 bytes (bytes 12-15 are zero).
+    __attribute__((target("sse4.1"))) inline __m128i base64Pack16(__m128i values)
+    {
+        const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const __m128i triples = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        return _mm_shuffle_epi8(triples, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    }
+
+    /// @brief Decode one padded frame into bytes 0-10; sets bits in `invalid` for bad characters or padding.
+    __attribute__((target("sse4.1"))) inline __m128i base64Frame16(const char *in, int &invalid)
+    {
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        invalid |= _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('='))) ^ 0x8000; // '=' in the last position only
+        return base64Pack16(base64Values16(_mm_insert_epi8(c, 'A', 15), invalid));
+    }
+
+    __attribute__((target("sse4.1"))) size_t base64ToFramesSse41(const char *in, size_t count, size_t stride, uint8_t *frames)
+    {
+        for (size_t k = 0; k < count; k++)
+        {
+            int invalid = 0;
+            const __m128i bytes = base64Frame16(in + k * stride, invalid);
+            if (invalid != 0)
+            {
+                return k;
+            }
+            if (k + 1 < count)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(frames + k * SENSOR_PAYLOAD_SIZE), bytes); // next frame overwrites the surplus
+            }
+            else
+            {
+                uint8_t last[16];
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(last), bytes);
+                memcpy(frames + k * SENSOR_PAYLOAD_SIZE, last, SENSOR_PAYLOAD_SIZE);
+            }
+        }
+        return count;
+    }
+
+    __attribute__((target("sse4.1"))) bool base64BlocksSse41(const char *in, size_t blocks, uint8_t *out)
+    {
+        int invalid = 0;
+        for (size_t i = 0; i < blocks; i++)
+        {
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16 * i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12 * i), base64Pack16(base64Values16(c, invalid)));
+        }
+        return invalid == 0;
+    }
+
+    /// @brief 6-bit values of 32 characters; sets bits in `invalid` for characters outside the alphabet.
+    __attribute__((target("avx2"))) inline __m256i base64Values32(__m256i c, int &invalid)
+    {
+        const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                               0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                               0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(c, 4), nibble);
+        const __m256i lo = _mm256_and_si256(c, nibble);
+        const __m256i bad = _mm256_and_si256(_mm256_shuffle_epi8(lutLo, lo), _mm256_shuffle_epi8(lutHi, hi));
+        invalid |= _mm256_movemask_epi8(_mm256_cmpgt_epi8(bad, _mm256_setzero_si256()));
+        const __m256i slash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'));
+        return _mm256_add_epi8(c, _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(slash, hi)));
+    }
+
+    /// @brief Merge 32 6-bit values into 12 bytes per 128-bit lane (bytes 12-15 of each lane are zero).
+    __attribute__((target("avx2"))) inline __m256i base64Pack32(__m256i values)
+    {
+        const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        const __m256i triples = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        return _mm256_shuffle_epi8(triples, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                             2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    }
+
+    /// @brief Two frames per step, one in each 128-bit lane.
+    __attribute__((target("avx2"))) size_t base64ToFramesAvx2(const char *in, size_t count, size_t stride, uint8_t *frames)
+    {
+        size_t k = 0;
+        for (; k + 3 <= count; k += 2) // the second store ends 5 bytes into frame k + 2
+        {
+            const __m256i c = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + k * stride))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + (k + 1) * stride)), 1);
+            const __m256i pad = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('='));
+            int invalid = _mm256_movemask_epi8(pad) ^ static_cast<int>(0x80008000u);
+            const __m256i bytes = base64Pack32(base64Values32(_mm256_blendv_epi8(c, _mm256_set1_epi8('A'), pad), invalid));
+            if (invalid != 0)
+            {
+                break; // the one-frame loop finds which frame is bad
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(frames + k * SENSOR_PAYLOAD_SIZE), _mm256_castsi256_si128(bytes));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(frames + (k + 1) * SENSOR_PAYLOAD_SIZE), _mm256_extracti128_si256(bytes, 1));
+        }
+        return k + base64ToFramesSse41(in + k * stride, count - k, stride, frames + k * SENSOR_PAYLOAD_SIZE);
+    }
+
+    __attribute__((target("avx2"))) bool base64BlocksAvx2(const char *in, size_t blocks, uint8_t *out)
+    {
+        int invalid = 0;
+        size_t i = 0;
+        for (; i + 2 <= blocks; i += 2)
+        {
+            const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + 16 * i));
+            const __m256i bytes = base64Pack32(base64Values32(c, invalid));
+            // close the gap between the lanes: dwords 0-2 and 4-6 hold the 24 bytes
+            const __m256i packed = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 12 * i), packed);
+        }
+        const bool valid = invalid == 0;
+        return base64BlocksSse41(in + 16 * i, blocks - i, out + 12 * i) && valid;
+    }
+#endif
+
+    /// @brief Frame decoder, block decoder (none for the scalar kernel) and name for one kernel.
+    struct base64Entry
+    {
+        base64FramesFn frames;
+        base64BlocksFn blocks;
+        const char *name;
+    };
+
+    base64Entry base64EntryFor(decodeKernel kernel)
+    {
+        switch (kernel)
+        {
+#ifdef BASE64_CODEC_X86
+        case decodeKernel::avx2:
+            return base64Entry{base64ToFramesAvx2, base64BlocksAvx2, "avx2"};
+        case decodeKernel::sse41:
+            return base64Entry{base64ToFramesSse41, base64BlocksSse41, "sse4.1"};
+#endif
+        default:
+            return base64Entry{base64ToFramesScalar, nullptr, "scalar"};
+        }
+    }
+
+    decodeKernel bestBase64Kernel()
+    {
+        if (decodeKernelSupported(decodeKernel::avx2))
+        {
+            return decodeKernel::avx2;
+        }
+        if (decodeKernelSupported(decodeKernel::sse41))
+        {
+            return decodeKernel::sse41;
+        }
+        return decodeKernel::scalar;
+    }
+
+    base64Entry activeBase64 = base64EntryFor(bestBase64Kernel()); ///< Kernel used by the base64 decoders
+}
+
+size_t base64DecodedSize(const char *in, size_t length)
+{
+    const size_t chars = unpaddedLength(in, length);
+    if (chars % 4 == 1)
+    {
+        return 0; // a single trailing character cannot encode a whole byte
+    }
+    return chars / 4 * 3 + (chars % 4 == 0 ? 0 : chars % 4 - 1);
+}
+
+size_t base64ToBinary(const char *in, size_t length, uint8_t *out)
+{
+    const size_t chars = unpaddedLength(in, length);
+    const size_t size = base64DecodedSize(in, length);
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    uint8_t invalid = 0;
+    size_t o = 0;
+    size_t i = 0;
+    if (activeBase64.blocks != nullptr && size >= 20)
+    {
+        /** Whole 16-character blocks on the vector kernel, leaving 8 bytes behind the last store. */
+        const size_t blocks = std::min(chars / 16, (size - 8) / 12);
+        if (!activeBase64.blocks(in, blocks, out))
+        {
+            return 0;
+        }
+        i = 16 * blocks;
+        o = 12 * blocks;
+    }
+    for (; i + 4 <= chars; i += 4)
+    {
+        const uint8_t a = base64Value(in[i]);
+        const uint8_t b = base64Value(in[i + 1]);
+        const uint8_t c = base64Value(in[i + 2]);
+        const uint8_t d = base64Value(in[i + 3]);
+        invalid |= (a | b | c | d) & 0xC0;
+        const uint32_t triple = (static_cast<uint32_t>(a & 0x3F) << 18) | (static_cast<uint32_t>(b & 0x3F) << 12) |
+                                (static_cast<uint32_t>(c & 0x3F) << 6) | (d & 0x3F);
+        out[o++] = static_cast<uint8_t>(triple >> 16);
+        out[o++] = static_cast<uint8_t>(triple >> 8);
+        out[o++] = static_cast<uint8_t>(triple);
+    }
+
+    /** Tail of two or three characters: one or two bytes. */
+    if (i < chars)
+    {
+        uint32_t triple = 0;
+        const size_t rest = chars - i;
+        for (size_t k = 0; k < rest; k++)
+        {
+            const uint8_t v = base64Value(in[i + k]);
+            invalid |= v & 0xC0;
+            triple |= static_cast<uint32_t>(v & 0x3F) << (18 - 6 * k);
+        }
+        out[o++] = static_cast<uint8_t>(triple >> 16);
+        if (rest == 3)
+        {
+            out[o++] = static_cast<uint8_t>(triple >> 8);
+        }
+    }
+
+    return invalid == 0 ? o : 0;
+}
+
+void binaryToBase64(const uint8_t *in, size_t length, char *out)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < length; i += 3)
+    {
+        const size_t rest = length - i;
+        const uint32_t triple = (static_cast<uint32_t>(in[i]) << 16) |
+                                (rest > 1 ? static_cast<uint32_t>(in[i + 1]) << 8 : 0) |
+                                (rest > 2 ? in[i + 2] : 0);
+        out[o++] = alphabet[(triple >> 18) & 0x3F];
+        out[o++] = alphabet[(triple >> 12) & 0x3F];
+        out[o++] = rest > 1 ? alphabet[(triple >> 6) & 0x3F] : '=';
+        out[o++] = rest > 2 ? alphabet[triple & 0x3F] : '=';
+    }
+}
+
+bool base64ToFrame(const char *in, uint8_t *frame)
+{
+    return activeBase64.frames(in, 1, 0, frame) == 1;
+}
+
+size_t base64ToFrames(const char *in, size_t count, size_t stride, uint8_t *frames)
+{
+    return activeBase64.frames(in, count, stride, frames);
+}
+
+bool selectBase64Kernel(decodeKernel kernel)
+{
+    if (kernel == decodeKernel::automatic)
+    {
+        kernel = bestBase64Kernel();
+    }
+    if (!decodeKernelSupported(kernel))
+    {
+        return false;
+    }
+    activeBase64 = base64EntryFor(kernel);
+    return true;
+}
+
+const char *activeBase64KernelName()
+{
+    return activeBase64.name;
+}
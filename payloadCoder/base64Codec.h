@@ -0,0 +1,69 @@
+/**
+ * @file base64Codec.h
+ * @brief Base64 decoding of payloads, as delivered in TTN v3 `frm_payload` fields.
+ *
+ * Standard alphabet (RFC 4648) with optional '=' padding. An 11-byte frame is 16 characters.
+ * Encoding (used for generated traffic) always pads.
+ *
+ * Padded frames have their own decoder, base64ToFrame(), and a batch form, base64ToFrames(),
+ * that writes frames back-to-back, ready for payloadDecoder::decodeBatch(). Like the hex
+ * conversion, decoding has scalar, SSE4.1 (one frame or 16 characters per step) and AVX2 (two
+ * frames or 32 characters per step) implementations; the best one is picked at runtime.
+ */
+
+#ifndef BASE64CODEC_H
+#define BASE64CODEC_H
+
+#include <stdint.h> // uint8_t type
+#include <stddef.h> // size_t
+
+#include "decodeKernels.h" // decodeKernel
+
+const size_t BASE64_FRAME_LENGTH = 16; ///< Characters of one padded SENSOR_PAYLOAD_SIZE frame
+
+/// \brief number of bytes encoded by base64 text
+/// \param in base64 text
+/// \param length number of characters in `in`
+/// \return decoded size in bytes, or 0 if `length` is not a valid base64 length
+size_t base64DecodedSize(const char *in, size_t length);
+
+/// \brief convert base64 text to bytes
+/// \param in base64 text, padded or unpadded
+/// \param length number of characters in `in`
+/// \param out buffer receiving base64DecodedSize(in, length) bytes
+/// \return number of bytes written, or 0 if `in` is not valid base64
+size_t base64ToBinary(const char *in, size_t length, uint8_t *out);
+
+/// \brief number of characters of padded base64 text for a number of bytes
+inline size_t base64EncodedSize(size_t length) { return (length + 2) / 3 * 4; }
+
+/// \brief convert bytes to padded base64 text
+/// \param in bytes to convert
+/// \param length number of bytes in `in`
+/// \param out buffer receiving base64EncodedSize(length) characters (not null-terminated)
+void binaryToBase64(const uint8_t *in, size_t length, char *out);
+
+/// \brief convert one padded base64 frame ("AQIDBAEFZAoLDA0=") to SENSOR_PAYLOAD_SIZE bytes
+/// \param in BASE64_FRAME_LENGTH characters, the last one '='
+/// \param frame buffer receiving SENSOR_PAYLOAD_SIZE bytes
+/// \return false if `in` is not a padded frame; `frame` is then undefined
+bool base64ToFrame(const char *in, uint8_t *frame);
+
+/// \brief convert padded base64 frames stored at a fixed distance, such as one frame per line
+/// \param in first frame text
+/// \param count number of frames
+/// \param stride distance in characters from one frame text to the next (at least BASE64_FRAME_LENGTH)
+/// \param frames buffer receiving count * SENSOR_PAYLOAD_SIZE bytes, frames back-to-back
+/// \return number of frames converted; stops before the first text that is not a padded frame
+size_t base64ToFrames(const char *in, size_t count, size_t stride, uint8_t *frames);
+
+/// \brief select the implementation used by the base64 decoders
+/// \param kernel implementation to use; decodeKernel::automatic picks the best supported one
+/// \return false if the implementation is not supported on this CPU (selection is unchanged)
+bool selectBase64Kernel(decodeKernel kernel);
+
+/// \brief get the name of the selected implementation
+/// \return "scalar", "sse4.1" or "avx2"
+const char *activeBase64KernelName();
+
+#endif // BASE64CODEC_H
@@ -0,0 +1,85 @@
+#include "batchArena.h"
+
+#include <algorithm> // std::max
+
+batchArena::batchArena(size_t blockSize, std::pmr::memory_resource *upstream)
+    : _upstream(upstream), _blocks(), _current(0), _offset(0), _nextSize(std::max<size_t>(blockSize, 256)), _used(0), _peak(0)
+{
+}
+
+batchArena::~batchArena()
+{
+    release();
+}
+
+void batchArena::release()
+{
+    size_t capacity = 0;
+    for (const block &b : _blocks)
+    {
+        capacity += b.size;
+        _upstream->deallocate(b.data, b.size, alignof(std::max_align_t));
+    }
+    if (!_blocks.empty())
+    {
+        _nextSize = capacity;
+    }
+    _blocks.clear();
+}
+
+void *batchArena::do_allocate(size_t bytes, size_t alignment)
+{
+    for (;;)
+    {
+        if (_current == _blocks.size())
+        {
+            size_t size = _nextSize;
+            while (size < bytes + alignment)
+            {
+                size *= 2;
+            }
+            _blocks.push_back(block{static_cast<uint8_t *>(_upstream->allocate(size, alignof(std::max_align_t))), size});
+            _nextSize = size * 2;
+        }
+
+        const block &b = _blocks[_current];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+        const size_t start = static_cast<size_t>(((base + _offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1)) - base);
+        if (start + bytes <= b.size)
+        {
+            _used += start + bytes - _offset;
+            _peak = std::max(_peak, _used);
+            _offset = start + bytes;
+            return b.data + start;
+        }
+
+        /** The rest of this block stays unused until the next reset(). */
+        _current++;
+        _offset = 0;
+    }
+}
+
+size_t batchArena::get_capacity() const
+{
+    size_t capacity = 0;
+    for (const block &b : _blocks)
+    {
+        capacity += b.size;
+    }
+    return capacity;
+}
+
+void *trackingResource::do_allocate(size_t bytes, size_t alignment)
+{
+    void *pointer = _upstream->allocate(bytes, alignment);
+    _inUse += bytes;
+    _peak = std::max(_peak, _inUse);
+    _allocations++;
+    return pointer;
+}
+
+void trackingResource::do_deallocate(void *pointer, size_t bytes, size_t alignment)
+{
+    _upstream->deallocate(pointer, bytes, alignment);
+    _inUse -= bytes;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file batchArena.h
+ * @brief Monotonic arena for per-batch scratch memory, and a memory resource that counts bytes.
+ *
+ * Decoding works batch by batch: the columns decoded from one chunk of input are dropped before the
+ * next chunk is read. batchArena hands out that memory by bumping
+ * a pointer through large blocks, ignores deallocation, and reset() rewinds it to the first block
+ * in O(1) once the batch is done. The blocks stay allocated, so once the arena has grown to fit the
+ * largest batch, no memory comes from the heap at all.
+ *
+ * Both classes are std::pmr::memory_resource implementations, so any std::pmr container takes
+ * them; payloadBatch, frameReader, recordWriter and arrowWriter accept one.
+ *
+ * trackingResource forwards to another resource and counts the bytes in use, their peak and the
+ * number of allocations. Give each stage its own tracker (reading, decoding, formatting) to see
+ * how much memory each stage needs; used as the upstream of a batchArena it shows when the arena
+ * still has to grow.
+ *
+ * Neither class is thread-safe: use one per thread.
+ *
+ * Usage: create a batchArena, build the containers of a batch on it, destroy them, call reset().
+ */
+
+#ifndef BATCHARENA_H
+#define BATCHARENA_H
+
+#include <stdint.h> // uint8_t and uint64_t type
+#include <stddef.h> // size_t
+#include <memory_resource>
+#include <vector>
+
+/// \brief bump allocator over retained blocks, rewound once per batch
+class batchArena : public std::pmr::memory_resource
+{
+private:
+    /// \brief memory obtained from the upstream resource
+    struct block
+    {
+        uint8_t *data; ///< Start of the block
+        size_t size;   ///< Bytes in the block
+    };
+
+    std::pmr::memory_resource *_upstream; ///< Source of the blocks
+    std::vector<block> _blocks;           ///< All blocks, kept across reset()
+    size_t _current;                      ///< Block being filled
+    size_t _offset;                       ///< Bytes used in the current block
+    size_t _nextSize;                     ///< Size of the next block to allocate
+    size_t _used;                         ///< Bytes handed out since the last reset(), including alignment padding
+    size_t _peak;                         ///< Largest _used seen
+
+    /// \brief return all blocks upstream; the next block is as large as all of them together
+    void release();
+
+protected:
+    /// \brief hand out `bytes` bytes aligned to `alignment`
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    /// \brief does nothing: memory comes back with reset()
+    void do_deallocate(void *, size_t, size_t) override {}
+
+    /// \brief arenas only free memory they handed out themselves
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+public:
+    /// \brief constructor; no memory is taken until the first allocation
+    /// \param blockSize size of the first block; later blocks double in size
+    /// \param upstream source of the blocks
+    explicit batchArena(size_t blockSize = 64 << 10, std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+    ~batchArena() override;                             ///< Destructor, returns the blocks upstream
+    batchArena(const batchArena &) = delete;            ///< Copy constructor disabled
+    batchArena &operator=(const batchArena &) = delete; ///< Assignment operator disabled
+
+    /// \brief make all memory available again; everything allocated before must be out of use
+    /// If the memory since the last reset did not fit in the first block, the blocks are returned
+    /// and the next allocation takes one block as large as all of them, so that a steady stream of
+    /// similar batches runs from a single block.
+    void reset()
+    {
+        if (_current != 0)
+        {
+            release();
+        }
+        _current = 0;
+        _offset = 0;
+        _used = 0;
+    }
+
+    /// \brief bytes handed out since the last reset()
+    size_t get_used() const { return _used; }
+
+    /// \brief most bytes handed out between two resets
+    size_t get_peak() const { return _peak; }
+
+    /// \brief bytes held in blocks
+    size_t get_capacity() const;
+
+    /// \brief number of blocks
+    size_t get_blocks() const { return _blocks.size(); }
+};
+
+/// \brief memory resource that counts what passes through it
+class trackingResource : public std::pmr::memory_resource
+{
+private:
+    std::pmr::memory_resource *_upstream; ///< Resource that does the work
+    size_t _inUse;                        ///< Bytes allocated and not yet deallocated
+    size_t _peak;                         ///< Largest _inUse seen
+    uint64_t _allocations;                ///< Calls of allocate()
+
+protected:
+    /// \brief allocate upstream and count
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    /// \brief deallocate upstream and count
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+
+    /// \brief equal to itself only
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+public:
+    /// \brief constructor
+    /// \param upstream resource that does the work
+    explicit trackingResource(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : _upstream(upstream), _inUse(0), _peak(0), _allocations(0) {}
+    trackingResource(const trackingResource &) = delete;            ///< Copy constructor disabled
+    trackingResource &operator=(const trackingResource &) = delete; ///< Assignment operator disabled
+
+    /// \brief bytes allocated and not yet deallocated
+    size_t get_inUse() const { return _inUse; }
+
+    /// \brief most bytes in use at any time
+    size_t get_peak() const { return _peak; }
+
+    /// \brief number of allocations
+    uint64_t get_allocations() const { return _allocations; }
+};
+
+#endif // BATCHARENA_H
@@ -0,0 +1,186 @@
+#include "batteryTrend.h"
+
+#include <algorithm> // std::partial_sort, std::max, std::min
+#include <cmath>     // std::exp, std::log
+#include <limits>
+
+namespace
+{
+    const double SECONDS_PER_DAY = 86400.0; ///< Seconds per day
+
+    /// @brief Slot of an id in a table of `mask` + 1 slots.
+    inline size_t slotOf(uint32_t id, size_t mask)
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+
+    /// @brief Soonest empty first; ties by id so that the ranking is stable.
+    inline bool sooner(const batteryForecast &a, const batteryForecast &b)
+    {
+        return a.daysToEmpty != b.daysToEmpty ? a.daysToEmpty < b.daysToEmpty : a.id < b.id;
+    }
+}
+
+batteryTrendTracker::batteryTrendTracker(const batteryTrendConfig &config, size_t expectedTraps)
+    : _config(config), _decayPerDay(std::log(2.0) / config.halfLifeDays), _entries(), _traps(0), _records(0), _replacements(0)
+{
+    size_t slots = 16;
+    while (slots < expectedTraps * 2)
+    {
+        slots <<= 1;
+    }
+    _entries.resize(slots, entry{0, 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0});
+}
+
+void batteryTrendTracker::grow()
+{
+    std::vector<entry> old(_entries.size() * 2, entry{0, 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0});
+    old.swap(_entries);
+    const size_t mask = _entries.size() - 1;
+    for (const entry &e : old)
+    {
+        if (e.used)
+        {
+            size_t slot = slotOf(e.id, mask);
+            while (_entries[slot].used)
+            {
+                slot = (slot + 1) & mask;
+            }
+            _entries[slot] = e;
+        }
+    }
+}
+
+void batteryTrendTracker::update(uint32_t id, uint8_t battery, uint32_t unixTime)
+{
+    _records++;
+    const size_t mask = _entries.size() - 1;
+    size_t slot = slotOf(id, mask);
+    while (_entries[slot].used && _entries[slot].id != id)
+    {
+        slot = (slot + 1) & mask;
+    }
+    entry *e = &_entries[slot];
+    if (!e->used)
+    {
+        *e = entry{id, unixTime, unixTime, 0, 0.0, 0.0, 0.0, 0.0, 0.0, battery, 1};
+        if (++_traps * 2 > _entries.size())
+        {
+            grow();
+            slot = slotOf(id, _entries.size() - 1);
+            while (_entries[slot].id != id || !_entries[slot].used)
+            {
+                slot = (slot + 1) & (_entries.size() - 1);
+            }
+            e = &_entries[slot];
+        }
+    }
+
+    if (unixTime < e->baseTime)
+    {
+        // Late record from before the current battery
+        return;
+    }
+    double t = (static_cast<double>(unixTime) - static_cast<double>(e->baseTime)) / SECONDS_PER_DAY;
+    const double lastT = (static_cast<double>(e->lastTime) - static_cast<double>(e->baseTime)) / SECONDS_PER_DAY;
+    const double b = battery;
+    double weight = 1.0;
+    if (e->samples != 0 && unixTime >= e->lastTime)
+    {
+        // A rise well above the fitted line is a new battery: start a new fit at this record
+        const double fitted = e->ctt > 0.0 ? e->meanB + e->ctb / e->ctt * (t - e->meanT) : e->meanB;
+        if (b > fitted + _config.replacementJump)
+        {
+            *e = entry{id, unixTime, unixTime, 0, 0.0, 0.0, 0.0, 0.0, 0.0, battery, 1};
+            _replacements++;
+            t = 0.0;
+        }
+        else
+        {
+            // Age the fit to the new record
+            const double decay = std::exp(-_decayPerDay * (t - lastT));
+            e->weight *= decay;
+            e->ctt *= decay;
+            e->ctb *= decay;
+        }
+    }
+    else if (e->samples != 0)
+    {
+        // Late record: it enters with the weight it would have had if it had arrived in order
+        weight = std::exp(-_decayPerDay * (lastT - t));
+    }
+
+    // Weighted incremental update of the means and co-moments
+    e->weight += weight;
+    const double dT = t - e->meanT;
+    e->meanT += dT * weight / e->weight;
+    e->meanB += (b - e->meanB) * weight / e->weight;
+    e->ctt += weight * dT * (t - e->meanT);
+    e->ctb += weight * dT * (b - e->meanB);
+    e->samples++;
+    if (unixTime >= e->lastTime)
+    {
+        e->lastTime = unixTime;
+        e->battery = battery;
+    }
+}
+
+void batteryTrendTracker::update(const payloadBatch &batch)
+{
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        update(batch.id[i], batch.battery[i], batch.unixTime[i]);
+    }
+}
+
+void batteryTrendTracker::fill(const entry &e, batteryForecast &out) const
+{
+    const double lastT = (static_cast<double>(e.lastTime) - static_cast<double>(e.baseTime)) / SECONDS_PER_DAY;
+    out.id = e.id;
+    out.battery = e.battery;
+    out.lastTime = e.lastTime;
+    out.samples = e.samples;
+    out.valid = e.samples >= 3 && e.weight > 0.0 && e.ctt / e.weight >= _config.minSpanDays * _config.minSpanDays;
+    out.slopePerDay = e.ctt > 0.0 ? e.ctb / e.ctt : 0.0;
+    out.level = e.meanB + out.slopePerDay * (lastT - e.meanT);
+    out.daysToEmpty = out.valid && out.slopePerDay < 0.0
+                          ? std::max(0.0, (out.level - _config.emptyLevel) / -out.slopePerDay)
+                          : std::numeric_limits<double>::infinity();
+}
+
+bool batteryTrendTracker::forecast(uint32_t id, batteryForecast &out) const
+{
+    const size_t mask = _entries.size() - 1;
+    size_t slot = slotOf(id, mask);
+    while (_entries[slot].used)
+    {
+        if (_entries[slot].id == id)
+        {
+            fill(_entries[slot], out);
+            return true;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return false;
+}
+
+size_t batteryTrendTracker::dueForService(size_t count, std::vector<batteryForecast> &out) const
+{
+    out.clear();
+    batteryForecast f;
+    for (const entry &e : _entries)
+    {
+        if (e.used)
+        {
+            fill(e, f);
+            if (f.valid)
+            {
+                out.push_back(f);
+            }
+        }
+    }
+    const size_t n = std::min(count, out.size());
+    std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(n), out.end(), sooner);
+    out.resize(n);
+    return n;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file batteryTrend.h
+ * @brief Online per-trap fit of the battery decline and a forecast of when each trap runs empty.
+ *
+ * Every record updates a weighted least-squares line through (unixTime, batteryStatus) of its
+ * trap. The fit is kept as weighted means and co-moments (West's incremental form), so each
+ * update costs a few multiplications, needs no history and stays accurate however long a trap
+ * runs. Older samples fade out with a configurable half-life, so the slope follows changes in
+ * consumption (a cold week, a flaky sensor waking the node). A jump up by more than
+ * `replacementJump` percent is taken as a battery swap and restarts the fit.
+ *
+ * From the fit, the forecast gives the fitted level at the latest record, the decline per day and
+ * the days until the level reaches `emptyLevel`. dueForService() ranks the fleet by that figure.
+ *
+ * Usage: create one batteryTrendTracker, call update() with every decoded batch, and call
+ * forecast() or dueForService() whenever a route has to be planned.
+ */
+
+#ifndef BATTERYTREND_H
+#define BATTERYTREND_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <vector>
+
+#include "payloadBatch.h"
+
+/// \brief settings of the battery trend fit
+struct batteryTrendConfig
+{
+    double halfLifeDays = 14.0;    ///< Age at which a sample counts half in the fit
+    double emptyLevel = 0.0;       ///< Battery level (percent) that counts as empty
+    double replacementJump = 15.0; ///< Rise above the fitted level (percent) that means a new battery
+    double minSpanDays = 0.5;      ///< Weighted spread of sample times (standard deviation, days) needed for a forecast
+};
+
+/// \brief battery forecast of one trap
+struct batteryForecast
+{
+    uint32_t id = 0;          ///< Payload id of the trap
+    uint8_t battery = 0;      ///< Battery status of the latest record
+    uint32_t lastTime = 0;    ///< Unix time of the latest record
+    double level = 0.0;       ///< Fitted battery level at lastTime (percent)
+    double slopePerDay = 0.0; ///< Fitted change of the level per day (negative while draining)
+    double daysToEmpty = 0.0; ///< Days from lastTime until the level reaches emptyLevel; infinity if not draining
+    uint32_t samples = 0;     ///< Records in the current fit (since the last battery swap)
+    bool valid = false;       ///< True if the samples span enough time for a slope
+};
+
+/// \brief per-trap battery trend fits
+class batteryTrendTracker
+{
+private:
+    /// \brief fit of one trap (open addressing slot)
+    struct entry
+    {
+        uint32_t id;       ///< Payload id
+        uint32_t baseTime; ///< Unix time that sample times are counted from
+        uint32_t lastTime; ///< Time of the latest record
+        uint32_t samples;  ///< Records in the fit
+        double weight;     ///< Sum of the sample weights
+        double meanT;      ///< Weighted mean sample time (days since baseTime)
+        double meanB;      ///< Weighted mean battery level
+        double ctt;        ///< Weighted sum of squared time deviations
+        double ctb;        ///< Weighted sum of time-battery deviation products
+        uint8_t battery;   ///< Battery status of the latest record
+        uint8_t used;      ///< 1 if the slot holds a trap
+    };
+
+    batteryTrendConfig _config;  ///< Settings
+    double _decayPerDay;         ///< ln(2) / halfLifeDays
+    std::vector<entry> _entries; ///< Hash table, size a power of two
+    size_t _traps;               ///< Slots in use
+    uint64_t _records;           ///< Records applied
+    uint64_t _replacements;      ///< Battery swaps detected
+
+    /// \brief double the table
+    void grow();
+
+    /// \brief fill in a forecast from a fit
+    void fill(const entry &e, batteryForecast &out) const;
+
+public:
+    /// \brief constructor
+    /// \param config fit settings
+    /// \param expectedTraps number of traps to reserve room for
+    explicit batteryTrendTracker(const batteryTrendConfig &config = batteryTrendConfig(), size_t expectedTraps = 1024);
+
+    /// \brief add one record to its trap's fit
+    /// \param id payload id
+    /// \param battery battery status (percent)
+    /// \param unixTime unix time of the record; records may arrive out of order, those from before
+    ///        the latest battery swap are ignored
+    void update(uint32_t id, uint8_t battery, uint32_t unixTime);
+
+    /// \brief add all rows of a batch
+    /// \param batch decoded rows
+    void update(const payloadBatch &batch);
+
+    /// \brief forecast of one trap
+    /// \param id payload id
+    /// \param out receives the forecast
+    /// \return false if the trap has not been seen
+    bool forecast(uint32_t id, batteryForecast &out) const;
+
+    /// \brief traps that run empty soonest
+    /// \param count maximum number of traps to return
+    /// \param out receives the valid forecasts with the fewest days to empty, soonest first
+    /// \return number of forecasts returned
+    size_t dueForService(size_t count, std::vector<batteryForecast> &out) const;
+
+    /// \brief number of traps seen
+    size_t get_traps() const { return _traps; }
+
+    /// \brief number of records applied
+    uint64_t get_records() const { return _records; }
+
+    /// \brief number of battery swaps detected
+    uint64_t get_replacements() const { return _replacements; }
+};
+
+#endif // BATTERYTREND_H
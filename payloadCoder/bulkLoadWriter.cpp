@@ -0,0 +1,299 @@
+#include "bulkLoadWriter.h"
+
+#include <charconv> // std::to_chars
+#include <string.h> // memcpy
+#include <time.h>   // gmtime_r
+
+#include <fcntl.h>  // open
+#include <unistd.h> // access, close, fsync
+
+namespace
+{
+    const size_t MAX_ROW_SIZE = 512;    ///< Upper bound for one formatted row (text columns are clamped)
+    const size_t BUFFER_SIZE = 1 << 20; ///< Bytes buffered before writing to the file
+
+    /// @brief Append a string literal without its terminating null.
+    template <size_t N>
+    inline char *appendLiteral(char *out, const char (&text)[N])
+    {
+        memcpy(out, text, N - 1);
+        return out + N - 1;
+    }
+
+    /// @brief Append a number in decimal.
+    template <typename T>
+    inline char *appendNumber(char *out, T value)
+    {
+        return std::to_chars(out, out + 20, value).ptr;
+    }
+
+    /// @brief Append text escaped for LOAD DATA, at most `limit` characters of it; NULL if empty.
+    inline char *appendText(char *out, std::string_view text, size_t limit)
+    {
+        if (text.empty())
+        {
+            return appendLiteral(out, "\\N");
+        }
+        for (size_t i = 0; i < text.size() && i < limit; i++)
+        {
+            const char c = text[i];
+            if (c == '\t' || c == '\n' || c == '\\')
+            {
+                *out++ = '\\';
+                *out++ = c == '\t' ? 't' : c == '\n' ? 'n' : '\\';
+            }
+            else if (c != '\r' && c != '\0')
+            {
+                *out++ = c;
+            }
+        }
+        return out;
+    }
+}
+
+std::string bulkLoadStatement(const std::string &path, const char *table)
+{
+    std::string sql = "LOAD DATA LOCAL INFILE '";
+    for (const char c : path)
+    {
+        if (c == '\'' || c == '\\')
+        {
+            sql += '\\';
+        }
+        sql += c;
+    }
+    sql += "' INTO TABLE ";
+    sql += table;
+    sql += " CHARACTER SET utf8mb4 FIELDS TERMINATED BY '\\t' LINES TERMINATED BY '\\n' (";
+    sql += BULK_LOAD_COLUMNS;
+    sql += ");\n";
+    return sql;
+}
+
+bulkLoadWriter::bulkLoadWriter(const bulkLoadConfig &config)
+    : _config(config),
+      _file(nullptr),
+      _number(1),
+      _buffer(BUFFER_SIZE + MAX_ROW_SIZE),
+      _used(0),
+      _current(),
+      _completed(),
+      _rows(0),
+      _failed(false),
+      _dateSecond(0),
+      _dateText()
+{
+    if (_config.maxRows == 0)
+    {
+        _config.maxRows = 1;
+    }
+    if (_config.messageSource.size() > 32)
+    {
+        _config.messageSource.resize(32); // varchar(32)
+    }
+}
+
+bulkLoadWriter::~bulkLoadWriter()
+{
+    close();
+}
+
+std::string bulkLoadWriter::pathOf(unsigned number, bool part) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "-%06u.tsv%s", number, part ? ".part" : "");
+    return _config.directory + "/" + _config.prefix + name;
+}
+
+bool bulkLoadWriter::startFile()
+{
+    /** Skip numbers in use, completed or not, so that a restart never overwrites a file. */
+    for (; _number < 1000000; _number++)
+    {
+        if (access(pathOf(_number, false).c_str(), F_OK) == 0)
+        {
+            continue;
+        }
+        const int fd = open(pathOf(_number, true).c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            continue;
+        }
+        _file = fdopen(fd, "wb");
+        if (_file == nullptr)
+        {
+            ::close(fd);
+            break;
+        }
+        _current = bulkLoadFile();
+        _current.path = pathOf(_number, false);
+        return true;
+    }
+    _failed = true;
+    return false;
+}
+
+void bulkLoadWriter::drain()
+{
+    if (_used != 0 && _file != nullptr && fwrite(_buffer.data(), 1, _used, _file) != _used)
+    {
+        _failed = true;
+    }
+    _used = 0;
+}
+
+bool bulkLoadWriter::finishFile()
+{
+    drain();
+    bool ok = fflush(_file) == 0 && fsync(fileno(_file)) == 0;
+    ok = fclose(_file) == 0 && ok;
+    _file = nullptr;
+    ok = ok && rename(pathOf(_number, true).c_str(), _current.path.c_str()) == 0;
+    _number++;
+
+    if (ok)
+    {
+        FILE *manifest = fopen((_config.directory + "/" + _config.prefix + ".manifest").c_str(), "ab");
+        const size_t slash = _current.path.rfind('/');
+        ok = manifest != nullptr &&
+             fprintf(manifest, "%s\t%llu\t%llu\t%lu\t%lu\n", _current.path.c_str() + (slash == std::string::npos ? 0 : slash + 1),
+                     static_cast<unsigned long long>(_current.rows), static_cast<unsigned long long>(_current.bytes),
+                     static_cast<unsigned long>(_current.firstTime), static_cast<unsigned long>(_current.lastTime)) > 0;
+        ok = manifest != nullptr && fclose(manifest) == 0 && ok;
+        _completed.push_back(_current);
+    }
+    _failed = _failed || !ok;
+    return ok;
+}
+
+void bulkLoadWriter::appendRow(const payloadBatch &batch, size_t row, const ttnUplink *uplink)
+{
+    const char *const start = _buffer.data() + _used;
+    char *out = _buffer.data() + _used;
+    out = appendText(out, _config.messageSource, 32);
+    *out++ = '\t';
+
+    if (uplink != nullptr)
+    {
+        const uint32_t received = ttnTimeToUnix(uplink->receivedAt);
+        if (received != 0 && received != _dateSecond)
+        {
+            const time_t seconds = static_cast<time_t>(received);
+            struct tm utc;
+            gmtime_r(&seconds, &utc);
+            strftime(_dateText, sizeof(_dateText), "%Y-%m-%d %H:%M:%S", &utc);
+            _dateSecond = received;
+        }
+        out = received != 0 ? appendText(out, _dateText, 19) : appendLiteral(out, "\\N");
+        *out++ = '\t';
+        out = appendText(out, uplink->deviceId, 32);
+        out = appendLiteral(out, "\t\\N\t"); // appEUI
+        out = appendText(out, uplink->devEui, 16);
+        *out++ = '\t';
+        out = appendNumber(out, uplink->fcnt);
+        *out++ = '\t';
+        out = appendNumber(out, uplink->port);
+        *out++ = '\t';
+        out = appendText(out, uplink->devAddr, 8);
+        *out++ = '\t';
+        if (uplink->frequency != 0)
+        {
+            // MHz, as stored by the Node-RED flow
+            out = appendNumber(out, uplink->frequency / 1000000);
+            const uint32_t fraction = uplink->frequency % 1000000;
+            if (fraction != 0)
+            {
+                char digits[8];
+                snprintf(digits, sizeof(digits), ".%06lu", static_cast<unsigned long>(fraction));
+                size_t length = 7;
+                while (digits[length - 1] == '0')
+                {
+                    length--;
+                }
+                memcpy(out, digits, length);
+                out += length;
+            }
+        }
+        else
+        {
+            out = appendLiteral(out, "\\N");
+        }
+        *out++ = '\t';
+        out = uplink->sf != 0 ? appendNumber(out, uplink->sf) : appendLiteral(out, "\\N");
+    }
+    else
+    {
+        out = appendLiteral(out, "\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N");
+    }
+
+    *out++ = '\t';
+    out = appendNumber(out, batch.battery[row]);
+    *out++ = '\t';
+    *out++ = static_cast<char>('0' + batch.catchDetect[row]);
+    *out++ = '\t';
+    *out++ = static_cast<char>('0' + batch.doorStatus[row]);
+    *out++ = '\t';
+    *out++ = static_cast<char>('0' + batch.trapDisplacement[row]);
+    *out++ = '\t';
+    out = appendNumber(out, batch.id[row]);
+    *out++ = '\t';
+    out = appendNumber(out, batch.unixTime[row]);
+    *out++ = '\t';
+    out = appendNumber(out, batch.version[row]);
+    *out++ = '\n';
+
+    const size_t length = static_cast<size_t>(out - start);
+    _used += length;
+    const uint32_t time = batch.unixTime[row];
+    _current.firstTime = _current.rows == 0 || time < _current.firstTime ? time : _current.firstTime;
+    _current.lastTime = _current.rows == 0 || time > _current.lastTime ? time : _current.lastTime;
+    _current.rows++;
+    _current.bytes += length;
+    _rows++;
+}
+
+bool bulkLoadWriter::write(const payloadBatch &batch, const std::vector<ttnUplink> &uplinks)
+{
+    /** Rows skip rejected frames; walk the frame numbers alongside to find each row's message. */
+    size_t error = 0;
+    size_t frame = 0;
+    for (size_t row = 0; row < batch.size() && !_failed; row++, frame++)
+    {
+        while (error < batch.errors.size() && batch.errors[error].index == frame)
+        {
+            error++;
+            frame++;
+        }
+        if (_file == nullptr && !startFile())
+        {
+            break;
+        }
+        appendRow(batch, row, frame < uplinks.size() ? &uplinks[frame] : nullptr);
+        if (_current.rows >= _config.maxRows || _current.bytes + MAX_ROW_SIZE > _config.maxBytes)
+        {
+            finishFile();
+        }
+        else if (_used >= BUFFER_SIZE)
+        {
+            drain();
+        }
+    }
+    return !_failed;
+}
+
+bool bulkLoadWriter::close()
+{
+    if (_file != nullptr)
+    {
+        finishFile();
+    }
+    return !_failed;
+}
+
+size_t bulkLoadWriter::takeCompleted(std::vector<bulkLoadFile> &out)
+{
+    const size_t count = _completed.size();
+    out.insert(out.end(), _completed.begin(), _completed.end());
+    _completed.clear();
+    return count;
+}
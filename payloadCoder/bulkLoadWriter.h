@@ -0,0 +1,127 @@
+/**
+ * @file bulkLoadWriter.h
+ * @brief Rotating TSV files of decoded uplinks for MariaDB `LOAD DATA INFILE`.
+ *
+ * The Node-RED flow inserts one row per uplink into the muskrattrap table (see
+ * serverSide/databaseSetup.sql). Loading the same rows from a file with `LOAD DATA INFILE` costs a
+ * small fraction of that: one statement, one transaction and no SQL parsing per row. This writer
+ * formats decoded rows as tab-separated lines in the column order of that table and the Node-RED
+ * INSERT statement (BULK_LOAD_COLUMNS), using MariaDB's default escaping: `\N` for NULL and a
+ * backslash before tab, newline and backslash in text.
+ *
+ * Rows go to `<directory>/<prefix>-<number>.tsv.part`. When a file reaches `maxRows` rows or
+ * `maxBytes` bytes, or the writer is closed, the file is synced and renamed to `.tsv`, and a line
+ * `name, rows, bytes, first unixTime, last unixTime` (tab-separated) is appended to
+ * `<directory>/<prefix>.manifest`. A loader only ever sees complete files; files are numbered
+ * after the ones already in the directory, so a restarted writer never overwrites them.
+ *
+ * Receive metadata (device id, DevEUI, frame counter, radio settings and the receive time for
+ * `dateTime`, in UTC) comes from TTN messages. Rows of plain frames have NULL in those columns.
+ * appEUI is not parsed from TTN messages and is always NULL.
+ *
+ * Usage: create one bulkLoadWriter, call write() for every decoded block, and load the files
+ * returned by takeCompleted() with bulkLoadStatement().
+ */
+
+#ifndef BULKLOADWRITER_H
+#define BULKLOADWRITER_H
+
+#include <stdint.h> // uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+#include <string>
+#include <vector>
+
+#include "payloadBatch.h"
+#include "ttnUplink.h"
+
+/// \brief columns of the muskrattrap table written by bulkLoadWriter, in file order
+const char BULK_LOAD_COLUMNS[] = "messageSource, dateTime, devID, appEUI, devEUI, fcnt, port, devAddr, frequency, sf, "
+                                 "batteryStatus, catchDetect, doorStatus, trapDisplacement, id, unixTime, version";
+
+/// \brief settings of the bulk load writer
+struct bulkLoadConfig
+{
+    std::string directory = ".";         ///< Directory of the files and the manifest (must exist)
+    std::string prefix = "muskrattrap";  ///< File name prefix
+    std::string messageSource = "TTNV3"; ///< Value of the messageSource column
+    size_t maxRows = 500000;             ///< Rows per file
+    size_t maxBytes = 64 << 20;          ///< Bytes per file
+};
+
+/// \brief one completed file, as listed in the manifest
+struct bulkLoadFile
+{
+    std::string path = {};  ///< Path of the .tsv file
+    uint64_t rows = 0;      ///< Number of rows
+    uint64_t bytes = 0;     ///< Size in bytes
+    uint32_t firstTime = 0; ///< Lowest payload unixTime in the file
+    uint32_t lastTime = 0;  ///< Highest payload unixTime in the file
+};
+
+/// \brief LOAD DATA statement for one file
+/// \param path path of the file as seen by the client (LOCAL INFILE)
+/// \param table table name
+/// \return statement ending with ";\n"
+std::string bulkLoadStatement(const std::string &path, const char *table = "muskrattrap");
+
+/// \brief writes decoded rows into rotating TSV files and a manifest
+class bulkLoadWriter
+{
+private:
+    bulkLoadConfig _config;                ///< Settings
+    FILE *_file;                           ///< Current .part file, nullptr between files
+    unsigned _number;                      ///< Number of the current or next file
+    std::vector<char> _buffer;             ///< Rows not yet written to the file
+    size_t _used;                          ///< Bytes of _buffer in use
+    bulkLoadFile _current;                 ///< Statistics of the current file
+    std::vector<bulkLoadFile> _completed;  ///< Files completed since the last takeCompleted()
+    uint64_t _rows;                        ///< Rows written in total
+    bool _failed;                          ///< A file operation failed
+    uint32_t _dateSecond;                  ///< Receive time of the cached dateTime text
+    char _dateText[20];                    ///< "YYYY-MM-DD HH:MM:SS" of _dateSecond
+
+    /// \brief path of file number `number`, with or without the .part suffix
+    std::string pathOf(unsigned number, bool part) const;
+
+    /// \brief open the next free file number
+    bool startFile();
+
+    /// \brief write, sync and rename the current file and add it to the manifest
+    bool finishFile();
+
+    /// \brief write the buffered rows to the current file
+    void drain();
+
+    /// \brief append one row to the buffer
+    void appendRow(const payloadBatch &batch, size_t row, const ttnUplink *uplink);
+
+public:
+    /// \brief constructor; no file is created until the first row
+    /// \param config settings
+    explicit bulkLoadWriter(const bulkLoadConfig &config = bulkLoadConfig());
+    ~bulkLoadWriter();                                        ///< Destructor, completes the current file
+    bulkLoadWriter(const bulkLoadWriter &) = delete;            ///< Copy constructor disabled
+    bulkLoadWriter &operator=(const bulkLoadWriter &) = delete; ///< Assignment operator disabled
+
+    /// \brief append all rows of a batch
+    /// \param batch rows decoded from one block of frames
+    /// \param uplinks TTN messages of the block, one per frame including rejected ones (as
+    ///        returned by frameReader::get_uplinks()), or empty for plain frames
+    /// \return false if a file operation failed (now or earlier)
+    bool write(const payloadBatch &batch, const std::vector<ttnUplink> &uplinks);
+
+    /// \brief complete the current file
+    /// \return false if a file operation failed (now or earlier)
+    bool close();
+
+    /// \brief move the files completed since the last call to `out`
+    /// \param out receives the files, oldest first
+    /// \return number of files moved
+    size_t takeCompleted(std::vector<bulkLoadFile> &out);
+
+    /// \brief number of rows written
+    uint64_t get_rows() const { return _rows; }
+};
+
+#endif // BULKLOADWRITER_H
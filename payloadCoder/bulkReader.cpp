@@ -0,0 +1,473 @@
+#include "bulkReader.h"
+#include "encoder.h"
+
+#include <algorithm> // std::min, std::max
+#include <errno.h>   // errno
+#include <stdlib.h>  // posix_memalign, free
+#include <string.h>  // memset
+
+#include <fcntl.h>    // open, posix_fadvise
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // pread, read, close, lseek
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h> // io_uring_params, io_uring_sqe, io_uring_cqe
+#include <sys/mman.h>       // mmap, munmap
+#include <sys/syscall.h>    // __NR_io_uring_setup, __NR_io_uring_enter, __NR_io_uring_register
+#include <sys/uio.h>        // iovec
+#endif
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define BULK_READER_URING 1
+#else
+#define BULK_READER_URING 0
+#endif
+
+namespace
+{
+    const size_t PAGE_SIZE = 4096; ///< Alignment of buffers, offsets and O_DIRECT lengths
+
+    /// @brief Round `n` up to a multiple of PAGE_SIZE.
+    inline size_t pageRound(size_t n)
+    {
+        return (n + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+}
+
+/// @brief Mapped submission and completion rings of one io_uring instance.
+struct bulkReader::ring
+{
+    int fd = -1;                ///< Ring file descriptor
+    void *sqMap = nullptr;      ///< Mapped submission ring
+    size_t sqMapSize = 0;       ///< Size of sqMap
+    void *cqMap = nullptr;      ///< Mapped completion ring (may equal sqMap)
+    size_t cqMapSize = 0;       ///< Size of cqMap
+    void *sqes = nullptr;       ///< Mapped submission queue entries
+    size_t sqesSize = 0;        ///< Size of sqes
+    uint32_t *sqTail = nullptr; ///< Submission ring tail (written here)
+    uint32_t *sqMask = nullptr; ///< Submission ring index mask
+    uint32_t *sqArray = nullptr; ///< Submission ring index array
+    uint32_t *cqHead = nullptr; ///< Completion ring head (written here)
+    uint32_t *cqTail = nullptr; ///< Completion ring tail (written by the kernel)
+    uint32_t *cqMask = nullptr; ///< Completion ring index mask
+    void *cqes = nullptr;       ///< Completion queue entries
+    uint32_t pending = 0;       ///< Entries queued but not yet passed to io_uring_enter
+    bool fixed = false;         ///< Buffers registered: use READ_FIXED
+};
+
+#if BULK_READER_URING
+
+namespace
+{
+    /// @brief Set up a ring with `entries` entries and map it; false if io_uring is not available.
+    bool setupRing(bulkReader::ring &r, unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        const long fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+        {
+            return false;
+        }
+        r.fd = static_cast<int>(fd);
+        r.sqMapSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        r.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+        {
+            r.sqMapSize = r.cqMapSize = std::max(r.sqMapSize, r.cqMapSize);
+        }
+        r.sqMap = mmap(nullptr, r.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQ_RING);
+        if (r.sqMap == MAP_FAILED)
+        {
+            r.sqMap = nullptr;
+            return false;
+        }
+        r.cqMap = single ? r.sqMap
+                         : mmap(nullptr, r.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_CQ_RING);
+        if (r.cqMap == MAP_FAILED)
+        {
+            r.cqMap = nullptr;
+            return false;
+        }
+        r.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        r.sqes = mmap(nullptr, r.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQES);
+        if (r.sqes == MAP_FAILED)
+        {
+            r.sqes = nullptr;
+            return false;
+        }
+        uint8_t *const sq = static_cast<uint8_t *>(r.sqMap);
+        uint8_t *const cq = static_cast<uint8_t *>(r.cqMap);
+        r.sqTail = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+        r.sqMask = reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+        r.sqArray = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+        r.cqHead = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+        r.cqTail = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+        r.cqMask = reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+        r.cqes = cq + params.cq_off.cqes;
+        return true;
+    }
+
+    /// @brief Unmap and close a ring.
+    void teardownRing(bulkReader::ring &r)
+    {
+        if (r.sqes != nullptr)
+        {
+            munmap(r.sqes, r.sqesSize);
+        }
+        if (r.cqMap != nullptr && r.cqMap != r.sqMap)
+        {
+            munmap(r.cqMap, r.cqMapSize);
+        }
+        if (r.sqMap != nullptr)
+        {
+            munmap(r.sqMap, r.sqMapSize);
+        }
+        if (r.fd >= 0)
+        {
+            ::close(r.fd);
+        }
+        r = bulkReader::ring();
+    }
+
+    /// @brief Submit the queued entries and optionally wait for one completion.
+    /// @return false on an error other than EINTR
+    bool enterRing(bulkReader::ring &r, bool wait)
+    {
+        for (;;)
+        {
+            const long done = syscall(__NR_io_uring_enter, r.fd, r.pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (done >= 0)
+            {
+                r.pending -= std::min(r.pending, static_cast<uint32_t>(done));
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                return false;
+            }
+        }
+    }
+}
+
+#endif // BULK_READER_URING
+
+bulkReader::bulkReader(const bulkReadConfig &config)
+    : _config(config),
+      _fd(-1),
+      _ownsFd(false),
+      _seekable(false),
+      _start(0),
+      _size(0),
+      _pool(nullptr),
+      _slots(),
+      _ring(),
+      _submitted(0),
+      _delivered(0),
+      _bytes(0),
+      _eof(false),
+      _failed(false)
+{
+    /** Whole frames in every buffer, and page-aligned reads for O_DIRECT. */
+    const size_t unit = SENSOR_PAYLOAD_SIZE * PAGE_SIZE;
+    _config.bufferSize = std::max(unit, _config.bufferSize / unit * unit);
+    _config.buffers = std::max(1u, _config.buffers);
+}
+
+bulkReader::~bulkReader()
+{
+    close();
+    free(_pool);
+}
+
+void bulkReader::close()
+{
+#if BULK_READER_URING
+    if (_ring)
+    {
+        /** Reads still in flight write into the pool: wait for them before it can be freed. */
+        for (size_t i = 0; i < _slots.size(); i++)
+        {
+            await(i);
+        }
+        teardownRing(*_ring);
+    }
+#endif
+    _ring.reset();
+    if (_fd >= 0 && _ownsFd)
+    {
+        ::close(_fd);
+    }
+    _fd = -1;
+}
+
+bool bulkReader::open(const char *path)
+{
+    int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_DIRECT
+    if (_config.direct)
+    {
+        flags |= O_DIRECT;
+    }
+#endif
+    int fd = ::open(path, flags);
+    if (fd < 0 && flags != (O_RDONLY | O_CLOEXEC) && errno == EINVAL)
+    {
+        fd = ::open(path, O_RDONLY | O_CLOEXEC); // file system without O_DIRECT (tmpfs)
+    }
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (!open(fd))
+    {
+        const int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+    _ownsFd = true;
+    return true;
+}
+
+bool bulkReader::open(int fd)
+{
+    close();
+    _slots.assign(_config.buffers, slot());
+    _submitted = 0;
+    _delivered = 0;
+    _bytes = 0;
+    _eof = false;
+    _failed = false;
+    if (_pool == nullptr)
+    {
+        void *memory = nullptr;
+        if (posix_memalign(&memory, PAGE_SIZE, _config.buffers * _config.bufferSize) != 0)
+        {
+            errno = ENOMEM;
+            return false;
+        }
+        _pool = static_cast<uint8_t *>(memory);
+    }
+
+    struct stat status;
+    _fd = fd;
+    _ownsFd = false;
+    _seekable = fstat(fd, &status) == 0 && S_ISREG(status.st_mode);
+    if (!_seekable)
+    {
+        return true; // pipes and terminals: plain read() per buffer
+    }
+    _size = static_cast<uint64_t>(status.st_size);
+    const off_t position = lseek(fd, 0, SEEK_CUR);
+    _start = position > 0 ? static_cast<uint64_t>(position) : 0; // stdin redirected from a partly read file
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+#if BULK_READER_URING
+    if (_config.uring)
+    {
+        _ring.reset(new ring());
+        if (!setupRing(*_ring, _config.buffers))
+        {
+            teardownRing(*_ring);
+            _ring.reset(); // not available here: pread fallback
+        }
+        else
+        {
+            /** Registered buffers save mapping the pages for every read; needs enough locked memory. */
+            std::vector<iovec> vectors(_config.buffers);
+            for (size_t i = 0; i < vectors.size(); i++)
+            {
+                vectors[i].iov_base = _pool + i * _config.bufferSize;
+                vectors[i].iov_len = _config.bufferSize;
+            }
+            _ring->fixed = syscall(__NR_io_uring_register, _ring->fd, IORING_REGISTER_BUFFERS, vectors.data(), _config.buffers) == 0;
+        }
+    }
+#endif
+    submit();
+    return true;
+}
+
+void bulkReader::queue(size_t index)
+{
+#if BULK_READER_URING
+    ring &r = *_ring;
+    slot &s = _slots[index];
+    size_t length = s.length - s.filled;
+    if (_config.direct)
+    {
+        length = std::min(pageRound(length), _config.bufferSize - s.filled); // O_DIRECT: whole pages, short at the end of the file
+    }
+    const uint32_t tail = *r.sqTail;
+    const uint32_t position = tail & *r.sqMask;
+    io_uring_sqe &sqe = static_cast<io_uring_sqe *>(r.sqes)[position];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = r.fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe.fd = _fd;
+    sqe.addr = reinterpret_cast<uint64_t>(_pool + index * _config.bufferSize + s.filled);
+    sqe.len = static_cast<uint32_t>(length);
+    sqe.off = s.offset + s.filled;
+    sqe.buf_index = static_cast<uint16_t>(index);
+    sqe.user_data = index;
+    r.sqArray[position] = position;
+    __atomic_store_n(r.sqTail, tail + 1, __ATOMIC_RELEASE);
+    r.pending++;
+    s.busy = true;
+#else
+    (void)index;
+#endif
+}
+
+void bulkReader::submit()
+{
+    /** Every buffer that is neither handed out nor reading yet starts the read of the next part of the file. */
+    while (!_eof && _submitted - _delivered < _slots.size())
+    {
+        const uint64_t offset = _start + _submitted * _config.bufferSize;
+        if (offset >= _size)
+        {
+            _eof = true;
+            break;
+        }
+        slot &s = _slots[static_cast<size_t>(_submitted % _slots.size())];
+        s.offset = offset;
+        s.length = static_cast<size_t>(std::min<uint64_t>(_config.bufferSize, _size - offset));
+        s.filled = 0;
+        if (_ring)
+        {
+            queue(static_cast<size_t>(_submitted % _slots.size()));
+        }
+        _submitted++;
+    }
+#if BULK_READER_URING
+    if (_ring && _ring->pending > 0 && !enterRing(*_ring, false))
+    {
+        _failed = true;
+    }
+#endif
+}
+
+void bulkReader::await(size_t index)
+{
+#if BULK_READER_URING
+    ring &r = *_ring;
+    while (_slots[index].busy)
+    {
+        /** Take all completions there are; a short read queues the rest of its buffer again. */
+        uint32_t head = *r.cqHead;
+        const uint32_t tail = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe &cqe = static_cast<const io_uring_cqe *>(r.cqes)[head & *r.cqMask];
+            slot &s = _slots[static_cast<size_t>(cqe.user_data)];
+            s.busy = false;
+            if (cqe.res > 0)
+            {
+                s.filled = std::min(s.length, s.filled + static_cast<size_t>(cqe.res));
+                if (s.filled < s.length)
+                {
+                    queue(static_cast<size_t>(cqe.user_data));
+                }
+            }
+            else if (cqe.res == -EAGAIN || cqe.res == -EINTR)
+            {
+                queue(static_cast<size_t>(cqe.user_data));
+            }
+            else if (cqe.res == 0)
+            {
+                s.length = s.filled; // the file became shorter
+            }
+            else
+            {
+                _failed = true;
+            }
+        }
+        __atomic_store_n(r.cqHead, head, __ATOMIC_RELEASE);
+        if (_slots[index].busy && !enterRing(r, true))
+        {
+            _failed = true;
+            return;
+        }
+    }
+#else
+    (void)index;
+#endif
+}
+
+void bulkReader::readNow(size_t index)
+{
+    slot &s = _slots[index];
+    uint8_t *const buffer = _pool + index * _config.bufferSize;
+    while (s.filled < s.length)
+    {
+        size_t length = s.length - s.filled;
+        if (_config.direct)
+        {
+            length = std::min(pageRound(length), _config.bufferSize - s.filled);
+        }
+        const ssize_t n = _seekable ? pread(_fd, buffer + s.filled, length, static_cast<off_t>(s.offset + s.filled))
+                                    : read(_fd, buffer + s.filled, length);
+        if (n > 0)
+        {
+            s.filled = std::min(s.length, s.filled + static_cast<size_t>(n));
+        }
+        else if (n == 0)
+        {
+            s.length = s.filled; // end of the file (or of the pipe)
+        }
+        else if (errno != EINTR && errno != EAGAIN)
+        {
+            _failed = true;
+            return;
+        }
+    }
+}
+
+bool bulkReader::next(const uint8_t *&data, size_t &length)
+{
+    length = 0;
+    if (_fd < 0 || _failed)
+    {
+        return false;
+    }
+    const size_t index = static_cast<size_t>(_delivered % _slots.size());
+    slot &s = _slots[index];
+    if (!_seekable)
+    {
+        /** Pipes: one blocking read per buffer, no read-ahead. */
+        s.offset = _bytes;
+        s.length = _config.bufferSize;
+        s.filled = 0;
+        readNow(index);
+    }
+    else
+    {
+        /** The buffer handed out last time is free again: put it to work before waiting. */
+        submit();
+        if (_delivered == _submitted)
+        {
+            return false;
+        }
+        if (_ring)
+        {
+            await(index);
+        }
+        else
+        {
+            readNow(index);
+        }
+    }
+    if (_failed || s.filled == 0)
+    {
+        return false;
+    }
+    data = _pool + index * _config.bufferSize;
+    length = s.filled;
+    _delivered++;
+    _bytes += length;
+    return true;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file bulkReader.h
+ * @brief Sequential file reader with several large reads in flight (io_uring, or pread as fallback).
+ *
+ * Reprocessing an archive or export reads gigabytes once, front to back. A buffered reader
+ * issues one read at a time and copies every byte once more out of its buffer. bulkReader
+ * instead owns a fixed pool of large, page-aligned buffers and keeps a read in flight for every
+ * buffer that is not being decoded: while the caller works on one buffer, the device fills the
+ * next ones. next() hands out the filled buffers themselves, in file order, and takes the
+ * previous one back into the pool.
+ *
+ * On Linux the reads go through io_uring, set up with the raw system calls (no liburing). The
+ * pool is registered with the ring when the memlock limit allows it, so the kernel does not map
+ * the pages again for every read. Where io_uring is missing or not permitted (old kernels,
+ * containers with a seccomp filter), or for pipes and other files that cannot be read at an
+ * offset, the reader falls back to one pread() (or read()) per buffer, with the kernel's
+ * sequential read-ahead.
+ *
+ * Buffer sizes are rounded to a multiple of SENSOR_PAYLOAD_SIZE * 4096 bytes, so every buffer
+ * of a raw archive holds whole frames and every read is page aligned, which `direct` (O_DIRECT,
+ * bypassing the page cache) requires. All buffers except the last are full.
+ *
+ * Usage: open() a file, call next() until it returns false, then check failed().
+ */
+
+#ifndef BULKREADER_H
+#define BULKREADER_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <memory>
+#include <vector>
+
+/// \brief settings of the bulk reader
+struct bulkReadConfig
+{
+    size_t bufferSize = 1 << 20; ///< Bytes per buffer (rounded down to whole frames and pages); about the cache the decoder works in
+    unsigned buffers = 16;       ///< Buffers in the pool; all but the one handed out are read ahead
+    bool uring = true;           ///< Use io_uring if available
+    bool direct = false;         ///< Open with O_DIRECT if the file system supports it
+};
+
+/// \brief reads a file front to back into a pool of buffers
+class bulkReader
+{
+public:
+    struct ring; ///< io_uring state (defined in bulkReader.cpp)
+
+private:
+    /// \brief one buffer of the pool
+    struct slot
+    {
+        uint64_t offset = 0; ///< File offset of the buffer
+        size_t length = 0;   ///< Bytes requested
+        size_t filled = 0;   ///< Bytes read so far
+        bool busy = false;   ///< Read submitted and not yet complete
+    };
+
+    bulkReadConfig _config;        ///< Settings
+    int _fd;                       ///< Input file, -1 if none
+    bool _ownsFd;                  ///< True if open() opened the file
+    bool _seekable;                ///< Regular file: reads at offsets, size known
+    uint64_t _start;               ///< File offset of the first buffer (seekable files)
+    uint64_t _size;                ///< File size at open() (seekable files)
+    uint8_t *_pool;                ///< Buffers, page aligned, _config.buffers * _config.bufferSize bytes
+    std::vector<slot> _slots;      ///< State of each buffer
+    std::unique_ptr<ring> _ring;   ///< io_uring, nullptr for the pread fallback
+    uint64_t _submitted;           ///< Buffers submitted (sequence number of the next one)
+    uint64_t _delivered;           ///< Buffers handed out by next()
+    uint64_t _bytes;               ///< Bytes handed out
+    bool _eof;                     ///< No more reads to submit
+    bool _failed;                  ///< A read failed
+
+    /// \brief start reads into all free buffers that are due
+    void submit();
+
+    /// \brief queue the (rest of the) read of one buffer on the ring
+    void queue(size_t index);
+
+    /// \brief wait for io_uring completions until buffer `index` is complete
+    void await(size_t index);
+
+    /// \brief read buffer `index` synchronously (fallback)
+    void readNow(size_t index);
+
+    /// \brief release the file and the ring
+    void close();
+
+public:
+    /// \brief constructor
+    /// \param config settings
+    explicit bulkReader(const bulkReadConfig &config = bulkReadConfig());
+    ~bulkReader();                                      ///< Destructor, closes the file if it was opened here
+    bulkReader(const bulkReader &) = delete;            ///< Copy constructor disabled
+    bulkReader &operator=(const bulkReader &) = delete; ///< Assignment operator disabled
+
+    /// \brief open a file and start reading ahead
+    /// \param path file name
+    /// \return false if the file cannot be opened (the reason is in errno)
+    bool open(const char *path);
+
+    /// \brief read an open file descriptor from its current position; the reader does not close it
+    /// \param fd file descriptor, for example 0 for stdin
+    /// \return false if the buffers cannot be allocated
+    bool open(int fd);
+
+    /// \brief take the next buffer; the previous one goes back to the pool
+    /// \param data receives a pointer to the bytes, valid until the next call
+    /// \param length receives the number of bytes
+    /// \return false at the end of the file or after a read error
+    bool next(const uint8_t *&data, size_t &length);
+
+    /// \brief true if a read failed
+    bool failed() const { return _failed; }
+
+    /// \brief true if the reads go through io_uring
+    bool usesUring() const { return _ring != nullptr; }
+
+    /// \brief size of each buffer after rounding
+    size_t get_bufferSize() const { return _config.bufferSize; }
+
+    /// \brief bytes handed out so far
+    uint64_t get_bytes() const { return _bytes; }
+};
+
+#endif // BULKREADER_H
@@ -0,0 +1,266 @@
+#include "decodeKernels.h"
+#include "encoder.h" // SENSOR_PAYLOAD_SIZE, PAYLOAD_VERSION
+#include "payloadRegistry.h"
+
+#include <string.h> // memcpy
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DECODE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // The vector kernels hard-wire the version 1 byte positions into their shuffle masks.
+    static_assert(payloadLayoutV1::offsetOf(payloadFieldId::id) == 0 &&
+                      payloadLayoutV1::offsetOf(payloadFieldId::version) == 32 &&
+                      payloadLayoutV1::offsetOf(payloadFieldId::doorStatus) == 45 &&
+                      payloadLayoutV1::offsetOf(payloadFieldId::catchDetect) == 46 &&
+                      payloadLayoutV1::offsetOf(payloadFieldId::trapDisplacement) == 47 &&
+                      payloadLayoutV1::offsetOf(payloadFieldId::batteryStatus) == 48 &&
+                      payloadLayoutV1::offsetOf(payloadFieldId::unixTime) == 56 &&
+                      SENSOR_PAYLOAD_SIZE == 11,
+                  "decode kernel shuffle masks do not match payloadLayoutV1");
+
+    /// @brief Portable kernel: decode frames one by one, each with the decoder of its version, until an unknown version is found.
+    size_t decodeScalar(const uint8_t *frames, size_t count, const batchColumns &col)
+    {
+        size_t i = 0;
+        for (; i < count; i++)
+        {
+            if (!decodeFrameScalar(frames + i * SENSOR_PAYLOAD_SIZE, col.advance(i)))
+            {
+                break;
+            }
+        }
+        return i;
+    }
+
+#ifdef DECODE_KERNELS_X86
+    /**
+     * Both vector kernels load 16 bytes at the start of every frame and shuffle them into
+     * [id (LE), unixTime (LE), version | flags << 8 | battery << 16, 0]. Transposing four such
+     * registers as 32-bit lanes yields one register of ids, one of unix times and one of
+     * version/flags/battery words, which are stored straight into the columns.
+     *
+     * A 16-byte load at frame k reads 5 bytes past the frame, so a step over frames i..i+n-1
+     * is only taken while at least one more frame follows frame i+n-1.
+     */
+
+    /// @brief Pack three 0/1 boolean lanes from up to 8 packed flag bytes (one per byte lane).
+    inline void splitFlags(uint64_t flags, size_t lanes, const batchColumns &col)
+    {
+        const uint64_t ones = 0x0101010101010101ULL;
+        const uint64_t door = (flags >> 2) & ones;
+        const uint64_t catchBit = (flags >> 1) & ones;
+        const uint64_t displacement = flags & ones;
+        memcpy(col.doorStatus, &door, lanes);
+        memcpy(col.catchDetect, &catchBit, lanes);
+        memcpy(col.trapDisplacement, &displacement, lanes);
+    }
+
+    __attribute__((target("sse4.1"))) size_t decodeSse41(const uint8_t *frames, size_t count, const batchColumns &col)
+    {
+        const __m128i frameShuffle = _mm_setr_epi8(3, 2, 1, 0, 10, 9, 8, 7, 4, 5, 6, -1, -1, -1, -1, -1);
+        const __m128i metaShuffle = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, -1, -1, -1, -1);
+        const __m128i versionMask = _mm_set1_epi32(0xFF);
+        const __m128i version = _mm_set1_epi32(PAYLOAD_VERSION);
+
+        size_t i = 0;
+        for (; i + 5 <= count; i += 4)
+        {
+            const uint8_t *f = frames + i * SENSOR_PAYLOAD_SIZE;
+            const __m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(f)), frameShuffle);
+            const __m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(f + SENSOR_PAYLOAD_SIZE)), frameShuffle);
+            const __m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(f + 2 * SENSOR_PAYLOAD_SIZE)), frameShuffle);
+            const __m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(f + 3 * SENSOR_PAYLOAD_SIZE)), frameShuffle);
+
+            const __m128i t0 = _mm_unpacklo_epi32(r0, r1); // id0 id1 time0 time1
+            const __m128i t1 = _mm_unpacklo_epi32(r2, r3); // id2 id3 time2 time3
+            const __m128i t2 = _mm_unpackhi_epi32(r0, r1); // meta0 meta1 0 0
+            const __m128i t3 = _mm_unpackhi_epi32(r2, r3); // meta2 meta3 0 0
+            const __m128i meta = _mm_unpacklo_epi64(t2, t3);
+
+            const __m128i known = _mm_cmpeq_epi32(_mm_and_si128(meta, versionMask), version);
+            if (_mm_movemask_epi8(known) != 0xFFFF)
+            {
+                break;
+            }
+
+            const batchColumns row = col.advance(i);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(row.id), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(row.unixTime), _mm_unpackhi_epi64(t0, t1));
+
+            const __m128i packed = _mm_shuffle_epi8(meta, metaShuffle); // versions, flags, batteries
+            const uint32_t versions = static_cast<uint32_t>(_mm_cvtsi128_si32(packed));
+            const uint32_t flags = static_cast<uint32_t>(_mm_extract_epi32(packed, 1)) & 0x07070707U;
+            const uint32_t batteries = static_cast<uint32_t>(_mm_extract_epi32(packed, 2));
+            memcpy(row.version, &versions, 4);
+            memcpy(row.flags, &flags, 4);
+            memcpy(row.battery, &batteries, 4);
+            splitFlags(flags, 4, row);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) size_t decodeAvx2(const uint8_t *frames, size_t count, const batchColumns &col)
+    {
+        const __m256i frameShuffle = _mm256_setr_epi8(3, 2, 1, 0, 10, 9, 8, 7, 4, 5, 6, -1, -1, -1, -1, -1,
+                                                      3, 2, 1, 0, 10, 9, 8, 7, 4, 5, 6, -1, -1, -1, -1, -1);
+        const __m256i metaShuffle = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, -1, -1, -1, -1,
+                                                     0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, -1, -1, -1, -1);
+        const __m256i laneOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        const __m256i versionMask = _mm256_set1_epi32(0xFF);
+        const __m256i version = _mm256_set1_epi32(PAYLOAD_VERSION);
+
+        size_t i = 0;
+        for (; i + 9 <= count; i += 8)
+        {
+            const uint8_t *f = frames + i * SENSOR_PAYLOAD_SIZE;
+            __m256i r[4];
+            for (int k = 0; k < 4; k++)
+            {
+                // low lane: frame i+k, high lane: frame i+k+4
+                const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(f + k * SENSOR_PAYLOAD_SIZE));
+                const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(f + (k + 4) * SENSOR_PAYLOAD_SIZE));
+                r[k] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), frameShuffle);
+            }
+
+            const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+            const __m256i t1 = _mm256_unpacklo_epi32(r[2], r[3]);
+            const __m256i t2 = _mm256_unpackhi_epi32(r[0], r[1]);
+            const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+            const __m256i meta = _mm256_unpacklo_epi64(t2, t3);
+
+            const __m256i known = _mm256_cmpeq_epi32(_mm256_and_si256(meta, versionMask), version);
+            if (_mm256_movemask_epi8(known) != -1)
+            {
+                break;
+            }
+
+            const batchColumns row = col.advance(i);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(row.id), _mm256_unpacklo_epi64(t0, t1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(row.unixTime), _mm256_unpackhi_epi64(t0, t1));
+
+            // versions 0-7, flags 0-7, batteries 0-7 as consecutive 64-bit words
+            const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(meta, metaShuffle), laneOrder);
+            const __m128i lo = _mm256_castsi256_si128(packed);
+            const __m128i hi = _mm256_extracti128_si256(packed, 1);
+            const uint64_t versions = static_cast<uint64_t>(_mm_cvtsi128_si64(lo));
+            const uint64_t flags = static_cast<uint64_t>(_mm_extract_epi64(lo, 1)) & 0x0707070707070707ULL;
+            const uint64_t batteries = static_cast<uint64_t>(_mm_cvtsi128_si64(hi));
+            memcpy(row.version, &versions, 8);
+            memcpy(row.flags, &flags, 8);
+            memcpy(row.battery, &batteries, 8);
+            splitFlags(flags, 8, row);
+        }
+        return i;
+    }
+
+    /// @brief Run a vector kernel and finish the remaining valid frames with the scalar kernel.
+    template <decodeKernelFn Vector>
+    size_t decodeVectorThenScalar(const uint8_t *frames, size_t count, const batchColumns &col)
+    {
+        const size_t done = Vector(frames, count, col);
+        return done + decodeScalar(frames + done * SENSOR_PAYLOAD_SIZE,
+                                   count - done < 16 ? count - done : 16, col.advance(done));
+    }
+#endif
+
+    /// @brief Kernel function, name and CPU support for one decodeKernel value.
+    struct kernelEntry
+    {
+        decodeKernelFn fn;
+        const char *name;
+    };
+
+    kernelEntry kernelFor(decodeKernel kernel)
+    {
+        switch (kernel)
+        {
+#ifdef DECODE_KERNELS_X86
+        case decodeKernel::avx2:
+            return kernelEntry{decodeVectorThenScalar<decodeAvx2>, "avx2"};
+        case decodeKernel::sse41:
+            return kernelEntry{decodeVectorThenScalar<decodeSse41>, "sse4.1"};
+#endif
+        default:
+            return kernelEntry{decodeScalar, "scalar"};
+        }
+    }
+
+    decodeKernel bestKernel()
+    {
+#ifdef DECODE_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return decodeKernel::avx2;
+        }
+        if (__builtin_cpu_supports("sse4.1"))
+        {
+            return decodeKernel::sse41;
+        }
+#endif
+        return decodeKernel::scalar;
+    }
+
+    kernelEntry activeKernel = kernelFor(bestKernel()); ///< Kernel used by decodeBatch(); set before decoding starts
+}
+
+bool decodeFrameScalar(const uint8_t *frame, const batchColumns &col)
+{
+    /**
+     * Decodes one frame with the decoder of its version. Layouts of another size than
+     * SENSOR_PAYLOAD_SIZE cannot appear in a back-to-back stream of fixed-size frames.
+     */
+    const payloadVersionDecoder &decoder = payloadDecoderFor(frame[PAYLOAD_VERSION_INDEX]);
+    if (decoder.size != SENSOR_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+    decoder.decodeRow(frame, col);
+    return true;
+}
+
+bool decodeKernelSupported(decodeKernel kernel)
+{
+#ifdef DECODE_KERNELS_X86
+    __builtin_cpu_init();
+    switch (kernel)
+    {
+    case decodeKernel::avx2:
+        return __builtin_cpu_supports("avx2");
+    case decodeKernel::sse41:
+        return __builtin_cpu_supports("sse4.1");
+    default:
+        return true;
+    }
+#else
+    return kernel == decodeKernel::automatic || kernel == decodeKernel::scalar;
+#endif
+}
+
+bool selectDecodeKernel(decodeKernel kernel)
+{
+    if (kernel == decodeKernel::automatic)
+    {
+        kernel = bestKernel();
+    }
+    if (!decodeKernelSupported(kernel))
+    {
+        return false;
+    }
+    activeKernel = kernelFor(kernel);
+    return true;
+}
+
+decodeKernelFn activeDecodeKernel()
+{
+    return activeKernel.fn;
+}
+
+const char *activeDecodeKernelName()
+{
+    return activeKernel.name;
+}
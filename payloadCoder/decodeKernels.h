@@ -0,0 +1,78 @@
+/**
+ * @file decodeKernels.h
+ * @brief Batch decode kernels (scalar, SSE4.1 and AVX2) used by payloadDecoder::decodeBatch().
+ *
+ * A kernel decodes back-to-back frames of SENSOR_PAYLOAD_SIZE bytes into batch columns and
+ * stops at the first frame with an unknown version, leaving error handling to the caller.
+ * The vector kernels handle runs of PAYLOAD_VERSION frames; frames of other known versions
+ * are decoded one at a time through the version table in payloadRegistry.h.
+ * The best kernel for the CPU is picked at runtime; the scalar kernel is always available.
+ */
+
+#ifndef DECODEKERNELS_H
+#define DECODEKERNELS_H
+
+#include <stdint.h> // uint8_t and uint32_t type
+#include <stddef.h> // size_t
+
+#include "payloadBatch.h"
+
+/// \brief batch decode kernel selection
+enum class decodeKernel : uint8_t
+{
+    automatic, ///< Best kernel supported by the CPU
+    scalar,    ///< Portable one-frame-at-a-time kernel
+    sse41,     ///< 4 frames per step using SSE4.1 byte shuffles
+    avx2       ///< 8 frames per step using AVX2 byte shuffles
+};
+
+/// \brief raw pointers into the columns of a payloadBatch, starting at a given row
+struct batchColumns
+{
+    uint32_t *id;              ///< id column
+    uint8_t *version;          ///< version column
+    uint8_t *flags;            ///< packed flag column
+    uint8_t *battery;          ///< battery column
+    uint32_t *unixTime;        ///< unix time column
+    uint8_t *doorStatus;       ///< door status column
+    uint8_t *catchDetect;      ///< catch detection column
+    uint8_t *trapDisplacement; ///< trap displacement column
+
+    /// \brief columns starting `rows` further
+    batchColumns advance(size_t rows) const
+    {
+        return batchColumns{id + rows, version + rows, flags + rows, battery + rows, unixTime + rows,
+                            doorStatus + rows, catchDetect + rows, trapDisplacement + rows};
+    }
+};
+
+/// \brief decode kernel signature
+/// \param frames pointer to the first frame
+/// \param count number of whole frames available at `frames`
+/// \param col columns receiving the rows
+/// \return number of frames decoded, all with a known version; stops early before a frame
+///         with an unknown version or when too few frames remain for a vector step
+typedef size_t (*decodeKernelFn)(const uint8_t *frames, size_t count, const batchColumns &col);
+
+/// \brief check whether a kernel can run on this CPU
+/// \param kernel kernel to check
+/// \return true if supported
+bool decodeKernelSupported(decodeKernel kernel);
+
+/// \brief select the kernel used by payloadDecoder::decodeBatch()
+/// \param kernel kernel to use; decodeKernel::automatic picks the best supported one
+/// \return false if the kernel is not supported on this CPU (selection is unchanged)
+bool selectDecodeKernel(decodeKernel kernel);
+
+/// \brief get the selected kernel function
+decodeKernelFn activeDecodeKernel();
+
+/// \brief get the name of the selected kernel
+/// \return "scalar", "sse4.1" or "avx2"
+const char *activeDecodeKernelName();
+
+/// \brief decode a single frame into row 0 of `col` with the decoder of its version (see payloadRegistry.h)
+/// \return true if the version has a layout of SENSOR_PAYLOAD_SIZE bytes; the row is only written then
+bool decodeFrameScalar(const uint8_t *frame, const batchColumns &col);
+
+#endif // DECODEKERNELS_H
@@ -1,14 +1,36 @@
 #include "decoder.h"
+#include "encoder.h" // SENSOR_PAYLOAD_SIZE, PAYLOAD_VERSION
+#include "decodeKernels.h"
+#include "payloadRegistry.h"
 #include <iostream> // cout, endl // debugging only
+#include <string.h> // memcpy
+
+namespace
+{
+    /// @brief Grow the batch by `count` rows and return pointers to the new rows.
+    batchColumns growBatch(payloadBatch &out, size_t count)
+    {
+        const size_t first = out.size();
+        out.resize(first + count);
+        return batchColumns{out.id.data() + first,
+                            out.version.data() + first,
+                            out.flags.data() + first,
+                            out.battery.data() + first,
+                            out.unixTime.data() + first,
+                            out.doorStatus.data() + first,
+                            out.catchDetect.data() + first,
+                            out.trapDisplacement.data() + first};
+    }
+
+    /// @brief Clamp a frame size for storage in rejectedFrame::size.
+    inline uint8_t saturateSize(size_t size)
+    {
+        return size > 0xFF ? 0xFF : static_cast<uint8_t>(size);
+    }
+}
 
 /// @brief Constructs a new payloadDecoder object.
-payloadDecoder::payloadDecoder() : _id{0},
-                                   _version{0},
-                                   _doorStatus{0},
-                                   _catchDetect{0},
-                                   _trapDisplacement{0},
-                                   _batteryStatus{0},
-                                   _unixTime{0},
+payloadDecoder::payloadDecoder() : _fields{},
                                    _buffer{nullptr},
                                    _bufferSize{0}
 {
@@ -21,98 +43,136 @@ payloadDecoder::~payloadDecoder()
     // Destructor
 }
 
-void payloadDecoder::decodePayload()
+void payloadDecoder::decodePayload(const uint8_t *buffer, uint8_t size)
 {
-    /**
-     * Decodes the payload data.
-     * This function prints the payload in binary format and extracts various data fields from the payload buffer.
-
-    std::cout << "Decoder payload binary: ";
-    for (int i = 0; i < _bufferSize; i++)
-    {
-        for (int j = 7; j >= 0; j--)
-        {
-            std::cout << ((_buffer[i] >> j) & 1);
-        }
-        std::cout << " ";
-    }
-    std::cout << std::endl;
-    */
-
-    _id = static_cast<int>(extract_uint32(_buffer, 0));
-    _version = static_cast<int>(extract_uint8(_buffer, 4));
-    _doorStatus = extract_bool(_buffer, 5, 2);
-    _catchDetect = extract_bool(_buffer, 5, 1);
-    _trapDisplacement = extract_bool(_buffer, 5, 0);
-    _batteryStatus = static_cast<int>(extract_uint8(_buffer, 6));
-    _unixTime = static_cast<int>(extract_uint32(_buffer, 7));
+    _buffer = buffer;
+    _bufferSize = size;
+    decodePayload();
 }
 
-uint8_t payloadDecoder::extract_uint8(const uint8_t *buf, const unsigned char idx)
+void payloadDecoder::decodePayload()
 {
     /**
-     * Extracts a uint8_t value from the given buffer at the specified index.
-     *
-     * @param buf The buffer containing the data.
-     * @param idx The index of the value to extract.
-     * @return The extracted uint8_t value.
+     * Decodes the payload data using the layout of its version byte (see payloadRegistry.h).
+     * Versions without a layout are decoded with the PAYLOAD_VERSION layout, so get_version()
+     * still reports them. Payloads shorter than their layout are ignored and leave the
+     * fields unchanged.
      */
-    return static_cast<uint8_t>(buf[idx]);
+    if (_buffer == nullptr || _bufferSize <= PAYLOAD_VERSION_INDEX)
+    {
+        return;
+    }
+    const payloadVersionDecoder *decoder = &payloadDecoderFor(_buffer[PAYLOAD_VERSION_INDEX]);
+    if (decoder->size == 0)
+    {
+        decoder = &payloadDecoderFor(PAYLOAD_VERSION);
+    }
+    if (_bufferSize < decoder->size)
+    {
+        return;
+    }
+    decoder->decodeFields(_buffer, _fields);
 }
 
-uint16_t payloadDecoder::extract_uint16(const uint8_t *buf, const unsigned char idx)
+size_t payloadDecoder::decodeBatch(const uint8_t *frames, size_t length, payloadBatch &out)
 {
     /**
-     * @brief Extracts a 16-bit unsigned integer from a buffer at the specified index.
-     *
-     * This function takes a buffer `buf` and an index `idx` and extracts a 16-bit unsigned integer
-     * from the buffer starting at the specified index. The most significant byte is located at `buf[idx]
-     * and the least significant byte is located at `buf[idx + 1].
-     *
-     * @param buf Pointer to the buffer containing the data.
-     * @param idx Index of the most significant byte in the buffer.
-     * @return The extracted 16-bit unsigned integer value.
+     * Decodes back-to-back frames in a single pass over memory.
+     * The active kernel (see decodeKernels.h) decodes runs of frames with a known version;
+     * it returns 0 only when the next frame has an unknown version, which is then skipped
+     * and reported before the kernel resumes.
      */
+    const size_t count = length / SENSOR_PAYLOAD_SIZE;
+    const size_t first = out.size();
+    const batchColumns col = growBatch(out, count);
+    const decodeKernelFn kernel = activeDecodeKernel();
+
+    size_t rows = 0;
+    size_t i = 0;
+    while (i < count)
+    {
+        const size_t done = kernel(frames + i * SENSOR_PAYLOAD_SIZE, count - i, col.advance(rows));
+        i += done;
+        rows += done;
+        if (done == 0)
+        {
+            out.errors.push_back(rejectedFrame{i, decodeError::unknownVersion, SENSOR_PAYLOAD_SIZE});
+            i++;
+        }
+    }
+
+    const size_t tail = length % SENSOR_PAYLOAD_SIZE;
+    if (tail != 0)
+    {
+        out.errors.push_back(rejectedFrame{count, decodeError::wrongSize, saturateSize(tail)});
+    }
 
-    uint16_t value{0};
-    value = static_cast<uint16_t>(buf[idx] << 8); // msb
-    value |= static_cast<uint16_t>(buf[idx + 1]); // lsb
-    return value;
+    out.resize(first + rows);
+    return rows;
 }
 
-uint32_t payloadDecoder::extract_uint32(const uint8_t *buf, const unsigned char idx)
+size_t payloadDecoder::decodeBatch(const uint8_t *const *frames, const size_t *sizes, size_t count, payloadBatch &out)
 {
     /**
-     * Extracts a 32-bit unsigned integer from a buffer at the specified index.
-     * This function takes a buffer `buf` and an index `idx` and extracts a 32-bit unsigned integer
-     * from the buffer starting at the specified index. The most significant byte is located at `buf[idx]
-     * and the least significant byte is located at `buf[idx + 3].
-     * @param buf The buffer containing the data.
-     * @param idx The index in the buffer where the 32-bit integer starts.
-     * @return The extracted 32-bit unsigned integer.
+     * Decodes separately stored frames, each with the decoder of its version, so frames of
+     * different layouts and sizes can be mixed. Frames of an unknown version or of another
+     * size than their layout are rejected.
      */
+    const size_t first = out.size();
+    const batchColumns col = growBatch(out, count);
 
-    uint32_t value{0};
-    for (uint8_t i = 0; i < 4; i++)
+    size_t rows = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        value |= static_cast<uint32_t>(buf[idx + i] << (24 - (i * 8))); // msb
+        if (sizes[i] <= PAYLOAD_VERSION_INDEX)
+        {
+            out.errors.push_back(rejectedFrame{i, decodeError::wrongSize, saturateSize(sizes[i])});
+            continue;
+        }
+        const payloadVersionDecoder &decoder = payloadDecoderFor(frames[i][PAYLOAD_VERSION_INDEX]);
+        if (decoder.size == 0)
+        {
+            out.errors.push_back(rejectedFrame{i, decodeError::unknownVersion, saturateSize(sizes[i])});
+            continue;
+        }
+        if (sizes[i] != decoder.size)
+        {
+            out.errors.push_back(rejectedFrame{i, decodeError::wrongSize, saturateSize(sizes[i])});
+            continue;
+        }
+        decoder.decodeRow(frames[i], col.advance(rows));
+        rows++;
     }
-    return value;
+
+    out.resize(first + rows);
+    return rows;
 }
 
-bool payloadDecoder::extract_bool(const uint8_t *buf, const unsigned char idx, unsigned int pos)
+bool payloadDecoder::widenFrame(const uint8_t *frame, size_t size, uint32_t receivedAt, uint8_t *out)
 {
     /**
-     * Extracts a boolean value from a buffer at a specified index and position.
-     *
-     * @param buf The buffer containing the data.
-     * @param idx The index of the byte in the buffer.
-     * @param pos The position of the bit within the byte.
-     * @return The extracted boolean value.
+     * Decodes the frame with the layout of its version and encodes it again in the full layout.
      */
-    bool value;
-    value = (buf[idx] >> pos) & 1;
-    return value;
+    if (size <= PAYLOAD_VERSION_INDEX)
+    {
+        return false;
+    }
+    const payloadVersionDecoder &decoder = payloadDecoderFor(frame[PAYLOAD_VERSION_INDEX]);
+    if (decoder.size == 0 || size != decoder.size)
+    {
+        return false;
+    }
+    if (decoder.timeBits >= 32 && decoder.size == SENSOR_PAYLOAD_SIZE)
+    {
+        memcpy(out, frame, SENSOR_PAYLOAD_SIZE);
+        return true;
+    }
+    payloadFields fields;
+    decoder.decodeFields(frame, fields);
+    fields.version = PAYLOAD_VERSION;
+    fields.unixTime = payloadExpandTime(fields.unixTime, decoder.timeBits, receivedAt);
+    payloadCodecV1::encode(fields, out);
+    return true;
 }
 
 // print payload decoded
@@ -122,11 +182,46 @@ void payloadDecoder::printPayloadDecoded()
      * Prints the decoded payload information.
      */
     std::cout << "Payload decoded: " << std::endl;
-    std::cout << "ID: " << _id << std::endl;
-    std::cout << "Version: " << static_cast<int>(_version) << std::endl;
-    std::cout << "Door status: " << _doorStatus << std::endl;
-    std::cout << "Catch detect: " << _catchDetect << std::endl;
-    std::cout << "Trap displacement: " << _trapDisplacement << std::endl;
-    std::cout << "Battery status: " << static_cast<int>(_batteryStatus) << std::endl;
-    std::cout << "Unix time: " << _unixTime << std::endl;
-}
\ No newline at end of file
+    std::cout << "ID: " << _fields.id << std::endl;
+    std::cout << "Version: " << static_cast<int>(_fields.version) << std::endl;
+    std::cout << "Door status: " << _fields.doorStatus << std::endl;
+    std::cout << "Catch detect: " << _fields.catchDetect << std::endl;
+    std::cout << "Trap displacement: " << _fields.trapDisplacement << std::endl;
+    std::cout << "Battery status: " << static_cast<int>(_fields.batteryStatus) << std::endl;
+    std::cout << "Unix time: " << _fields.unixTime << std::endl;
+}
+
+uint32_t payloadDecoder::get_id() const
+{
+    return _fields.id;
+}
+
+uint8_t payloadDecoder::get_version() const
+{
+    return _fields.version;
+}
+
+bool payloadDecoder::get_doorStatus() const
+{
+    return _fields.doorStatus;
+}
+
+bool payloadDecoder::get_catchDetect() const
+{
+    return _fields.catchDetect;
+}
+
+bool payloadDecoder::get_trapDisplacement() const
+{
+    return _fields.trapDisplacement;
+}
+
+uint8_t payloadDecoder::get_batteryStatus() const
+{
+    return _fields.batteryStatus;
+}
+
+uint32_t payloadDecoder::get_unixTime() const
+{
+    return _fields.unixTime;
+}
@@ -10,48 +10,22 @@
 #define DECODER_H
 
 #include <stdint.h> // uint8_t, uint16_t, and uint32_t type
+#include <stddef.h> // size_t
+
+#include "payloadBatch.h"
+#include "../nodeCode/payloadSchema.h"
 
 /// \brief payload decode class
 /// This class wil decode variables out of a payload for use in a LoRaWAN application.
+/// The byte layout is picked by the version byte from the layouts in payloadSchema.h.
 /// The class is setup using both .h and .cpp files where the setters and getters are
 /// placed in to the .h file.
 class payloadDecoder {
 private:
-    uint32_t _id;           ///< Identification number (4 bytes)
-    uint8_t _version;       ///< Payload version number (1 byte)
-    bool _doorStatus;       ///< Door status (1 bit)
-    bool _catchDetect;      ///< Catch detection (1 bit)
-    bool _trapDisplacement; ///< Trap displacement (1 bit)
-    uint8_t _batteryStatus; ///< Battery status (1 byte)
-    uint32_t _unixTime;     ///< Date and time (4 bytes)
-    uint8_t *_buffer;       ///< buffer containing payload with sensor data
+    payloadFields _fields;  ///< Decoded field values (layout in payloadSchema.h)
+    const uint8_t *_buffer; ///< buffer containing payload with sensor data
     uint8_t _bufferSize;    ///< Size of payload for housekeeping.
 
-    /// \brief extract uint8 from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \return uint8_t value
-    uint8_t extract_uint8(const uint8_t *buf, const unsigned char idx = 0);
-
-    /// \brief extract uint16 from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \return uint16_t value
-    uint16_t extract_uint16(const uint8_t *buf, const unsigned char idx = 0);
-
-    /// \brief extract uint32 from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \return uint32_t value
-    uint32_t extract_uint32(const uint8_t *buf, const unsigned char idx = 0);
-
-    /// \brief extract boolean from payload
-    /// \param buf pointer to buffer
-    /// \param idx index in buffer
-    /// \param pos position in byte
-    /// \return boolean value
-    bool extract_bool(const uint8_t *buf, const unsigned char idx = 0, unsigned int pos = 0);
-
 public:
     payloadDecoder();                                           ///< Constructor
     ~payloadDecoder();                                          ///< Destuctor
@@ -61,17 +35,57 @@ public:
     /// \brief set payload
     /// Copy the payload to the buffer
     /// \param payload pointer to buffer
-    void setPayload(uint8_t *payload) { _buffer = payload; }
+    void setPayload(const uint8_t *payload) { _buffer = payload; }
 
     /// \brief set payload size
     /// Set the size of the payload
     /// \param size size of payload
     void setPayloadSize(uint8_t size) { _bufferSize = size; }
 
+    /// \brief decode payload
+    /// Extract the variables from the payload set with setPayload()
+    void decodePayload();
+
     /// \brief decode payload
     /// Extract the variables from the payload
+    /// \param buffer pointer to buffer
+    /// \param size size of payload
     void decodePayload(const uint8_t* buffer, uint8_t size);
 
+    /// \brief decode a contiguous array of frames
+    /// Decode back-to-back frames of SENSOR_PAYLOAD_SIZE bytes into the columns of `out`, each
+    /// with the decoder of its version byte (see payloadRegistry.h).
+    /// Frames with an unknown version and a trailing partial frame are reported in `out.errors`.
+    /// Rows and errors are appended, so a batch can be filled by several calls.
+    /// \param frames pointer to the first frame
+    /// \param length total number of bytes in `frames`
+    /// \param out batch receiving the decoded rows
+    /// \return number of decoded rows
+    static size_t decodeBatch(const uint8_t *frames, size_t length, payloadBatch &out);
+
+    /// \brief decode a list of separately stored frames
+    /// Same as decodeBatch() for contiguous frames, but each frame has its own pointer and size,
+    /// so frames of every known version and size can be mixed. Frames whose size does not
+    /// match the layout of their version are reported as decodeError::wrongSize. Compact
+    /// (version 2) frames give only the low bits of unixTime; see widenFrame().
+    /// \param frames array of `count` frame pointers
+    /// \param sizes array of `count` frame sizes
+    /// \param count number of frames
+    /// \param out batch receiving the decoded rows
+    /// \return number of decoded rows
+    static size_t decodeBatch(const uint8_t *const *frames, const size_t *sizes, size_t count, payloadBatch &out);
+
+    /// \brief rewrite a frame of any known version as a full (PAYLOAD_VERSION) frame
+    /// Receivers keep every frame in the full layout, so archives and back-to-back streams hold
+    /// frames of one size. The compact layout carries only the low bits of unixTime; the full
+    /// time is the one nearest to `receivedAt` (see payloadExpandTime()). Full frames are copied.
+    /// \param frame frame as received
+    /// \param size size of `frame` in bytes
+    /// \param receivedAt unix time the frame was received
+    /// \param out buffer receiving SENSOR_PAYLOAD_SIZE bytes
+    /// \return false if the version has no layout or `size` does not match it
+    static bool widenFrame(const uint8_t *frame, size_t size, uint32_t receivedAt, uint8_t *out);
+
     /// \brief get ID
     /// Fetch the ID from the payload
     /// \return ID (uint32_t)
@@ -103,7 +117,7 @@ public:
     uint8_t get_batteryStatus() const;
 
     /// \brief get unix time
-    /// Fetch the unix time from thepayload
+    /// Fetch the unix time from thepayload (only the low bits for a compact frame, see widenFrame())
     /// \return unix time (uint32_t)
     uint32_t get_unixTime() const;
 
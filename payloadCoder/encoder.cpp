@@ -1,31 +1,20 @@
 #include "encoder.h"
 #include <iostream> // only used for debug output
-#include <stdlib.h> // malloc()
 
 /**
  * @brief Constructs a new payloadEncoder object.
  *
- * This constructor initializes the member variables of the payloadEncoder class,
- * including _id, _version, _doorStatus, _catchDetect, _trapDisplacement,
- * _batteryStatus, and _unixTime. It also allocates memory for the _buffer using
- * malloc() and sets _bufferSize to 0.
+ * This constructor initializes all payload fields to zero. The payload buffer is a
+ * fixed-size member, so constructing an encoder never touches the heap.
  */
-payloadEncoder::payloadEncoder() : _id{0},
-                                   _version{0},
-                                   _doorStatus{0},
-                                   _catchDetect{0},
-                                   _trapDisplacement{0},
-                                   _batteryStatus{0},
-                                   _unixTime{0},
-                                   _buffer{NULL},
+payloadEncoder::payloadEncoder() : _fields{},
+                                   _buffer{},
                                    _bufferSize{0}
 {
-    _buffer = reinterpret_cast<uint8_t *>(malloc(SENSOR_PAYLOAD_SIZE));
 }
 
 payloadEncoder::~payloadEncoder()
 {
-    free(_buffer);
 }
 
 void payloadEncoder::composePayload()
@@ -34,99 +23,38 @@ void payloadEncoder::composePayload()
      * @brief Composes the payload by adding various data elements to the buffer.
      *
      * This function initializes the buffer size and adds data elements such as ID, version, door status, catch detection,
-     * trap displacement, battery status, and UNIX time to the buffer. It also prints the payload size in bytes for debugging purposes.
+     * trap displacement, battery status, and UNIX time to the buffer.
      */
 
-    _bufferSize = 0; // init
-
-    _bufferSize = add_uint32(_bufferSize, _id);
-    _bufferSize = add_uint8(_bufferSize, _version);
-
-    _bufferSize = add_bool(_bufferSize, _doorStatus, 2);
-    _bufferSize = add_bool(_bufferSize, _catchDetect, 1);
-    _bufferSize = add_bool(_bufferSize, _trapDisplacement, 0);
-
-    _bufferSize = add_uint8(_bufferSize, _batteryStatus);
-    _bufferSize = add_uint32(_bufferSize, _unixTime);
-
-    ///  show payload size in bytes for debugging purposes
-    std::cout << "Payload size in bytes: " << static_cast<int>(_bufferSize) << std::endl;
-}
-
-unsigned char payloadEncoder::add_uint8(unsigned char idx_in, const uint8_t value)
-{
-    /**
-     * Adds a uint8_t value to the buffer at the specified index.
-     *
-     * @param idx_in The index in the buffer where the value should be added.
-     * @param value The uint8_t value to be added to the buffer.
-     * @return The updated index after adding the value.
-     */
-    _buffer[idx_in++] = value;
-    return (idx_in);
+    _bufferSize = encodeInto(_buffer, SENSOR_PAYLOAD_SIZE);
 }
 
-unsigned char payloadEncoder::add_uint16(unsigned char idx_in, const uint16_t value)
+uint8_t payloadEncoder::encodeInto(uint8_t *out, uint8_t capacity) const
 {
     /**
-     * Adds a 16-bit unsigned integer to the buffer at the specified index.
+     * @brief Encodes all fields into `out` using the layout of the version set with set_version().
      *
-     * @param idx_in The index in the buffer where the value should be added.
-     * @param value The 16-bit unsigned integer value to be added.
-     * @return The updated index after adding the value to the buffer.
+     * PAYLOAD_VERSION_COMPACT gives the 8-byte layout; every other version the full layout.
+     * Unused bits are always zero, even when `out` holds stale data.
      */
 
-    _buffer[idx_in++] = (value >> 8) & 0xFF; // msb
-    _buffer[idx_in++] = (value) & 0xFF;      // lsb
-
-    return (idx_in);
-}
-
-unsigned char payloadEncoder::add_uint32(unsigned char idx_in, uint32_t value)
-{
-    /**
-     * Adds a 32-bit unsigned integer to the buffer.
-     *
-     * @param idx_in The starting index in the buffer.
-     * @param value The value to be added.
-     * @return The updated index after adding the value.
-     */
-
-    _buffer[idx_in++] = (value >> 24) & 0xFF; // MSB
-    _buffer[idx_in++] = (value >> 16) & 0xFF;
-    _buffer[idx_in++] = (value >> 8) & 0xFF;
-    _buffer[idx_in++] = value & 0xFF;         // LSB
-    return (idx_in);
-}
-
-unsigned char payloadEncoder::add_bool(unsigned char idx_in, bool value, unsigned int pos)
-{
-    /**
-     * @brief Adds a boolean value to the payload buffer at the specified position.
-     *
-     * This function sets or clears a specific bit in the buffer based on the given boolean value.
-     * If the value is true, the bit at the specified position is set to 1.
-     * If the value is false, the bit at the specified position is set to 0.
-     *
-     * @param idx_in The index of the buffer where the boolean value will be added.
-     * @param value The boolean value to be added to the buffer.
-     * @param pos The position of the bit in the buffer where the boolean value will be added.
-     * @return The updated index of the buffer.
-     */
-
-    if (value)
-    {
-        _buffer[idx_in] |= (1 << pos);
-    }
-    else
+    if (_fields.version == PAYLOAD_VERSION_COMPACT)
     {
-        _buffer[idx_in] &= ~(1 << pos);
+        if (capacity < payloadCodecV2::size)
+        {
+            return 0;
+        }
+        payloadCodecV2::encode(_fields, out);
+        return payloadCodecV2::size;
     }
-    if (pos == 0)
+
+    if (capacity < SENSOR_PAYLOAD_SIZE)
     {
-        idx_in++;
+        return 0;
     }
-    return (idx_in);
+
+    payloadCodecV1::encode(_fields, out);
+    return SENSOR_PAYLOAD_SIZE;
 }
 
 /**
@@ -161,11 +89,73 @@ void payloadEncoder::printPayloadEncoded()
      */
 
     std::cout << "Payload encoded: " << std::endl;
-    std::cout << "ID: " << _id << std::endl;
-    std::cout << "Version: " << static_cast<int>(_version) << std::endl;
-    std::cout << "Door status: " << _doorStatus << std::endl;
-    std::cout << "Catch detect: " << _catchDetect << std::endl;
-    std::cout << "Trap displacement: " << _trapDisplacement << std::endl;
-    std::cout << "Battery status: " << static_cast<int>(_batteryStatus) << std::endl;
-    std::cout << "Unix time: " << _unixTime << std::endl;
+    std::cout << "ID: " << _fields.id << std::endl;
+    std::cout << "Version: " << static_cast<int>(_fields.version) << std::endl;
+    std::cout << "Door status: " << _fields.doorStatus << std::endl;
+    std::cout << "Catch detect: " << _fields.catchDetect << std::endl;
+    std::cout << "Trap displacement: " << _fields.trapDisplacement << std::endl;
+    std::cout << "Battery status: " << static_cast<int>(_fields.batteryStatus) << std::endl;
+    std::cout << "Unix time: " << _fields.unixTime << std::endl;
+}
+
+void payloadEncoder::set_id(uint32_t id)
+{
+    _fields.id = id;
+}
+
+void payloadEncoder::set_version(uint8_t version)
+{
+    _fields.version = version;
+}
+
+void payloadEncoder::set_doorStatus(bool doorStatus)
+{
+    _fields.doorStatus = doorStatus;
+}
+
+void payloadEncoder::set_catchDetect(bool catchDetect)
+{
+    _fields.catchDetect = catchDetect;
+}
+
+void payloadEncoder::set_trapDisplacement(bool trapDisplacement)
+{
+    _fields.trapDisplacement = trapDisplacement;
+}
+
+void payloadEncoder::set_batteryStatus(uint8_t batteryStatus)
+{
+    _fields.batteryStatus = batteryStatus;
+}
+
+void payloadEncoder::set_unixTime(uint32_t unixTime)
+{
+    _fields.unixTime = unixTime;
+}
+
+size_t payloadEncoder::encodeBatch(const payloadBatch &batch, uint8_t *out, size_t capacity)
+{
+    /**
+     * Encodes rows straight into `out` in one pass over the columns. Every frame is written in
+     * the full layout, so its version byte is PAYLOAD_VERSION whatever the row's version says.
+     */
+    size_t rows = batch.size();
+    if (rows > capacity / SENSOR_PAYLOAD_SIZE)
+    {
+        rows = capacity / SENSOR_PAYLOAD_SIZE;
+    }
+
+    payloadFields fields{};
+    for (size_t row = 0; row < rows; row++)
+    {
+        fields.id = batch.id[row];
+        fields.version = PAYLOAD_VERSION;
+        fields.doorStatus = batch.flags[row] & FLAG_DOOR_STATUS;
+        fields.catchDetect = batch.flags[row] & FLAG_CATCH_DETECT;
+        fields.trapDisplacement = batch.flags[row] & FLAG_TRAP_DISPLACEMENT;
+        fields.batteryStatus = batch.battery[row];
+        fields.unixTime = batch.unixTime[row];
+        payloadCodecV1::encode(fields, out + row * SENSOR_PAYLOAD_SIZE);
+    }
+    return rows;
 }
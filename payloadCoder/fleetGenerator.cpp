@@ -0,0 +1,251 @@
+#include "fleetGenerator.h"
+#include "base64Codec.h"
+#include "encoder.h"
+#include "hexCodec.h"
+#include "ttnUplink.h"
+
+#include <algorithm> // std::make_heap, std::push_heap, std::pop_heap, std::min, std::max
+#include <cmath>     // std::log, std::lround
+#include <limits>
+#include <stdio.h>   // snprintf
+#include <string.h>  // memcpy
+
+namespace
+{
+    const uint64_t MS_PER_DAY = 86400000ULL;                     ///< Milliseconds per day
+    const uint64_t MAX_BOOT_DELAY_MS = 60000;                    ///< Traps power up within the first minute
+    const uint64_t NEVER = std::numeric_limits<uint64_t>::max(); ///< Event that does not happen
+    const uint64_t DEV_EUI_BASE = 0x70B3D57ED0000000ULL;         ///< Base of the simulated DevEUIs
+    const uint64_t GATEWAY_EUI_BASE = 0xB827EBFFFE000000ULL;     ///< Base of the simulated gateway EUIs
+
+    /// @brief Sensor flag toggled by each event kind (door, catch, displacement).
+    const uint8_t EVENT_FLAGS[3] = {FLAG_DOOR_STATUS, FLAG_CATCH_DETECT, FLAG_TRAP_DISPLACEMENT};
+
+    /// @brief EU868 uplink channels in Hz.
+    const uint32_t EU868_CHANNELS[8] = {868100000, 868300000, 868500000, 867100000,
+                                        867300000, 867500000, 867700000, 867900000};
+
+    /// @brief Heap order for wake-ups: earliest time first, ties in trap order, so the output
+    /// does not depend on the standard library's heap implementation.
+    struct laterWake
+    {
+        template <typename Wake>
+        bool operator()(const Wake &a, const Wake &b) const
+        {
+            return a.timeMs != b.timeMs ? a.timeMs > b.timeMs : a.trap > b.trap;
+        }
+    };
+
+    /// @brief splitmix64 step: advance `state` and return the next 64 random bits.
+    inline uint64_t splitmix64(uint64_t &state)
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// @brief Append one uplink as a single-line TTN v3 message.
+    void appendTtnLine(const fleetConfig &config, const uint8_t *frame, const fleetUplink &uplink, std::string &out)
+    {
+        const uint32_t id = config.firstId + uplink.trap;
+        uplinkRecord record;
+        snprintf(record.deviceId, sizeof(record.deviceId), "trap-%lu", static_cast<unsigned long>(id));
+        snprintf(record.gatewayId, sizeof(record.gatewayId), "fleet-gw-%u", uplink.channel);
+        record.devEui = DEV_EUI_BASE | id;
+        record.gatewayEui = GATEWAY_EUI_BASE | uplink.channel;
+        record.receivedMs = static_cast<uint64_t>(config.startTime) * 1000 + uplink.timeMs;
+        record.devAddr = (id & 0x01FFFFFFu) | 0x26000000u;
+        record.fcnt = uplink.fcnt;
+        record.frequency = EU868_CHANNELS[uplink.channel];
+        record.rssi = uplink.rssi;
+        record.snr = uplink.snr;
+        record.port = 1;
+        record.sf = uplink.sf;
+        record.gateways = 1;
+        memcpy(record.frame, frame, SENSOR_PAYLOAD_SIZE);
+        appendTtnUplink(record, out);
+    }
+}
+
+fleetConfig defaultFleetConfig()
+{
+    fleetConfig config = {};
+    config.traps = 1000;
+    config.firstId = 1;
+    config.seed = 1;
+    config.startTime = 1700000000;
+    config.doorEventsPerDay = 4.0;
+    config.catchEventsPerDay = 0.2;
+    config.displacementEventsPerDay = 0.05;
+    config.batteryDrainPerDay = 0.1;
+    return config;
+}
+
+double fleetGenerator::uniform(uint64_t &rng)
+{
+    // 53 random bits, shifted into (0, 1] so that log() stays finite
+    return static_cast<double>((splitmix64(rng) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+uint64_t fleetGenerator::nextEvent(uint64_t &rng, uint64_t fromMs, double perDay)
+{
+    if (!(perDay > 0.0))
+    {
+        return NEVER;
+    }
+    const double gapMs = -std::log(uniform(rng)) / perDay * static_cast<double>(MS_PER_DAY);
+    return fromMs + 1 + static_cast<uint64_t>(std::min(gapMs, 1e15));
+}
+
+uint64_t fleetGenerator::wakeTime(const trap &t, uint64_t nowMs)
+{
+    // loop() sends a timed heartbeat once both the duty cycle interval and the heartbeat interval
+    // have passed (both compare with '>', hence the + 1). Elapsed times use the 32-bit trap clock,
+    // exactly as the firmware sees them.
+    const uint32_t clock = static_cast<uint32_t>(nowMs - t.bootMs);
+    const uint32_t sinceSend = clock - t.policy.lastSendTime;
+    const uint32_t sinceHeartbeat = clock - t.policy.lastHeartbeat;
+    const uint64_t sendWait = sinceSend > MIN_SEND_INTERVAL_MS ? 0 : MIN_SEND_INTERVAL_MS + 1 - sinceSend;
+    const uint64_t heartbeatWait = sinceHeartbeat > HEARTBEAT_INTERVAL_MS ? 0 : HEARTBEAT_INTERVAL_MS + 1 - sinceHeartbeat;
+    uint64_t next = nowMs + std::max<uint64_t>(std::max(sendWait, heartbeatWait), 1);
+    next = std::min(next, t.nextTickMs);
+    for (uint64_t eventMs : t.nextEventMs)
+    {
+        next = std::min(next, eventMs);
+    }
+    return next;
+}
+
+fleetGenerator::fleetGenerator(const fleetConfig &config)
+    : _config(config), _traps(config.traps), _heap(), _timeMs(0)
+{
+    const double rates[3] = {config.doorEventsPerDay, config.catchEventsPerDay, config.displacementEventsPerDay};
+    _heap.reserve(config.traps);
+    for (uint32_t i = 0; i < config.traps; i++)
+    {
+        trap &t = _traps[i];
+        uint64_t seeder = config.seed ^ (static_cast<uint64_t>(i) * 0xD1B54A32D192ED03ULL);
+        t.rng = splitmix64(seeder);
+        t.bootMs = splitmix64(t.rng) % MAX_BOOT_DELAY_MS;
+        t.policy = sendPolicyState{0, 0, 0};
+        for (int k = 0; k < 3; k++)
+        {
+            t.nextEventMs[k] = nextEvent(t.rng, t.bootMs, rates[k]);
+        }
+        t.nextTickMs = t.bootMs + 1 + splitmix64(t.rng) % WATCHDOG_PERIOD_MS;
+        t.battery = 60.0 + 40.0 * uniform(t.rng);
+        t.fcnt = 0;
+        t.sensors = 0;
+        _heap.push_back(wake{wakeTime(t, t.bootMs), i});
+    }
+    std::make_heap(_heap.begin(), _heap.end(), laterWake());
+}
+
+size_t fleetGenerator::next(size_t count, uint64_t endMs, payloadBatch &batch, std::vector<fleetUplink> &uplinks)
+{
+    const double rates[3] = {_config.doorEventsPerDay, _config.catchEventsPerDay, _config.displacementEventsPerDay};
+
+    size_t produced = 0;
+    while (produced < count && !_heap.empty() && _heap.front().timeMs <= endMs)
+    {
+        std::pop_heap(_heap.begin(), _heap.end(), laterWake());
+        const wake w = _heap.back();
+        trap &t = _traps[w.trap];
+        _timeMs = w.timeMs;
+
+        bool event = false;
+        for (int k = 0; k < 3; k++)
+        {
+            if (t.nextEventMs[k] <= w.timeMs)
+            {
+                t.sensors ^= EVENT_FLAGS[k];
+                t.nextEventMs[k] = nextEvent(t.rng, w.timeMs, rates[k]);
+                event = true;
+            }
+        }
+        bool tick = false;
+        if (t.nextTickMs <= w.timeMs)
+        {
+            tick = true;
+            t.nextTickMs += WATCHDOG_PERIOD_MS;
+        }
+
+        const uint8_t reason = sendPolicyDecide(t.policy, static_cast<uint32_t>(w.timeMs - t.bootMs), event, tick);
+        if (reason != 0)
+        {
+            const double battery = t.battery - _config.batteryDrainPerDay * static_cast<double>(w.timeMs) / static_cast<double>(MS_PER_DAY);
+            const size_t row = batch.size();
+            batch.resize(row + 1);
+            batch.id[row] = _config.firstId + w.trap;
+            batch.version[row] = PAYLOAD_VERSION;
+            batch.flags[row] = t.sensors;
+            batch.battery[row] = static_cast<uint8_t>(std::lround(std::max(battery, 0.0)));
+            batch.unixTime[row] = _config.startTime + static_cast<uint32_t>(w.timeMs / 1000);
+            batch.doorStatus[row] = (t.sensors & FLAG_DOOR_STATUS) ? 1 : 0;
+            batch.catchDetect[row] = (t.sensors & FLAG_CATCH_DETECT) ? 1 : 0;
+            batch.trapDisplacement[row] = (t.sensors & FLAG_TRAP_DISPLACEMENT) ? 1 : 0;
+
+            const uint64_t radio = splitmix64(t.rng);
+            fleetUplink uplink = {};
+            uplink.timeMs = w.timeMs;
+            uplink.trap = w.trap;
+            uplink.fcnt = t.fcnt++;
+            uplink.reason = reason;
+            uplink.rssi = static_cast<int16_t>(-40 - static_cast<int>(radio % 81));
+            uplink.snr = static_cast<int8_t>(static_cast<int>((radio >> 8) % 31) - 20);
+            uplink.sf = static_cast<uint8_t>(7 + (radio >> 16) % 6);
+            uplink.channel = static_cast<uint8_t>((radio >> 24) % 8);
+            uplinks.push_back(uplink);
+            produced++;
+        }
+
+        _heap.back().timeMs = wakeTime(t, w.timeMs);
+        std::push_heap(_heap.begin(), _heap.end(), laterWake());
+    }
+    return produced;
+}
+
+void appendFleetUplinks(inputFormat format, const fleetConfig &config, const uint8_t *frames,
+                        const std::vector<fleetUplink> &uplinks, std::string &out)
+{
+    const size_t count = uplinks.size();
+    switch (format)
+    {
+    case inputFormat::raw:
+        out.append(reinterpret_cast<const char *>(frames), count * SENSOR_PAYLOAD_SIZE);
+        break;
+    case inputFormat::hex:
+    {
+        const size_t lineLength = 2 * SENSOR_PAYLOAD_SIZE + 1;
+        const size_t start = out.size();
+        out.resize(start + count * lineLength);
+        for (size_t i = 0; i < count; i++)
+        {
+            char *line = &out[start + i * lineLength];
+            binaryToHex(frames + i * SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE, line);
+            line[lineLength - 1] = '\n';
+        }
+        break;
+    }
+    case inputFormat::base64:
+    {
+        const size_t lineLength = BASE64_FRAME_LENGTH + 1;
+        const size_t start = out.size();
+        out.resize(start + count * lineLength);
+        for (size_t i = 0; i < count; i++)
+        {
+            char *line = &out[start + i * lineLength];
+            binaryToBase64(frames + i * SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE, line);
+            line[lineLength - 1] = '\n';
+        }
+        break;
+    }
+    case inputFormat::ttn:
+        for (size_t i = 0; i < count; i++)
+        {
+            appendTtnLine(config, frames + i * SENSOR_PAYLOAD_SIZE, uplinks[i], out);
+        }
+        break;
+    }
+}
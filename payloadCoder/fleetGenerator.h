@@ -0,0 +1,128 @@
+/**
+ * @file fleetGenerator.h
+ * @brief Synthetic uplink traffic from a simulated fleet of muskrat traps.
+ *
+ * Every simulated trap runs the send rules of the firmware (sendPolicyDecide() from
+ * nodeCode/sendPolicy.h) on its own millisecond clock. loop() is evaluated whenever something
+ * can change its decision: a sensor event, a watchdog tick (every WATCHDOG_PERIOD_MS) or the
+ * moment the timed heartbeat falls due. Door, catch and displacement events arrive as Poisson
+ * processes with per-day rates and toggle the trap's state; the battery drains slowly.
+ *
+ * Traps are advanced in simulated time order through a min-heap, so the uplinks of the whole
+ * fleet come out ordered by time. Each trap has its own random generator seeded from the fleet
+ * seed and its index, so the same configuration always produces the same traffic. Frames are
+ * encoded with payloadEncoder::encodeBatch().
+ */
+
+#ifndef FLEETGENERATOR_H
+#define FLEETGENERATOR_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <string>
+#include <vector>
+
+#include "../nodeCode/sendPolicy.h"
+#include "frameReader.h" // inputFormat
+#include "payloadBatch.h"
+
+const uint32_t WATCHDOG_PERIOD_MS = 8000; ///< Watchdog interrupt period set up in setup() (8 s)
+
+/// \brief settings of a simulated fleet
+struct fleetConfig
+{
+    uint32_t traps;                  ///< Number of simulated traps
+    uint32_t firstId;                ///< Payload id of the first trap; trap i gets firstId + i
+    uint64_t seed;                   ///< Random seed; the same seed gives the same traffic
+    uint32_t startTime;              ///< Unix time at simulated time 0
+    double doorEventsPerDay;         ///< Door events per trap per day
+    double catchEventsPerDay;        ///< Catch events per trap per day
+    double displacementEventsPerDay; ///< Displacement events per trap per day
+    double batteryDrainPerDay;       ///< Battery percentage lost per trap per day
+};
+
+/// \brief default fleet: 1000 traps, a few events per trap per day
+fleetConfig defaultFleetConfig();
+
+/// \brief one generated uplink (the frame itself is the matching row of the batch)
+struct fleetUplink
+{
+    uint64_t timeMs; ///< Simulated time since the start in ms
+    uint32_t trap;   ///< Trap index, 0 .. traps - 1
+    uint32_t fcnt;   ///< LoRaWAN frame counter of the trap
+    uint8_t reason;  ///< SEND_EVENT and/or SEND_HEARTBEAT
+    int16_t rssi;    ///< Simulated rssi in dBm
+    int8_t snr;      ///< Simulated snr in dB
+    uint8_t sf;      ///< Simulated spreading factor
+    uint8_t channel; ///< Simulated EU868 channel (0-7)
+};
+
+/// \brief simulated fleet of traps
+class fleetGenerator
+{
+private:
+    /// \brief state of one simulated trap
+    struct trap
+    {
+        sendPolicyState policy;  ///< Send timers, as kept by the firmware (trap clock)
+        uint64_t bootMs;         ///< Simulated time at which the trap's millis() clock started
+        uint64_t nextEventMs[3]; ///< Next door, catch and displacement event
+        uint64_t nextTickMs;     ///< Next watchdog tick
+        uint64_t rng;            ///< Random generator state
+        double battery;          ///< Battery level in percent at simulated time 0
+        uint32_t fcnt;           ///< Uplinks sent so far
+        uint8_t sensors;         ///< Door, catch and displacement state (FLAG_* bits)
+    };
+
+    /// \brief heap entry: next time a trap must be looked at
+    struct wake
+    {
+        uint64_t timeMs; ///< Simulated time
+        uint32_t trap;   ///< Trap index
+    };
+
+    fleetConfig _config;       ///< Fleet settings
+    std::vector<trap> _traps;  ///< Trap states
+    std::vector<wake> _heap;   ///< Min-heap of wake-up times, one entry per trap
+    uint64_t _timeMs;          ///< Simulated time of the last processed wake-up
+
+    /// \brief uniform random number in (0, 1]
+    static double uniform(uint64_t &rng);
+
+    /// \brief time of the next event of a Poisson process with `perDay` events per day
+    static uint64_t nextEvent(uint64_t &rng, uint64_t fromMs, double perDay);
+
+    /// \brief next simulated time after `nowMs` at which loop() of the trap can decide differently
+    static uint64_t wakeTime(const trap &t, uint64_t nowMs);
+
+public:
+    /// \brief constructor
+    /// \param config fleet settings
+    explicit fleetGenerator(const fleetConfig &config);
+
+    /// \brief simulate until `count` uplinks are produced or simulated time passes `endMs`
+    /// \param count maximum number of uplinks to produce
+    /// \param endMs stop before wake-ups after this simulated time (ms since the start)
+    /// \param batch receives one row per uplink
+    /// \param uplinks receives the metadata of each uplink
+    /// \return number of uplinks appended
+    size_t next(size_t count, uint64_t endMs, payloadBatch &batch, std::vector<fleetUplink> &uplinks);
+
+    /// \brief simulated time of the last processed wake-up in ms
+    uint64_t get_timeMs() const { return _timeMs; }
+
+    /// \brief fleet settings
+    const fleetConfig &get_config() const { return _config; }
+};
+
+/// \brief append generated uplinks as text or raw frames, in a format `payloadCoder decode` reads
+/// \param format raw (frames back-to-back), hex or base64 (one frame per line), or ttn (one TTN v3
+///        JSON uplink per line)
+/// \param config fleet settings (ids and start time)
+/// \param frames encoded frames, one per uplink
+/// \param uplinks uplink metadata
+/// \param out receives the output
+void appendFleetUplinks(inputFormat format, const fleetConfig &config, const uint8_t *frames,
+                        const std::vector<fleetUplink> &uplinks, std::string &out);
+
+#endif // FLEETGENERATOR_H
@@ -0,0 +1,184 @@
+#include "fleetState.h"
+
+namespace
+{
+    /// @brief Pack version, flags and battery into one word.
+    inline uint32_t pack(uint8_t version, uint8_t flags, uint8_t battery)
+    {
+        return static_cast<uint32_t>(version) | static_cast<uint32_t>(flags) << 8 | static_cast<uint32_t>(battery) << 16;
+    }
+}
+
+fleetStateTable::fleetStateTable(size_t capacity)
+    : _slots(), _mask(0), _size(0)
+{
+    size_t slots = 1;
+    while (slots < capacity)
+    {
+        slots <<= 1;
+    }
+    _slots.reset(new slot[slots]);
+    _mask = slots - 1;
+    for (size_t i = 0; i < slots; i++)
+    {
+        _slots[i].key.store(0, std::memory_order_relaxed);
+        _slots[i].sequence.store(0, std::memory_order_relaxed);
+        _slots[i].unixTime.store(0, std::memory_order_relaxed);
+        _slots[i].changedTime.store(0, std::memory_order_relaxed);
+        _slots[i].updates.store(0, std::memory_order_relaxed);
+        _slots[i].packed.store(0, std::memory_order_relaxed);
+    }
+}
+
+fleetStateTable::slot *fleetStateTable::find(uint32_t id, bool claim, bool &claimed) const
+{
+    claimed = false;
+    const uint64_t key = static_cast<uint64_t>(id) + 1;
+    size_t index = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & _mask;
+    for (size_t probe = 0; probe <= _mask; probe++, index = (index + 1) & _mask)
+    {
+        slot &s = _slots[index];
+        uint64_t current = s.key.load(std::memory_order_acquire);
+        if (current == key)
+        {
+            return &s;
+        }
+        if (current == 0)
+        {
+            if (!claim)
+            {
+                return nullptr;
+            }
+            // Another writer may claim the slot first, for this id or another one
+            if (s.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            {
+                claimed = true;
+                return &s;
+            }
+            if (current == key)
+            {
+                return &s;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void fleetStateTable::load(const slot &s, uint32_t id, trapState &state)
+{
+    uint32_t before;
+    uint32_t after;
+    do
+    {
+        before = s.sequence.load(std::memory_order_acquire);
+        while (before & 1)
+        {
+            before = s.sequence.load(std::memory_order_acquire);
+        }
+        state.unixTime = s.unixTime.load(std::memory_order_relaxed);
+        state.changedTime = s.changedTime.load(std::memory_order_relaxed);
+        state.updates = s.updates.load(std::memory_order_relaxed);
+        const uint32_t packed = s.packed.load(std::memory_order_relaxed);
+        state.version = static_cast<uint8_t>(packed);
+        state.flags = static_cast<uint8_t>(packed >> 8);
+        state.battery = static_cast<uint8_t>(packed >> 16);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = s.sequence.load(std::memory_order_relaxed);
+    } while (before != after);
+    state.id = id;
+}
+
+bool fleetStateTable::update(uint32_t id, uint8_t version, uint8_t flags, uint8_t battery, uint32_t unixTime)
+{
+    bool claimed;
+    slot *s = find(id, true, claimed);
+    if (s == nullptr)
+    {
+        return false;
+    }
+    if (claimed)
+    {
+        _size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Take the slot: only other writers of the same trap wait here, never readers
+    uint32_t sequence = s->sequence.load(std::memory_order_relaxed);
+    do
+    {
+        while (sequence & 1)
+        {
+            sequence = s->sequence.load(std::memory_order_relaxed);
+        }
+    } while (!s->sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint32_t updates = s->updates.load(std::memory_order_relaxed);
+    if (updates != 0 && unixTime < s->unixTime.load(std::memory_order_relaxed))
+    {
+        // Late record: nothing changed, so the old sequence value is still valid
+        s->sequence.store(sequence, std::memory_order_release);
+        return false;
+    }
+    const uint32_t packed = pack(version, flags, battery);
+    const uint32_t previous = s->packed.load(std::memory_order_relaxed);
+    if (updates == 0 || static_cast<uint8_t>(previous >> 8) != flags)
+    {
+        s->changedTime.store(unixTime, std::memory_order_relaxed);
+    }
+    s->unixTime.store(unixTime, std::memory_order_relaxed);
+    s->packed.store(packed, std::memory_order_relaxed);
+    s->updates.store(updates + 1, std::memory_order_relaxed);
+    s->sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
+
+bool fleetStateTable::update(const payloadDecoder &decoder)
+{
+    const uint8_t flags = (decoder.get_doorStatus() ? FLAG_DOOR_STATUS : 0) |
+                          (decoder.get_catchDetect() ? FLAG_CATCH_DETECT : 0) |
+                          (decoder.get_trapDisplacement() ? FLAG_TRAP_DISPLACEMENT : 0);
+    return update(decoder.get_id(), decoder.get_version(), flags, decoder.get_batteryStatus(), decoder.get_unixTime());
+}
+
+size_t fleetStateTable::update(const payloadBatch &batch)
+{
+    size_t applied = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        applied += update(batch.id[i], batch.version[i], batch.flags[i], batch.battery[i], batch.unixTime[i]);
+    }
+    return applied;
+}
+
+bool fleetStateTable::read(uint32_t id, trapState &state) const
+{
+    bool claimed;
+    const slot *s = find(id, false, claimed);
+    if (s == nullptr)
+    {
+        return false;
+    }
+    load(*s, id, state);
+    return state.updates != 0;
+}
+
+size_t fleetStateTable::snapshot(std::vector<trapState> &out) const
+{
+    out.clear();
+    out.reserve(size());
+    for (size_t i = 0; i <= _mask; i++)
+    {
+        const uint64_t key = _slots[i].key.load(std::memory_order_acquire);
+        if (key == 0)
+        {
+            continue;
+        }
+        trapState state;
+        load(_slots[i], static_cast<uint32_t>(key - 1), state);
+        if (state.updates != 0)
+        {
+            out.push_back(state);
+        }
+    }
+    return out.size();
+}
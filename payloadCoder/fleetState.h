@@ -0,0 +1,117 @@
+/**
+ * @file fleetState.h
+ * @brief Current state of every trap, updated by decoders and read by dashboards without locks.
+ *
+ * The table keeps the latest door, catch, displacement and battery state per payload id in a
+ * fixed-size open-addressing hash table. Each slot is guarded by a sequence counter (seqlock):
+ * a writer makes the counter odd, stores the fields and makes it even again; a reader copies the
+ * fields between two reads of the counter and retries if it changed. Readers never write shared
+ * memory, so any number of them can poll the table while uplinks arrive, and a writer never
+ * waits for a reader. Writers to the same trap take turns on that slot's counter; writers to
+ * different traps do not interact.
+ *
+ * The table does not grow: slots are claimed once per id and never freed, so its capacity must
+ * cover the fleet (keep it at least 1.5 times the number of traps for short probe sequences).
+ *
+ * Usage: create one fleetStateTable, call update() from the decode threads and read() or
+ * snapshot() from any other thread.
+ */
+
+#ifndef FLEETSTATE_H
+#define FLEETSTATE_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "decoder.h"
+#include "payloadBatch.h"
+
+/// \brief consistent copy of one trap's state
+struct trapState
+{
+    uint32_t id = 0;          ///< Payload id of the trap
+    uint8_t version = 0;      ///< Payload version of the latest record
+    uint8_t flags = 0;        ///< Door/catch/displacement bits of the latest record (see FLAG_*)
+    uint8_t battery = 0;      ///< Battery status of the latest record
+    uint32_t unixTime = 0;    ///< Unix time of the latest record
+    uint32_t changedTime = 0; ///< Unix time of the first record with the current flags
+    uint32_t updates = 0;     ///< Records applied to this trap
+};
+
+/// \brief lock-free readable table of the latest state per trap
+class fleetStateTable
+{
+private:
+    /// \brief one trap; the fields are atomics so that readers may copy them while a writer stores
+    struct alignas(32) slot
+    {
+        std::atomic<uint64_t> key{0};         ///< 0 if free, else payload id + 1
+        std::atomic<uint32_t> sequence{0};    ///< Seqlock counter, odd while a writer stores
+        std::atomic<uint32_t> unixTime{0};    ///< See trapState
+        std::atomic<uint32_t> changedTime{0}; ///< See trapState
+        std::atomic<uint32_t> updates{0};     ///< See trapState
+        std::atomic<uint32_t> packed{0};      ///< version | flags << 8 | battery << 16
+    };
+
+    std::unique_ptr<slot[]> _slots; ///< Hash table
+    size_t _mask;                   ///< Capacity - 1 (capacity is a power of two)
+    std::atomic<size_t> _size;      ///< Slots in use
+
+    /// \brief find the slot of an id
+    /// \param id payload id
+    /// \param claim claim a free slot if the id is not in the table
+    /// \param claimed set to true if a free slot was claimed for the id
+    /// \return slot, or nullptr if the id is absent (or the table is full when claiming)
+    slot *find(uint32_t id, bool claim, bool &claimed) const;
+
+    /// \brief copy a slot's fields consistently
+    static void load(const slot &s, uint32_t id, trapState &state);
+
+public:
+    /// \brief constructor
+    /// \param capacity maximum number of traps; rounded up to a power of two
+    explicit fleetStateTable(size_t capacity);
+    fleetStateTable(const fleetStateTable &) = delete;            ///< Copy constructor disabled
+    fleetStateTable &operator=(const fleetStateTable &) = delete; ///< Assignment operator disabled
+
+    /// \brief apply one record; records older than the trap's latest are ignored
+    /// \param id payload id
+    /// \param version payload version
+    /// \param flags door/catch/displacement bits (see FLAG_*)
+    /// \param battery battery status
+    /// \param unixTime unix time of the record
+    /// \return false if the record is older than the stored state or the table is full
+    bool update(uint32_t id, uint8_t version, uint8_t flags, uint8_t battery, uint32_t unixTime);
+
+    /// \brief apply the record held by a decoder
+    /// \param decoder decoder after decodePayload()
+    /// \return see update()
+    bool update(const payloadDecoder &decoder);
+
+    /// \brief apply all rows of a batch, in row order
+    /// \param batch decoded rows
+    /// \return number of rows applied
+    size_t update(const payloadBatch &batch);
+
+    /// \brief read the state of one trap
+    /// \param id payload id
+    /// \param state receives a consistent copy of the trap's state
+    /// \return false if no record of the trap has been applied yet
+    bool read(uint32_t id, trapState &state) const;
+
+    /// \brief copy the state of every trap; each entry is consistent, the set is not a single instant
+    /// \param out receives one entry per trap, in table order
+    /// \return number of traps
+    size_t snapshot(std::vector<trapState> &out) const;
+
+    /// \brief number of traps in the table
+    size_t size() const { return _size.load(std::memory_order_relaxed); }
+
+    /// \brief maximum number of traps
+    size_t capacity() const { return _mask + 1; }
+};
+
+#endif // FLEETSTATE_H
@@ -0,0 +1,459 @@
+#include "frameReader.h"
+#include "bulkReader.h"
+#include "decoder.h"
+#include "encoder.h"
+#include "hexCodec.h"
+#include "base64Codec.h"
+
+#include <string.h> // memchr, memcpy, memmove, strcmp
+
+namespace
+{
+    /// @brief Value of a hex digit, or 0xFF for any other character.
+    inline uint8_t hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return static_cast<uint8_t>(c - '0');
+        }
+        const char lower = static_cast<char>(c | 0x20);
+        if (lower >= 'a' && lower <= 'f')
+        {
+            return static_cast<uint8_t>(lower - 'a' + 10);
+        }
+        return 0xFF;
+    }
+
+    /**
+     * @brief Parse a frame written as separated hex bytes, as in "01 02 03", "01:02:03" or the
+     * node's debug output, which prints bytes without leading zeros ("1 2 3 4 1 5 64 A B C D").
+     * @return number of bytes, at most SENSOR_PAYLOAD_SIZE; 0 if a token is not one or two digits
+     */
+    size_t hexTokensToFrame(const char *line, size_t length, uint8_t *frame)
+    {
+        size_t count = 0;
+        size_t i = 0;
+        while (i < length)
+        {
+            const char c = line[i];
+            if (c == ' ' || c == ':' || c == '-')
+            {
+                i++;
+                continue;
+            }
+            const uint8_t hi = hexDigit(c);
+            if (hi == 0xFF || count == SENSOR_PAYLOAD_SIZE)
+            {
+                return 0;
+            }
+            uint8_t value = hi;
+            i++;
+            if (i < length && hexDigit(line[i]) != 0xFF)
+            {
+                value = static_cast<uint8_t>((hi << 4) | hexDigit(line[i]));
+                i++;
+            }
+            if (i < length && hexDigit(line[i]) != 0xFF)
+            {
+                return 0; // three digits without a separator
+            }
+            frame[count++] = value;
+        }
+        return count;
+    }
+}
+
+bool parseInputFormat(const char *name, inputFormat &format)
+{
+    if (strcmp(name, "raw") == 0)
+    {
+        format = inputFormat::raw;
+    }
+    else if (strcmp(name, "hex") == 0)
+    {
+        format = inputFormat::hex;
+    }
+    else if (strcmp(name, "base64") == 0)
+    {
+        format = inputFormat::base64;
+    }
+    else if (strcmp(name, "ttn") == 0)
+    {
+        format = inputFormat::ttn;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+frameReader::frameReader(FILE *file, inputFormat format, size_t chunkSize, std::pmr::memory_resource *memory)
+    : _file(file),
+      _source(nullptr),
+      _format(format),
+      _read(chunkSize < 4 * SENSOR_PAYLOAD_SIZE ? 4 * SENSOR_PAYLOAD_SIZE : chunkSize, memory),
+      _spare(memory),
+      _carryFrom(0),
+      _carry(0),
+      _frames(memory),
+      _uplinks(),
+      _eof(false),
+      _skipLine(false),
+      _lines(0),
+      _rejectedLines(0),
+      _receivedAt(0)
+{
+    if (_format != inputFormat::raw)
+    {
+        _frames.reserve(_read.size() / 2);
+    }
+}
+
+frameReader::frameReader(bulkReader &source, inputFormat format, size_t lineSize, std::pmr::memory_resource *memory)
+    : frameReader(nullptr, format, lineSize, memory)
+{
+    _source = &source;
+}
+
+frameReader::frameReader(inputFormat format, size_t lineSize, std::pmr::memory_resource *memory)
+    : frameReader(nullptr, format, lineSize, memory)
+{
+}
+
+bool frameReader::failed() const
+{
+    if (_source != nullptr)
+    {
+        return _source->failed();
+    }
+    return _file != nullptr && ferror(_file) != 0;
+}
+
+bool frameReader::convertLine(const char *line, size_t length)
+{
+    /** Strip the line ending and surrounding white space. */
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ' || line[length - 1] == '\t'))
+    {
+        length--;
+    }
+    while (length > 0 && (line[0] == ' ' || line[0] == '\t'))
+    {
+        line++;
+        length--;
+    }
+
+    uint8_t frame[SENSOR_PAYLOAD_SIZE];
+    size_t size = SENSOR_PAYLOAD_SIZE;
+    if (_format == inputFormat::hex)
+    {
+        /** Fast path for plain hex; separated bytes can also be 22 characters long ("1 2 3 ..."). */
+        const bool plain = length % 2 == 0 && length <= 2 * SENSOR_PAYLOAD_SIZE && hexToBinary(line, length, frame);
+        size = plain ? length / 2 : hexTokensToFrame(line, length, frame);
+    }
+    else if (_format == inputFormat::ttn)
+    {
+        /** Join accepts and other events hold no frame and count as rejected lines. */
+        ttnUplink uplink;
+        if (parseTtnUplink(std::string_view(line, length), uplink) != ttnMessage::uplink ||
+            !ttnUplinkFrame(uplink, frame))
+        {
+            return false;
+        }
+        _uplinks.push_back(uplink);
+    }
+    else if (length == BASE64_FRAME_LENGTH)
+    {
+        if (!base64ToFrame(line, frame))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        size = base64DecodedSize(line, length);
+        if (size == 0 || size > SENSOR_PAYLOAD_SIZE || base64ToBinary(line, length, frame) != size)
+        {
+            return false;
+        }
+    }
+
+    if (size != SENSOR_PAYLOAD_SIZE)
+    {
+        /** A shorter layout (the node's compact frames) is widened; text lines carry no receive time, so it must be set. */
+        uint8_t received[SENSOR_PAYLOAD_SIZE];
+        memcpy(received, frame, size);
+        if (_receivedAt == 0 || !payloadDecoder::widenFrame(received, size, _receivedAt, frame))
+        {
+            return false;
+        }
+    }
+
+    _frames.insert(_frames.end(), frame, frame + SENSOR_PAYLOAD_SIZE);
+    return true;
+}
+
+size_t frameReader::convertBase64Run(const char *text, size_t length)
+{
+    const size_t stride = BASE64_FRAME_LENGTH + 1;
+    size_t count = 0;
+    while ((count + 1) * stride <= length && text[count * stride + BASE64_FRAME_LENGTH] == '\n')
+    {
+        count++;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const size_t before = _frames.size();
+    _frames.resize(before + count * SENSOR_PAYLOAD_SIZE);
+    const size_t converted = base64ToFrames(text, count, stride, _frames.data() + before);
+    _frames.resize(before + converted * SENSOR_PAYLOAD_SIZE);
+    _lines += converted;
+    return converted * stride;
+}
+
+size_t frameReader::convertLines(const char *text, size_t length)
+{
+    size_t pos = 0;
+    if (_skipLine)
+    {
+        const char *end = static_cast<const char *>(memchr(text, '\n', length));
+        if (end == nullptr)
+        {
+            return length;
+        }
+        pos = static_cast<size_t>(end - text) + 1;
+        _skipLine = false;
+    }
+
+    while (pos < length)
+    {
+        if (_format == inputFormat::base64)
+        {
+            /** TTN dumps are mostly plain "AQIDBAEFZAoLDA0=" lines: convert those in batches. */
+            pos += convertBase64Run(text + pos, length - pos);
+            if (pos == length)
+            {
+                break;
+            }
+        }
+        const char *line = text + pos;
+        const char *end = static_cast<const char *>(memchr(line, '\n', length - pos));
+        if (end == nullptr)
+        {
+            break;
+        }
+        const size_t lineLength = static_cast<size_t>(end - line);
+        pos += lineLength + 1;
+
+        if (lineLength == 0 || (lineLength == 1 && line[0] == '\r'))
+        {
+            continue; // empty lines are not frames
+        }
+        _lines++;
+        if (!convertLine(line, lineLength))
+        {
+            _rejectedLines++;
+        }
+    }
+    return pos;
+}
+
+bool frameReader::next(const uint8_t *&frames, size_t &length)
+{
+    if (_source != nullptr)
+    {
+        return nextFromSource(frames, length);
+    }
+    if (_file == nullptr)
+    {
+        length = 0;
+        return false; // input comes through convert()
+    }
+
+    /** Move the bytes left over from the previous call to the front of the buffer. */
+    if (_carry > 0 && _carryFrom > 0)
+    {
+        memmove(_read.data(), _read.data() + _carryFrom, _carry);
+    }
+    size_t total = _carry;
+    _carry = 0;
+    _carryFrom = 0;
+
+    if (!_eof)
+    {
+        const size_t room = _read.size() - total;
+        const size_t count = fread(_read.data() + total, 1, room, _file);
+        total += count;
+        if (count < room)
+        {
+            _eof = true; // end of file or read error, see failed()
+        }
+    }
+    if (total == 0)
+    {
+        length = 0;
+        return false;
+    }
+
+    if (_format == inputFormat::raw)
+    {
+        /** Hand out whole frames in place; keep a partial frame unless this is the end. */
+        const size_t whole = _eof ? total : total - total % SENSOR_PAYLOAD_SIZE;
+        _carryFrom = whole;
+        _carry = total - whole;
+        frames = _read.data();
+        length = whole;
+        return true;
+    }
+
+    _frames.clear();
+    _uplinks.clear();
+    const char *text = reinterpret_cast<const char *>(_read.data());
+    size_t used = convertLines(text, total);
+    if (_eof && used < total)
+    {
+        /** Last line without a line ending. */
+        _lines++;
+        if (!convertLine(text + used, total - used))
+        {
+            _rejectedLines++;
+        }
+        used = total;
+    }
+    else if (used == 0 && total == _read.size())
+    {
+        /** A line longer than the whole buffer cannot be a frame: skip it. */
+        _lines++;
+        _rejectedLines++;
+        _skipLine = true;
+        used = total;
+    }
+    _carryFrom = used;
+    _carry = total - used;
+
+    frames = _frames.data();
+    length = _frames.size();
+    return true;
+}
+
+bool frameReader::nextFromSource(const uint8_t *&frames, size_t &length)
+{
+    const uint8_t *block = nullptr;
+    size_t size = 0;
+    const bool more = _source->next(block, size);
+    return convert(block, size, more, frames, length);
+}
+
+bool frameReader::convert(const uint8_t *block, size_t size, bool more, const uint8_t *&frames, size_t &length)
+{
+    /** _read only holds bytes carried over between blocks, at its front. */
+    if (_format == inputFormat::raw)
+    {
+        if (_carry > 0 && _carryFrom > 0)
+        {
+            memmove(_read.data(), _read.data() + _carryFrom, _carry);
+        }
+        _carryFrom = 0;
+        if (more && _carry == 0 && size % SENSOR_PAYLOAD_SIZE == 0)
+        {
+            frames = block; // whole frames: straight from the read buffer
+            length = size;
+            return true;
+        }
+        if (!more)
+        {
+            /** A partial frame at the end of the input is returned on its own. */
+            frames = _read.data();
+            length = _carry;
+            _carry = 0;
+            return length > 0;
+        }
+        if (_read.size() < _carry + size)
+        {
+            _read.resize(_carry + size);
+        }
+        memcpy(_read.data() + _carry, block, size);
+        const size_t total = _carry + size;
+        const size_t whole = total - total % SENSOR_PAYLOAD_SIZE;
+        frames = _read.data();
+        length = whole;
+        _carryFrom = whole; // moved to the front on the next call, once the block was used
+        _carry = total - whole;
+        return true;
+    }
+
+    _frames.clear();
+    _uplinks.clear();
+    if (!more)
+    {
+        if (_carry > 0 && !_skipLine)
+        {
+            /** Last line without a line ending. */
+            _lines++;
+            if (!convertLine(reinterpret_cast<const char *>(_read.data()), _carry))
+            {
+                _rejectedLines++;
+            }
+        }
+        _carry = 0;
+        frames = _frames.data();
+        length = _frames.size();
+        return length > 0;
+    }
+
+    const char *text = reinterpret_cast<const char *>(block);
+    size_t pos = 0;
+    bool joined = false;
+    if (_carry > 0)
+    {
+        /** Complete the line that started in the previous buffer. */
+        const char *end = static_cast<const char *>(memchr(text, '\n', size));
+        const size_t prefix = end != nullptr ? static_cast<size_t>(end - text) + 1 : size;
+        if (_carry + prefix > _read.size())
+        {
+            _lines++;
+            _rejectedLines++;
+            _skipLine = end == nullptr;
+            _carry = 0;
+        }
+        else
+        {
+            memcpy(_read.data() + _carry, text, prefix);
+            _carry += prefix;
+            if (end != nullptr)
+            {
+                convertLines(reinterpret_cast<const char *>(_read.data()), _carry);
+                _carry = 0;
+                joined = true;
+            }
+        }
+        pos = prefix;
+    }
+    pos += convertLines(text + pos, size - pos);
+
+    /** Keep the unfinished last line for the next buffer. */
+    const size_t tail = size - pos;
+    if (tail > _read.size())
+    {
+        _lines++;
+        _rejectedLines++;
+        _skipLine = true;
+    }
+    else if (tail > 0)
+    {
+        /** The uplinks of a line joined in _read point into it until the next call: carry over in the spare buffer. */
+        if (joined)
+        {
+            _spare.resize(_read.size());
+            _read.swap(_spare);
+        }
+        memcpy(_read.data(), text + pos, tail);
+        _carry = tail;
+    }
+    frames = _frames.data();
+    length = _frames.size();
+    return true;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file frameReader.h
+ * @brief Chunked reader turning a file or stdin into contiguous payload frames.
+ *
+ * Input formats:
+ * - raw: back-to-back binary frames of SENSOR_PAYLOAD_SIZE bytes
+ * - hex: one frame per line as 22 hex digits, or as bytes separated by spaces, ':' or '-'
+ *   (leading zeros may be left out, as in the node's debug output)
+ * - base64: one frame per line as base64 (TTN `frm_payload`)
+ * - ttn: one TTN v3 uplink message per line (newline-delimited JSON, see ttnUplink.h); the
+ *   frame is taken from `frm_payload` and the other fields are kept next to it
+ *
+ * The reader fills a large buffer per call and hands it out as one block of frames, ready for
+ * payloadDecoder::decodeBatch(). Text lines that do not hold exactly one frame are counted and skipped.
+ * Text lines may also hold the node's compact (version 2) frames; these are widened to the full
+ * layout (see payloadDecoder::widenFrame()), so the frames handed out all have the same size.
+ * Hex and base64 lines do not say when they were received, so compact frames in them are
+ * rejected unless the caller sets the receive time (see set_receivedAt()).
+ *
+ * Instead of a FILE, the reader can take its input from a bulkReader (see bulkReader.h). Raw
+ * frames are then handed out in the bulkReader's buffers without a copy, and text lines are
+ * converted where they were read; only a line that spans two buffers is copied. Input read by
+ * the caller (from a socket, see asyncIngest.h) is handed to convert() block by block the same way.
+ *
+ * The read buffer and the converted frames take their memory from the resource passed to the
+ * constructor (see batchArena.h); with a trackingResource that shows what the reading stage needs.
+ */
+
+#ifndef FRAMEREADER_H
+#define FRAMEREADER_H
+
+#include <stdint.h> // uint8_t and uint64_t type
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+#include <memory_resource>
+#include <vector>
+
+#include "ttnUplink.h"
+
+class bulkReader;
+
+/// \brief format of the frames read by frameReader
+enum class inputFormat : uint8_t
+{
+    raw,   ///< Binary frames back-to-back
+    hex,   ///< One hex frame per line
+    base64, ///< One base64 frame per line
+    ttn     ///< One TTN v3 uplink message per line
+};
+
+/// \brief parse an input format name ("raw", "hex", "base64" or "ttn")
+/// \param name format name
+/// \param format receives the format
+/// \return false if the name is unknown
+bool parseInputFormat(const char *name, inputFormat &format);
+
+/// \brief reads frames from a file in large chunks
+class frameReader
+{
+private:
+    FILE *_file;                       ///< Input file (not owned), nullptr when reading from _source
+    bulkReader *_source;               ///< Input buffers (not owned), nullptr when reading from _file
+    inputFormat _format;               ///< Format of the input
+    std::pmr::vector<uint8_t> _read;   ///< Bytes read from the file, including a partial frame or line carried over
+    std::pmr::vector<uint8_t> _spare;  ///< Takes the next carried-over line in convert() while _read holds one just converted
+    size_t _carryFrom;                 ///< Offset in _read of the bytes to carry over to the next call
+    size_t _carry;                     ///< Number of bytes to carry over to the next call
+    std::pmr::vector<uint8_t> _frames; ///< Frames converted from text lines
+    std::vector<ttnUplink> _uplinks;   ///< Uplink fields of the frames in _frames (ttn input only)
+    bool _eof;                         ///< End of file reached
+    bool _skipLine;                    ///< Discarding the rest of an overlong line
+    uint64_t _lines;                   ///< Text lines seen
+    uint64_t _rejectedLines;           ///< Text lines that did not hold one frame
+    uint32_t _receivedAt;              ///< Receive time for compact hex and base64 frames, 0: not known
+
+    /// \brief convert one text line and append the frame to _frames
+    /// \return false if the line does not hold exactly one frame
+    bool convertLine(const char *line, size_t length);
+
+    /// \brief convert a run of lines that hold exactly one padded base64 frame each
+    /// \return number of bytes consumed; stops at the first other line
+    size_t convertBase64Run(const char *text, size_t length);
+
+    /// \brief convert all complete lines in `text`, return the number of bytes consumed
+    size_t convertLines(const char *text, size_t length);
+
+    /// \brief next() for input from a bulkReader
+    bool nextFromSource(const uint8_t *&frames, size_t &length);
+
+public:
+    /// \brief constructor
+    /// \param file input file, for example stdin
+    /// \param format format of the input
+    /// \param chunkSize number of bytes read from the file per call to next()
+    /// \param memory resource for the read buffer and the converted frames
+    frameReader(FILE *file, inputFormat format, size_t chunkSize = 1 << 20,
+                std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+    /// \brief constructor for input from a bulkReader
+    /// \param source opened bulk reader
+    /// \param format format of the input
+    /// \param lineSize longest text line that is still converted
+    /// \param memory resource for the carried-over bytes and the converted frames
+    frameReader(bulkReader &source, inputFormat format, size_t lineSize = 1 << 20,
+                std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+    /// \brief constructor for input that the caller reads and hands to convert()
+    /// \param format format of the input
+    /// \param lineSize longest text line that is still converted
+    /// \param memory resource for the carried-over bytes and the converted frames
+    explicit frameReader(inputFormat format, size_t lineSize = 1 << 20,
+                         std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    frameReader(const frameReader &) = delete;            ///< Copy constructor disabled
+    frameReader &operator=(const frameReader &) = delete; ///< Assignment operator disabled
+
+    /// \brief read the next block of frames
+    /// Raw input is returned straight from the read buffer; a trailing partial frame is kept for
+    /// the next call and only returned (as the end of the last block) at end of file.
+    /// \param frames receives a pointer to the frames, valid until the next call
+    /// \param length receives the number of bytes in the block
+    /// \return false when the input is exhausted
+    bool next(const uint8_t *&frames, size_t &length);
+
+    /// \brief convert the next block of input read by the caller
+    /// Works like next() with a bulkReader: whole raw frames are handed out in place, a partial
+    /// frame or line is kept until the next block. Blocks may be of any size.
+    /// \param block bytes read; must stay valid until the next call
+    /// \param size number of bytes in `block`
+    /// \param more false at the end of the input (`block` is then ignored)
+    /// \param frames receives a pointer to the frames, valid until the next call
+    /// \param length receives the number of bytes in the block of frames (may be 0)
+    /// \return false when the input is exhausted
+    bool convert(const uint8_t *block, size_t size, bool more, const uint8_t *&frames, size_t &length);
+
+    /// \brief set the receive time used to widen compact hex and base64 frames
+    /// Compact (version 2) frames carry only the low bits of unixTime, completed from the time
+    /// the frame was received (see payloadDecoder::widenFrame()). ttn input uses received_at;
+    /// hex and base64 lines use this time. While it is 0 (the default), compact frames in hex and
+    /// base64 lines are rejected: the time of conversion can lie in another period of the time field.
+    /// \param receivedAt unix time, or 0 if not known
+    void set_receivedAt(uint32_t receivedAt) { _receivedAt = receivedAt; }
+
+    /// \brief true if reading stopped because of a read error
+    bool failed() const;
+
+    /// \brief number of text lines seen (0 for raw input)
+    uint64_t get_lines() const { return _lines; }
+
+    /// \brief number of text lines that did not hold exactly one frame
+    uint64_t get_rejectedLines() const { return _rejectedLines; }
+
+    /// \brief uplink fields of the frames returned by the last call to next() (ttn input only)
+    /// One entry per frame; the string views are valid until the next call.
+    const std::vector<ttnUplink> &get_uplinks() const { return _uplinks; }
+};
+
+#endif // FRAMEREADER_H
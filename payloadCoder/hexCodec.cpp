@@ -0,0 +1,265 @@
+#include "hexCodec.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HEX_CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    /// @brief Value of a hex digit, or 0xFF for any other character.
+    inline uint8_t hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return static_cast<uint8_t>(c - '0');
+        }
+        const char lower = static_cast<char>(c | 0x20);
+        if (lower >= 'a' && lower <= 'f')
+        {
+            return static_cast<uint8_t>(lower - 'a' + 10);
+        }
+        return 0xFF;
+    }
+
+    const char HEX_DIGITS[] = "0123456789ABCDEF"; ///< Digits used by binaryToHex()
+
+    typedef bool (*hexDecodeFn)(const char *in, size_t length, uint8_t *out);
+    typedef void (*hexEncodeFn)(const uint8_t *in, size_t length, char *out);
+
+    /// @brief Portable decoder; `length` is even.
+    bool hexToBinaryScalar(const char *in, size_t length, uint8_t *out)
+    {
+        uint8_t invalid = 0; // collects the 0xF0 bits of invalid digits instead of branching per byte
+        for (size_t i = 0; i < length / 2; i++)
+        {
+            const uint8_t hi = hexValue(in[2 * i]);
+            const uint8_t lo = hexValue(in[2 * i + 1]);
+            invalid |= (hi | lo) & 0xF0;
+            out[i] = static_cast<uint8_t>((hi << 4) | (lo & 0x0F));
+        }
+        return invalid == 0;
+    }
+
+    /// @brief Portable encoder.
+    void binaryToHexScalar(const uint8_t *in, size_t length, char *out)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            out[2 * i] = HEX_DIGITS[in[i] >> 4];
+            out[2 * i + 1] = HEX_DIGITS[in[i] & 0x0F];
+        }
+    }
+
+#ifdef HEX_CODEC_X86
+    /**
+     * The vector decoders classify every character as digit ('0'-'9') or letter ('a'-'f' after
+     * folding case with | 0x20) using unsigned range checks, turn it into its nibble value and
+     * combine each pair of nibbles with one multiply-add (hi * 16 + lo). Inputs that are not a
+     * multiple of the block size finish with one more block aligned to the end of the input,
+     * which overlaps the previous block and rewrites a few bytes with the same values. So
+     * there is no per-character tail loop for any input of 16 characters or more.
+     */
+
+    /// @brief Decode 16 characters into 8 bytes; returns a non-zero mask for invalid characters.
+    __attribute__((target("sse4.1"))) inline int hex16Sse41(const char *in, uint8_t *out)
+    {
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        const __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+        const __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        const __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+        const __m128i value = _mm_blendv_epi8(_mm_add_epi8(letter, _mm_set1_epi8(10)), digit, isDigit);
+        const __m128i pairs = _mm_maddubs_epi16(value, _mm_set1_epi16(0x0110));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(pairs, pairs));
+        return ~_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) & 0xFFFF;
+    }
+
+    /// @brief Decode 32 characters into 16 bytes; returns a non-zero mask for invalid characters.
+    __attribute__((target("avx2"))) inline int hex32Avx2(const char *in, uint8_t *out)
+    {
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+        const __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+        const __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        const __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+        const __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+        const __m256i value = _mm256_blendv_epi8(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), digit, isDigit);
+        const __m256i pairs = _mm256_maddubs_epi16(value, _mm256_set1_epi16(0x0110));
+        // packus works per 128-bit lane: bytes 0-7 land in qword 0, bytes 8-15 in qword 2
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, pairs), 0xD8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm256_castsi256_si128(packed));
+        return ~_mm256_movemask_epi8(_mm256_or_si256(isDigit, isLetter));
+    }
+
+    __attribute__((target("sse4.1"))) bool hexToBinarySse41(const char *in, size_t length, uint8_t *out)
+    {
+        if (length < 16)
+        {
+            return hexToBinaryScalar(in, length, out);
+        }
+        int invalid = 0;
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            invalid |= hex16Sse41(in + i, out + i / 2);
+        }
+        if (i < length)
+        {
+            invalid |= hex16Sse41(in + length - 16, out + (length - 16) / 2);
+        }
+        return invalid == 0;
+    }
+
+    __attribute__((target("avx2"))) bool hexToBinaryAvx2(const char *in, size_t length, uint8_t *out)
+    {
+        if (length < 32)
+        {
+            return hexToBinarySse41(in, length, out);
+        }
+        int invalid = 0;
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32)
+        {
+            invalid |= hex32Avx2(in + i, out + i / 2);
+        }
+        if (i < length)
+        {
+            invalid |= hex32Avx2(in + length - 32, out + (length - 32) / 2);
+        }
+        return invalid == 0;
+    }
+
+    /// @brief Encode 16 bytes into 32 characters.
+    __attribute__((target("sse4.1"))) inline void hex16EncodeSse41(const uint8_t *in, char *out)
+    {
+        const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i *>(HEX_DIGITS));
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        const __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(b, 4), nibble));
+        const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(b, nibble));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    /// @brief Encode 32 bytes into 64 characters.
+    __attribute__((target("avx2"))) inline void hex32EncodeAvx2(const uint8_t *in, char *out)
+    {
+        const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(HEX_DIGITS)));
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+        const __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(b, 4), nibble));
+        const __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(b, nibble));
+        const __m256i first = _mm256_unpacklo_epi8(hi, lo);  // bytes 0-7 | 16-23
+        const __m256i second = _mm256_unpackhi_epi8(hi, lo); // bytes 8-15 | 24-31
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+
+    __attribute__((target("sse4.1"))) void binaryToHexSse41(const uint8_t *in, size_t length, char *out)
+    {
+        if (length < 16)
+        {
+            binaryToHexScalar(in, length, out);
+            return;
+        }
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            hex16EncodeSse41(in + i, out + 2 * i);
+        }
+        if (i < length)
+        {
+            hex16EncodeSse41(in + length - 16, out + 2 * (length - 16));
+        }
+    }
+
+    __attribute__((target("avx2"))) void binaryToHexAvx2(const uint8_t *in, size_t length, char *out)
+    {
+        if (length < 32)
+        {
+            binaryToHexSse41(in, length, out);
+            return;
+        }
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32)
+        {
+            hex32EncodeAvx2(in + i, out + 2 * i);
+        }
+        if (i < length)
+        {
+            hex32EncodeAvx2(in + length - 32, out + 2 * (length - 32));
+        }
+    }
+#endif
+
+    /// @brief Decoder, encoder and name for one kernel.
+    struct hexEntry
+    {
+        hexDecodeFn decode;
+        hexEncodeFn encode;
+        const char *name;
+    };
+
+    hexEntry hexEntryFor(decodeKernel kernel)
+    {
+        switch (kernel)
+        {
+#ifdef HEX_CODEC_X86
+        case decodeKernel::avx2:
+            return hexEntry{hexToBinaryAvx2, binaryToHexAvx2, "avx2"};
+        case decodeKernel::sse41:
+            return hexEntry{hexToBinarySse41, binaryToHexSse41, "sse4.1"};
+#endif
+        default:
+            return hexEntry{hexToBinaryScalar, binaryToHexScalar, "scalar"};
+        }
+    }
+
+    decodeKernel bestHexKernel()
+    {
+        if (decodeKernelSupported(decodeKernel::avx2))
+        {
+            return decodeKernel::avx2;
+        }
+        if (decodeKernelSupported(decodeKernel::sse41))
+        {
+            return decodeKernel::sse41;
+        }
+        return decodeKernel::scalar;
+    }
+
+    hexEntry activeHex = hexEntryFor(bestHexKernel()); ///< Kernel used by hexToBinary() and binaryToHex()
+}
+
+bool hexToBinary(const char *in, size_t length, uint8_t *out)
+{
+    if (length % 2 != 0)
+    {
+        return false;
+    }
+    return activeHex.decode(in, length, out);
+}
+
+void binaryToHex(const uint8_t *in, size_t length, char *out)
+{
+    activeHex.encode(in, length, out);
+}
+
+bool selectHexKernel(decodeKernel kernel)
+{
+    if (kernel == decodeKernel::automatic)
+    {
+        kernel = bestHexKernel();
+    }
+    if (!decodeKernelSupported(kernel))
+    {
+        return false;
+    }
+    activeHex = hexEntryFor(kernel);
+    return true;
+}
+
+const char *activeHexKernelName()
+{
+    return activeHex.name;
+}
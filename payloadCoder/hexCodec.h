@@ -0,0 +1,42 @@
+/**
+ * @file hexCodec.h
+ * @brief Conversion between hexadecimal text and binary payload bytes.
+ *
+ * Used to read hex-encoded frames (gateway logs, database exports) and to print payloads.
+ * Both upper and lower case digits are accepted when decoding.
+ *
+ * Like the batch decode kernels, the conversion has scalar, SSE4.1 (16 characters per step) and
+ * AVX2 (32 characters per step) implementations; the best one for the CPU is picked at runtime.
+ */
+
+#ifndef HEXCODEC_H
+#define HEXCODEC_H
+
+#include <stdint.h> // uint8_t type
+#include <stddef.h> // size_t
+
+#include "decodeKernels.h" // decodeKernel
+
+/// \brief convert hex text to bytes
+/// \param in hex digits, two per byte, without separators
+/// \param length number of characters in `in` (must be even)
+/// \param out buffer receiving length / 2 bytes
+/// \return false if `length` is odd or `in` contains a non-hex character; `out` is then undefined
+bool hexToBinary(const char *in, size_t length, uint8_t *out);
+
+/// \brief convert bytes to hex text
+/// \param in bytes to convert
+/// \param length number of bytes in `in`
+/// \param out buffer receiving 2 * length upper case hex digits (not null-terminated)
+void binaryToHex(const uint8_t *in, size_t length, char *out);
+
+/// \brief select the implementation used by hexToBinary() and binaryToHex()
+/// \param kernel implementation to use; decodeKernel::automatic picks the best supported one
+/// \return false if the implementation is not supported on this CPU (selection is unchanged)
+bool selectHexKernel(decodeKernel kernel);
+
+/// \brief get the name of the selected implementation
+/// \return "scalar", "sse4.1" or "avx2"
+const char *activeHexKernelName();
+
+#endif // HEXCODEC_H
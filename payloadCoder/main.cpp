@@ -12,21 +12,1750 @@
  * The project consists of two classes: payloadEncoder and payloadDecoder. The payloadEncoder class
  * encodes variables into a single payload, and the payloadDecoder class decodes the payload back into
  * the original variables. The project also contains a unit test that tests the encoder and decoder classes.
+ *
+ * Usage:
+ * - `payloadCoder` runs the unit tests.
+ * - `payloadCoder decode [--input raw|hex|base64|ttn] [--output csv|json|binary|arrow] [--threads n]
+ *   [--io uring|pread|stdio] [--direct] [--memory] [--received-at t] [file]` decodes frames from `file`
+ *   (or stdin) and writes one record per frame to stdout; see streamDecode.h. With `--threads`, decoding
+ *   runs on a worker pool (see parallelDecode.h). A named file is read with several reads in flight (see
+ *   bulkReader.h). `--memory` reports the peak memory of each stage (see batchArena.h). Compact
+ *   (version 2) hex and base64 frames are only decoded with `--received-at`, the unix time that
+ *   completes their time field; archive, transitions, battery and bulkload take the same option.
+ * - `payloadCoder archive [--input raw|hex|base64|ttn] [--received-at t] segment [file]` stores frames in an archive
+ *   segment; see archiveSegment.h.
+ * - `payloadCoder history --id id [--output csv|json|binary|arrow] segment...` rebuilds the history of
+ *   one trap from archive segments.
+ * - `payloadCoder transitions [--input raw|hex|base64|ttn] [--received-at t] [--all] [--window s] [file]` writes only the
+ *   records in which a trap's door, catch or displacement state changed; see transitionExtractor.h.
+ *   With `--window`, records are first put back in time order (see uplinkOrder.h).
+ * - `payloadCoder battery [--input raw|hex|base64|ttn] [--received-at t] [--top n] [--shards n [--pin] [--busy-poll]] [file]`
+ *   fits the battery decline of every trap and lists the traps that run empty soonest; see
+ *   batteryTrend.h. With `--shards` the fits run on n threads, each owning a share of the traps
+ *   (see shardPipeline.h).
+ * - `payloadCoder dedup [--hold ms] [--remember ms] [--capacity n] [--bloom bits] [file]` passes TTN
+ *   uplinks through once per (devEui, fcnt), keeping the copy with the best rssi; see uplinkDedup.h.
+ * - `payloadCoder merge [--input raw|hex|base64|ttn] [--window s] [--archive segment] file...` merges
+ *   time-ordered inputs into one time-ordered stream in a single pass; see uplinkOrder.h.
+ * - `payloadCoder bulkload [--input raw|hex|base64|ttn] [--received-at t] [--dir d] [--prefix p] [--source name]
+ *   [--rows n] [--bytes n] [file]` writes rows for the muskrattrap table to rotating TSV files for LOAD DATA
+ *   INFILE and prints one LOAD DATA statement per completed file; see bulkLoadWriter.h.
+ * - `payloadCoder webhook [--address a] [--port p] [--threads n] [--token t] [--output csv|json|binary]`
+ *   receives TTN webhooks over HTTP and writes the decoded records to stdout until SIGINT or
+ *   SIGTERM; see webhookServer.h.
+ * - `payloadCoder post [--address a] [--port p] [--path p] [--connections n] [--depth n] [--requests n] [file]`
+ *   posts the TTN messages in `file` (or stdin) to a webhook server and reports the request rate.
+ * - `payloadCoder ingest [--input raw|hex|base64|ttn] [--output csv|json|binary] [--threads n] [--address a]
+ *   [--port p] [file...]` decodes files and TCP connections (default input ttn, one message per line)
+ *   concurrently on n event loops and writes the records to stdout; with `--port` it runs until
+ *   SIGINT or SIGTERM. Each input is one coroutine; see asyncIngest.h.
+ * - `payloadCoder generate [--traps n] [--seed s] [--seconds n | --count n] [--format raw|hex|base64|ttn]
+ *   [--rate r] [--door n] [--catch n] [--displacement n]` writes synthetic fleet traffic to stdout;
+ *   see fleetGenerator.h.
  */
 
+#include <algorithm> // std::min, std::max, std::sort
+#include <atomic>
+#include <chrono>   // std::chrono::steady_clock
+#include <errno.h>  // errno
+#include <memory>   // std::unique_ptr
+#include <mutex>    // std::mutex
+#include <signal.h> // signal
+#include <stdio.h>  // fopen, fprintf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+#include <string>
+#include <thread>   // std::this_thread::sleep_until
+#include <vector>
+
+#include "archiveSegment.h"
+#include "arrowWriter.h"
+#include "asyncIngest.h"
+#include "batteryTrend.h"
+#include "bulkLoadWriter.h"
+#include "bulkReader.h"
+
 #include "decoder.h"
 #include "encoder.h"
+#include "fleetGenerator.h"
+#include "shardPipeline.h"
+#include "streamDecode.h"
+#include "transitionExtractor.h"
+#include "uplinkDedup.h"
+#include "uplinkOrder.h"
 #include "unitTest.h"
+#include "webhookServer.h"
 
 using namespace std;
 
-int main()
+/// \brief print the command line usage to stderr
+static void printUsage()
+{
+    fprintf(stderr,
+            "usage: payloadCoder                 run the unit tests\n"
+            "       payloadCoder decode [--input raw|hex|base64|ttn] [--output csv|json|binary|arrow] [--threads n]\n"
+            "                           [--io uring|pread|stdio] [--direct] [--memory] [--received-at t] [file]\n"
+            "                                    decode frames from file (default stdin) to stdout,\n"
+            "                                    on n worker threads (0: one per hardware thread);\n"
+            "                                    --io: how a file is read (default uring, pread where\n"
+            "                                    io_uring is not available), --direct: bypass the page cache,\n"
+            "                                    --memory: report the peak memory of each stage,\n"
+            "                                    --received-at: unix time that completes compact hex and base64 frames\n"
+            "       payloadCoder archive [--input raw|hex|base64|ttn] [--received-at t] segment [file]\n"
+            "                                    store frames from file (default stdin) in a new segment\n"
+            "       payloadCoder history --id id [--output csv|json|binary|arrow] segment...\n"
+            "                                    decode all frames of one trap, ordered by time\n"
+            "       payloadCoder transitions [--input raw|hex|base64|ttn] [--received-at t] [--all] [--window s] [file]\n"
+            "                                    write door closed, catch and displacement events as csv\n"
+            "                                    (--all: also door opened and cleared flags;\n"
+            "                                    --window: first reorder records arriving up to s seconds late)\n"
+            "       payloadCoder battery [--input raw|hex|base64|ttn] [--received-at t] [--top n] [--shards n [--pin] [--busy-poll]] [file]\n"
+            "                                    list the n traps (default 20) whose battery runs empty soonest\n"
+            "                                    (--shards: fit on n threads (0: one per core), split by trap)\n"
+            "       payloadCoder dedup [--hold ms] [--remember ms] [--capacity n] [--bloom bits] [file]\n"
+            "                                    write each TTN uplink once, merging copies from several gateways\n"
+            "       payloadCoder merge [--input raw|hex|base64|ttn] [--window s] [--archive segment] file...\n"
+            "                                    merge time-ordered files and archive segments into one\n"
+            "                                    time-ordered stream of raw frames (or a new segment)\n"
+            "       payloadCoder bulkload [--input raw|hex|base64|ttn] [--received-at t] [--dir d] [--prefix p] [--source name]\n"
+            "                             [--rows n] [--bytes n] [file]\n"
+            "                                    write muskrattrap rows to rotating TSV files in d and print a\n"
+            "                                    LOAD DATA statement for each completed file\n"
+            "       payloadCoder webhook [--address a] [--port p] [--threads n] [--token t] [--output csv|json|binary]\n"
+            "                                    receive TTN webhooks on port p (default 8080) and write the decoded\n"
+            "                                    records to stdout; t is the required Authorization header\n"
+            "       payloadCoder post [--address a] [--port p] [--path p] [--connections n] [--depth n] [--requests n] [file]\n"
+            "                                    post each TTN message of file (default stdin) to a webhook server,\n"
+            "                                    n requests in flight per connection, and report the request rate\n"
+            "       payloadCoder ingest [--input raw|hex|base64|ttn] [--output csv|json|binary] [--threads n]\n"
+            "                           [--address a] [--port p] [file...]\n"
+            "                                    decode the files and every connection to port p (default input ttn)\n"
+            "                                    concurrently on n event loops (default 1) and write the records to stdout\n"
+            "       payloadCoder generate [--traps n] [--seed s] [--seconds n | --count n] [--format raw|hex|base64|ttn]\n"
+            "                             [--rate r] [--door n] [--catch n] [--displacement n]\n"
+            "                                    write uplinks of a simulated fleet to stdout, r uplinks per\n"
+            "                                    second (default as fast as possible); event rates per trap per day\n");
+}
+
+/// \brief run the decode command
+/// \param argc number of arguments after "decode"
+/// \param argv arguments after "decode"
+/// \return process exit code
+static int runDecode(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::raw;
+    uint32_t receivedAt = 0;
+    outputFormat output = outputFormat::csv;
+    bool arrow = false;
+    const char *path = nullptr;
+    bool parallel = false;
+    unsigned threads = 0;
+    bool stdio = false;
+    bool memoryReport = false;
+    bulkReadConfig bulk;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--received-at") == 0 && i + 1 < argc)
+        {
+            receivedAt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+            parallel = true;
+        }
+        else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc)
+        {
+            i++;
+            stdio = strcmp(argv[i], "stdio") == 0;
+            bulk.uring = strcmp(argv[i], "uring") == 0;
+            if (!stdio && !bulk.uring && strcmp(argv[i], "pread") != 0)
+            {
+                fprintf(stderr, "payloadCoder: unknown io method '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--direct") == 0)
+        {
+            bulk.direct = true;
+        }
+        else if (strcmp(argv[i], "--memory") == 0)
+        {
+            memoryReport = true;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            arrow = strcmp(argv[++i], "arrow") == 0;
+            if (!arrow && !parseOutputFormat(argv[i], output))
+            {
+                fprintf(stderr, "payloadCoder: unknown output format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    /** Named files go through the bulk reader; stdin (often a pipe) and --io stdio through stdio. */
+    FILE *in = stdin;
+    const bool named = path != nullptr && strcmp(path, "-") != 0;
+    if (parallel)
+    {
+        bulk.bufferSize = 16 << 20; // larger blocks keep the workers busy between buffers
+        bulk.buffers = 4;
+    }
+    bulkReader source(bulk);
+    trackingResource readMemory;
+    trackingResource decodeMemory;
+    trackingResource formatMemory;
+    streamMemory memory;
+    if (memoryReport)
+    {
+        memory.input = &readMemory;
+        memory.batches = &decodeMemory;
+        memory.output = &formatMemory;
+    }
+    std::unique_ptr<frameReader> reader;
+    if (named && stdio)
+    {
+        in = fopen(path, "rb");
+    }
+    else if (named && source.open(path))
+    {
+        reader.reset(new frameReader(source, input, 1 << 20, memory.input));
+        reader->set_receivedAt(receivedAt);
+    }
+    if (in == nullptr || (named && in == stdin && !reader))
+    {
+        fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+        return 1;
+    }
+
+    std::unique_ptr<parallelDecoder> pool;
+    if (parallel)
+    {
+        pool.reset(new parallelDecoder(threads));
+    }
+
+    streamStats stats;
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = false;
+    if (reader)
+    {
+        ok = arrow ? streamDecodeArrow(*reader, stdout, stats, pool.get(), memory)
+                   : streamDecode(*reader, stdout, output, stats, pool.get(), memory);
+    }
+    else
+    {
+        ok = arrow ? streamDecodeArrow(in, input, stdout, stats, pool.get(), memory, receivedAt)
+                   : streamDecode(in, input, stdout, output, stats, pool.get(), memory, receivedAt);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+
+    if (pool)
+    {
+        /** Per worker throughput; "busy" excludes time spent waiting for input or for the writer. */
+        fprintf(stderr, "worker   chunks   stolen       frames  busy s   Mframes/s  MB/s (busy)\n");
+        for (size_t i = 0; i < pool->reports().size(); i++)
+        {
+            const workerReport &r = pool->reports()[i];
+            const double busy = r.busySeconds > 0 ? r.busySeconds : 1e-9;
+            fprintf(stderr, "%6zu %8llu %8llu %12llu %7.3f %11.2f %11.1f\n", i,
+                    static_cast<unsigned long long>(r.chunks), static_cast<unsigned long long>(r.stolen),
+                    static_cast<unsigned long long>(r.frames), r.busySeconds,
+                    static_cast<double>(r.frames) / busy / 1e6, static_cast<double>(r.bytes) / busy / 1e6);
+        }
+        fprintf(stderr, "payloadCoder: %u threads, %.3f s wall, %.2f Mframes/s\n", pool->get_threads(), seconds,
+                static_cast<double>(stats.frames) / (seconds > 0 ? seconds : 1e-9) / 1e6);
+    }
+
+    fprintf(stderr, "payloadCoder: %llu frames, %llu decoded, %llu rejected, %llu bad lines\n",
+            static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.rows),
+            static_cast<unsigned long long>(stats.rejectedFrames), static_cast<unsigned long long>(stats.rejectedLines));
+    if (memoryReport)
+    {
+        /** Allocations that do not grow with the input mean the stages run without the heap. */
+        fprintf(stderr, "payloadCoder: peak bytes: read %zu (%llu allocations), decode %zu per chunk in %zu (%llu allocations), "
+                        "format %zu (%llu allocations)\n",
+                readMemory.get_peak(), static_cast<unsigned long long>(readMemory.get_allocations()), stats.batchBytes,
+                decodeMemory.get_peak(), static_cast<unsigned long long>(decodeMemory.get_allocations()),
+                formatMemory.get_peak(), static_cast<unsigned long long>(formatMemory.get_allocations()));
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "payloadCoder: read or write error\n");
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief run the archive command
+/// \param argc number of arguments after "archive"
+/// \param argv arguments after "archive"
+/// \return process exit code
+static int runArchive(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::raw;
+    uint32_t receivedAt = 0;
+    const char *segmentPath = nullptr;
+    const char *path = nullptr;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--received-at") == 0 && i + 1 < argc)
+        {
+            receivedAt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argv[i][0] != '-' && segmentPath == nullptr)
+        {
+            segmentPath = argv[i];
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (segmentPath == nullptr)
+    {
+        printUsage();
+        return 2;
+    }
+
+    FILE *in = stdin;
+    if (path != nullptr && strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    segmentWriter writer;
+    if (!writer.create(segmentPath))
+    {
+        fprintf(stderr, "payloadCoder: cannot create '%s'\n", segmentPath);
+        if (in != stdin)
+        {
+            fclose(in);
+        }
+        return 1;
+    }
+
+    frameReader reader(in, input);
+    reader.set_receivedAt(receivedAt);
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    bool ok = true;
+    while (ok && reader.next(frames, length))
+    {
+        const std::vector<ttnUplink> &uplinks = reader.get_uplinks();
+        for (size_t offset = 0; ok && offset + SENSOR_PAYLOAD_SIZE <= length; offset += SENSOR_PAYLOAD_SIZE)
+        {
+            const uint8_t *frame = frames + offset;
+            ok = writer.append(frame, uplinkMetaOf(frame, uplinks.empty() ? nullptr : &uplinks[offset / SENSOR_PAYLOAD_SIZE]));
+        }
+    }
+    const size_t records = writer.size();
+    ok = writer.close() && ok && !reader.failed();
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+
+    fprintf(stderr, "payloadCoder: %zu frames archived, %llu bad lines\n",
+            records, static_cast<unsigned long long>(reader.get_rejectedLines()));
+    if (!ok)
+    {
+        fprintf(stderr, "payloadCoder: read or write error\n");
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief run the history command
+/// \param argc number of arguments after "history"
+/// \param argv arguments after "history"
+/// \return process exit code
+static int runHistory(int argc, char *argv[])
+{
+    outputFormat output = outputFormat::csv;
+    bool arrow = false;
+    bool haveId = false;
+    uint32_t id = 0;
+    std::vector<const char *> paths;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--id") == 0 && i + 1 < argc)
+        {
+            id = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+            haveId = true;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            arrow = strcmp(argv[++i], "arrow") == 0;
+            if (!arrow && !parseOutputFormat(argv[i], output))
+            {
+                fprintf(stderr, "payloadCoder: unknown output format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (argv[i][0] != '-')
+        {
+            paths.push_back(argv[i]);
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (!haveId || paths.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<segmentReader> segments(paths.size());
+    std::vector<const segmentReader *> readers;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!segments[i].open(paths[i]))
+        {
+            fprintf(stderr, "payloadCoder: '%s' is not an archive segment\n", paths[i]);
+            return 1;
+        }
+        if (!segments[i].sealed())
+        {
+            fprintf(stderr, "payloadCoder: '%s' is not sealed, scanning all records\n", paths[i]);
+        }
+        readers.push_back(&segments[i]);
+    }
+
+    payloadBatch batch;
+    trapHistory(readers.data(), readers.size(), id, batch);
+    bool ok = true;
+    if (arrow)
+    {
+        arrowWriter writer(stdout);
+        writer.write(batch);
+        ok = writer.close();
+    }
+    else
+    {
+        recordWriter writer(stdout, output);
+        writer.write(batch);
+        ok = writer.flush();
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "payloadCoder: %zu records for trap %lu from %zu segments in %.3f ms\n",
+            batch.size(), static_cast<unsigned long>(id), segments.size(), ms);
+    return ok ? 0 : 1;
+}
+
+/// \brief run the transitions command
+/// \param argc number of arguments after "transitions"
+/// \param argv arguments after "transitions"
+/// \return process exit code
+static int runTransitions(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::raw;
+    uint32_t receivedAt = 0;
+    uint8_t kinds = DEFAULT_TRANSITIONS;
+    const char *path = nullptr;
+    bool reorder = false;
+    reorderConfig window;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--received-at") == 0 && i + 1 < argc)
+        {
+            receivedAt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--all") == 0)
+        {
+            kinds = ALL_TRANSITIONS;
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc)
+        {
+            window.windowSeconds = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            reorder = true;
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    FILE *in = stdin;
+    if (path != nullptr && strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    frameReader reader(in, input);
+    reader.set_receivedAt(receivedAt);
+    transitionExtractor extractor(kinds);
+    std::vector<trapTransition> transitions;
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    uint64_t events = 0;
+    bool ok = fputs("id,event,unixTime,previousSince,previousLast\n", stdout) >= 0;
+    const auto process = [&](const uint8_t *block, size_t size)
+    {
+        transitions.clear();
+        extractor.process(block, size, transitions);
+        for (const trapTransition &t : transitions)
+        {
+            ok = ok && fprintf(stdout, "%lu,%s,%lu,%lu,%lu\n", static_cast<unsigned long>(t.id), transitionName(t.kind),
+                               static_cast<unsigned long>(t.unixTime), static_cast<unsigned long>(t.previousSince),
+                               static_cast<unsigned long>(t.previousLast)) > 0;
+        }
+        events += transitions.size();
+    };
+
+    /** With --window, records pass a reorder buffer first so that the extractor sees them in payload time order. */
+    reorderBuffer buffer(window);
+    std::vector<archiveRecord> records;
+    std::vector<archiveRecord> ordered;
+    std::vector<uint8_t> orderedFrames;
+    const auto processOrdered = [&]()
+    {
+        orderedFrames.resize(ordered.size() * SENSOR_PAYLOAD_SIZE);
+        for (size_t i = 0; i < ordered.size(); i++)
+        {
+            memcpy(orderedFrames.data() + i * SENSOR_PAYLOAD_SIZE, ordered[i].frame, SENSOR_PAYLOAD_SIZE);
+        }
+        process(orderedFrames.data(), orderedFrames.size());
+        ordered.clear();
+    };
+    while (ok && reader.next(frames, length))
+    {
+        if (!reorder)
+        {
+            process(frames, length);
+            continue;
+        }
+        records.clear();
+        appendArchiveRecords(frames, length, reader.get_uplinks(), records);
+        for (const archiveRecord &record : records)
+        {
+            buffer.push(record, ordered);
+        }
+        processOrdered();
+    }
+    buffer.flush(ordered);
+    processOrdered();
+    ok = fflush(stdout) == 0 && ok && !reader.failed();
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+
+    fprintf(stderr, "payloadCoder: %llu records from %zu traps, %llu transitions, %llu late, %llu rejected, %llu bad lines\n",
+            static_cast<unsigned long long>(extractor.get_records()), extractor.get_traps(),
+            static_cast<unsigned long long>(events), static_cast<unsigned long long>(extractor.get_lateRecords()),
+            static_cast<unsigned long long>(extractor.get_rejectedFrames()),
+            static_cast<unsigned long long>(reader.get_rejectedLines()));
+    if (reorder)
+    {
+        fprintf(stderr, "payloadCoder: reorder window %lu s, %llu records out of order beyond it, %llu released early, %zu held at most\n",
+                static_cast<unsigned long>(window.windowSeconds), static_cast<unsigned long long>(buffer.get_stats().late),
+                static_cast<unsigned long long>(buffer.get_stats().forced), buffer.get_stats().maxHeld);
+    }
+    return ok ? 0 : 1;
+}
+
+/// \brief run the battery command
+/// \param argc number of arguments after "battery"
+/// \param argv arguments after "battery"
+/// \return process exit code
+static int runBattery(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::raw;
+    uint32_t receivedAt = 0;
+    size_t top = 20;
+    shardConfig shards;
+    bool sharded = false;
+    const char *path = nullptr;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--received-at") == 0 && i + 1 < argc)
+        {
+            receivedAt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+        {
+            top = static_cast<size_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+        {
+            shards.shards = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+            sharded = true;
+        }
+        else if (strcmp(argv[i], "--pin") == 0)
+        {
+            shards.pin = true;
+        }
+        else if (strcmp(argv[i], "--busy-poll") == 0)
+        {
+            shards.busyPoll = true;
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    FILE *in = stdin;
+    if (path != nullptr && strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    frameReader reader(in, input);
+    reader.set_receivedAt(receivedAt);
+    std::vector<std::unique_ptr<batteryTrendTracker>> trackers;
+    payloadBatch batch;
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    if (sharded)
+    {
+        /** The reading thread decodes; every shard fits its own traps, so no tracker is shared. */
+        shardPipeline pipeline(shards, [&trackers](unsigned shard, const payloadBatch &rows)
+                               { trackers[shard]->update(rows); });
+        /** The shards reach the trackers only through pushed batches, so filling them in now is safe. */
+        for (unsigned s = 0; s < pipeline.get_shards(); s++)
+        {
+            trackers.emplace_back(new batteryTrendTracker());
+        }
+        while (reader.next(frames, length))
+        {
+            batch.clear();
+            payloadDecoder::decodeBatch(frames, length, batch);
+            pipeline.push(0, batch);
+        }
+        pipeline.flush(0);
+        pipeline.close();
+        fprintf(stderr, "payloadCoder: %u shards, %llu waits for a shard\n", pipeline.get_shards(),
+                static_cast<unsigned long long>(pipeline.get_waits()));
+    }
+    else
+    {
+        trackers.emplace_back(new batteryTrendTracker());
+        while (reader.next(frames, length))
+        {
+            batch.clear();
+            payloadDecoder::decodeBatch(frames, length, batch);
+            trackers[0]->update(batch);
+        }
+    }
+    const bool readOk = !reader.failed();
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+
+    /** Every trap lives in one tracker, so the overall top n is among the top n of each. */
+    std::vector<batteryForecast> due;
+    std::vector<batteryForecast> part;
+    uint64_t records = 0;
+    size_t traps = 0;
+    uint64_t replacements = 0;
+    for (const std::unique_ptr<batteryTrendTracker> &tracker : trackers)
+    {
+        tracker->dueForService(top, part);
+        due.insert(due.end(), part.begin(), part.end());
+        records += tracker->get_records();
+        traps += tracker->get_traps();
+        replacements += tracker->get_replacements();
+    }
+    std::sort(due.begin(), due.end(), [](const batteryForecast &a, const batteryForecast &b)
+              { return a.daysToEmpty != b.daysToEmpty ? a.daysToEmpty < b.daysToEmpty : a.id < b.id; });
+    due.resize(std::min(top, due.size()));
+    bool ok = fputs("id,battery,level,slopePerDay,daysToEmpty,lastTime\n", stdout) >= 0;
+    for (const batteryForecast &f : due)
+    {
+        ok = ok && fprintf(stdout, "%lu,%u,%.1f,%.3f,%.1f,%lu\n", static_cast<unsigned long>(f.id), f.battery, f.level,
+                           f.slopePerDay, f.daysToEmpty, static_cast<unsigned long>(f.lastTime)) > 0;
+    }
+    ok = fflush(stdout) == 0 && ok && readOk;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "payloadCoder: %llu records from %zu traps, %llu battery swaps, %.3f s\n",
+            static_cast<unsigned long long>(records), traps, static_cast<unsigned long long>(replacements), seconds);
+    return ok ? 0 : 1;
+}
+
+/// \brief run the dedup command
+/// \param argc number of arguments after "dedup"
+/// \param argv arguments after "dedup"
+/// \return process exit code
+static int runDedup(int argc, char *argv[])
+{
+    dedupConfig config;
+    const char *path = nullptr;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--hold") == 0 && i + 1 < argc)
+        {
+            config.holdMs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--remember") == 0 && i + 1 < argc)
+        {
+            config.rememberMs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc)
+        {
+            config.capacity = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--bloom") == 0 && i + 1 < argc)
+        {
+            config.bloomBits = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (config.capacity == 0)
+    {
+        printUsage();
+        return 2;
+    }
+
+    FILE *in = stdin;
+    if (path != nullptr && strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    frameReader reader(in, inputFormat::ttn);
+    uplinkDeduplicator dedup(config);
+    std::vector<uplinkRecord> released;
+    std::string out;
+    uplinkRecord record;
+    uint64_t skipped = 0;
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    bool ok = true;
+    while (ok && reader.next(frames, length))
+    {
+        for (const ttnUplink &uplink : reader.get_uplinks())
+        {
+            if (uplinkRecordFromTtn(uplink, record))
+            {
+                dedup.offer(record, released);
+            }
+            else
+            {
+                skipped++;
+            }
+        }
+        out.clear();
+        for (const uplinkRecord &r : released)
+        {
+            appendTtnUplink(r, out);
+        }
+        released.clear();
+        ok = fwrite(out.data(), 1, out.size(), stdout) == out.size();
+    }
+    dedup.flush(released);
+    out.clear();
+    for (const uplinkRecord &r : released)
+    {
+        appendTtnUplink(r, out);
+    }
+    ok = ok && fwrite(out.data(), 1, out.size(), stdout) == out.size();
+    ok = fflush(stdout) == 0 && ok && !reader.failed();
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const dedupStats &stats = dedup.get_stats();
+    fprintf(stderr, "payloadCoder: %llu copies, %llu uplinks written, %llu merged, %llu late, %llu released early, "
+                    "%llu without DevEUI, %llu bad lines, %.3f s\n",
+            static_cast<unsigned long long>(stats.copies), static_cast<unsigned long long>(stats.released),
+            static_cast<unsigned long long>(stats.merged), static_cast<unsigned long long>(stats.late),
+            static_cast<unsigned long long>(stats.evicted), static_cast<unsigned long long>(skipped),
+            static_cast<unsigned long long>(reader.get_rejectedLines()), seconds);
+    return ok ? 0 : 1;
+}
+
+/// \brief run the merge command
+/// \param argc number of arguments after "merge"
+/// \param argv arguments after "merge"
+/// \return process exit code
+static int runMerge(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::raw;
+    const char *segmentPath = nullptr;
+    bool reorder = false;
+    reorderConfig window;
+    std::vector<const char *> paths;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc)
+        {
+            window.windowSeconds = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            reorder = true;
+        }
+        else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+        {
+            segmentPath = argv[++i];
+        }
+        else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0)
+        {
+            paths.push_back(argv[i]);
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (paths.empty())
+    {
+        paths.push_back("-");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    uplinkMerger merger;
+    for (const char *path : paths)
+    {
+        if (strcmp(path, "-") == 0)
+        {
+            merger.add(stdin, input);
+        }
+        else if (!merger.add(path, input))
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    segmentWriter writer;
+    if (segmentPath != nullptr && !writer.create(segmentPath))
+    {
+        fprintf(stderr, "payloadCoder: cannot create '%s'\n", segmentPath);
+        return 1;
+    }
+
+    /** Raw frames on stdout feed straight into the other commands; an archive segment also keeps the metadata. */
+    reorderBuffer buffer(window);
+    std::vector<archiveRecord> merged;
+    std::vector<archiveRecord> ordered;
+    std::vector<uint8_t> out;
+    bool ok = true;
+    const auto write = [&](const std::vector<archiveRecord> &records)
+    {
+        if (segmentPath != nullptr)
+        {
+            for (size_t i = 0; ok && i < records.size(); i++)
+            {
+                ok = writer.append(records[i]);
+            }
+            return;
+        }
+        out.resize(records.size() * SENSOR_PAYLOAD_SIZE);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            memcpy(out.data() + i * SENSOR_PAYLOAD_SIZE, records[i].frame, SENSOR_PAYLOAD_SIZE);
+        }
+        ok = ok && fwrite(out.data(), 1, out.size(), stdout) == out.size();
+    };
+    while (ok && merger.next(merged, 64 * 1024) != 0)
+    {
+        if (reorder)
+        {
+            for (const archiveRecord &record : merged)
+            {
+                buffer.push(record, ordered);
+            }
+            write(ordered);
+            ordered.clear();
+        }
+        else
+        {
+            write(merged);
+        }
+        merged.clear();
+    }
+    buffer.flush(ordered);
+    write(ordered);
+    ok = (segmentPath != nullptr ? writer.close() : fflush(stdout) == 0) && ok && !merger.failed();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "payloadCoder: %llu records from %zu inputs, %llu out of order within their input, %llu bad lines, %.3f s\n",
+            static_cast<unsigned long long>(merger.get_records()), merger.inputs(),
+            static_cast<unsigned long long>(merger.get_unsorted()),
+            static_cast<unsigned long long>(merger.get_rejectedLines()), seconds);
+    if (reorder)
+    {
+        fprintf(stderr, "payloadCoder: reorder window %lu s, %llu records out of order beyond it, %llu released early, %zu held at most\n",
+                static_cast<unsigned long>(window.windowSeconds), static_cast<unsigned long long>(buffer.get_stats().late),
+                static_cast<unsigned long long>(buffer.get_stats().forced), buffer.get_stats().maxHeld);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "payloadCoder: read or write error\n");
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief run the bulkload command
+/// \param argc number of arguments after "bulkload"
+/// \param argv arguments after "bulkload"
+/// \return process exit code
+static int runBulkLoad(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::raw;
+    uint32_t receivedAt = 0;
+    bulkLoadConfig config;
+    const char *path = nullptr;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--received-at") == 0 && i + 1 < argc)
+        {
+            receivedAt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+        {
+            config.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--prefix") == 0 && i + 1 < argc)
+        {
+            config.prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--source") == 0 && i + 1 < argc)
+        {
+            config.messageSource = argv[++i];
+        }
+        else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+        {
+            config.maxRows = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc)
+        {
+            config.maxBytes = static_cast<size_t>(strtoull(argv[++i], nullptr, 10));
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    FILE *in = stdin;
+    if (path != nullptr && strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    /** Each completed file is announced on stdout as a LOAD DATA statement, ready to pipe into the mariadb client. */
+    const auto start = std::chrono::steady_clock::now();
+    frameReader reader(in, input);
+    reader.set_receivedAt(receivedAt);
+    bulkLoadWriter writer(config);
+    payloadBatch batch;
+    std::vector<bulkLoadFile> completed;
+    uint64_t rejected = 0;
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    bool ok = true;
+    const auto announce = [&]()
+    {
+        completed.clear();
+        writer.takeCompleted(completed);
+        for (const bulkLoadFile &file : completed)
+        {
+            ok = ok && fputs(bulkLoadStatement(file.path).c_str(), stdout) >= 0 && fflush(stdout) == 0;
+        }
+    };
+    while (ok && reader.next(frames, length))
+    {
+        batch.clear();
+        payloadDecoder::decodeBatch(frames, length, batch);
+        rejected += batch.errors.size();
+        ok = writer.write(batch, reader.get_uplinks());
+        announce();
+    }
+    ok = writer.close() && ok && !reader.failed();
+    announce();
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "payloadCoder: %llu rows written, %llu frames rejected, %llu bad lines, %.3f s\n",
+            static_cast<unsigned long long>(writer.get_rows()), static_cast<unsigned long long>(rejected),
+            static_cast<unsigned long long>(reader.get_rejectedLines()), seconds);
+    if (!ok)
+    {
+        fprintf(stderr, "payloadCoder: read or write error\n");
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief server stopped by stopWebhook(), set while runWebhook() waits for it
+static webhookServer *runningWebhook = nullptr;
+
+/// \brief SIGINT and SIGTERM handler of the webhook command
+static void stopWebhook(int)
+{
+    if (runningWebhook != nullptr)
+    {
+        runningWebhook->stop();
+    }
+}
+
+/// \brief run the webhook command
+/// \param argc number of arguments after "webhook"
+/// \param argv arguments after "webhook"
+/// \return process exit code
+static int runWebhook(int argc, char *argv[])
+{
+    webhookConfig config;
+    outputFormat output = outputFormat::csv;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--address") == 0 && i + 1 < argc)
+        {
+            config.address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            config.port = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            config.threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--token") == 0 && i + 1 < argc)
+        {
+            config.authorization = argv[++i];
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            if (!parseOutputFormat(argv[++i], output))
+            {
+                fprintf(stderr, "payloadCoder: unknown output format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    /** The loops share stdout; each round's records are written and flushed under the lock. */
+    std::mutex lock;
+    recordWriter writer(stdout, output);
+    bool ok = true;
+    webhookServer server(config, [&](unsigned, const payloadBatch &batch, const std::vector<uplinkRecord> &)
+                         {
+                             std::lock_guard<std::mutex> guard(lock);
+                             writer.write(batch);
+                             ok = writer.flush() && ok;
+                         });
+    if (!server.start())
+    {
+        fprintf(stderr, "payloadCoder: cannot listen on %s:%u: %s\n", config.address.c_str(), config.port, strerror(errno));
+        return 1;
+    }
+    runningWebhook = &server;
+    signal(SIGINT, stopWebhook);
+    signal(SIGTERM, stopWebhook);
+    fprintf(stderr, "payloadCoder: listening on %s:%u\n", config.address.c_str(), server.get_port());
+    const auto start = std::chrono::steady_clock::now();
+    server.wait();
+    runningWebhook = nullptr;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const webhookStats stats = server.get_stats();
+    fprintf(stderr, "payloadCoder: %llu connections, %llu requests, %llu uplinks in %llu batches, %llu ignored, %llu rejected, %.1f s\n",
+            static_cast<unsigned long long>(stats.connections), static_cast<unsigned long long>(stats.requests),
+            static_cast<unsigned long long>(stats.uplinks), static_cast<unsigned long long>(stats.batches),
+            static_cast<unsigned long long>(stats.ignored), static_cast<unsigned long long>(stats.rejected), seconds);
+    if (!ok)
+    {
+        fprintf(stderr, "payloadCoder: write error\n");
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief run the post command
+/// \param argc number of arguments after "post"
+/// \param argv arguments after "post"
+/// \return process exit code
+static int runPost(int argc, char *argv[])
+{
+    webhookLoadConfig config;
+    const char *path = nullptr;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--address") == 0 && i + 1 < argc)
+        {
+            config.address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            config.port = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+        {
+            config.path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc)
+        {
+            config.connections = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+        {
+            config.depth = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+        {
+            config.requests = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (argv[i][0] != '-' && path == nullptr)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+
+    FILE *in = stdin;
+    if (path != nullptr && strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "rb");
+        if (in == nullptr)
+        {
+            fprintf(stderr, "payloadCoder: cannot open '%s'\n", path);
+            return 1;
+        }
+    }
+
+    /** The messages are read up front, so the run measures the server and not the input. */
+    std::string text;
+    char chunk[1 << 16];
+    size_t n = 0;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    {
+        text.append(chunk, n);
+    }
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    std::vector<std::string_view> messages;
+    for (size_t begin = 0; begin < text.size();)
+    {
+        size_t end = text.find('\n', begin);
+        end = end == std::string::npos ? text.size() : end;
+        if (end > begin)
+        {
+            messages.emplace_back(text.data() + begin, end - begin);
+        }
+        begin = end + 1;
+    }
+
+    webhookLoadResult result;
+    const bool ok = runWebhookLoad(config, messages, result);
+    fprintf(stderr, "payloadCoder: %llu requests, %llu responses, %llu ok, %.3f s (%.0f requests/s)\n",
+            static_cast<unsigned long long>(result.requests), static_cast<unsigned long long>(result.responses),
+            static_cast<unsigned long long>(result.ok), result.seconds,
+            static_cast<double>(result.responses) / (result.seconds > 0 ? result.seconds : 1e-9));
+    if (!ok)
+    {
+        fprintf(stderr, "payloadCoder: connection to %s:%u failed or closed early\n", config.address.c_str(), config.port);
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief counters of the ingest command, shared by all flows
+struct ingestCounters
+{
+    std::atomic<uint64_t> sources{0};        ///< Sources read to the end
+    std::atomic<uint64_t> frames{0};         ///< Frames decoded
+    std::atomic<uint64_t> rows{0};           ///< Rows written
+    std::atomic<uint64_t> rejectedFrames{0}; ///< Frames the decoder rejected
+    std::atomic<uint64_t> rejectedLines{0};  ///< Text lines without one frame
+    std::atomic<uint64_t> failed{0};         ///< Sources that ended with a read error
+};
+
+/// \brief decode one source into the sink
+/// \param source opened source, owned by the flow
+/// \param sink shared output
+/// \param counters shared counters
+static task<void> ingestSource(std::unique_ptr<asyncSource> source, asyncSink *sink, ingestCounters *counters)
+{
+    payloadBatch batch;
+    uint64_t rows = 0;
+    uint64_t rejected = 0;
+    while (co_await source->nextBatch(batch))
+    {
+        rows += batch.size();
+        rejected += batch.errors.size();
+        if (!co_await sink->write(batch))
+        {
+            break;
+        }
+    }
+    counters->sources++;
+    counters->frames += source->get_frames();
+    counters->rows += rows;
+    counters->rejectedFrames += rejected;
+    counters->rejectedLines += source->get_rejectedLines();
+    counters->failed += source->failed() ? 1 : 0;
+}
+
+/// \brief accept connections and start a flow for each, on the listener's loop
+/// \param executor executor running the flows
+/// \param listener listening socket of this loop
+/// \param input format sent over the connections
+/// \param sink shared output
+/// \param counters shared counters
+static task<void> ingestConnections(asyncExecutor *executor, asyncListener *listener, inputFormat input, asyncSink *sink,
+                                    ingestCounters *counters)
+{
+    for (;;)
+    {
+        const int fd = co_await listener->accept();
+        if (fd < 0)
+        {
+            if (errno != EMFILE && errno != ENFILE)
+            {
+                co_return;
+            }
+            co_await asyncExecutor::yield(); // out of descriptors until connections close
+            continue;
+        }
+        std::unique_ptr<asyncSource> source(new asyncSource(input));
+        if (source->open(fd))
+        {
+            executor->spawn(ingestSource(std::move(source), sink, counters));
+        }
+    }
+}
+
+/// \brief executor stopped by stopIngest(), set while runIngest() waits for it
+static asyncExecutor *runningIngest = nullptr;
+
+/// \brief SIGINT and SIGTERM handler of the ingest command
+static void stopIngest(int)
+{
+    if (runningIngest != nullptr)
+    {
+        runningIngest->stop();
+    }
+}
+
+/// \brief run the ingest command
+/// \param argc number of arguments after "ingest"
+/// \param argv arguments after "ingest"
+/// \return process exit code
+static int runIngest(int argc, char *argv[])
+{
+    inputFormat input = inputFormat::ttn;
+    outputFormat output = outputFormat::csv;
+    unsigned threads = 1;
+    std::string address = "0.0.0.0";
+    bool listen = false;
+    uint16_t port = 0;
+    std::vector<const char *> paths;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], input))
+            {
+                fprintf(stderr, "payloadCoder: unknown input format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            if (!parseOutputFormat(argv[++i], output))
+            {
+                fprintf(stderr, "payloadCoder: unknown output format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--address") == 0 && i + 1 < argc)
+        {
+            address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            port = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+            listen = true;
+        }
+        else if (argv[i][0] != '-')
+        {
+            paths.push_back(argv[i]);
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (!listen && paths.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    asyncExecutor executor(threads);
+    asyncSink sink(1, output);
+    ingestCounters counters;
+
+    /** One listener per loop on the same port; the kernel spreads the connections over them. */
+    std::vector<std::unique_ptr<asyncListener>> listeners;
+    for (unsigned i = 0; listen && i < executor.get_threads(); i++)
+    {
+        listeners.emplace_back(new asyncListener());
+        if (!listeners.back()->listen(address, i == 0 ? port : listeners.front()->get_port()))
+        {
+            fprintf(stderr, "payloadCoder: cannot listen on %s:%u: %s\n", address.c_str(), port, strerror(errno));
+            return 1;
+        }
+        executor.spawn(i, ingestConnections(&executor, listeners.back().get(), input, &sink, &counters));
+    }
+    for (const char *path : paths)
+    {
+        std::unique_ptr<asyncSource> source(new asyncSource(input));
+        if (!source->open(path))
+        {
+            fprintf(stderr, "payloadCoder: cannot open %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+        executor.spawn(ingestSource(std::move(source), &sink, &counters));
+    }
+
+    if (listen)
+    {
+        runningIngest = &executor;
+        signal(SIGINT, stopIngest);
+        signal(SIGTERM, stopIngest);
+        fprintf(stderr, "payloadCoder: listening on %s:%u\n", address.c_str(), listeners.front()->get_port());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const bool ran = executor.run();
+    runningIngest = nullptr;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const bool written = sink.finish();
+
+    const asyncStats stats = executor.get_stats();
+    fprintf(stderr, "payloadCoder: %llu sources, %llu frames, %llu rows, %llu rejected frames, %llu bad lines, "
+                    "%llu resumes, %llu waits, %.1f s\n",
+            static_cast<unsigned long long>(counters.sources.load()), static_cast<unsigned long long>(counters.frames.load()),
+            static_cast<unsigned long long>(counters.rows.load()), static_cast<unsigned long long>(counters.rejectedFrames.load()),
+            static_cast<unsigned long long>(counters.rejectedLines.load()), static_cast<unsigned long long>(stats.resumes),
+            static_cast<unsigned long long>(stats.waits), seconds);
+    if (!ran)
+    {
+        fprintf(stderr, "payloadCoder: cannot start the event loops: %s\n", strerror(errno));
+        return 1;
+    }
+    if (!written || counters.failed.load() != 0)
+    {
+        fprintf(stderr, "payloadCoder: %s\n", written ? "read error" : "write error");
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief run the generate command
+/// \param argc number of arguments after "generate"
+/// \param argv arguments after "generate"
+/// \return process exit code
+static int runGenerate(int argc, char *argv[])
+{
+    fleetConfig config = defaultFleetConfig();
+    inputFormat format = inputFormat::raw;
+    uint64_t endMs = 0;
+    uint64_t count = 0;
+    double rate = 0.0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            if (!parseInputFormat(argv[++i], format))
+            {
+                fprintf(stderr, "payloadCoder: unknown format '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--traps") == 0 && i + 1 < argc)
+        {
+            config.traps = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            config.seed = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            endMs = strtoull(argv[++i], nullptr, 10) * 1000;
+        }
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+        {
+            count = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+        {
+            rate = strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--door") == 0 && i + 1 < argc)
+        {
+            config.doorEventsPerDay = strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--catch") == 0 && i + 1 < argc)
+        {
+            config.catchEventsPerDay = strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--displacement") == 0 && i + 1 < argc)
+        {
+            config.displacementEventsPerDay = strtod(argv[++i], nullptr);
+        }
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (config.traps == 0 || (endMs != 0 && count != 0))
+    {
+        printUsage();
+        return 2;
+    }
+    if (endMs == 0)
+    {
+        // without --seconds, simulate one hour, or as long as it takes to produce --count uplinks
+        endMs = count != 0 ? UINT64_MAX : 3600 * 1000;
+    }
+    if (count == 0)
+    {
+        count = UINT64_MAX;
+    }
+
+    // with --rate, write small chunks so the output is smooth rather than bursty
+    const size_t chunk = rate > 0.0 ? static_cast<size_t>(std::max(1.0, std::min(4096.0, rate / 20.0))) : 4096;
+    fleetGenerator fleet(config);
+    payloadBatch batch;
+    std::vector<fleetUplink> uplinks;
+    std::vector<uint8_t> frames;
+    std::string out;
+    uint64_t produced = 0;
+    bool ok = true;
+    const auto start = std::chrono::steady_clock::now();
+
+    while (ok && produced < count)
+    {
+        batch.clear();
+        uplinks.clear();
+        out.clear();
+        const size_t n = fleet.next(static_cast<size_t>(std::min<uint64_t>(chunk, count - produced)), endMs, batch, uplinks);
+        if (n == 0)
+        {
+            break;
+        }
+        frames.resize(n * SENSOR_PAYLOAD_SIZE);
+        payloadEncoder::encodeBatch(batch, frames.data(), frames.size());
+        appendFleetUplinks(format, config, frames.data(), uplinks, out);
+        if (rate > 0.0)
+        {
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(static_cast<double>(produced) / rate));
+        }
+        ok = fwrite(out.data(), 1, out.size(), stdout) == out.size();
+        produced += n;
+    }
+    ok = fflush(stdout) == 0 && ok;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "payloadCoder: %llu uplinks from %lu traps over %.1f simulated s in %.3f s (%.2f M uplinks/s)\n",
+            static_cast<unsigned long long>(produced), static_cast<unsigned long>(config.traps),
+            static_cast<double>(fleet.get_timeMs()) / 1000.0, seconds,
+            static_cast<double>(produced) / (seconds > 0 ? seconds : 1e-9) / 1e6);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
 {
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "decode") == 0)
+        {
+            return runDecode(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "archive") == 0)
+        {
+            return runArchive(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "history") == 0)
+        {
+            return runHistory(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "transitions") == 0)
+        {
+            return runTransitions(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "battery") == 0)
+        {
+            return runBattery(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "dedup") == 0)
+        {
+            return runDedup(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "merge") == 0)
+        {
+            return runMerge(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "bulkload") == 0)
+        {
+            return runBulkLoad(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "webhook") == 0)
+        {
+            return runWebhook(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "post") == 0)
+        {
+            return runPost(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "ingest") == 0)
+        {
+            return runIngest(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "generate") == 0)
+        {
+            return runGenerate(argc - 2, argv + 2);
+        }
+        printUsage();
+        return 2;
+    }
+
     // Test 1
     test01();
 
     // Test 2
     test02();
 
+    // Test 3
+    test03();
+
+    // Test 4
+    test04();
+
+    // Test 5
+    test05();
+
+    // Test 6
+    test06();
+
+    // Test 7
+    test07();
+
+    // Test 8
+    test08();
+
+    // Test 9
+    test09();
+
+    // Test 10
+    test10();
+
+    // Test 11
+    test11();
+
+    // Test 12
+    test12();
+
+    // Test 13
+    test13();
+
+    // Test 14
+    test14();
+
+    // Test 15
+    test15();
+
+    // Test 16
+    test16();
+
+    // Test 17
+    test17();
+
+    // Test 18
+    test18();
+
+    // Test 19
+    test19();
+
+    // Test 20
+    test20();
+
+    // Test 21
+    test21();
+
+    // Test 22
+    test22();
+
+    // Test 23
+    test23();
+
+    // Test 24
+    test24();
+
+    // Test 25
+    test25();
+
+    // Test 26
+    test26();
+
+    // Test 27
+    test27();
+
+    // Test 28
+    test28();
+
     return 0;
 }
\ No newline at end of file
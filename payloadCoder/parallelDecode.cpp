@@ -0,0 +1,231 @@
+#include "parallelDecode.h"
+#include "decoder.h"
+#include "encoder.h"
+
+#include <algorithm> // std::min
+#include <chrono>    // std::chrono::steady_clock
+
+parallelDecoder::parallelDecoder(unsigned threads, size_t chunkFrames)
+    : _threads(threads != 0 ? threads : (std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1)),
+      _chunkFrames(chunkFrames != 0 ? chunkFrames : 1),
+      _windowChunks(0),
+      _format(false),
+      _windows(),
+      _reports(),
+      _workers(),
+      _mutex(),
+      _wakeWorkers(),
+      _wakeMain(),
+      _published(0),
+      _stop(false)
+{
+    /** A few chunks per worker per window leave room for stealing without long waits at the window end. */
+    _windowChunks = 8 * static_cast<size_t>(_threads);
+    for (window &w : _windows)
+    {
+        w.ranges.reset(new std::atomic<uint64_t>[_threads]);
+        w.slots.reset(new decodedChunk[_windowChunks]);
+        for (size_t i = 0; i < _windowChunks; i++)
+        {
+            w.slots[i].text.set_header(false);
+        }
+    }
+    _reports.assign(_threads, workerReport{0, 0, 0, 0, 0.0});
+
+    _workers.reserve(_threads);
+    for (unsigned i = 0; i < _threads; i++)
+    {
+        _workers.emplace_back(&parallelDecoder::workerLoop, this, i);
+    }
+}
+
+parallelDecoder::~parallelDecoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wakeWorkers.notify_all();
+    for (std::thread &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+void parallelDecoder::set_outputFormat(outputFormat format)
+{
+    _format = true;
+    for (window &w : _windows)
+    {
+        for (size_t i = 0; i < _windowChunks; i++)
+        {
+            w.slots[i].text.set_format(format);
+        }
+    }
+}
+
+long parallelDecoder::takeChunk(window &w, unsigned worker, bool &stolen)
+{
+    /** Own range: take from the front. */
+    std::atomic<uint64_t> &own = w.ranges[worker];
+    uint64_t range = own.load(std::memory_order_relaxed);
+    while (static_cast<uint32_t>(range) < static_cast<uint32_t>(range >> 32))
+    {
+        if (own.compare_exchange_weak(range, range + 1, std::memory_order_acq_rel))
+        {
+            stolen = false;
+            return static_cast<long>(static_cast<uint32_t>(range));
+        }
+    }
+
+    /** Other ranges: take from the back, so the owner keeps working on its front undisturbed. */
+    for (unsigned step = 1; step < _threads; step++)
+    {
+        std::atomic<uint64_t> &victim = w.ranges[(worker + step) % _threads];
+        range = victim.load(std::memory_order_relaxed);
+        while (static_cast<uint32_t>(range) < static_cast<uint32_t>(range >> 32))
+        {
+            const uint64_t end = (range >> 32) - 1;
+            if (victim.compare_exchange_weak(range, (end << 32) | static_cast<uint32_t>(range), std::memory_order_acq_rel))
+            {
+                stolen = true;
+                return static_cast<long>(end);
+            }
+        }
+    }
+    return -1;
+}
+
+void parallelDecoder::decodeChunk(window &w, size_t chunk)
+{
+    decodedChunk &slot = w.slots[chunk];
+    const size_t chunkBytes = _chunkFrames * SENSOR_PAYLOAD_SIZE;
+    const size_t begin = (w.firstChunk + chunk) * chunkBytes;
+    const size_t end = (w.length - begin > chunkBytes) ? begin + chunkBytes : w.length;
+
+    slot.firstFrame = (w.firstChunk + chunk) * _chunkFrames;
+    slot.frames = (end - begin + SENSOR_PAYLOAD_SIZE - 1) / SENSOR_PAYLOAD_SIZE;
+    slot.batch.clear();
+    slot.text.clear();
+    payloadDecoder::decodeBatch(w.frames + begin, end - begin, slot.batch);
+    if (_format)
+    {
+        slot.text.write(slot.batch);
+    }
+}
+
+void parallelDecoder::workerLoop(unsigned worker)
+{
+    workerReport &report = _reports[worker];
+    for (uint64_t generation = 0;; generation++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeWorkers.wait(lock, [&]
+                              { return _stop || _published > generation; });
+            if (_published <= generation)
+            {
+                return; // stopped, and no window left to finish
+            }
+        }
+
+        window &w = _windows[generation % 2];
+        bool stolen = false;
+        for (long chunk = takeChunk(w, worker, stolen); chunk >= 0; chunk = takeChunk(w, worker, stolen))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            decodeChunk(w, static_cast<size_t>(chunk));
+            report.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            report.chunks++;
+            report.stolen += stolen ? 1 : 0;
+            report.frames += w.slots[chunk].frames;
+            report.bytes += w.slots[chunk].frames * SENSOR_PAYLOAD_SIZE;
+        }
+
+        /** The last worker to leave the window knows every chunk in it is finished. */
+        if (w.active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _wakeMain.notify_all();
+        }
+    }
+}
+
+void parallelDecoder::publish(const uint8_t *frames, size_t length, size_t first, size_t count)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    window &w = _windows[_published % 2];
+    w.frames = frames;
+    w.length = length;
+    w.firstChunk = first;
+    w.chunkCount = count;
+    for (unsigned i = 0; i < _threads; i++)
+    {
+        const uint64_t begin = count * i / _threads;
+        const uint64_t end = count * (i + 1) / _threads;
+        w.ranges[i].store((end << 32) | begin, std::memory_order_relaxed);
+    }
+    w.active.store(_threads, std::memory_order_relaxed);
+    _published++;
+    lock.unlock();
+    _wakeWorkers.notify_all();
+}
+
+void parallelDecoder::wait(window &w)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _wakeMain.wait(lock, [&]
+                   { return w.active.load(std::memory_order_acquire) == 0; });
+}
+
+void parallelDecoder::run(const uint8_t *frames, size_t length, const std::function<void(const decodedChunk &)> &emit)
+{
+    const size_t chunkBytes = _chunkFrames * SENSOR_PAYLOAD_SIZE;
+    const size_t chunks = (length + chunkBytes - 1) / chunkBytes;
+    const size_t windows = (chunks + _windowChunks - 1) / _windowChunks;
+
+    /** Keep two windows in flight: the workers decode window k + 1 while window k is emitted. */
+    const uint64_t base = _published;
+    for (size_t k = 0; k < windows && k < 2; k++)
+    {
+        const size_t first = k * _windowChunks;
+        publish(frames, length, first, std::min(_windowChunks, chunks - first));
+    }
+    for (size_t k = 0; k < windows; k++)
+    {
+        window &w = _windows[(base + k) % 2];
+        wait(w);
+        for (size_t i = 0; i < w.chunkCount; i++)
+        {
+            emit(w.slots[i]);
+        }
+        if (k + 2 < windows)
+        {
+            const size_t first = (k + 2) * _windowChunks;
+            publish(frames, length, first, std::min(_windowChunks, chunks - first));
+        }
+    }
+}
+
+size_t parallelDecoder::decode(const uint8_t *frames, size_t length, payloadBatch &out)
+{
+    const size_t before = out.size();
+    out.reserve(before + length / SENSOR_PAYLOAD_SIZE);
+    run(frames, length, [&out](const decodedChunk &chunk)
+        {
+            const payloadBatch &b = chunk.batch;
+            out.id.insert(out.id.end(), b.id.begin(), b.id.end());
+            out.version.insert(out.version.end(), b.version.begin(), b.version.end());
+            out.flags.insert(out.flags.end(), b.flags.begin(), b.flags.end());
+            out.battery.insert(out.battery.end(), b.battery.begin(), b.battery.end());
+            out.unixTime.insert(out.unixTime.end(), b.unixTime.begin(), b.unixTime.end());
+            out.doorStatus.insert(out.doorStatus.end(), b.doorStatus.begin(), b.doorStatus.end());
+            out.catchDetect.insert(out.catchDetect.end(), b.catchDetect.begin(), b.catchDetect.end());
+            out.trapDisplacement.insert(out.trapDisplacement.end(), b.trapDisplacement.begin(), b.trapDisplacement.end());
+            for (const rejectedFrame &error : b.errors)
+            {
+                out.errors.push_back(rejectedFrame{error.index + chunk.firstFrame, error.reason, error.size});
+            }
+        });
+    return out.size() - before;
+}
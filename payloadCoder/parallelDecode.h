@@ -0,0 +1,136 @@
+/**
+ * @file parallelDecode.h
+ * @brief Multi-threaded decode of large frame buffers with in-order output.
+ *
+ * The input is split into chunks of whole frames. Chunks are handed out in windows: every
+ * worker gets a contiguous range of the window's chunks and, when its own range is empty,
+ * steals chunks from the end of another worker's range. Each chunk is decoded (and optionally
+ * formatted) into its own slot, so workers never share an output buffer. The calling thread
+ * receives the finished chunks strictly in input order while the workers already decode the
+ * next window.
+ *
+ * Usage: create one parallelDecoder, call run() for each block of frames, read reports() at the end.
+ */
+
+#ifndef PARALLELDECODE_H
+#define PARALLELDECODE_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "payloadBatch.h"
+#include "recordWriter.h"
+
+/// \brief decoded chunk handed to the caller of parallelDecoder::run()
+struct decodedChunk
+{
+    size_t firstFrame;   ///< Index of the chunk's first frame in the block passed to run()
+    size_t frames;       ///< Number of frames in the chunk (including rejected ones)
+    payloadBatch batch;  ///< Decoded rows; error indices are relative to `firstFrame`
+    recordWriter text;   ///< Formatted records (empty unless a format was given)
+
+    decodedChunk() : firstFrame(0), frames(0), batch(), text(nullptr, outputFormat::csv, 0) {} ///< Constructor
+};
+
+/// \brief work done by one worker (cache line aligned: each worker updates its own report)
+struct alignas(64) workerReport
+{
+    uint64_t chunks;    ///< Chunks decoded
+    uint64_t stolen;    ///< Chunks taken from another worker's range
+    uint64_t frames;    ///< Frames decoded
+    uint64_t bytes;     ///< Input bytes decoded
+    double busySeconds; ///< Time spent decoding and formatting
+};
+
+/// \brief pool of decode workers
+class parallelDecoder
+{
+private:
+    /// \brief chunks of one window and their distribution over the workers
+    struct window
+    {
+        const uint8_t *frames;                           ///< Input block
+        size_t length;                                   ///< Bytes in the input block
+        size_t firstChunk;                               ///< Block chunk number of the window's first chunk
+        size_t chunkCount;                               ///< Chunks in this window
+        std::unique_ptr<std::atomic<uint64_t>[]> ranges; ///< Per worker: begin (low 32 bits) and end (high 32 bits)
+        std::atomic<unsigned> active;                    ///< Workers that have not finished this window
+        std::unique_ptr<decodedChunk[]> slots;           ///< Output per chunk
+
+        window() : frames(nullptr), length(0), firstChunk(0), chunkCount(0), ranges(), active(0), slots() {} ///< Constructor
+        window(const window &) = delete;            ///< Copy constructor disabled
+        window &operator=(const window &) = delete; ///< Assignment operator disabled
+    };
+
+    unsigned _threads;                   ///< Number of workers
+    size_t _chunkFrames;                 ///< Frames per chunk
+    size_t _windowChunks;                ///< Chunks per window
+    bool _format;                        ///< Format records in the workers
+    window _windows[2];                  ///< Double-buffered windows
+    std::vector<workerReport> _reports;  ///< Per worker counters
+    std::vector<std::thread> _workers;   ///< Worker threads
+    std::mutex _mutex;                   ///< Protects _published and _stop
+    std::condition_variable _wakeWorkers; ///< Signals a new window or stop
+    std::condition_variable _wakeMain;   ///< Signals a finished window
+    uint64_t _published;                 ///< Number of windows published so far
+    bool _stop;                          ///< Workers must exit
+
+    /// \brief worker thread body
+    void workerLoop(unsigned worker);
+
+    /// \brief take the next chunk of a window: own range first, then steal
+    /// \return chunk number within the window, or -1 if the window has no chunks left
+    long takeChunk(window &w, unsigned worker, bool &stolen);
+
+    /// \brief decode one chunk of a window into its slot
+    void decodeChunk(window &w, size_t chunk);
+
+    /// \brief fill a window with chunks [first, first + count) of a block and wake the workers
+    void publish(const uint8_t *frames, size_t length, size_t first, size_t count);
+
+    /// \brief wait until every worker has finished the window (and so every chunk in it)
+    void wait(window &w);
+
+public:
+    /// \brief constructor, starts the workers
+    /// \param threads number of workers (0 for the number of hardware threads)
+    /// \param chunkFrames frames per chunk
+    parallelDecoder(unsigned threads = 0, size_t chunkFrames = 1 << 16);
+    ~parallelDecoder();                                         ///< Destructor, stops the workers
+    parallelDecoder(const parallelDecoder &) = delete;            ///< Copy constructor disabled
+    parallelDecoder &operator=(const parallelDecoder &) = delete; ///< Assignment operator disabled
+
+    /// \brief let the workers format records into decodedChunk::text
+    /// \param format record format; CSV chunks have no header line
+    void set_outputFormat(outputFormat format);
+
+    /// \brief decode a block of back-to-back frames
+    /// `emit` is called on the calling thread once per chunk, in input order. A trailing partial
+    /// frame is reported as decodeError::wrongSize in the last chunk.
+    /// \param frames pointer to the first frame
+    /// \param length total number of bytes in `frames`
+    /// \param emit receives each finished chunk; the chunk is reused after emit returns
+    void run(const uint8_t *frames, size_t length, const std::function<void(const decodedChunk &)> &emit);
+
+    /// \brief decode a block of frames into one batch, in input order
+    /// \param frames pointer to the first frame
+    /// \param length total number of bytes in `frames`
+    /// \param out batch receiving the decoded rows (appended) and errors (indices relative to `frames`)
+    /// \return number of decoded rows
+    size_t decode(const uint8_t *frames, size_t length, payloadBatch &out);
+
+    /// \brief number of workers
+    unsigned get_threads() const { return _threads; }
+
+    /// \brief per worker counters since construction
+    const std::vector<workerReport> &reports() const { return _reports; }
+};
+
+#endif // PARALLELDECODE_H
@@ -0,0 +1,110 @@
+/**
+ * @file payloadBatch.h
+ * @brief Structure-of-arrays container for decoding many muskrat trap payloads at once.
+ *
+ * Each decoded frame becomes one row spread over the column vectors (id, version, flags,
+ * battery, unixTime, and the three flag bits as separate boolean columns). Frames that cannot be decoded are listed in `errors` instead.
+ * The columns are std::pmr vectors: a batch built on a batchArena (see batchArena.h) takes its
+ * memory from the arena, and dropping the batch costs nothing.
+ * Usage: pass a payloadBatch to payloadDecoder::decodeBatch(), then read the columns directly.
+ */
+
+#ifndef PAYLOADBATCH_H
+#define PAYLOADBATCH_H
+
+#include <stdint.h> // uint8_t and uint32_t type
+#include <stddef.h> // size_t
+#include <memory_resource>
+#include <memory_resource>
+#include <vector>
+
+const uint8_t FLAG_DOOR_STATUS = 1 << 2;       ///< Door status bit in the packed flag byte
+const uint8_t FLAG_CATCH_DETECT = 1 << 1;      ///< Catch detection bit in the packed flag byte
+const uint8_t FLAG_TRAP_DISPLACEMENT = 1 << 0; ///< Trap displacement bit in the packed flag byte
+
+/// \brief reason a frame was rejected by the batch decoder
+enum class decodeError : uint8_t
+{
+    wrongSize = 1,     ///< Frame is not SENSOR_PAYLOAD_SIZE bytes long
+    unknownVersion = 2 ///< Version byte does not name a known payload layout
+};
+
+/// \brief frame rejected by the batch decoder
+struct rejectedFrame
+{
+    size_t index;       ///< Position of the frame in the input batch
+    decodeError reason; ///< Why the frame was rejected
+    uint8_t size;       ///< Size of the rejected frame in bytes (saturated at 255)
+};
+
+/// \brief decoded payloads stored as structure-of-arrays
+/// All column vectors have the same length; row `i` holds the fields of the i-th accepted frame.
+/// Rows keep the input order; rejected frames are skipped and reported in `errors`.
+class payloadBatch
+{
+public:
+    std::pmr::vector<uint32_t> id;               ///< Identification number per row
+    std::pmr::vector<uint8_t> version;           ///< Payload version per row
+    std::pmr::vector<uint8_t> flags;             ///< Packed door/catch/displacement bits per row (see FLAG_*)
+    std::pmr::vector<uint8_t> battery;           ///< Battery status per row
+    std::pmr::vector<uint32_t> unixTime;         ///< Unix time per row
+    std::pmr::vector<uint8_t> doorStatus;        ///< Door status per row (0 or 1), split from `flags`
+    std::pmr::vector<uint8_t> catchDetect;       ///< Catch detection per row (0 or 1), split from `flags`
+    std::pmr::vector<uint8_t> trapDisplacement;  ///< Trap displacement per row (0 or 1), split from `flags`
+    std::pmr::vector<rejectedFrame> errors;      ///< Frames that could not be decoded
+
+    payloadBatch() : payloadBatch(std::pmr::get_default_resource()) {} ///< Constructor, columns on the default heap
+
+    /// \brief constructor
+    /// \param memory resource for all columns, for example a batchArena
+    explicit payloadBatch(std::pmr::memory_resource *memory)
+        : id(memory), version(memory), flags(memory), battery(memory), unixTime(memory),
+          doorStatus(memory), catchDetect(memory), trapDisplacement(memory), errors(memory) {}
+
+    /// \brief number of decoded rows
+    size_t size() const { return id.size(); }
+
+    /// \brief remove all rows and errors, keeping the allocated capacity
+    void clear()
+    {
+        id.clear();
+        version.clear();
+        flags.clear();
+        battery.clear();
+        unixTime.clear();
+        doorStatus.clear();
+        catchDetect.clear();
+        trapDisplacement.clear();
+        errors.clear();
+    }
+
+    /// \brief reserve room for a number of rows
+    /// \param rows expected number of rows
+    void reserve(size_t rows)
+    {
+        id.reserve(rows);
+        version.reserve(rows);
+        flags.reserve(rows);
+        battery.reserve(rows);
+        unixTime.reserve(rows);
+        doorStatus.reserve(rows);
+        catchDetect.reserve(rows);
+        trapDisplacement.reserve(rows);
+    }
+
+    /// \brief set all columns to the same number of rows
+    /// \param rows new number of rows
+    void resize(size_t rows)
+    {
+        id.resize(rows);
+        version.resize(rows);
+        flags.resize(rows);
+        battery.resize(rows);
+        unixTime.resize(rows);
+        doorStatus.resize(rows);
+        catchDetect.resize(rows);
+        trapDisplacement.resize(rows);
+    }
+};
+
+#endif // PAYLOADBATCH_H
@@ -0,0 +1,58 @@
+#include "payloadRegistry.h"
+#include "payloadBatch.h" // FLAG_*
+
+#include <utility> // std::index_sequence
+
+namespace
+{
+    /// @brief Decode a frame of layout `Layout` into fields.
+    template <typename Layout>
+    void decodeFieldsFor(const uint8_t *frame, payloadFields &fields)
+    {
+        payloadCodec<Layout>::decode(frame, fields);
+    }
+
+    /// @brief Decode a frame of layout `Layout` into row 0 of batch columns.
+    template <typename Layout>
+    void decodeRowFor(const uint8_t *frame, const batchColumns &col)
+    {
+        payloadFields fields;
+        payloadCodec<Layout>::decode(frame, fields);
+        col.id[0] = fields.id;
+        col.version[0] = fields.version;
+        col.flags[0] = (fields.doorStatus ? FLAG_DOOR_STATUS : 0) |
+                       (fields.catchDetect ? FLAG_CATCH_DETECT : 0) |
+                       (fields.trapDisplacement ? FLAG_TRAP_DISPLACEMENT : 0);
+        col.battery[0] = fields.batteryStatus;
+        col.unixTime[0] = fields.unixTime;
+        col.doorStatus[0] = fields.doorStatus;
+        col.catchDetect[0] = fields.catchDetect;
+        col.trapDisplacement[0] = fields.trapDisplacement;
+    }
+
+    /// @brief Table entry for a version without a layout.
+    template <uint8_t Version, bool Known = payloadVersionLayout<Version>::known>
+    struct versionEntry
+    {
+        static constexpr payloadVersionDecoder value = {0, 0, nullptr, nullptr};
+    };
+
+    /// @brief Table entry for a version with a layout.
+    template <uint8_t Version>
+    struct versionEntry<Version, true>
+    {
+        typedef typename payloadVersionLayout<Version>::layout layout;
+        static_assert(layout::offsetOf(payloadFieldId::version) == PAYLOAD_VERSION_INDEX * 8,
+                      "the version byte must stay at PAYLOAD_VERSION_INDEX in every layout");
+        static constexpr payloadVersionDecoder value = {payloadCodec<layout>::size, layout::bitsOf(payloadFieldId::unixTime),
+                                                         decodeFieldsFor<layout>, decodeRowFor<layout>};
+    };
+
+    template <size_t... Versions>
+    constexpr std::array<payloadVersionDecoder, 256> buildTable(std::index_sequence<Versions...>)
+    {
+        return {{versionEntry<static_cast<uint8_t>(Versions)>::value...}};
+    }
+}
+
+const std::array<payloadVersionDecoder, 256> PAYLOAD_VERSION_DECODERS = buildTable(std::make_index_sequence<256>());
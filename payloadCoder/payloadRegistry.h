@@ -0,0 +1,45 @@
+/**
+ * @file payloadRegistry.h
+ * @brief Table of payload decoders indexed by the version byte.
+ *
+ * Every layout keeps its version byte at PAYLOAD_VERSION_INDEX, so a frame's layout is known
+ * after reading one byte. The table has one entry per possible version byte and is built at
+ * compile time from the payloadVersionLayout specialisations in payloadSchema.h. Each entry's
+ * decoders are instantiated from their own layout, with all offsets as constants, so mixed
+ * versions cost one indexed call per frame and no runtime offset lookups.
+ */
+
+#ifndef PAYLOADREGISTRY_H
+#define PAYLOADREGISTRY_H
+
+#include <stdint.h> // uint8_t type
+#include <array>
+
+#include "../nodeCode/payloadSchema.h"
+#include "decodeKernels.h" // batchColumns
+
+/// \brief decoders for one payload version
+struct payloadVersionDecoder
+{
+    uint8_t size;     ///< Frame size in bytes, or 0 if the version has no layout
+    uint8_t timeBits; ///< Low bits of unixTime carried by the frame (32: the full time)
+
+    /// \brief decode a frame into fields (nullptr if the version has no layout)
+    void (*decodeFields)(const uint8_t *frame, payloadFields &fields);
+
+    /// \brief decode a frame into row 0 of batch columns (nullptr if the version has no layout)
+    void (*decodeRow)(const uint8_t *frame, const batchColumns &col);
+};
+
+/// \brief decoder table, one entry per version byte value
+extern const std::array<payloadVersionDecoder, 256> PAYLOAD_VERSION_DECODERS;
+
+/// \brief get the decoders for a version byte
+/// \param version version byte of a frame (byte PAYLOAD_VERSION_INDEX)
+/// \return table entry; entry.size is 0 for unknown versions
+inline const payloadVersionDecoder &payloadDecoderFor(uint8_t version)
+{
+    return PAYLOAD_VERSION_DECODERS[version];
+}
+
+#endif // PAYLOADREGISTRY_H
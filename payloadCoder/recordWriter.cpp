@@ -0,0 +1,223 @@
+#include "recordWriter.h"
+
+#include <charconv> // std::to_chars
+#include <string.h> // memcpy, strcmp
+
+namespace
+{
+    const size_t MAX_RECORD_SIZE = 192; ///< Upper bound for one formatted record (longest is JSON, ~140 bytes)
+
+    const char CSV_HEADER[] = "id,version,doorStatus,catchDetect,trapDisplacement,batteryStatus,unixTime\n";
+
+    /// @brief Append a string literal without its terminating null.
+    template <size_t N>
+    inline char *appendLiteral(char *out, const char (&text)[N])
+    {
+        memcpy(out, text, N - 1);
+        return out + N - 1;
+    }
+
+    /// @brief Append a number in decimal.
+    template <typename T>
+    inline char *appendNumber(char *out, T value)
+    {
+        return std::to_chars(out, out + 10, value).ptr; // 10 digits fit any uint32_t
+    }
+
+    /// @brief Append "true" or "false".
+    inline char *appendBool(char *out, bool value)
+    {
+        return value ? appendLiteral(out, "true") : appendLiteral(out, "false");
+    }
+
+    /// @brief Append a 32-bit value little-endian.
+    inline char *appendLE32(char *out, uint32_t value)
+    {
+        out[0] = static_cast<char>(value);
+        out[1] = static_cast<char>(value >> 8);
+        out[2] = static_cast<char>(value >> 16);
+        out[3] = static_cast<char>(value >> 24);
+        return out + 4;
+    }
+}
+
+bool parseOutputFormat(const char *name, outputFormat &format)
+{
+    if (strcmp(name, "csv") == 0)
+    {
+        format = outputFormat::csv;
+    }
+    else if (strcmp(name, "json") == 0)
+    {
+        format = outputFormat::json;
+    }
+    else if (strcmp(name, "binary") == 0 || strcmp(name, "bin") == 0)
+    {
+        format = outputFormat::binary;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+recordWriter::recordWriter(FILE *file, outputFormat format, size_t bufferSize, std::pmr::memory_resource *memory)
+    : _file(file),
+      _format(format),
+      _buffer(bufferSize < 2 * MAX_RECORD_SIZE ? 2 * MAX_RECORD_SIZE : bufferSize, memory),
+      _used(0),
+      _headerWritten(false),
+      _failed(false)
+{
+}
+
+recordWriter::~recordWriter()
+{
+    flush();
+}
+
+void recordWriter::appendRow(const payloadBatch &batch, size_t row)
+{
+    char *out = _buffer.data() + _used;
+    const uint8_t flags = batch.flags[row];
+
+    switch (_format)
+    {
+    case outputFormat::csv:
+        out = appendNumber(out, batch.id[row]);
+        *out++ = ',';
+        out = appendNumber(out, batch.version[row]);
+        *out++ = ',';
+        *out++ = (flags & FLAG_DOOR_STATUS) ? '1' : '0';
+        *out++ = ',';
+        *out++ = (flags & FLAG_CATCH_DETECT) ? '1' : '0';
+        *out++ = ',';
+        *out++ = (flags & FLAG_TRAP_DISPLACEMENT) ? '1' : '0';
+        *out++ = ',';
+        out = appendNumber(out, batch.battery[row]);
+        *out++ = ',';
+        out = appendNumber(out, batch.unixTime[row]);
+        *out++ = '\n';
+        break;
+
+    case outputFormat::json:
+        out = appendLiteral(out, "{\"id\":");
+        out = appendNumber(out, batch.id[row]);
+        out = appendLiteral(out, ",\"version\":");
+        out = appendNumber(out, batch.version[row]);
+        out = appendLiteral(out, ",\"doorStatus\":");
+        out = appendBool(out, flags & FLAG_DOOR_STATUS);
+        out = appendLiteral(out, ",\"catchDetect\":");
+        out = appendBool(out, flags & FLAG_CATCH_DETECT);
+        out = appendLiteral(out, ",\"trapDisplacement\":");
+        out = appendBool(out, flags & FLAG_TRAP_DISPLACEMENT);
+        out = appendLiteral(out, ",\"batteryStatus\":");
+        out = appendNumber(out, batch.battery[row]);
+        out = appendLiteral(out, ",\"unixTime\":");
+        out = appendNumber(out, batch.unixTime[row]);
+        out = appendLiteral(out, "}\n");
+        break;
+
+    case outputFormat::binary:
+        out = appendLE32(out, batch.id[row]);
+        out = appendLE32(out, batch.unixTime[row]);
+        *out++ = static_cast<char>(batch.version[row]);
+        *out++ = static_cast<char>(flags);
+        *out++ = static_cast<char>(batch.battery[row]);
+        *out++ = 0;
+        break;
+    }
+
+    _used = static_cast<size_t>(out - _buffer.data());
+}
+
+void recordWriter::reserve(size_t bytes)
+{
+    if (_buffer.size() - _used >= bytes)
+    {
+        return;
+    }
+    if (_file != nullptr)
+    {
+        drain();
+    }
+    if (_buffer.size() - _used < bytes)
+    {
+        _buffer.resize(_used + bytes);
+    }
+}
+
+void recordWriter::writeHeader()
+{
+    if (_format == outputFormat::csv && !_headerWritten)
+    {
+        reserve(sizeof(CSV_HEADER));
+        _used = static_cast<size_t>(appendLiteral(_buffer.data() + _used, CSV_HEADER) - _buffer.data());
+    }
+    _headerWritten = true;
+}
+
+void recordWriter::write(const payloadBatch &batch)
+{
+    writeHeader();
+
+    const size_t rows = batch.size();
+    if (_file == nullptr)
+    {
+        reserve(rows * MAX_RECORD_SIZE);
+    }
+    for (size_t row = 0; row < rows; row++)
+    {
+        if (_buffer.size() - _used < MAX_RECORD_SIZE)
+        {
+            drain();
+        }
+        appendRow(batch, row);
+    }
+}
+
+void recordWriter::write(const char *text, size_t length)
+{
+    writeHeader();
+
+    if (_file != nullptr && length >= _buffer.size() / 2)
+    {
+        /** Large blocks go straight to the file instead of through the buffer. */
+        drain();
+        if (fwrite(text, 1, length, _file) != length)
+        {
+            _failed = true;
+        }
+        return;
+    }
+    reserve(length);
+    memcpy(_buffer.data() + _used, text, length);
+    _used += length;
+}
+
+void recordWriter::drain()
+{
+    if (_file != nullptr && _used > 0)
+    {
+        if (fwrite(_buffer.data(), 1, _used, _file) != _used)
+        {
+            _failed = true;
+        }
+        _used = 0;
+    }
+}
+
+bool recordWriter::flush()
+{
+    if (_file == nullptr)
+    {
+        return true;
+    }
+    drain();
+    if (fflush(_file) != 0)
+    {
+        _failed = true;
+    }
+    return !_failed;
+}
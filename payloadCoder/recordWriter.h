@@ -0,0 +1,109 @@
+/**
+ * @file recordWriter.h
+ * @brief Buffered writer for decoded payloads as CSV, newline-delimited JSON or binary records.
+ *
+ * Numbers are formatted with std::to_chars into one reused output buffer, which is written to
+ * the file with fwrite() when full. No iostreams and no per-row flushing.
+ *
+ * CSV columns and JSON keys use the column names of the muskrattrap database table:
+ * id, version, doorStatus, catchDetect, trapDisplacement, batteryStatus, unixTime.
+ *
+ * Without a file the writer collects the records in memory (data(), size()), so worker threads
+ * can format their own part of the output; see parallelDecode.h.
+ *
+ * Binary records are BINARY_RECORD_SIZE bytes, little-endian:
+ * | id (u32) | unixTime (u32) | version (u8) | flags (u8, see FLAG_*) | batteryStatus (u8) | reserved (u8, 0) |
+ */
+
+#ifndef RECORDWRITER_H
+#define RECORDWRITER_H
+
+#include <stdint.h> // uint8_t type
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+#include <memory_resource>
+#include <vector>
+
+#include "payloadBatch.h"
+
+const size_t BINARY_RECORD_SIZE = 12; ///< Size of one binary output record in bytes
+
+/// \brief format of the records written by recordWriter
+enum class outputFormat : uint8_t
+{
+    csv,   ///< Comma separated values with a header line
+    json,  ///< One JSON object per line
+    binary ///< Fixed-width binary records
+};
+
+/// \brief parse an output format name ("csv", "json" or "binary")
+/// \param name format name
+/// \param format receives the format
+/// \return false if the name is unknown
+bool parseOutputFormat(const char *name, outputFormat &format);
+
+/// \brief writes decoded rows to a file
+class recordWriter
+{
+private:
+    FILE *_file;                    ///< Output file (not owned), nullptr to collect in memory
+    outputFormat _format;           ///< Format of the output
+    std::pmr::vector<char> _buffer; ///< Reused output buffer
+    size_t _used;                   ///< Bytes of _buffer in use
+    bool _headerWritten;            ///< CSV header already written (or not wanted)
+    bool _failed;                   ///< A write to the file failed
+
+    /// \brief append one row of `batch`; _buffer must have room for the longest record
+    void appendRow(const payloadBatch &batch, size_t row);
+
+    /// \brief hand the buffered records to the file
+    void drain();
+
+    /// \brief make room for `bytes` more bytes: drain to the file, or grow the buffer in memory mode
+    void reserve(size_t bytes);
+
+    /// \brief append the CSV header if it is still due
+    void writeHeader();
+
+public:
+    /// \brief constructor
+    /// \param file output file, for example stdout, or nullptr to collect the records in memory
+    /// \param format format of the output
+    /// \param bufferSize size of the output buffer in bytes
+    /// \param memory resource for the output buffer
+    recordWriter(FILE *file, outputFormat format, size_t bufferSize = 1 << 20,
+                 std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+    ~recordWriter();                                        ///< Destructor, flushes the buffer
+    recordWriter(const recordWriter &) = delete;            ///< Copy constructor disabled
+    recordWriter &operator=(const recordWriter &) = delete; ///< Assignment operator disabled
+
+    /// \brief append all rows of a batch
+    /// \param batch decoded rows
+    void write(const payloadBatch &batch);
+
+    /// \brief append records formatted by another writer with the same format
+    /// \param text formatted records, without CSV header
+    /// \param length number of bytes in `text`
+    void write(const char *text, size_t length);
+
+    /// \brief write the buffered records to the file
+    /// \return false if a write failed (now or earlier)
+    bool flush();
+
+    /// \brief change the format of the records written from now on
+    void set_format(outputFormat format) { _format = format; }
+
+    /// \brief enable or disable the CSV header line (enabled by default)
+    void set_header(bool enabled) { _headerWritten = !enabled; }
+
+    /// \brief records collected in memory mode
+    const char *data() const { return _buffer.data(); }
+
+    /// \brief number of bytes collected in memory mode
+    size_t size() const { return _used; }
+
+    /// \brief discard the records collected in memory mode, keeping the buffer
+    void clear() { _used = 0; }
+};
+
+#endif // RECORDWRITER_H
@@ -0,0 +1,304 @@
+#include "shardPipeline.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // _mm_pause
+#endif
+
+#ifdef __linux__
+#include <pthread.h> // pthread_setaffinity_np
+#include <sched.h>   // cpu_set_t
+#endif
+
+/// \brief state of one shard thread
+struct shardPipeline::shard
+{
+    std::vector<std::unique_ptr<spscRing<payloadBatch *>>> inbox;   ///< Per producer: filled batches to process
+    std::vector<std::unique_ptr<spscRing<payloadBatch *>>> returns; ///< Per producer: emptied batches to refill
+    std::mutex mutex;                                               ///< Guards the sleep, so no wake-up is lost
+    std::condition_variable wake;                                   ///< Signalled by producers and close()
+    std::atomic<bool> sleeping;                                     ///< True while the shard waits on `wake`
+    shardStats stats;                                               ///< Counters
+
+    shard() : inbox(), returns(), mutex(), wake(), sleeping(false), stats() {} ///< Constructor
+};
+
+/// \brief state of one producer
+struct shardPipeline::producer
+{
+    std::vector<payloadBatch *> open;                 ///< Per shard: batch being filled
+    std::vector<std::unique_ptr<payloadBatch>> pool; ///< All batches of this producer
+    uint64_t waits;                                   ///< Times this producer waited for a free batch
+
+    producer() : open(), pool(), waits(0) {} ///< Constructor
+};
+
+namespace
+{
+    /// @brief Tell the core that this is a spin loop (saves power, frees the sibling hyperthread).
+    inline void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    }
+
+    /// @brief Spins of an idle shard before it yields, and before it sleeps.
+    const unsigned SPIN_ROUNDS = 64;
+    const unsigned YIELD_ROUNDS = 256;
+}
+
+shardPipeline::shardPipeline(const shardConfig &config, shardStage stage)
+    : _config(config), _stage(std::move(stage)), _shards(), _producers(), _threads(), _closing(false)
+{
+    if (_config.shards == 0)
+    {
+        _config.shards = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+    }
+    if (_config.producers == 0)
+    {
+        _config.producers = 1;
+    }
+    if (_config.batchRows == 0)
+    {
+        _config.batchRows = 1;
+    }
+    if (_config.ringBatches == 0)
+    {
+        _config.ringBatches = 1;
+    }
+
+    /** Each producer owns ringBatches + 1 batches per shard: one open, the rest in flight or free.
+        Both rings hold all of them, so a push never fails; producers wait only for a free batch. */
+    for (unsigned s = 0; s < _config.shards; s++)
+    {
+        _shards.emplace_back(new shard());
+    }
+    for (unsigned p = 0; p < _config.producers; p++)
+    {
+        _producers.emplace_back(new producer());
+        producer &pr = *_producers.back();
+        for (unsigned s = 0; s < _config.shards; s++)
+        {
+            shard &sh = *_shards[s];
+            sh.inbox.emplace_back(new spscRing<payloadBatch *>(_config.ringBatches + 1));
+            sh.returns.emplace_back(new spscRing<payloadBatch *>(_config.ringBatches + 1));
+            for (size_t b = 0; b <= _config.ringBatches; b++)
+            {
+                pr.pool.emplace_back(new payloadBatch());
+                pr.pool.back()->reserve(_config.batchRows);
+                if (b == 0)
+                {
+                    pr.open.push_back(pr.pool.back().get());
+                }
+                else
+                {
+                    sh.returns.back()->tryPush(pr.pool.back().get());
+                }
+            }
+        }
+    }
+
+    for (unsigned s = 0; s < _config.shards; s++)
+    {
+        _threads.emplace_back(&shardPipeline::run, this, s);
+#ifdef __linux__
+        if (_config.pin)
+        {
+            const unsigned cores = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(s % cores, &set);
+            pthread_setaffinity_np(_threads.back().native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+shardPipeline::~shardPipeline()
+{
+    close();
+}
+
+void shardPipeline::run(unsigned index)
+{
+    shard &sh = *_shards[index];
+    const size_t producers = sh.inbox.size();
+    unsigned idle = 0;
+    bool closing = false;
+    for (;;)
+    {
+        /** One batch per producer per round, so that a busy producer cannot starve the others. */
+        bool worked = false;
+        for (size_t p = 0; p < producers; p++)
+        {
+            payloadBatch *batch = nullptr;
+            if (sh.inbox[p]->tryPop(batch))
+            {
+                _stage(index, *batch);
+                sh.stats.rows += batch->size();
+                sh.stats.batches++;
+                sh.returns[p]->tryPush(batch);
+                worked = true;
+            }
+        }
+        if (worked)
+        {
+            idle = 0;
+            continue;
+        }
+        if (closing)
+        {
+            /** close() is called after the last flush(), and this pass started after close() was
+                seen, so empty rings now stay empty. */
+            break;
+        }
+        if (_closing.load(std::memory_order_acquire))
+        {
+            closing = true;
+            continue;
+        }
+
+        idle++;
+        if (_config.busyPoll || idle < SPIN_ROUNDS)
+        {
+            cpuRelax();
+        }
+        else if (idle < YIELD_ROUNDS)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            /** Announce the sleep, then look once more: a producer either sees `sleeping` after its
+                push and notifies under the mutex, or its push is visible to the check below. */
+            std::unique_lock<std::mutex> lock(sh.mutex);
+            sh.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool empty = !_closing.load(std::memory_order_relaxed);
+            for (size_t p = 0; p < producers && empty; p++)
+            {
+                empty = sh.inbox[p]->empty();
+            }
+            if (empty)
+            {
+                sh.stats.sleeps++;
+                sh.wake.wait(lock);
+            }
+            sh.sleeping.store(false, std::memory_order_relaxed);
+            idle = 0;
+        }
+    }
+}
+
+void shardPipeline::send(unsigned producerIndex, unsigned index)
+{
+    producer &p = *_producers[producerIndex];
+    shard &sh = *_shards[index];
+    sh.inbox[producerIndex]->tryPush(p.open[index]);
+
+    /** Pairs with the fence in run(): either the shard sees the batch or this sees `sleeping`. */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sh.sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        sh.wake.notify_one();
+    }
+
+    payloadBatch *next = nullptr;
+    if (!sh.returns[producerIndex]->tryPop(next))
+    {
+        p.waits++;
+        unsigned spins = 0;
+        while (!sh.returns[producerIndex]->tryPop(next))
+        {
+            if (++spins < SPIN_ROUNDS)
+            {
+                cpuRelax();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    next->clear();
+    p.open[index] = next;
+}
+
+void shardPipeline::push(unsigned producerIndex, const payloadBatch &batch)
+{
+    producer &p = *_producers[producerIndex];
+    const unsigned shards = _config.shards;
+    const size_t rows = batch.size();
+    for (size_t i = 0; i < rows; i++)
+    {
+        const unsigned s = shards == 1 ? 0 : shardOf(batch.id[i], shards);
+        payloadBatch &out = *p.open[s];
+        out.id.push_back(batch.id[i]);
+        out.version.push_back(batch.version[i]);
+        out.flags.push_back(batch.flags[i]);
+        out.battery.push_back(batch.battery[i]);
+        out.unixTime.push_back(batch.unixTime[i]);
+        out.doorStatus.push_back(batch.doorStatus[i]);
+        out.catchDetect.push_back(batch.catchDetect[i]);
+        out.trapDisplacement.push_back(batch.trapDisplacement[i]);
+        if (out.size() >= _config.batchRows)
+        {
+            send(producerIndex, s);
+        }
+    }
+}
+
+void shardPipeline::flush(unsigned producerIndex)
+{
+    producer &p = *_producers[producerIndex];
+    for (unsigned s = 0; s < _config.shards; s++)
+    {
+        if (p.open[s]->size() != 0)
+        {
+            send(producerIndex, s);
+        }
+    }
+}
+
+void shardPipeline::close()
+{
+    if (_threads.empty())
+    {
+        return;
+    }
+    _closing.store(true, std::memory_order_release);
+    for (std::unique_ptr<shard> &sh : _shards)
+    {
+        std::lock_guard<std::mutex> lock(sh->mutex);
+        sh->wake.notify_one();
+    }
+    for (std::thread &t : _threads)
+    {
+        t.join();
+    }
+    _threads.clear();
+}
+
+std::vector<shardStats> shardPipeline::get_stats() const
+{
+    std::vector<shardStats> stats;
+    for (const std::unique_ptr<shard> &sh : _shards)
+    {
+        stats.push_back(sh->stats);
+    }
+    return stats;
+}
+
+uint64_t shardPipeline::get_waits() const
+{
+    uint64_t waits = 0;
+    for (const std::unique_ptr<producer> &p : _producers)
+    {
+        waits += p->waits;
+    }
+    return waits;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file shardPipeline.h
+ * @brief Shard-per-core stage runner fed through bounded lock-free rings of decoded batches.
+ *
+ * The state a stage keeps per trap (battery fits, transition detectors, dedup windows) is only
+ * ever touched by records of that trap. shardPipeline splits the traps over a fixed number of
+ * shards by a hash of the payload id; each shard runs on its own thread and owns the state of
+ * its traps, so stages need no locks and the threads share nothing but the rings between them.
+ *
+ * Producers (the threads that read and decode) hand decoded batches to push(). push() copies each
+ * row into the open batch of the row's shard; a full batch travels to the shard through a
+ * single-producer single-consumer ring, and the shard hands the emptied batch back through a
+ * second ring, so the batches are allocated once and recycled. Several producers reach a shard
+ * through one ring each, which the shard polls in turn: a multi-producer queue built from
+ * single-producer rings, without compare-and-swap on the hot path.
+ *
+ * Ordering: all rows of a trap land in the same shard, and every ring is first in, first out, so
+ * a shard sees the rows of a trap from one producer in the order that producer pushed them.
+ * Rows of one trap pushed by different producers are not ordered against each other; split the
+ * input by trap, or use one producer, where that matters.
+ *
+ * Back pressure: each producer owns `ringBatches` + 1 batches per shard; a producer that has
+ * none of them free waits for the shard. An idle shard spins briefly, then sleeps until a producer wakes it; with `busyPoll` it
+ * never sleeps, trading a core for the lowest latency. With `pin` the shard threads are bound to
+ * cores 0, 1, ... (Linux only).
+ *
+ * Usage: create a shardPipeline with the number of producers and a stage, call push() from the
+ * producer threads, flush() from each producer when it is done, then close(). The stage is called
+ * on the shard threads with batches that hold only rows of that shard.
+ */
+
+#ifndef SHARDPIPELINE_H
+#define SHARDPIPELINE_H
+
+#include <stdint.h> // uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "payloadBatch.h"
+
+/// \brief bounded lock-free ring for exactly one producer thread and one consumer thread
+/// The head and tail counters live on their own cache lines, and each side keeps a copy of the
+/// other side's counter, so a push or pop normally touches no line the other thread writes.
+template <typename T>
+class spscRing
+{
+private:
+    alignas(64) std::atomic<size_t> _head; ///< Next slot to pop (written by the consumer)
+    size_t _tailCache;                     ///< Consumer's copy of _tail
+    alignas(64) std::atomic<size_t> _tail; ///< Next slot to push (written by the producer)
+    size_t _headCache;                     ///< Producer's copy of _head
+    alignas(64) size_t _mask;              ///< Capacity - 1
+    std::unique_ptr<T[]> _slots;           ///< Ring storage
+
+    /// \brief smallest power of two that is at least `n`
+    static size_t roundUp(size_t n)
+    {
+        size_t capacity = 2;
+        while (capacity < n)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+public:
+    /// \brief constructor
+    /// \param capacity minimum number of elements (rounded up to a power of two)
+    explicit spscRing(size_t capacity)
+        : _head(0), _tailCache(0), _tail(0), _headCache(0), _mask(roundUp(capacity) - 1), _slots(new T[_mask + 1]()) {}
+    spscRing(const spscRing &) = delete;            ///< Copy constructor disabled
+    spscRing &operator=(const spscRing &) = delete; ///< Assignment operator disabled
+
+    /// \brief append an element (producer thread only)
+    /// \return false if the ring is full
+    bool tryPush(const T &value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _headCache > _mask)
+        {
+            _headCache = _head.load(std::memory_order_acquire);
+            if (tail - _headCache > _mask)
+            {
+                return false;
+            }
+        }
+        _slots[tail & _mask] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// \brief remove the oldest element (consumer thread only)
+    /// \return false if the ring is empty
+    bool tryPop(T &value)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tailCache)
+        {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if (head == _tailCache)
+            {
+                return false;
+            }
+        }
+        value = _slots[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// \brief true if there is nothing to pop (either thread; a snapshot)
+    bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+    /// \brief number of slots
+    size_t capacity() const { return _mask + 1; }
+};
+
+/// \brief settings of the shard pipeline
+struct shardConfig
+{
+    unsigned shards = 0;     ///< Shards, one thread each (0: one per hardware thread)
+    unsigned producers = 1;  ///< Threads that call push()
+    size_t batchRows = 4096; ///< Rows per batch sent to a shard
+    size_t ringBatches = 16; ///< Batches in flight per producer and shard (ring capacity)
+    bool pin = false;        ///< Bind shard thread i to core i (modulo the core count)
+    bool busyPoll = false;   ///< Idle shards spin instead of sleeping
+};
+
+/// \brief counters of one shard (cache line aligned: each shard updates its own)
+struct alignas(64) shardStats
+{
+    uint64_t rows = 0;    ///< Rows handed to the stage
+    uint64_t batches = 0; ///< Calls of the stage
+    uint64_t sleeps = 0;  ///< Times the shard went to sleep for lack of work
+};
+
+/// \brief processes the rows of one shard
+/// Called on the thread of shard `shard`, never concurrently for the same shard. `batch` holds only
+/// rows whose id maps to that shard; `errors` is always empty.
+using shardStage = std::function<void(unsigned shard, const payloadBatch &batch)>;
+
+/// \brief threads that each own the traps of one shard, fed by lock-free rings
+class shardPipeline
+{
+public:
+    struct shard;    ///< State of one shard thread (defined in shardPipeline.cpp)
+    struct producer; ///< State of one producer (defined in shardPipeline.cpp)
+
+private:
+    shardConfig _config;                               ///< Settings
+    shardStage _stage;                                 ///< Work done per batch
+    std::vector<std::unique_ptr<shard>> _shards;       ///< Shard state
+    std::vector<std::unique_ptr<producer>> _producers; ///< Producer state
+    std::vector<std::thread> _threads;                 ///< Shard threads
+    std::atomic<bool> _closing;                        ///< Set by close(): shards exit once their rings are empty
+
+    /// \brief run one shard until close()
+    void run(unsigned index);
+
+    /// \brief send a producer's open batch of one shard and take a free one
+    void send(unsigned producerIndex, unsigned index);
+
+public:
+    /// \brief constructor, starts the shard threads
+    /// \param config settings
+    /// \param stage work done per batch on the shard threads
+    shardPipeline(const shardConfig &config, shardStage stage);
+    ~shardPipeline();                                         ///< Destructor, calls close()
+    shardPipeline(const shardPipeline &) = delete;            ///< Copy constructor disabled
+    shardPipeline &operator=(const shardPipeline &) = delete; ///< Assignment operator disabled
+
+    /// \brief shard that owns a payload id
+    /// \param id payload id
+    /// \param shards number of shards
+    static unsigned shardOf(uint32_t id, unsigned shards)
+    {
+        const uint32_t h = static_cast<uint32_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL) >> 32);
+        return static_cast<unsigned>((static_cast<uint64_t>(h) * shards) >> 32);
+    }
+
+    /// \brief distribute the rows of a decoded batch over the shards
+    /// \param producerIndex index of the calling producer (0 .. producers - 1); one thread per index
+    /// \param batch decoded rows; errors are ignored
+    void push(unsigned producerIndex, const payloadBatch &batch);
+
+    /// \brief send the partly filled batches of a producer
+    /// \param producerIndex index of the calling producer
+    void flush(unsigned producerIndex);
+
+    /// \brief wait until the shards processed everything sent and stop them
+    /// Call after every producer called flush() for the last time; calling it again does nothing.
+    void close();
+
+    /// \brief number of shards
+    unsigned get_shards() const { return _config.shards; }
+
+    /// \brief per shard counters; read after close()
+    std::vector<shardStats> get_stats() const;
+
+    /// \brief times a producer waited for a shard to catch up, summed over the producers; read after close()
+    uint64_t get_waits() const;
+};
+
+#endif // SHARDPIPELINE_H
@@ -0,0 +1,113 @@
+#include "streamDecode.h"
+#include "decoder.h"
+#include "encoder.h"
+
+namespace
+{
+    const size_t PARALLEL_BLOCK_SIZE = 64 << 20; ///< Bytes read per block when decoding on a worker pool
+    const size_t ARENA_BLOCK_SIZE = 2 << 20;     ///< First block of the batch arena; a 1 MiB chunk of raw frames needs about 1.3 MiB
+}
+
+bool streamDecode(FILE *in, inputFormat input, FILE *out, outputFormat output, streamStats &stats,
+                  parallelDecoder *pool, const streamMemory &memory, uint32_t receivedAt)
+{
+    frameReader reader(in, input, pool != nullptr ? PARALLEL_BLOCK_SIZE : 1 << 20, memory.input);
+    reader.set_receivedAt(receivedAt);
+    return streamDecode(reader, out, output, stats, pool, memory);
+}
+
+bool streamDecode(frameReader &reader, FILE *out, outputFormat output, streamStats &stats, parallelDecoder *pool,
+                  const streamMemory &memory)
+{
+    stats = streamStats{0, 0, 0, 0, 0};
+
+    recordWriter writer(out, output, 1 << 20, memory.output);
+    batchArena arena(ARENA_BLOCK_SIZE, memory.batches);
+
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    if (pool != nullptr)
+    {
+        /** Workers decode and format; this thread only writes the chunks in order. */
+        pool->set_outputFormat(output);
+        while (reader.next(frames, length))
+        {
+            pool->run(frames, length, [&](const decodedChunk &chunk)
+                      {
+                          writer.write(chunk.text.data(), chunk.text.size());
+                          stats.frames += chunk.frames;
+                          stats.rows += chunk.batch.size();
+                          stats.rejectedFrames += chunk.batch.errors.size();
+                      });
+        }
+    }
+    while (pool == nullptr && reader.next(frames, length))
+    {
+        /** One batch per chunk, on the arena; the reset drops it without a single free(). */
+        {
+            payloadBatch batch(&arena);
+            payloadDecoder::decodeBatch(frames, length, batch);
+            writer.write(batch);
+
+            stats.frames += (length + SENSOR_PAYLOAD_SIZE - 1) / SENSOR_PAYLOAD_SIZE;
+            stats.rows += batch.size();
+            stats.rejectedFrames += batch.errors.size();
+        }
+        arena.reset();
+    }
+    stats.rejectedLines = reader.get_rejectedLines();
+    stats.batchBytes = arena.get_peak();
+
+    const bool written = writer.flush();
+    return written && !reader.failed();
+}
+
+bool streamDecodeArrow(FILE *in, inputFormat input, FILE *out, streamStats &stats, parallelDecoder *pool,
+                       const streamMemory &memory, uint32_t receivedAt)
+{
+    frameReader reader(in, input, pool != nullptr ? PARALLEL_BLOCK_SIZE : 1 << 20, memory.input);
+    reader.set_receivedAt(receivedAt);
+    return streamDecodeArrow(reader, out, stats, pool, memory);
+}
+
+bool streamDecodeArrow(frameReader &reader, FILE *out, streamStats &stats, parallelDecoder *pool,
+                       const streamMemory &memory)
+{
+    stats = streamStats{0, 0, 0, 0, 0};
+
+    arrowWriter writer(out, 1 << 16, memory.output);
+    batchArena arena(ARENA_BLOCK_SIZE, memory.batches);
+
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    while (reader.next(frames, length))
+    {
+        if (pool != nullptr)
+        {
+            /** Workers only decode; the columns are written in chunk order on this thread. */
+            pool->run(frames, length, [&](const decodedChunk &chunk)
+                      {
+                          writer.write(chunk.batch);
+                          stats.frames += chunk.frames;
+                          stats.rows += chunk.batch.size();
+                          stats.rejectedFrames += chunk.batch.errors.size();
+                      });
+            continue;
+        }
+        {
+            payloadBatch batch(&arena);
+            payloadDecoder::decodeBatch(frames, length, batch);
+            writer.write(batch);
+
+            stats.frames += (length + SENSOR_PAYLOAD_SIZE - 1) / SENSOR_PAYLOAD_SIZE;
+            stats.rows += batch.size();
+            stats.rejectedFrames += batch.errors.size();
+        }
+        arena.reset();
+    }
+    stats.rejectedLines = reader.get_rejectedLines();
+    stats.batchBytes = arena.get_peak();
+
+    const bool written = writer.close();
+    return written && !reader.failed();
+}
@@ -0,0 +1,90 @@
+/**
+ * @file streamDecode.h
+ * @brief Streaming decode: frames in, records out, in large chunks.
+ *
+ * Connects frameReader, payloadDecoder::decodeBatch() and recordWriter (or arrowWriter). Used by
+ * the `payloadCoder decode` command to reprocess database exports and TTN dumps.
+ *
+ * Each chunk is decoded into a batch built on a batchArena, which is reset after the chunk is
+ * written (see batchArena.h). streamMemory names the memory resource of each stage, so a caller
+ * can measure the stages with trackingResource; after the first chunks no stage allocates.
+ */
+
+#ifndef STREAMDECODE_H
+#define STREAMDECODE_H
+
+#include <stdint.h> // uint64_t type
+#include <stdio.h>  // FILE
+
+#include "frameReader.h"
+#include "arrowWriter.h"
+#include "batchArena.h"
+#include "parallelDecode.h"
+#include "recordWriter.h"
+
+/// \brief counters collected by streamDecode()
+struct streamStats
+{
+    uint64_t frames;         ///< Frames passed to the decoder
+    uint64_t rows;           ///< Frames decoded and written
+    uint64_t rejectedFrames; ///< Frames rejected by the decoder (wrong size or unknown version)
+    uint64_t rejectedLines;  ///< Text lines that did not hold one frame
+    size_t batchBytes;       ///< Most arena bytes one decoded chunk needed (0 on a worker pool)
+};
+
+/// \brief memory resources of the stages of streamDecode()
+struct streamMemory
+{
+    std::pmr::memory_resource *input = std::pmr::get_default_resource();   ///< Read buffer and converted frames (FILE overloads)
+    std::pmr::memory_resource *batches = std::pmr::get_default_resource(); ///< Blocks of the arena that holds each decoded chunk
+    std::pmr::memory_resource *output = std::pmr::get_default_resource();  ///< Buffers of the writer
+};
+
+/// \brief decode all frames from `in` and write the records to `out`
+/// \param in input file
+/// \param input format of the input
+/// \param out output file
+/// \param output format of the output
+/// \param stats receives the counters
+/// \param pool decode and format on these workers (in blocks of 64 MiB), or nullptr to decode on the calling thread
+/// \param memory memory resources of the stages
+/// \param receivedAt receive time for compact text frames, 0 if unknown (see frameReader::set_receivedAt())
+/// \return false if reading or writing failed
+bool streamDecode(FILE *in, inputFormat input, FILE *out, outputFormat output, streamStats &stats,
+                  parallelDecoder *pool = nullptr, const streamMemory &memory = streamMemory(), uint32_t receivedAt = 0);
+
+/// \brief decode all frames of a reader and write the records to `out`
+/// Same as streamDecode() above, for a reader set up by the caller (for example on a bulkReader).
+/// \param reader frame reader
+/// \param out output file
+/// \param output format of the output
+/// \param stats receives the counters
+/// \param pool decode and format on these workers, or nullptr to decode on the calling thread
+/// \param memory memory resources of the stages (`input` is not used)
+/// \return false if reading or writing failed
+bool streamDecode(frameReader &reader, FILE *out, outputFormat output, streamStats &stats,
+                  parallelDecoder *pool = nullptr, const streamMemory &memory = streamMemory());
+
+/// \brief decode all frames from `in` and write them to `out` as an Arrow IPC file (see arrowWriter.h)
+/// \param in input file
+/// \param input format of the input
+/// \param out output file
+/// \param stats receives the counters
+/// \param pool decode on these workers (in blocks of 64 MiB), or nullptr to decode on the calling thread
+/// \param memory memory resources of the stages
+/// \param receivedAt receive time for compact text frames, 0 if unknown (see frameReader::set_receivedAt())
+/// \return false if reading or writing failed
+bool streamDecodeArrow(FILE *in, inputFormat input, FILE *out, streamStats &stats, parallelDecoder *pool = nullptr,
+                       const streamMemory &memory = streamMemory(), uint32_t receivedAt = 0);
+
+/// \brief decode all frames of a reader and write them to `out` as an Arrow IPC file
+/// \param reader frame reader
+/// \param out output file
+/// \param stats receives the counters
+/// \param pool decode on these workers, or nullptr to decode on the calling thread
+/// \param memory memory resources of the stages (`input` is not used)
+/// \return false if reading or writing failed
+bool streamDecodeArrow(frameReader &reader, FILE *out, streamStats &stats, parallelDecoder *pool = nullptr,
+                       const streamMemory &memory = streamMemory());
+
+#endif // STREAMDECODE_H
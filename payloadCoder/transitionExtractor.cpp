@@ -0,0 +1,142 @@
+#include "transitionExtractor.h"
+#include "encoder.h" // SENSOR_PAYLOAD_SIZE, payloadLayoutV1
+
+static_assert(payloadLayoutV1::offsetOf(payloadFieldId::doorStatus) == PAYLOAD_FLAGS_INDEX * 8 + 5 &&
+                  payloadLayoutV1::offsetOf(payloadFieldId::catchDetect) == PAYLOAD_FLAGS_INDEX * 8 + 6 &&
+                  payloadLayoutV1::offsetOf(payloadFieldId::trapDisplacement) == PAYLOAD_FLAGS_INDEX * 8 + 7,
+              "the flag byte of a version 1 frame must match FLAG_*");
+static_assert(FLAG_DOOR_STATUS == 4 && FLAG_CATCH_DETECT == 2 && FLAG_TRAP_DISPLACEMENT == 1,
+              "transition kinds are derived from the flag bit numbers");
+
+namespace
+{
+    const uint8_t STATE_FLAGS = FLAG_DOOR_STATUS | FLAG_CATCH_DETECT | FLAG_TRAP_DISPLACEMENT; ///< Flags whose changes are tracked
+
+    /// @brief Slot of an id in a table of `mask` + 1 slots.
+    inline size_t slotOf(uint32_t id, size_t mask)
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+}
+
+const char *transitionName(transitionKind kind)
+{
+    switch (kind)
+    {
+    case transitionKind::doorClosed:
+        return "door_closed";
+    case transitionKind::doorOpened:
+        return "door_opened";
+    case transitionKind::catchDetected:
+        return "catch_detected";
+    case transitionKind::catchCleared:
+        return "catch_cleared";
+    case transitionKind::displaced:
+        return "displaced";
+    case transitionKind::displacementCleared:
+        return "displacement_cleared";
+    }
+    return "unknown";
+}
+
+transitionExtractor::transitionExtractor(uint8_t kinds, size_t expectedTraps)
+    : _kinds(kinds), _entries(), _traps(0), _records(0), _late(0), _rejected(0)
+{
+    size_t slots = 16;
+    while (slots < expectedTraps * 2)
+    {
+        slots <<= 1;
+    }
+    _entries.resize(slots, entry{0, 0, {0, 0, 0}, 0, 0});
+}
+
+void transitionExtractor::grow()
+{
+    std::vector<entry> old(_entries.size() * 2, entry{0, 0, {0, 0, 0}, 0, 0});
+    old.swap(_entries);
+    const size_t mask = _entries.size() - 1;
+    for (const entry &e : old)
+    {
+        if (e.used)
+        {
+            size_t slot = slotOf(e.id, mask);
+            while (_entries[slot].used)
+            {
+                slot = (slot + 1) & mask;
+            }
+            _entries[slot] = e;
+        }
+    }
+}
+
+void transitionExtractor::apply(uint32_t id, uint8_t flags, uint32_t unixTime, size_t index, std::vector<trapTransition> &out)
+{
+    _records++;
+    size_t mask = _entries.size() - 1;
+    size_t slot = slotOf(id, mask);
+    while (_entries[slot].used && _entries[slot].id != id)
+    {
+        slot = (slot + 1) & mask;
+    }
+    entry &e = _entries[slot];
+    if (!e.used)
+    {
+        // First record of this trap: it only sets the baseline
+        e = entry{id, unixTime, {unixTime, unixTime, unixTime}, flags, 1};
+        if (++_traps * 2 > _entries.size())
+        {
+            grow();
+        }
+        return;
+    }
+    if (unixTime < e.last)
+    {
+        _late++;
+        return;
+    }
+
+    uint8_t changed = static_cast<uint8_t>(e.flags ^ flags);
+    while (changed != 0)
+    {
+        // Bit 2 is the door, bit 1 the catch, bit 0 the displacement; kinds come in set/cleared pairs
+        const int bit = 31 - __builtin_clz(changed);
+        changed = static_cast<uint8_t>(changed & ~(1u << bit));
+        const transitionKind kind = static_cast<transitionKind>((2 - bit) * 2 + ((flags >> bit) & 1 ? 0 : 1));
+        if (_kinds & transitionBit(kind))
+        {
+            out.push_back(trapTransition{id, kind, unixTime, e.since[bit], e.last, index});
+        }
+        e.since[bit] = unixTime;
+    }
+    e.flags = flags;
+    e.last = unixTime;
+}
+
+size_t transitionExtractor::process(const uint8_t *frames, size_t length, std::vector<trapTransition> &out)
+{
+    typedef payloadBits<payloadLayoutV1::offsetOf(payloadFieldId::id), 32> idBits;
+    typedef payloadBits<payloadLayoutV1::offsetOf(payloadFieldId::unixTime), 32> timeBits;
+    const size_t before = out.size();
+    const size_t count = length / SENSOR_PAYLOAD_SIZE;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *frame = frames + i * SENSOR_PAYLOAD_SIZE;
+        if (frame[PAYLOAD_VERSION_INDEX] != PAYLOAD_VERSION)
+        {
+            _rejected++;
+            continue;
+        }
+        apply(idBits::read(frame), frame[PAYLOAD_FLAGS_INDEX] & STATE_FLAGS, timeBits::read(frame), i, out);
+    }
+    return out.size() - before;
+}
+
+size_t transitionExtractor::process(const payloadBatch &batch, std::vector<trapTransition> &out)
+{
+    const size_t before = out.size();
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        apply(batch.id[i], batch.flags[i] & STATE_FLAGS, batch.unixTime[i], i, out);
+    }
+    return out.size() - before;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file transitionExtractor.h
+ * @brief Streaming filter that turns trap records into door, catch and displacement transitions.
+ *
+ * Most uplinks are heartbeats that repeat the previous state. The extractor keeps the last flags
+ * of every trap and reports only the records in which a flag changed, together with the time the
+ * flag entered its previous state. For raw frames it reads the id, the flag byte
+ * (PAYLOAD_FLAGS_INDEX) and the time straight from the frame without decoding it. Each record
+ * costs one hash lookup and a compare; only the rare changed records do more work.
+ *
+ * The first record of a trap sets its baseline and produces no transition. Records older than
+ * the latest record of their trap are counted as late and skipped, so that reordered uplinks do
+ * not report a state flapping back and forth.
+ *
+ * Usage: create one transitionExtractor per stream and call process() for each block of frames
+ * or each decoded batch.
+ */
+
+#ifndef TRANSITIONEXTRACTOR_H
+#define TRANSITIONEXTRACTOR_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <vector>
+
+#include "payloadBatch.h"
+
+const uint8_t PAYLOAD_FLAGS_INDEX = 5; ///< Byte index of the door/catch/displacement bits in a version 1 frame
+
+/// \brief kind of state change
+enum class transitionKind : uint8_t
+{
+    doorClosed = 0,          ///< Door status false -> true
+    doorOpened = 1,          ///< Door status true -> false
+    catchDetected = 2,       ///< Catch detection false -> true
+    catchCleared = 3,        ///< Catch detection true -> false
+    displaced = 4,           ///< Trap displacement false -> true
+    displacementCleared = 5  ///< Trap displacement true -> false
+};
+
+/// \brief bit of a transition kind in a kind mask
+inline uint8_t transitionBit(transitionKind kind) { return static_cast<uint8_t>(1u << static_cast<uint8_t>(kind)); }
+
+/// \brief kinds reported by default: door closed, catch detected and trap displaced
+const uint8_t DEFAULT_TRANSITIONS = (1u << 0) | (1u << 2) | (1u << 4);
+
+/// \brief all transition kinds
+const uint8_t ALL_TRANSITIONS = 0x3F;
+
+/// \brief name of a transition kind ("door_closed", "catch_detected", ...)
+const char *transitionName(transitionKind kind);
+
+/// \brief one state change of one trap
+struct trapTransition
+{
+    uint32_t id;            ///< Payload id of the trap
+    transitionKind kind;    ///< What changed
+    uint32_t unixTime;      ///< Time of the record with the new state
+    uint32_t previousSince; ///< Time of the first record with the previous state of this flag
+    uint32_t previousLast;  ///< Time of the last record before the change
+    size_t index;           ///< Frame or row index of the record within the processed block
+};
+
+/// \brief last known flags per trap and the transitions between them
+class transitionExtractor
+{
+private:
+    /// \brief state of one trap (open addressing slot)
+    struct entry
+    {
+        uint32_t id;       ///< Payload id
+        uint32_t last;     ///< Time of the latest record
+        uint32_t since[3]; ///< Time each flag entered its current value, indexed by bit number
+        uint8_t flags;     ///< Current flags (FLAG_*)
+        uint8_t used;      ///< 1 if the slot holds a trap
+    };
+
+    uint8_t _kinds;              ///< Reported kinds (mask of transitionBit())
+    std::vector<entry> _entries; ///< Hash table, size a power of two
+    size_t _traps;               ///< Slots in use
+    uint64_t _records;           ///< Records seen
+    uint64_t _late;              ///< Records skipped because they were older than their trap's latest
+    uint64_t _rejected;          ///< Frames skipped because of their version
+
+    /// \brief double the table
+    void grow();
+
+    /// \brief apply one record and append its transitions
+    void apply(uint32_t id, uint8_t flags, uint32_t unixTime, size_t index, std::vector<trapTransition> &out);
+
+public:
+    /// \brief constructor
+    /// \param kinds transition kinds to report (mask of transitionBit() values)
+    /// \param expectedTraps number of traps to reserve room for
+    explicit transitionExtractor(uint8_t kinds = DEFAULT_TRANSITIONS, size_t expectedTraps = 1024);
+
+    /// \brief process back-to-back version 1 frames; frames of other versions are counted and skipped
+    /// \param frames SENSOR_PAYLOAD_SIZE-byte frames
+    /// \param length number of bytes (a trailing partial frame is ignored)
+    /// \param out receives the transitions, in record order
+    /// \return number of transitions appended
+    size_t process(const uint8_t *frames, size_t length, std::vector<trapTransition> &out);
+
+    /// \brief process decoded rows
+    /// \param batch decoded rows (uses the `flags` column)
+    /// \param out receives the transitions, in row order
+    /// \return number of transitions appended
+    size_t process(const payloadBatch &batch, std::vector<trapTransition> &out);
+
+    /// \brief number of traps seen
+    size_t get_traps() const { return _traps; }
+
+    /// \brief number of records seen
+    uint64_t get_records() const { return _records; }
+
+    /// \brief number of records skipped because they were older than their trap's latest record
+    uint64_t get_lateRecords() const { return _late; }
+
+    /// \brief number of frames skipped because their version is not 1
+    uint64_t get_rejectedFrames() const { return _rejected; }
+};
+
+#endif // TRANSITIONEXTRACTOR_H
@@ -0,0 +1,596 @@
+#include "ttnUplink.h"
+#include "base64Codec.h"
+#include "decoder.h" // payloadDecoder::widenFrame
+#include "encoder.h" // SENSOR_PAYLOAD_SIZE
+
+#include <charconv> // std::from_chars
+#include <float.h>  // FLT_MAX
+#include <stdio.h>  // snprintf
+#include <string.h> // memchr, memcpy
+
+namespace
+{
+    /// @brief Read position in the JSON text.
+    struct cursor
+    {
+        const char *p;   ///< Next character
+        const char *end; ///< End of the text
+    };
+
+    /// @brief Skip white space; returns the next character, or 0 at the end of the text.
+    inline char peek(cursor &c)
+    {
+        while (c.p < c.end && (*c.p == ' ' || *c.p == '\n' || *c.p == '\r' || *c.p == '\t'))
+        {
+            c.p++;
+        }
+        return c.p < c.end ? *c.p : 0;
+    }
+
+    /// @brief Consume `expected` after optional white space.
+    inline bool take(cursor &c, char expected)
+    {
+        if (peek(c) != expected)
+        {
+            return false;
+        }
+        c.p++;
+        return true;
+    }
+
+    /// @brief Read a string; `text` receives the characters between the quotes, still escaped.
+    bool readString(cursor &c, std::string_view &text)
+    {
+        if (!take(c, '"'))
+        {
+            return false;
+        }
+        const char *begin = c.p;
+        for (;;)
+        {
+            const char *quote = static_cast<const char *>(memchr(c.p, '"', static_cast<size_t>(c.end - c.p)));
+            if (quote == nullptr)
+            {
+                return false;
+            }
+            /** A quote preceded by an odd number of backslashes is part of the string. */
+            const char *q = quote;
+            while (q > begin && q[-1] == '\\')
+            {
+                q--;
+            }
+            c.p = quote + 1;
+            if ((quote - q) % 2 == 0)
+            {
+                text = std::string_view(begin, static_cast<size_t>(quote - begin));
+                return true;
+            }
+        }
+    }
+
+    /// @brief Read a number, true, false or null as text.
+    bool readScalar(cursor &c, std::string_view &text)
+    {
+        peek(c);
+        const char *begin = c.p;
+        while (c.p < c.end && *c.p != ',' && *c.p != '}' && *c.p != ']' &&
+               *c.p != ' ' && *c.p != '\n' && *c.p != '\r' && *c.p != '\t')
+        {
+            c.p++;
+        }
+        text = std::string_view(begin, static_cast<size_t>(c.p - begin));
+        return c.p > begin;
+    }
+
+    /// @brief Skip any value, including nested objects and arrays.
+    bool skipValue(cursor &c)
+    {
+        std::string_view text;
+        const char first = peek(c);
+        if (first == '"')
+        {
+            return readString(c, text);
+        }
+        if (first != '{' && first != '[')
+        {
+            return readScalar(c, text);
+        }
+
+        /** Nesting is only counted, not checked: the fields of interest are read by the walkers. */
+        int depth = 0;
+        while (c.p < c.end)
+        {
+            const char ch = *c.p;
+            if (ch == '"')
+            {
+                if (!readString(c, text))
+                {
+                    return false;
+                }
+                continue;
+            }
+            c.p++;
+            if (ch == '{' || ch == '[')
+            {
+                depth++;
+            }
+            else if ((ch == '}' || ch == ']') && --depth == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Read a number that may also be written as a string (TTN writes 64-bit values as strings).
+    bool readNumberText(cursor &c, std::string_view &text)
+    {
+        return peek(c) == '"' ? readString(c, text) : readScalar(c, text);
+    }
+
+    /// @brief Parse an integer of type T from the whole of `text`.
+    template <typename T>
+    bool parseInteger(std::string_view text, T &value)
+    {
+        const std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+
+    const int FLOAT_EXPONENT_LIMIT = 45; ///< Decimal exponents beyond this are out of float range
+
+    /// @brief Parse a decimal number such as "-7.25" or "1e-05" (std::from_chars for floats is not available everywhere).
+    /// Numbers too large for a float are rejected, so the exponent loops run at most FLOAT_EXPONENT_LIMIT times.
+    bool parseDecimal(std::string_view text, float &value)
+    {
+        size_t i = 0;
+        const bool negative = i < text.size() && text[i] == '-';
+        i += negative ? 1 : 0;
+        double result = 0;
+        size_t digits = 0;
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++)
+        {
+            result = result * 10 + (text[i] - '0');
+        }
+        if (i < text.size() && text[i] == '.')
+        {
+            double scale = 0.1;
+            for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++, digits++)
+            {
+                result += (text[i] - '0') * scale;
+                scale /= 10;
+            }
+        }
+        if (i < text.size() && (text[i] == 'e' || text[i] == 'E'))
+        {
+            int exponent = 0;
+            size_t start = i + 1 < text.size() && text[i + 1] == '+' ? i + 2 : i + 1;
+            if (!parseInteger(text.substr(start), exponent) || exponent > FLOAT_EXPONENT_LIMIT)
+            {
+                return false;
+            }
+            if (exponent < -FLOAT_EXPONENT_LIMIT)
+            {
+                result = 0; // below the smallest float
+                exponent = 0;
+            }
+            for (; exponent > 0; exponent--)
+            {
+                result *= 10;
+            }
+            for (; exponent < 0; exponent++)
+            {
+                result /= 10;
+            }
+            i = text.size();
+        }
+        if (result > FLT_MAX)
+        {
+            return false;
+        }
+        value = static_cast<float>(negative ? -result : result);
+        return digits > 0 && i == text.size();
+    }
+
+    /// @brief Walk the members of an object; `member(key)` must consume the value.
+    template <typename F>
+    bool walkObject(cursor &c, F member)
+    {
+        if (!take(c, '{'))
+        {
+            return false;
+        }
+        if (take(c, '}'))
+        {
+            return true;
+        }
+        for (;;)
+        {
+            std::string_view key;
+            if (!readString(c, key) || !take(c, ':') || !member(key))
+            {
+                return false;
+            }
+            if (take(c, ','))
+            {
+                continue;
+            }
+            return take(c, '}');
+        }
+    }
+
+    /// @brief Walk the elements of an array; `element()` must consume the value.
+    template <typename F>
+    bool walkArray(cursor &c, F element)
+    {
+        if (!take(c, '['))
+        {
+            return false;
+        }
+        if (take(c, ']'))
+        {
+            return true;
+        }
+        for (;;)
+        {
+            if (!element())
+            {
+                return false;
+            }
+            if (take(c, ','))
+            {
+                continue;
+            }
+            return take(c, ']');
+        }
+    }
+
+    /// @brief Read one rx_metadata entry; keep it if its rssi is the best so far.
+    bool readGateway(cursor &c, ttnUplink &uplink)
+    {
+        std::string_view id;
+        std::string_view eui;
+        std::string_view text;
+        int16_t rssi = INT16_MIN;
+        float snr = 0;
+        const bool ok = walkObject(c, [&](std::string_view key)
+                                   {
+                                       if (key == "gateway_ids")
+                                       {
+                                           return walkObject(c, [&](std::string_view idKey)
+                                                             {
+                                                                 if (idKey == "gateway_id")
+                                                                 {
+                                                                     return readString(c, id);
+                                                                 }
+                                                                 if (idKey == "eui")
+                                                                 {
+                                                                     return readString(c, eui);
+                                                                 }
+                                                                 return skipValue(c);
+                                                             });
+                                       }
+                                       if (key == "rssi")
+                                       {
+                                           return readScalar(c, text) && parseInteger(text, rssi);
+                                       }
+                                       if (key == "snr")
+                                       {
+                                           return readScalar(c, text) && parseDecimal(text, snr);
+                                       }
+                                       return skipValue(c);
+                                   });
+        if (ok && (uplink.gateways == 0 || rssi > uplink.rssi))
+        {
+            uplink.gatewayId = id;
+            uplink.gatewayEui = eui;
+            uplink.rssi = rssi == INT16_MIN ? 0 : rssi;
+            uplink.snr = snr;
+        }
+        uplink.gateways = static_cast<uint8_t>(uplink.gateways < 255 ? uplink.gateways + 1 : 255);
+        return ok;
+    }
+
+    /// @brief Read uplink_message.settings.
+    bool readSettings(cursor &c, ttnUplink &uplink)
+    {
+        std::string_view text;
+        return walkObject(c, [&](std::string_view key)
+                          {
+                              if (key == "frequency")
+                              {
+                                  return readNumberText(c, text) && parseInteger(text, uplink.frequency);
+                              }
+                              if (key != "data_rate")
+                              {
+                                  return skipValue(c);
+                              }
+                              return walkObject(c, [&](std::string_view rateKey)
+                                                {
+                                                    if (rateKey != "lora")
+                                                    {
+                                                        return skipValue(c);
+                                                    }
+                                                    return walkObject(c, [&](std::string_view loraKey)
+                                                                      {
+                                                                          if (loraKey == "spreading_factor")
+                                                                          {
+                                                                              return readScalar(c, text) && parseInteger(text, uplink.sf);
+                                                                          }
+                                                                          return skipValue(c);
+                                                                      });
+                                                });
+                          });
+    }
+
+    /// @brief Read uplink_message.
+    bool readUplinkMessage(cursor &c, ttnUplink &uplink)
+    {
+        std::string_view text;
+        return walkObject(c, [&](std::string_view key)
+                          {
+                              if (key == "frm_payload")
+                              {
+                                  return readString(c, uplink.frmPayload);
+                              }
+                              if (key == "f_cnt")
+                              {
+                                  return readScalar(c, text) && parseInteger(text, uplink.fcnt);
+                              }
+                              if (key == "f_port")
+                              {
+                                  return readScalar(c, text) && parseInteger(text, uplink.port);
+                              }
+                              if (key == "rx_metadata")
+                              {
+                                  return walkArray(c, [&]
+                                                   { return readGateway(c, uplink); });
+                              }
+                              if (key == "settings")
+                              {
+                                  return readSettings(c, uplink);
+                              }
+                              return skipValue(c);
+                          });
+    }
+
+    /// @brief Days since 1970-01-01 of a date in the proleptic Gregorian calendar (H. Hinnant's days_from_civil).
+    int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+    {
+        y -= m <= 2 ? 1 : 0;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    /// @brief Date of a day count since 1970-01-01 (H. Hinnant's civil_from_days).
+    void civilFromDays(int64_t z, int64_t &y, unsigned &m, unsigned &d)
+    {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(z - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2 ? 1 : 0);
+    }
+
+    /// @brief Parse exactly `digits` hex digits.
+    bool parseHex(std::string_view text, size_t digits, uint64_t &value)
+    {
+        if (text.size() != digits)
+        {
+            return false;
+        }
+        value = 0;
+        for (char ch : text)
+        {
+            unsigned nibble;
+            if (ch >= '0' && ch <= '9')
+            {
+                nibble = static_cast<unsigned>(ch - '0');
+            }
+            else if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')
+            {
+                nibble = static_cast<unsigned>((ch | 0x20) - 'a' + 10);
+            }
+            else
+            {
+                return false;
+            }
+            value = value << 4 | nibble;
+        }
+        return true;
+    }
+
+    /// @brief Copy a string view into a null-terminated buffer of `size` bytes, truncating if needed.
+    void copyText(std::string_view text, char *buffer, size_t size)
+    {
+        const size_t length = text.size() < size - 1 ? text.size() : size - 1;
+        memcpy(buffer, text.data(), length);
+        buffer[length] = 0;
+    }
+}
+
+ttnMessage parseTtnUplink(std::string_view json, ttnUplink &uplink)
+{
+    uplink = ttnUplink{};
+    cursor c = {json.data(), json.data() + json.size()};
+    bool isUplink = false;
+    const bool ok = walkObject(c, [&](std::string_view key)
+                               {
+                                   if (key == "end_device_ids")
+                                   {
+                                       return walkObject(c, [&](std::string_view idKey)
+                                                         {
+                                                             if (idKey == "device_id")
+                                                             {
+                                                                 return readString(c, uplink.deviceId);
+                                                             }
+                                                             if (idKey == "dev_eui")
+                                                             {
+                                                                 return readString(c, uplink.devEui);
+                                                             }
+                                                             if (idKey == "dev_addr")
+                                                             {
+                                                                 return readString(c, uplink.devAddr);
+                                                             }
+                                                             return skipValue(c);
+                                                         });
+                                   }
+                                   if (key == "received_at")
+                                   {
+                                       return readString(c, uplink.receivedAt);
+                                   }
+                                   if (key == "uplink_message")
+                                   {
+                                       isUplink = true;
+                                       return readUplinkMessage(c, uplink);
+                                   }
+                                   return skipValue(c);
+                               });
+    if (!ok || peek(c) != 0)
+    {
+        return ttnMessage::malformed;
+    }
+    return isUplink ? ttnMessage::uplink : ttnMessage::other;
+}
+
+bool ttnUplinkFrame(const ttnUplink &uplink, uint8_t *frame)
+{
+    if (uplink.frmPayload.size() == BASE64_FRAME_LENGTH)
+    {
+        return base64ToFrame(uplink.frmPayload.data(), frame);
+    }
+
+    /** A shorter layout (the node's compact frames) is widened with the time the uplink was received. */
+    uint8_t received[SENSOR_PAYLOAD_SIZE];
+    const uint32_t receivedAt = ttnTimeToUnix(uplink.receivedAt);
+    const size_t size = base64DecodedSize(uplink.frmPayload.data(), uplink.frmPayload.size());
+    return receivedAt != 0 && size > 0 && size < SENSOR_PAYLOAD_SIZE &&
+           base64ToBinary(uplink.frmPayload.data(), uplink.frmPayload.size(), received) == size &&
+           payloadDecoder::widenFrame(received, size, receivedAt, frame);
+}
+
+bool uplinkRecordFromTtn(const ttnUplink &uplink, uplinkRecord &record)
+{
+    record = uplinkRecord{};
+    uint64_t devAddr = 0;
+    if (!ttnUplinkFrame(uplink, record.frame) || !parseHex(uplink.devEui, 16, record.devEui))
+    {
+        return false;
+    }
+    if (parseHex(uplink.devAddr, 8, devAddr))
+    {
+        record.devAddr = static_cast<uint32_t>(devAddr);
+    }
+    if (!parseHex(uplink.gatewayEui, 16, record.gatewayEui))
+    {
+        record.gatewayEui = 0;
+    }
+    copyText(uplink.deviceId, record.deviceId, sizeof(record.deviceId));
+    copyText(uplink.gatewayId, record.gatewayId, sizeof(record.gatewayId));
+    record.receivedMs = ttnTimeToUnixMs(uplink.receivedAt);
+    record.fcnt = uplink.fcnt;
+    record.frequency = uplink.frequency;
+    record.rssi = uplink.rssi;
+    record.snr = uplink.snr;
+    record.port = uplink.port;
+    record.sf = uplink.sf;
+    record.gateways = uplink.gateways;
+    return true;
+}
+
+void appendTtnUplink(const uplinkRecord &record, std::string &out)
+{
+    const uint64_t msOfDay = record.receivedMs % 86400000;
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(static_cast<int64_t>(record.receivedMs / 86400000), year, month, day);
+
+    char payload[BASE64_FRAME_LENGTH + 1];
+    binaryToBase64(record.frame, sizeof(record.frame), payload);
+    payload[BASE64_FRAME_LENGTH] = 0;
+
+    /** Only the best gateway is listed in rx_metadata; the other gateways' metadata is not kept. */
+    char line[640];
+    const int length = snprintf(
+        line, sizeof(line),
+        "{\"end_device_ids\":{\"device_id\":\"%s\",\"dev_eui\":\"%016llX\",\"dev_addr\":\"%08lX\"},"
+        "\"received_at\":\"%04lld-%02u-%02uT%02u:%02u:%02u.%03uZ\","
+        "\"uplink_message\":{\"f_port\":%u,\"f_cnt\":%lu,\"frm_payload\":\"%s\","
+        "\"rx_metadata\":[{\"gateway_ids\":{\"gateway_id\":\"%s\",\"eui\":\"%016llX\"},"
+        "\"rssi\":%d,\"channel_rssi\":%d,\"snr\":%.2f}],"
+        "\"settings\":{\"data_rate\":{\"lora\":{\"bandwidth\":125000,\"spreading_factor\":%u,\"coding_rate\":\"4/5\"}},"
+        "\"frequency\":\"%lu\"}}}\n",
+        record.deviceId, static_cast<unsigned long long>(record.devEui), static_cast<unsigned long>(record.devAddr),
+        static_cast<long long>(year), month, day,
+        static_cast<unsigned>(msOfDay / 3600000), static_cast<unsigned>(msOfDay / 60000 % 60),
+        static_cast<unsigned>(msOfDay / 1000 % 60), static_cast<unsigned>(msOfDay % 1000),
+        record.port, static_cast<unsigned long>(record.fcnt), payload,
+        record.gatewayId, static_cast<unsigned long long>(record.gatewayEui),
+        record.rssi, record.rssi, static_cast<double>(record.snr),
+        record.sf, static_cast<unsigned long>(record.frequency));
+    if (length > 0)
+    {
+        out.append(line, static_cast<size_t>(length) < sizeof(line) ? static_cast<size_t>(length) : sizeof(line) - 1);
+    }
+}
+
+uint64_t ttnTimeToUnixMs(std::string_view text)
+{
+    const uint32_t seconds = ttnTimeToUnix(text);
+    if (seconds == 0)
+    {
+        return 0;
+    }
+    unsigned ms = 0;
+    if (text.size() > 19 && text[19] == '.')
+    {
+        unsigned scale = 100;
+        for (size_t i = 20; i < text.size() && scale > 0 && text[i] >= '0' && text[i] <= '9'; i++, scale /= 10)
+        {
+            ms += static_cast<unsigned>(text[i] - '0') * scale;
+        }
+    }
+    return static_cast<uint64_t>(seconds) * 1000 + ms;
+}
+
+uint32_t ttnTimeToUnix(std::string_view text)
+{
+    /** "YYYY-MM-DDTHH:MM:SS", then optional fraction and 'Z'. */
+    const char pattern[] = "0000-00-00T00:00:00";
+    if (text.size() < sizeof(pattern) - 1)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(pattern) - 1; i++)
+    {
+        const bool digit = text[i] >= '0' && text[i] <= '9';
+        if (pattern[i] == '0' ? !digit : text[i] != pattern[i])
+        {
+            return 0;
+        }
+    }
+    auto number = [&text](size_t at, size_t digits)
+    {
+        unsigned value = 0;
+        for (size_t i = at; i < at + digits; i++)
+        {
+            value = value * 10 + static_cast<unsigned>(text[i] - '0');
+        }
+        return value;
+    };
+    const unsigned month = number(5, 2);
+    const unsigned day = number(8, 2);
+    if (month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        return 0;
+    }
+    const int64_t seconds = daysFromCivil(number(0, 4), month, day) * 86400 +
+                            number(11, 2) * 3600 + number(14, 2) * 60 + number(17, 2);
+    return seconds > 0 && seconds <= UINT32_MAX ? static_cast<uint32_t>(seconds) : 0;
+}
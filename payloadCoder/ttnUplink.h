@@ -0,0 +1,110 @@
+/**
+ * @file ttnUplink.h
+ * @brief Allocation-free parser for TTN v3 uplink messages (webhook and MQTT JSON).
+ *
+ * A TTN v3 uplink is a JSON document of a few KB, of which only a handful of fields end up in
+ * the `muskrattrap` table. The parser walks the document once, picks out those fields and skips
+ * everything else without building a tree. Strings are returned as views into the input and
+ * are not unescaped; none of the fields used here contain escapes.
+ *
+ * Fields read (paths as in the TTN v3 data format):
+ * - end_device_ids.device_id, end_device_ids.dev_eui, end_device_ids.dev_addr
+ * - received_at
+ * - uplink_message.f_port, uplink_message.f_cnt, uplink_message.frm_payload
+ * - uplink_message.rx_metadata[].gateway_ids.gateway_id, .gateway_ids.eui, .rssi, .snr
+ * - uplink_message.settings.frequency, uplink_message.settings.data_rate.lora.spreading_factor
+ */
+
+#ifndef TTNUPLINK_H
+#define TTNUPLINK_H
+
+#include <stdint.h> // uint8_t, int16_t, uint32_t and uint64_t type
+#include <string>
+#include <string_view>
+
+#include "../nodeCode/payloadSchema.h"
+
+/// \brief fields of one TTN v3 uplink; string views point into the parsed text
+struct ttnUplink
+{
+    std::string_view deviceId = {};   ///< end_device_ids.device_id (devID column)
+    std::string_view devEui = {};     ///< end_device_ids.dev_eui
+    std::string_view devAddr = {};    ///< end_device_ids.dev_addr
+    std::string_view receivedAt = {}; ///< received_at, RFC 3339 in UTC
+    std::string_view frmPayload = {}; ///< uplink_message.frm_payload, base64
+    std::string_view gatewayId = {};  ///< gateway_ids.gateway_id of the gateway with the best rssi
+    std::string_view gatewayEui = {}; ///< gateway_ids.eui of that gateway
+    uint32_t fcnt = 0;                ///< Frame counter (TTN leaves out f_cnt when it is 0)
+    uint32_t frequency = 0;           ///< Uplink frequency in Hz
+    int16_t rssi = 0;                 ///< Best rssi over all gateways in dBm
+    float snr = 0.0f;                 ///< Signal to noise ratio at that gateway in dB
+    uint8_t port = 0;                 ///< LoRaWAN FPort
+    uint8_t sf = 0;                   ///< Spreading factor
+    uint8_t gateways = 0;             ///< Number of gateways that received the uplink (saturates at 255)
+};
+
+/// \brief fields of one uplink copied out of the message text, for stages that keep uplinks
+/// longer than the text they were parsed from (deduplication, reordering, bulk loading)
+struct uplinkRecord
+{
+    char deviceId[37] = {};                     ///< end_device_ids.device_id, null-terminated (TTN allows 36 characters)
+    char gatewayId[37] = {};                    ///< gateway_id of the gateway with the best rssi, null-terminated
+    uint64_t devEui = 0;                        ///< end_device_ids.dev_eui
+    uint64_t gatewayEui = 0;                    ///< eui of that gateway
+    uint64_t receivedMs = 0;                    ///< received_at in ms since 1970-01-01, 0 if missing
+    uint32_t devAddr = 0;                       ///< end_device_ids.dev_addr
+    uint32_t fcnt = 0;                          ///< Frame counter
+    uint32_t frequency = 0;                     ///< Uplink frequency in Hz
+    int16_t rssi = 0;                           ///< Best rssi over all gateways in dBm
+    float snr = 0.0f;                           ///< Signal to noise ratio at that gateway in dB
+    uint8_t port = 0;                           ///< LoRaWAN FPort
+    uint8_t sf = 0;                             ///< Spreading factor
+    uint8_t gateways = 0;                       ///< Number of gateways that received the uplink (saturates at 255)
+    uint8_t frame[payloadCodecV1::size] = {};   ///< Decoded frm_payload
+};
+
+/// \brief kind of message found by parseTtnUplink()
+enum class ttnMessage : uint8_t
+{
+    uplink,   ///< Uplink message; the fields are filled in
+    other,    ///< Valid JSON object without uplink_message (join accept, downlink event, ...)
+    malformed ///< Not a JSON object, or a field of the wrong type
+};
+
+/// \brief parse one TTN v3 message
+/// \param json message text, for example one line of a newline-delimited stream
+/// \param uplink receives the fields; fields missing from the message are zero or empty
+/// \return kind of message
+ttnMessage parseTtnUplink(std::string_view json, ttnUplink &uplink);
+
+/// \brief decode the frm_payload of an uplink
+/// Compact (version 2) frames are widened to the full layout, with the time completed from
+/// received_at (see payloadDecoder::widenFrame()).
+/// \param uplink parsed uplink
+/// \param frame buffer receiving SENSOR_PAYLOAD_SIZE bytes
+/// \return false if frm_payload does not hold exactly one frame, or a compact frame has no received_at
+bool ttnUplinkFrame(const ttnUplink &uplink, uint8_t *frame);
+
+/// \brief copy the fields of a parsed uplink
+/// \param uplink parsed uplink
+/// \param record receives the fields
+/// \return false if frm_payload does not hold exactly one frame or dev_eui is not 16 hex digits
+bool uplinkRecordFromTtn(const ttnUplink &uplink, uplinkRecord &record);
+
+/// \brief append a record as a single-line TTN v3 uplink message that parseTtnUplink() reads back
+/// Only the best gateway is written, so `gateways` reads back as 1.
+/// \param record uplink fields
+/// \param out receives the message and a newline
+void appendTtnUplink(const uplinkRecord &record, std::string &out);
+
+/// \brief convert a TTN timestamp to unix time in milliseconds
+/// \param text RFC 3339 timestamp in UTC; digits beyond milliseconds are ignored
+/// \return milliseconds since 1970-01-01, or 0 if `text` is not a timestamp
+uint64_t ttnTimeToUnixMs(std::string_view text);
+
+/// \brief convert a TTN timestamp ("2024-05-01T12:00:00.123456789Z") to unix time
+/// \param text RFC 3339 timestamp in UTC; fractional seconds are ignored
+/// \return seconds since 1970-01-01, or 0 if `text` is not a timestamp
+uint32_t ttnTimeToUnix(std::string_view text);
+
+#endif // TTNUPLINK_H
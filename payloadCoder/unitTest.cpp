@@ -1,7 +1,44 @@
 #include "unitTest.h"
 #include "encoder.h"
 #include "decoder.h"
+#include "decodeKernels.h"
+#include "hexCodec.h"
+#include "base64Codec.h"
+#include "streamDecode.h"
+#include "archiveSegment.h"
+#include "parallelDecode.h"
+#include "ttnUplink.h"
+#include "payloadRegistry.h"
+#include "fleetGenerator.h"
+#include "fleetState.h"
+#include "transitionExtractor.h"
+#include "batteryTrend.h"
+#include "uplinkDedup.h"
+#include "uplinkOrder.h"
+#include "bulkLoadWriter.h"
+#include "arrowWriter.h"
+#include "webhookServer.h"
+#include "bulkReader.h"
+#include "shardPipeline.h"
+#include "batchArena.h"
+#include "asyncIngest.h"
 
+#include <stdio.h>  // tmpfile, fread, fwrite
+#include <stdlib.h> // mkstemp, mkdtemp
+#include <fcntl.h>  // open, O_NONBLOCK
+#include <poll.h>   // poll
+#include <string.h> // memcpy
+#include <unistd.h> // access, close, pipe2, read, rmdir, truncate, unlink, write
+#include <arpa/inet.h>  // htons, htonl
+#include <netinet/in.h> // sockaddr_in
+#include <sys/socket.h> // socket, connect, send
+#include <sys/wait.h>   // waitpid
+#include <algorithm> // std::min, std::sort, std::stable_sort
+#include <atomic>
+#include <cmath>  // std::lround, std::isinf
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <iostream> // cout, endl // debugging only
 #include <iomanip>  // setw for table formatting
 
@@ -220,3 +257,2719 @@ void test03()
         cout << "---" << endl;
     }
 }
+
+/**
+ * @brief Test case for payloadDecoder::decodeBatch().
+ *
+ * Frames are encoded back-to-back; frame 2 gets an unknown version and a 5 byte
+ * fragment is appended to the end of the buffer.
+ */
+void test04()
+{
+    cout << endl
+         << "Test 4 results (Batch decode)" << endl;
+
+    const size_t frameCount = 5;
+    payloadEncoder encoder;
+    std::vector<uint8_t> frames(frameCount * SENSOR_PAYLOAD_SIZE + 5, 0);
+
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        encoder.set_id(1000 + i);
+        encoder.set_version(PAYLOAD_VERSION);
+        encoder.set_doorStatus(i & 1);
+        encoder.set_catchDetect(i & 2);
+        encoder.set_trapDisplacement(i & 4);
+        encoder.set_batteryStatus(10 * i);
+        encoder.set_unixTime(1717891200 + i);
+        encoder.composePayload();
+        memcpy(&frames[i * SENSOR_PAYLOAD_SIZE], encoder.getPayload(), encoder.getPayloadSize());
+    }
+    frames[2 * SENSOR_PAYLOAD_SIZE + 4] = 99; // unknown version
+
+    payloadBatch batch;
+    size_t rows = payloadDecoder::decodeBatch(frames.data(), frames.size(), batch);
+
+    printTestResult("  rows", frameCount - 1, rows);
+    printTestResult("  errors", 2, batch.errors.size());
+    printTestResult("  error0 index", 2, batch.errors[0].index);
+    printTestResult("  error0 reason", static_cast<int>(decodeError::unknownVersion), static_cast<int>(batch.errors[0].reason));
+    printTestResult("  error1 index", frameCount, batch.errors[1].index);
+    printTestResult("  error1 reason", static_cast<int>(decodeError::wrongSize), static_cast<int>(batch.errors[1].reason));
+
+    const size_t expected[] = {0, 1, 3, 4}; // input frames that must appear as rows
+    for (size_t row = 0; row < batch.size(); ++row)
+    {
+        const size_t i = expected[row];
+        printTestResult("  id", 1000 + i, batch.id[row]);
+        printTestResult("  doorStatus", (i & 1) != 0, batch.doorStatus[row]);
+        printTestResult("  catchDetect", (i & 2) != 0, batch.catchDetect[row]);
+        printTestResult("  trapDisplacement", (i & 4) != 0, batch.trapDisplacement[row]);
+        printTestResult("  batteryStatus", 10 * i, batch.battery[row]);
+        printTestResult("  unixTime", 1717891200 + i, batch.unixTime[row]);
+    }
+
+    // Separately stored frames: one frame has the wrong size
+    const uint8_t *framePtrs[] = {&frames[0], &frames[SENSOR_PAYLOAD_SIZE], &frames[3 * SENSOR_PAYLOAD_SIZE]};
+    const size_t frameSizes[] = {SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE - 1, SENSOR_PAYLOAD_SIZE};
+    batch.clear();
+    rows = payloadDecoder::decodeBatch(framePtrs, frameSizes, 3, batch);
+    printTestResult("  list rows", 2, rows);
+    printTestResult("  list error index", 1, batch.errors.size() == 1 ? batch.errors[0].index : 99);
+    printTestResult("  list id", 1003, batch.id[1]);
+}
+
+/**
+ * @brief Test case for the SIMD batch decode kernels.
+ *
+ * Every supported kernel must produce exactly the same columns and errors as the scalar kernel.
+ */
+void test05()
+{
+    cout << endl
+         << "Test 5 results (Decode kernels, active: " << activeDecodeKernelName() << ")" << endl;
+
+    // Pseudo-random frames; every 37th frame gets an unknown version
+    const size_t frameCount = 1001;
+    std::vector<uint8_t> frames(frameCount * SENSOR_PAYLOAD_SIZE);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        frames[i] = static_cast<uint8_t>(seed >> 16);
+    }
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        frames[i * SENSOR_PAYLOAD_SIZE + 4] = (i % 37 == 36) ? 2 : PAYLOAD_VERSION;
+    }
+
+    selectDecodeKernel(decodeKernel::scalar);
+    payloadBatch reference;
+    payloadDecoder::decodeBatch(frames.data(), frames.size(), reference);
+
+    const decodeKernel kernels[] = {decodeKernel::sse41, decodeKernel::avx2};
+    for (decodeKernel kernel : kernels)
+    {
+        if (!selectDecodeKernel(kernel))
+        {
+            continue;
+        }
+        payloadBatch batch;
+        payloadDecoder::decodeBatch(frames.data(), frames.size(), batch);
+
+        const bool same = batch.id == reference.id &&
+                          batch.version == reference.version &&
+                          batch.flags == reference.flags &&
+                          batch.battery == reference.battery &&
+                          batch.unixTime == reference.unixTime &&
+                          batch.doorStatus == reference.doorStatus &&
+                          batch.catchDetect == reference.catchDetect &&
+                          batch.trapDisplacement == reference.trapDisplacement;
+        printTestResult(std::string("  ") + activeDecodeKernelName() + " rows", reference.size(), batch.size());
+        printTestResult(std::string("  ") + activeDecodeKernelName() + " errors", reference.errors.size(), batch.errors.size());
+        printTestResult(std::string("  ") + activeDecodeKernelName() + " columns", 1, same);
+    }
+    printTestResult("  scalar rows", frameCount - frameCount / 37, reference.size());
+    selectDecodeKernel(decodeKernel::automatic);
+}
+
+/**
+ * @brief Test case for payloadEncoder::encodeInto() and payloadEncoder::encodeBatch().
+ */
+void test06()
+{
+    cout << endl
+         << "Test 6 results (Heap-free encoding)" << endl;
+
+    payloadEncoder encoder;
+    encoder.set_id(42);
+    encoder.set_version(PAYLOAD_VERSION);
+    encoder.set_doorStatus(true);
+    encoder.set_catchDetect(false);
+    encoder.set_trapDisplacement(true);
+    encoder.set_batteryStatus(88);
+    encoder.set_unixTime(1717891234);
+    encoder.composePayload();
+
+    uint8_t out[SENSOR_PAYLOAD_SIZE];
+    memset(out, 0xFF, sizeof(out)); // stale data must not leak into the flag byte
+    const uint8_t written = encoder.encodeInto(out, sizeof(out));
+    printTestResult("  encodeInto size", SENSOR_PAYLOAD_SIZE, written);
+    printTestResult("  encodeInto bytes", 0, memcmp(out, encoder.getPayload(), SENSOR_PAYLOAD_SIZE));
+    printTestResult("  flag byte", FLAG_DOOR_STATUS | FLAG_TRAP_DISPLACEMENT, out[5]);
+    printTestResult("  too small", 0, encoder.encodeInto(out, SENSOR_PAYLOAD_SIZE - 1));
+
+    // Round trip a batch through encodeBatch() and decodeBatch()
+    payloadBatch batch;
+    const size_t rows = 100;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        batch.id.push_back(static_cast<uint32_t>(i * 2654435761U));
+        batch.version.push_back(PAYLOAD_VERSION);
+        batch.flags.push_back(i & 7);
+        batch.battery.push_back(i % 101);
+        batch.unixTime.push_back(1717891200 + 60 * i);
+    }
+    std::vector<uint8_t> frames(rows * SENSOR_PAYLOAD_SIZE);
+    printTestResult("  encodeBatch rows", rows, payloadEncoder::encodeBatch(batch, frames.data(), frames.size()));
+    printTestResult("  encodeBatch capped", 3, payloadEncoder::encodeBatch(batch, frames.data(), 3 * SENSOR_PAYLOAD_SIZE + 5));
+
+    payloadBatch decoded;
+    payloadDecoder::decodeBatch(frames.data(), frames.size(), decoded);
+    const bool same = decoded.id == batch.id && decoded.flags == batch.flags &&
+                      decoded.battery == batch.battery && decoded.unixTime == batch.unixTime;
+    printTestResult("  batch round trip", 1, same);
+
+    // A row decoded from a compact frame is written in the full layout, as version 1
+    batch.version[0] = PAYLOAD_VERSION_COMPACT;
+    payloadEncoder::encodeBatch(batch, frames.data(), SENSOR_PAYLOAD_SIZE);
+    payloadBatch widened;
+    payloadDecoder::decodeBatch(frames.data(), SENSOR_PAYLOAD_SIZE, widened);
+    printTestResult("  encodeBatch version", 1, widened.size() == 1 && widened.version[0] == PAYLOAD_VERSION &&
+                                                    widened.unixTime[0] == batch.unixTime[0]);
+}
+
+/**
+ * @brief Test case for the compile-time payload schema in payloadSchema.h.
+ */
+void test07()
+{
+    cout << endl
+         << "Test 7 results (Payload schema)" << endl;
+
+    printTestResult("  size", 11, payloadCodecV1::size);
+    printTestResult("  version offset", 32, payloadLayoutV1::offsetOf(payloadFieldId::version));
+    printTestResult("  door offset", 45, payloadLayoutV1::offsetOf(payloadFieldId::doorStatus));
+    printTestResult("  battery offset", 48, payloadLayoutV1::offsetOf(payloadFieldId::batteryStatus));
+    printTestResult("  unixTime offset", 56, payloadLayoutV1::offsetOf(payloadFieldId::unixTime));
+
+    // Reference frame written out by hand from the layout table in docs/iot-node-details.md
+    const uint8_t reference[] = {0x01, 0x02, 0x03, 0x04, 0x01, 0x05, 0x64, 0x0A, 0x0B, 0x0C, 0x0D};
+
+    payloadEncoder encoder;
+    encoder.set_id(0x01020304);
+    encoder.set_version(1);
+    encoder.set_doorStatus(true);
+    encoder.set_catchDetect(false);
+    encoder.set_trapDisplacement(true);
+    encoder.set_batteryStatus(100);
+    encoder.set_unixTime(0x0A0B0C0D);
+    encoder.composePayload();
+    printTestResult("  encoded bytes", 0, memcmp(encoder.getPayload(), reference, sizeof(reference)));
+
+    payloadDecoder decoder;
+    decoder.decodePayload(reference, sizeof(reference));
+    printTestResult("  id", 0x01020304, decoder.get_id());
+    printTestResult("  doorStatus", 1, decoder.get_doorStatus());
+    printTestResult("  catchDetect", 0, decoder.get_catchDetect());
+    printTestResult("  trapDisplacement", 1, decoder.get_trapDisplacement());
+    printTestResult("  batteryStatus", 100, decoder.get_batteryStatus());
+    printTestResult("  unixTime", 0x0A0B0C0D, decoder.get_unixTime());
+}
+
+/**
+ * @brief Test case for the streaming decode command.
+ */
+void test08()
+{
+    cout << endl
+         << "Test 8 results (Streaming decode)" << endl;
+
+    // Same reference frame as test 7
+    const uint8_t reference[] = {0x01, 0x02, 0x03, 0x04, 0x01, 0x05, 0x64, 0x0A, 0x0B, 0x0C, 0x0D};
+    uint8_t frame[SENSOR_PAYLOAD_SIZE];
+
+    char hex[2 * SENSOR_PAYLOAD_SIZE];
+    binaryToHex(reference, sizeof(reference), hex);
+    printTestResult("  binaryToHex", 0, memcmp(hex, "010203040105640A0B0C0D", sizeof(hex)));
+    printTestResult("  hexToBinary", 1, hexToBinary("010203040105640a0b0c0d", 22, frame));
+    printTestResult("  hex bytes", 0, memcmp(frame, reference, sizeof(frame)));
+    printTestResult("  hex invalid", 0, hexToBinary("010203040105640a0b0c0g", 22, frame));
+    printTestResult("  hex odd length", 0, hexToBinary("010203040105640a0b0c0", 21, frame));
+
+    printTestResult("  base64 size", SENSOR_PAYLOAD_SIZE, base64DecodedSize("AQIDBAEFZAoLDA0=", 16));
+    memset(frame, 0, sizeof(frame));
+    printTestResult("  base64 decode", SENSOR_PAYLOAD_SIZE, base64ToBinary("AQIDBAEFZAoLDA0=", 16, frame));
+    printTestResult("  base64 bytes", 0, memcmp(frame, reference, sizeof(frame)));
+    printTestResult("  base64 invalid", 0, base64ToBinary("AQIDBAEFZAoLD*0=", 16, frame));
+
+    // Hex lines: separators, a bad line, an unknown version and a CRLF line ending
+    const char input[] = "01 02 03 04 01 05 64 0A 0B 0C 0D\n"
+                         "\n"
+                         "not a frame\n"
+                         "0000002A63000000000000\n"
+                         "0000002A0107580000003C\r\n";
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    if (in == nullptr || out == nullptr)
+    {
+        printTestResult("  tmpfile", 1, 0);
+        return;
+    }
+    fwrite(input, 1, sizeof(input) - 1, in);
+    rewind(in);
+
+    streamStats stats;
+    printTestResult("  stream ok", 1, streamDecode(in, inputFormat::hex, out, outputFormat::csv, stats));
+    printTestResult("  frames", 3, stats.frames);
+    printTestResult("  rows", 2, stats.rows);
+    printTestResult("  rejected frames", 1, stats.rejectedFrames);
+    printTestResult("  bad lines", 1, stats.rejectedLines);
+
+    const char expected[] = "id,version,doorStatus,catchDetect,trapDisplacement,batteryStatus,unixTime\n"
+                            "16909060,1,1,0,1,100,168496141\n"
+                            "42,1,1,1,1,88,60\n";
+    char written[256] = {0};
+    rewind(out);
+    const size_t length = fread(written, 1, sizeof(written) - 1, out);
+    printTestResult("  csv length", sizeof(expected) - 1, length);
+    printTestResult("  csv text", 0, strcmp(written, expected));
+    fclose(in);
+    fclose(out);
+
+    // Raw input read in chunks that split frames: every frame must come out once, in order
+    in = tmpfile();
+    const size_t frameCount = 50;
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        uint8_t raw[SENSOR_PAYLOAD_SIZE];
+        memcpy(raw, reference, sizeof(raw));
+        raw[3] = static_cast<uint8_t>(i);
+        fwrite(raw, 1, sizeof(raw), in);
+    }
+    rewind(in);
+    frameReader reader(in, inputFormat::raw, 50);
+    payloadBatch batch;
+    const uint8_t *frames = nullptr;
+    size_t blockLength = 0;
+    while (reader.next(frames, blockLength))
+    {
+        payloadDecoder::decodeBatch(frames, blockLength, batch);
+    }
+    fclose(in);
+    bool ordered = batch.size() == frameCount;
+    for (size_t i = 0; ordered && i < frameCount; ++i)
+    {
+        ordered = batch.id[i] == (0x01020300u | static_cast<uint32_t>(i));
+    }
+    printTestResult("  chunked rows", frameCount, batch.size());
+    printTestResult("  chunked order", 1, ordered);
+}
+
+/**
+ * @brief Test case for archive segments.
+ */
+void test09()
+{
+    cout << endl
+         << "Test 9 results (Archive segments)" << endl;
+
+    char path[] = "/tmp/payloadCoderSegmentXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        printTestResult("  mkstemp", 1, 0);
+        return;
+    }
+    close(fd);
+
+    // Three traps, interleaved, with trap 7 arriving out of time order
+    const uint32_t ids[] = {7, 3, 7, 9, 7, 3};
+    const uint32_t times[] = {500, 100, 300, 50, 400, 200};
+    payloadEncoder encoder;
+    segmentWriter writer;
+    printTestResult("  create", 1, writer.create(path));
+    for (size_t i = 0; i < 6; ++i)
+    {
+        encoder.set_id(ids[i]);
+        encoder.set_version(PAYLOAD_VERSION);
+        encoder.set_batteryStatus(static_cast<uint8_t>(i));
+        encoder.set_unixTime(times[i]);
+        encoder.composePayload();
+        writer.append(encoder.getPayload(), uplinkMeta{static_cast<uint32_t>(1000 + i), static_cast<uint32_t>(i), -90, 7});
+    }
+    printTestResult("  seal", 1, writer.close());
+
+    segmentReader reader;
+    printTestResult("  open", 1, reader.open(path));
+    printTestResult("  sealed", 1, reader.sealed());
+    printTestResult("  records", 6, reader.size());
+    printTestResult("  traps", 3, reader.indexEnd() - reader.indexBegin());
+    printTestResult("  record rssi", -90, reader.records()[2].rssi);
+
+    const archiveIndexEntry *entry = reader.findTrap(7);
+    printTestResult("  trap 7 found", 1, entry != nullptr);
+    printTestResult("  trap 7 count", 3, entry ? entry->count : 0);
+    printTestResult("  trap 7 min", 300, entry ? entry->minTime : 0);
+    printTestResult("  trap 7 max", 500, entry ? entry->maxTime : 0);
+    printTestResult("  trap 8 missing", 1, reader.findTrap(8) == nullptr);
+
+    std::vector<const archiveRecord *> records;
+    reader.collectTrap(7, records);
+    printTestResult("  arrival order", 1, records.size() == 3 && records[0]->fcnt == 0 && records[1]->fcnt == 2 && records[2]->fcnt == 4);
+
+    // History is ordered by payload time
+    const segmentReader *segments[] = {&reader};
+    payloadBatch history;
+    printTestResult("  history rows", 3, trapHistory(segments, 1, 7, history));
+    printTestResult("  history order", 1, history.unixTime == std::pmr::vector<uint32_t>{300, 400, 500});
+
+    // Without the footer the reader falls back to scanning the records
+    reader.close();
+    const int truncated = truncate(path, sizeof(archiveHeader) + 6 * sizeof(archiveRecord));
+    printTestResult("  unsealed open", 1, truncated == 0 && reader.open(path));
+    printTestResult("  unsealed", 0, reader.sealed());
+    records.clear();
+    printTestResult("  unsealed scan", 2, reader.collectTrap(3, records));
+    reader.close();
+    unlink(path);
+
+    // Signal to noise ratios beyond the int8_t field are clamped
+    ttnUplink uplink;
+    uplink.snr = 1e6f;
+    const int8_t high = uplinkMetaOf(encoder.getPayload(), &uplink).snr;
+    uplink.snr = -300.0f;
+    const int8_t low = uplinkMetaOf(encoder.getPayload(), &uplink).snr;
+    uplink.snr = -7.6f;
+    const int8_t rounded = uplinkMetaOf(encoder.getPayload(), &uplink).snr;
+    printTestResult("  snr clamped", 1, high == INT8_MAX && low == INT8_MIN && rounded == -8);
+}
+
+/**
+ * @brief Test case for the parallel decode pipeline.
+ */
+void test10()
+{
+    cout << endl
+         << "Test 10 results (Parallel decode)" << endl;
+
+    // Pseudo-random frames with unknown versions and a trailing partial frame
+    const size_t frameCount = 5000;
+    std::vector<uint8_t> frames(frameCount * SENSOR_PAYLOAD_SIZE + 3);
+    uint32_t seed = 777;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        frames[i] = static_cast<uint8_t>(seed >> 16);
+    }
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        frames[i * SENSOR_PAYLOAD_SIZE + 4] = (i % 101 == 5) ? 0xEE : PAYLOAD_VERSION;
+    }
+
+    payloadBatch reference;
+    payloadDecoder::decodeBatch(frames.data(), frames.size(), reference);
+
+    // Small chunks and more workers than cores, so that windows, stealing and the merge are exercised
+    parallelDecoder pool(4, 37);
+    payloadBatch batch;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        batch.clear();
+        pool.decode(frames.data(), frames.size(), batch);
+    }
+    bool sameErrors = batch.errors.size() == reference.errors.size();
+    for (size_t i = 0; sameErrors && i < batch.errors.size(); ++i)
+    {
+        sameErrors = batch.errors[i].index == reference.errors[i].index && batch.errors[i].reason == reference.errors[i].reason;
+    }
+    printTestResult("  rows", reference.size(), batch.size());
+    printTestResult("  columns", 1, batch.id == reference.id && batch.flags == reference.flags &&
+                                         batch.battery == reference.battery && batch.unixTime == reference.unixTime);
+    printTestResult("  errors", 1, sameErrors);
+
+    uint64_t framesDone = 0;
+    for (const workerReport &report : pool.reports())
+    {
+        framesDone += report.frames;
+    }
+    printTestResult("  worker frames", 2 * (frameCount + 1), framesDone);
+
+    // Formatted output must equal the single-threaded writer
+    pool.set_outputFormat(outputFormat::json);
+    std::string parallelText;
+    pool.run(frames.data(), frames.size(), [&parallelText](const decodedChunk &chunk)
+             { parallelText.append(chunk.text.data(), chunk.text.size()); });
+    recordWriter single(nullptr, outputFormat::json);
+    single.write(reference);
+    printTestResult("  formatted", 1, parallelText == std::string(single.data(), single.size()));
+}
+
+/**
+ * @brief Test case for the SIMD hex converters.
+ */
+void test11()
+{
+    cout << endl
+         << "Test 11 results (Hex kernels, active: " << activeHexKernelName() << ")" << endl;
+
+    std::vector<uint8_t> bytes(300);
+    uint32_t seed = 4242;
+    for (uint8_t &b : bytes)
+    {
+        seed = seed * 1103515245 + 12345;
+        b = static_cast<uint8_t>(seed >> 16);
+    }
+
+    // Scalar reference for every length, including lengths that end mid-block
+    std::vector<std::string> reference;
+    selectHexKernel(decodeKernel::scalar);
+    for (size_t length = 0; length <= bytes.size(); ++length)
+    {
+        std::string text(2 * length, '\0');
+        binaryToHex(bytes.data(), length, &text[0]);
+        reference.push_back(text);
+    }
+
+    const decodeKernel kernels[] = {decodeKernel::scalar, decodeKernel::sse41, decodeKernel::avx2};
+    for (decodeKernel kernel : kernels)
+    {
+        if (!selectHexKernel(kernel))
+        {
+            continue;
+        }
+        bool encodeSame = true;
+        bool decodeSame = true;
+        bool invalidFound = true;
+        for (size_t length = 0; length <= bytes.size(); ++length)
+        {
+            std::string text(2 * length, '\0');
+            binaryToHex(bytes.data(), length, &text[0]);
+            encodeSame = encodeSame && text == reference[length];
+
+            // Lower case must decode to the same bytes
+            for (char &c : text)
+            {
+                c = static_cast<char>(c >= 'A' ? c | 0x20 : c);
+            }
+            std::vector<uint8_t> back(length + 1, 0xAA);
+            decodeSame = decodeSame && hexToBinary(text.data(), text.size(), back.data()) &&
+                         memcmp(back.data(), bytes.data(), length) == 0 && back[length] == 0xAA;
+
+            // One bad character anywhere must be reported
+            if (length > 0)
+            {
+                const char bad[] = {'g', 'G', '/', ':', '@', '`', ' ', '\x80'};
+                std::string broken = text;
+                broken[(length * 7) % broken.size()] = bad[length % sizeof(bad)];
+                invalidFound = invalidFound && !hexToBinary(broken.data(), broken.size(), back.data());
+            }
+        }
+        printTestResult(std::string("  ") + activeHexKernelName() + " encode", 1, encodeSame);
+        printTestResult(std::string("  ") + activeHexKernelName() + " decode", 1, decodeSame);
+        printTestResult(std::string("  ") + activeHexKernelName() + " invalid", 1, invalidFound);
+    }
+    selectHexKernel(decodeKernel::automatic);
+}
+
+void test12()
+{
+    cout << endl
+         << "Test 12 results (Base64 kernels, active: " << activeBase64KernelName() << ")" << endl;
+
+    const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    auto encode = [&alphabet](const uint8_t *in, size_t length)
+    {
+        std::string text;
+        for (size_t i = 0; i < length; i += 3)
+        {
+            const uint32_t b1 = i + 1 < length ? in[i + 1] : 0;
+            const uint32_t b2 = i + 2 < length ? in[i + 2] : 0;
+            const uint32_t triple = (static_cast<uint32_t>(in[i]) << 16) | (b1 << 8) | b2;
+            text += alphabet[(triple >> 18) & 0x3F];
+            text += alphabet[(triple >> 12) & 0x3F];
+            text += i + 1 < length ? alphabet[(triple >> 6) & 0x3F] : '=';
+            text += i + 2 < length ? alphabet[triple & 0x3F] : '=';
+        }
+        return text;
+    };
+
+    std::vector<uint8_t> bytes(3000);
+    uint32_t seed = 777;
+    for (uint8_t &b : bytes)
+    {
+        seed = seed * 1103515245 + 12345;
+        b = static_cast<uint8_t>(seed >> 16);
+    }
+
+    // 100 frames, one per line as in a TTN dump
+    const size_t frames = 100;
+    std::string lines;
+    for (size_t k = 0; k < frames; k++)
+    {
+        lines += encode(bytes.data() + k * SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE) + "\n";
+    }
+
+    // Scalar verdict for every byte value in every position of a frame
+    std::vector<uint8_t> reference;
+    selectBase64Kernel(decodeKernel::scalar);
+    for (size_t pos = 0; pos < BASE64_FRAME_LENGTH; pos++)
+    {
+        for (int c = 0; c < 256; c++)
+        {
+            std::string text = lines.substr(0, BASE64_FRAME_LENGTH);
+            text[pos] = static_cast<char>(c);
+            uint8_t frame[SENSOR_PAYLOAD_SIZE];
+            reference.push_back(base64ToFrame(text.data(), frame) ? frame[std::min<size_t>(pos * 3 / 4, SENSOR_PAYLOAD_SIZE - 1)] : 0xEE);
+        }
+    }
+
+    const decodeKernel kernels[] = {decodeKernel::scalar, decodeKernel::sse41, decodeKernel::avx2};
+    for (decodeKernel kernel : kernels)
+    {
+        if (!selectBase64Kernel(kernel))
+        {
+            continue;
+        }
+
+        // Single frames and every possible character
+        bool charactersSame = true;
+        for (size_t pos = 0; pos < BASE64_FRAME_LENGTH; pos++)
+        {
+            for (int c = 0; c < 256; c++)
+            {
+                std::string text = lines.substr(0, BASE64_FRAME_LENGTH);
+                text[pos] = static_cast<char>(c);
+                uint8_t frame[SENSOR_PAYLOAD_SIZE];
+                const uint8_t result = base64ToFrame(text.data(), frame) ? frame[std::min<size_t>(pos * 3 / 4, SENSOR_PAYLOAD_SIZE - 1)] : 0xEE;
+                charactersSame = charactersSame && result == reference[pos * 256 + static_cast<size_t>(c)];
+            }
+        }
+
+        // Batches of every size, and a batch stopped by a bad frame
+        bool batchSame = true;
+        std::vector<uint8_t> out(frames * SENSOR_PAYLOAD_SIZE + 1);
+        for (size_t count = 0; count <= 20; count++)
+        {
+            out.assign(out.size(), 0xAA);
+            batchSame = batchSame && base64ToFrames(lines.data(), count, BASE64_FRAME_LENGTH + 1, out.data()) == count &&
+                        memcmp(out.data(), bytes.data(), count * SENSOR_PAYLOAD_SIZE) == 0 &&
+                        out[count * SENSOR_PAYLOAD_SIZE] == 0xAA;
+        }
+        std::string broken = lines;
+        broken[13 * (BASE64_FRAME_LENGTH + 1) + 5] = '*';
+        batchSame = batchSame && base64ToFrames(broken.data(), frames, BASE64_FRAME_LENGTH + 1, out.data()) == 13 &&
+                    memcmp(out.data(), bytes.data(), 13 * SENSOR_PAYLOAD_SIZE) == 0;
+
+        // Long texts of every length up to 300 bytes, with and without padding
+        bool textSame = true;
+        for (size_t length = 0; length <= 300; length++)
+        {
+            std::string text = encode(bytes.data(), length);
+            std::vector<uint8_t> back(length + 1, 0xAA);
+            textSame = textSame && base64ToBinary(text.data(), text.size(), back.data()) == length &&
+                       memcmp(back.data(), bytes.data(), length) == 0 && back[length] == 0xAA;
+            while (!text.empty() && text.back() == '=')
+            {
+                text.pop_back();
+            }
+            if (length > 0)
+            {
+                textSame = textSame && base64ToBinary(text.data(), text.size(), back.data()) == length;
+                text[(length * 7) % text.size()] = '-';
+                textSame = textSame && base64ToBinary(text.data(), text.size(), back.data()) == 0;
+            }
+        }
+
+        // A dump with blank, indented, unpadded and bad lines between plain ones
+        std::string dump = lines.substr(0, 40 * (BASE64_FRAME_LENGTH + 1)) + "\n  " +
+                           lines.substr(40 * (BASE64_FRAME_LENGTH + 1), BASE64_FRAME_LENGTH - 1) + "\r\n" +
+                           "AQIDBAEFZAoLDA0*\n" + lines.substr(41 * (BASE64_FRAME_LENGTH + 1));
+        FILE *file = tmpfile();
+        fwrite(dump.data(), 1, dump.size(), file);
+        rewind(file);
+        frameReader reader(file, inputFormat::base64, 64);
+        std::vector<uint8_t> read;
+        const uint8_t *block = nullptr;
+        size_t length = 0;
+        while (reader.next(block, length))
+        {
+            read.insert(read.end(), block, block + length);
+        }
+        fclose(file);
+        const bool readSame = read.size() == frames * SENSOR_PAYLOAD_SIZE &&
+                              memcmp(read.data(), bytes.data(), read.size()) == 0 &&
+                              reader.get_lines() == frames + 1 && reader.get_rejectedLines() == 1;
+
+        printTestResult(std::string("  ") + activeBase64KernelName() + " characters", 1, charactersSame);
+        printTestResult(std::string("  ") + activeBase64KernelName() + " frames", 1, batchSame);
+        printTestResult(std::string("  ") + activeBase64KernelName() + " text", 1, textSame);
+        printTestResult(std::string("  ") + activeBase64KernelName() + " reader", 1, readSame);
+    }
+    selectBase64Kernel(decodeKernel::automatic);
+}
+
+void test13()
+{
+    cout << endl
+         << "Test 13 results (TTN v3 uplink parser)" << endl;
+
+    // Frame of trap 0x01020304: version 1, door and catch set, battery 100, time 1700000001
+    const std::string uplinkText =
+        "{\"end_device_ids\":{\"device_id\":\"trap-0042\",\"application_ids\":{\"application_id\":\"muskrattrap\"},"
+        "\"dev_eui\":\"70B3D57ED0061234\",\"join_eui\":\"0000000000000000\",\"dev_addr\":\"260B1234\"},"
+        "\"correlation_ids\":[\"as:up:01H\",\"gs:uplink:01H\"],\"received_at\":\"2023-11-14T22:13:21.123456789Z\","
+        "\"uplink_message\":{\"session_key_id\":\"AYv\\\"quoted\\\\\",\"f_port\":1,\"f_cnt\":4711,"
+        "\"frm_payload\":\"AQIDBAEGZGVT8QE=\",\"decoded_payload\":{\"nested\":[1,[2,{\"x\":\"]}\"}]]},"
+        "\"rx_metadata\":[{\"gateway_ids\":{\"gateway_id\":\"gw-far\",\"eui\":\"B827EBFFFE000001\"},\"rssi\":-117,\"snr\":-7.25},"
+        "{\"gateway_ids\":{\"gateway_id\":\"gw-near\",\"eui\":\"B827EBFFFE000002\"},\"time\":\"2023-11-14T22:13:21Z\","
+        "\"rssi\":-42,\"channel_rssi\":-42,\"snr\":9.5,\"location\":{\"latitude\":51.98,\"longitude\":5.91}}],"
+        "\"settings\":{\"data_rate\":{\"lora\":{\"bandwidth\":125000,\"spreading_factor\":9,\"coding_rate\":\"4/5\"}},"
+        "\"frequency\":\"868100000\",\"timestamp\":1234},\"consumed_airtime\":\"0.185344s\"}}";
+
+    ttnUplink uplink;
+    printTestResult("  uplink parsed", 1, parseTtnUplink(uplinkText, uplink) == ttnMessage::uplink);
+    printTestResult("  device ids", 1, uplink.deviceId == "trap-0042" && uplink.devEui == "70B3D57ED0061234" && uplink.devAddr == "260B1234");
+    printTestResult("  f_cnt", 4711, static_cast<int>(uplink.fcnt));
+    printTestResult("  f_port", 1, uplink.port);
+    printTestResult("  spreading factor", 9, uplink.sf);
+    printTestResult("  frequency (kHz)", 868100, static_cast<int>(uplink.frequency / 1000));
+    printTestResult("  gateways", 2, uplink.gateways);
+    printTestResult("  best rssi", -42, uplink.rssi);
+    printTestResult("  snr (x4)", 38, static_cast<int>(uplink.snr * 4));
+    printTestResult("  gateway", 1, uplink.gatewayId == "gw-near" && uplink.gatewayEui == "B827EBFFFE000002");
+    printTestResult("  received at", 1, ttnTimeToUnix(uplink.receivedAt) == 1700000001u);
+
+    uint8_t frame[SENSOR_PAYLOAD_SIZE];
+    payloadDecoder decoder;
+    const bool framed = ttnUplinkFrame(uplink, frame);
+    decoder.decodePayload(frame, SENSOR_PAYLOAD_SIZE);
+    printTestResult("  frame id", 0x01020304, framed ? static_cast<int>(decoder.get_id()) : 0);
+    printTestResult("  frame time", 1, framed && decoder.get_unixTime() == 1700000001u);
+
+    const std::string joinText = "{\"end_device_ids\":{\"device_id\":\"trap-0042\"},\"join_accept\":{\"session_key_id\":\"AYv\"}}";
+    printTestResult("  join accept", 1, parseTtnUplink(joinText, uplink) == ttnMessage::other);
+    printTestResult("  truncated", 1, parseTtnUplink(uplinkText.substr(0, uplinkText.size() / 2), uplink) == ttnMessage::malformed);
+    printTestResult("  not JSON", 1, parseTtnUplink("AQIDBAEGZGVT8QE=", uplink) == ttnMessage::malformed);
+    printTestResult("  bad f_cnt", 1, parseTtnUplink("{\"uplink_message\":{\"f_cnt\":\"x\"}}", uplink) == ttnMessage::malformed);
+    printTestResult("  huge exponent", 1, parseTtnUplink("{\"uplink_message\":{\"rx_metadata\":[{\"snr\":1e2000000000}]}}", uplink) == ttnMessage::malformed);
+    printTestResult("  tiny exponent", 1, parseTtnUplink("{\"uplink_message\":{\"rx_metadata\":[{\"snr\":-5e-2000000000}]}}", uplink) == ttnMessage::uplink && uplink.snr == 0.0f);
+    printTestResult("  spaces", 1, parseTtnUplink(" { \"uplink_message\" : { \"f_port\" : 2 , \"rx_metadata\" : [ ] } } ", uplink) == ttnMessage::uplink && uplink.port == 2);
+
+    // Newline-delimited stream: uplink, join accept, uplink without f_cnt
+    std::string noCount = uplinkText;
+    noCount.erase(noCount.find("\"f_cnt\":4711,"), 13);
+    const std::string stream = uplinkText + "\n" + joinText + "\n" + noCount + "\n";
+    FILE *file = tmpfile();
+    fwrite(stream.data(), 1, stream.size(), file);
+    rewind(file);
+    frameReader reader(file, inputFormat::ttn);
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    const bool read = reader.next(frames, length);
+    const bool streamOk = read && length == 2 * SENSOR_PAYLOAD_SIZE && memcmp(frames, frame, SENSOR_PAYLOAD_SIZE) == 0 &&
+                          reader.get_uplinks().size() == 2 && reader.get_uplinks()[0].fcnt == 4711 &&
+                          reader.get_uplinks()[1].fcnt == 0 && reader.get_uplinks()[1].rssi == -42;
+    fclose(file);
+    printTestResult("  stream", 1, streamOk);
+    printTestResult("  stream rejected lines", 1, static_cast<int>(reader.get_rejectedLines()));
+}
+
+void test14()
+{
+    cout << endl
+         << "Test 14 results (Version decoder table)" << endl;
+
+    int known = 0;
+    bool unknownEmpty = true;
+    for (int version = 0; version < 256; version++)
+    {
+        const payloadVersionDecoder &decoder = payloadDecoderFor(static_cast<uint8_t>(version));
+        known += decoder.size != 0;
+        unknownEmpty = unknownEmpty && (decoder.size != 0 || (decoder.decodeFields == nullptr && decoder.decodeRow == nullptr));
+    }
+    printTestResult("  known versions", 2, known);
+    printTestResult("  unknown entries empty", 1, unknownEmpty);
+    printTestResult("  version 1 size", SENSOR_PAYLOAD_SIZE, payloadDecoderFor(1).size);
+    printTestResult("  version 2 size", payloadCodecV2::size, payloadDecoderFor(2).size);
+
+    // Table decoders against the schema codec
+    uint8_t frame[SENSOR_PAYLOAD_SIZE];
+    uint32_t seed = 99;
+    bool same = true;
+    for (int n = 0; n < 100; n++)
+    {
+        for (uint8_t &b : frame)
+        {
+            seed = seed * 1103515245 + 12345;
+            b = static_cast<uint8_t>(seed >> 16);
+        }
+        frame[PAYLOAD_VERSION_INDEX] = PAYLOAD_VERSION;
+        payloadFields expected;
+        payloadFields fields;
+        payloadCodecV1::decode(frame, expected);
+        payloadDecoderFor(PAYLOAD_VERSION).decodeFields(frame, fields);
+        payloadBatch batch;
+        batch.resize(1);
+        payloadDecoderFor(PAYLOAD_VERSION).decodeRow(frame, batchColumns{batch.id.data(), batch.version.data(), batch.flags.data(),
+                                                                         batch.battery.data(), batch.unixTime.data(), batch.doorStatus.data(),
+                                                                         batch.catchDetect.data(), batch.trapDisplacement.data()});
+        same = same && fields.id == expected.id && fields.unixTime == expected.unixTime &&
+               fields.batteryStatus == expected.batteryStatus && fields.doorStatus == expected.doorStatus &&
+               batch.id[0] == expected.id && batch.unixTime[0] == expected.unixTime &&
+               batch.battery[0] == expected.batteryStatus && batch.catchDetect[0] == expected.catchDetect &&
+               batch.trapDisplacement[0] == expected.trapDisplacement;
+    }
+    printTestResult("  decoders match codec", 1, same);
+
+    // Separate frames: valid, unknown version, too long for its version, too short to hold a version
+    uint8_t unknown[SENSOR_PAYLOAD_SIZE];
+    memcpy(unknown, frame, sizeof(unknown));
+    unknown[PAYLOAD_VERSION_INDEX] = 200;
+    const uint8_t *frames[] = {frame, unknown, frame, frame};
+    const size_t sizes[] = {SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE + 1, PAYLOAD_VERSION_INDEX};
+    payloadBatch batch;
+    const size_t rows = payloadDecoder::decodeBatch(frames, sizes, 4, batch);
+    printTestResult("  rows", 1, static_cast<int>(rows));
+    printTestResult("  errors", 3, static_cast<int>(batch.errors.size()));
+    const bool reasons = batch.errors.size() == 3 &&
+                         batch.errors[0].index == 1 && batch.errors[0].reason == decodeError::unknownVersion &&
+                         batch.errors[1].index == 2 && batch.errors[1].reason == decodeError::wrongSize &&
+                         batch.errors[2].index == 3 && batch.errors[2].reason == decodeError::wrongSize;
+    printTestResult("  error reasons", 1, reasons);
+
+    // Single frames of an unknown version still decode with the current layout
+    payloadDecoder decoder;
+    decoder.decodePayload(unknown, SENSOR_PAYLOAD_SIZE);
+    printTestResult("  unknown version single", 200, decoder.get_version());
+}
+
+void test15()
+{
+    cout << endl
+         << "Test 15 results (Fleet generator)" << endl;
+
+    fleetConfig config = defaultFleetConfig();
+    config.traps = 50;
+    config.doorEventsPerDay = 2000.0; // about one event per trap every 40 s
+    config.catchEventsPerDay = 500.0;
+    const uint64_t endMs = 600 * 1000;
+
+    // Same seed, same traffic; another seed, other traffic
+    payloadBatch first, second, other;
+    std::vector<fleetUplink> firstUplinks, secondUplinks, otherUplinks;
+    fleetGenerator a(config), b(config);
+    a.next(SIZE_MAX, endMs, first, firstUplinks);
+    b.next(1000, endMs, second, secondUplinks); // in two calls, to check that resuming changes nothing
+    b.next(SIZE_MAX, endMs, second, secondUplinks);
+    config.seed = 2;
+    fleetGenerator c(config);
+    c.next(SIZE_MAX, endMs, other, otherUplinks);
+    config.seed = 1;
+    bool same = first.size() == second.size() && first.size() > 1000;
+    for (size_t i = 0; same && i < first.size(); i++)
+    {
+        same = first.id[i] == second.id[i] && first.flags[i] == second.flags[i] &&
+               first.unixTime[i] == second.unixTime[i] && firstUplinks[i].timeMs == secondUplinks[i].timeMs &&
+               firstUplinks[i].rssi == secondUplinks[i].rssi;
+    }
+    printTestResult("  same seed", 1, same);
+    bool differs = other.size() != first.size();
+    for (size_t i = 0; !differs && i < first.size(); i++)
+    {
+        differs = firstUplinks[i].timeMs != otherUplinks[i].timeMs || first.id[i] != other.id[i];
+    }
+    printTestResult("  other seed", 1, differs);
+
+    // Send rules: ordered by time, duty cycle kept, frame counters count up, events seen
+    std::vector<uint64_t> lastSend(config.traps, 0);
+    std::vector<uint32_t> nextCount(config.traps, 0);
+    bool ordered = true, dutyCycle = true, counters = true;
+    size_t events = 0;
+    for (size_t i = 0; i < firstUplinks.size(); i++)
+    {
+        const fleetUplink &u = firstUplinks[i];
+        ordered = ordered && (i == 0 || firstUplinks[i - 1].timeMs <= u.timeMs);
+        dutyCycle = dutyCycle && (u.fcnt == 0 || u.timeMs - lastSend[u.trap] > MIN_SEND_INTERVAL_MS);
+        counters = counters && u.fcnt == nextCount[u.trap]++ && first.id[i] == config.firstId + u.trap;
+        lastSend[u.trap] = u.timeMs;
+        events += (u.reason & SEND_EVENT) != 0;
+    }
+    printTestResult("  time order", 1, ordered);
+    printTestResult("  duty cycle", 1, dutyCycle);
+    printTestResult("  frame counters", 1, counters);
+    printTestResult("  event sends", 1, events > 0 && events < firstUplinks.size());
+
+    // Without events, the watchdog (8 s) and the duty cycle (> 10 s) set the pace: a heartbeat
+    // every 16 s, sent at the first watchdog tick after the duty cycle interval.
+    config.doorEventsPerDay = 0.0;
+    config.catchEventsPerDay = 0.0;
+    config.displacementEventsPerDay = 0.0;
+    config.traps = 1;
+    payloadBatch quiet;
+    std::vector<fleetUplink> quietUplinks;
+    fleetGenerator d(config);
+    d.next(SIZE_MAX, 200 * 1000, quiet, quietUplinks);
+    bool heartbeats = quietUplinks.size() > 5;
+    for (size_t i = 1; heartbeats && i < quietUplinks.size(); i++)
+    {
+        const uint64_t gap = quietUplinks[i].timeMs - quietUplinks[i - 1].timeMs;
+        heartbeats = quietUplinks[i].reason == SEND_HEARTBEAT && gap > MIN_SEND_INTERVAL_MS && gap <= 2 * WATCHDOG_PERIOD_MS;
+    }
+    printTestResult("  heartbeats", 1, heartbeats);
+    config = defaultFleetConfig();
+
+    // Encoded frames decode to the generated rows, in every output format
+    std::vector<uint8_t> frames(first.size() * SENSOR_PAYLOAD_SIZE);
+    payloadEncoder::encodeBatch(first, frames.data(), frames.size());
+    const inputFormat formats[] = {inputFormat::raw, inputFormat::hex, inputFormat::base64, inputFormat::ttn};
+    for (inputFormat format : formats)
+    {
+        std::string text;
+        appendFleetUplinks(format, config, frames.data(), firstUplinks, text);
+        FILE *file = tmpfile();
+        fwrite(text.data(), 1, text.size(), file);
+        rewind(file);
+        frameReader reader(file, format);
+        payloadBatch decoded;
+        bool metadata = true;
+        const uint8_t *block = nullptr;
+        size_t length = 0;
+        while (reader.next(block, length))
+        {
+            const size_t row = decoded.size();
+            payloadDecoder::decodeBatch(block, length, decoded);
+            // TTN fields are only valid until the next call, so they are checked per block
+            for (size_t i = 0; format == inputFormat::ttn && i < reader.get_uplinks().size() && row + i < firstUplinks.size(); i++)
+            {
+                const ttnUplink &uplink = reader.get_uplinks()[i];
+                const fleetUplink &expected = firstUplinks[row + i];
+                metadata = metadata && uplink.fcnt == expected.fcnt &&
+                           uplink.rssi == expected.rssi && uplink.sf == expected.sf && uplink.port == 1 &&
+                           ttnTimeToUnix(uplink.receivedAt) == config.startTime + expected.timeMs / 1000;
+            }
+        }
+        bool match = metadata && decoded.size() == first.size() && reader.get_rejectedLines() == 0;
+        for (size_t i = 0; match && i < first.size(); i++)
+        {
+            match = decoded.id[i] == first.id[i] && decoded.flags[i] == first.flags[i] &&
+                    decoded.battery[i] == first.battery[i] && decoded.unixTime[i] == first.unixTime[i];
+        }
+        fclose(file);
+        const char *names[] = {"  raw round trip", "  hex round trip", "  base64 round trip", "  ttn round trip"};
+        printTestResult(names[static_cast<int>(format)], 1, match);
+    }
+}
+
+void test16()
+{
+    cout << endl
+         << "Test 16 results (Fleet state table)" << endl;
+
+    fleetStateTable table(100);
+    printTestResult("  capacity", 128, static_cast<int>(table.capacity()));
+    trapState state;
+    printTestResult("  empty read", 0, table.read(7, state));
+
+    // Records in time order, a late record, a record that only changes the battery
+    table.update(7, 1, FLAG_DOOR_STATUS, 90, 1000);
+    table.update(7, 1, FLAG_DOOR_STATUS | FLAG_CATCH_DETECT, 89, 2000);
+    const bool late = table.update(7, 1, 0, 95, 1500);
+    table.update(7, 1, FLAG_DOOR_STATUS | FLAG_CATCH_DETECT, 88, 3000);
+    const bool found = table.read(7, state);
+    printTestResult("  late record", 0, late);
+    printTestResult("  read", 1, found && state.id == 7 && state.updates == 3);
+    printTestResult("  flags", FLAG_DOOR_STATUS | FLAG_CATCH_DETECT, state.flags);
+    printTestResult("  battery", 88, state.battery);
+    printTestResult("  changed time", 2000, static_cast<int>(state.changedTime));
+
+    // Records from a decoder and from a batch; id 0 is a valid id
+    payloadEncoder encoder;
+    encoder.set_id(0);
+    encoder.set_version(PAYLOAD_VERSION);
+    encoder.set_trapDisplacement(true);
+    encoder.set_batteryStatus(50);
+    encoder.set_unixTime(1700000000);
+    encoder.composePayload();
+    payloadDecoder decoder;
+    decoder.decodePayload(encoder.getPayload(), encoder.getPayloadSize());
+    table.update(decoder);
+    payloadBatch batch;
+    batch.resize(3);
+    for (size_t i = 0; i < 3; i++)
+    {
+        batch.id[i] = 100 + static_cast<uint32_t>(i);
+        batch.version[i] = PAYLOAD_VERSION;
+        batch.flags[i] = FLAG_CATCH_DETECT;
+        batch.battery[i] = 70;
+        batch.unixTime[i] = 1700000000;
+    }
+    printTestResult("  batch rows", 3, static_cast<int>(table.update(batch)));
+    printTestResult("  decoder record", 1, table.read(0, state) && state.flags == FLAG_TRAP_DISPLACEMENT && state.battery == 50);
+    std::vector<trapState> states;
+    printTestResult("  snapshot", 5, static_cast<int>(table.snapshot(states)));
+    printTestResult("  size", 5, static_cast<int>(table.size()));
+
+    // Full table
+    fleetStateTable small(2);
+    small.update(1, 1, 0, 0, 1);
+    small.update(2, 1, 0, 0, 1);
+    printTestResult("  full table", 0, small.update(3, 1, 0, 0, 1));
+
+    // Two writers and two readers on the same traps. Every record satisfies
+    // battery == unixTime % 101 and flags == unixTime & 7, so a torn read shows up as a mismatch.
+    const uint32_t traps = 64;
+    const uint32_t rounds = 2000;
+    fleetStateTable shared(traps * 2);
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> torn(0);
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 2; r++)
+    {
+        threads.emplace_back([&]()
+                             {
+            trapState s;
+            uint64_t bad = 0;
+            while (!done.load(std::memory_order_acquire))
+            {
+                for (uint32_t id = 0; id < traps; id++)
+                {
+                    if (shared.read(id, s))
+                    {
+                        bad += s.battery != s.unixTime % 101 || s.flags != (s.unixTime & 7) || s.id != id;
+                    }
+                }
+            }
+            torn += bad; });
+    }
+    std::vector<std::thread> writers;
+    for (uint32_t w = 0; w < 2; w++)
+    {
+        writers.emplace_back([&, w]()
+                             {
+            for (uint32_t round = 1; round <= rounds; round++)
+            {
+                for (uint32_t id = 0; id < traps; id++)
+                {
+                    const uint32_t time = round * 2 + w;
+                    shared.update(id, PAYLOAD_VERSION, static_cast<uint8_t>(time & 7), static_cast<uint8_t>(time % 101), time);
+                }
+            } });
+    }
+    for (std::thread &t : writers)
+    {
+        t.join();
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    bool latest = true;
+    for (uint32_t id = 0; id < traps; id++)
+    {
+        latest = latest && shared.read(id, state) && state.unixTime == rounds * 2 + 1;
+    }
+    printTestResult("  concurrent torn reads", 0, static_cast<int>(torn.load()));
+    printTestResult("  concurrent latest", 1, latest);
+}
+
+void test17()
+{
+    cout << endl
+         << "Test 17 results (Transition extractor)" << endl;
+
+    // Trap 5: open, open, closed, closed + catch, late record, open without catch
+    struct record
+    {
+        uint32_t id;
+        uint8_t flags;
+        uint32_t time;
+    };
+    const record records[] = {{5, 0, 100}, {9, FLAG_TRAP_DISPLACEMENT, 105}, {5, 0, 110}, {5, FLAG_DOOR_STATUS, 120},
+                              {5, FLAG_DOOR_STATUS | FLAG_CATCH_DETECT, 130}, {5, 0, 125}, {5, 0, 140}, {9, 0, 150}};
+    const size_t count = sizeof(records) / sizeof(records[0]);
+    std::vector<uint8_t> frames(count * SENSOR_PAYLOAD_SIZE);
+    payloadBatch batch;
+    batch.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        payloadEncoder encoder;
+        encoder.set_id(records[i].id);
+        encoder.set_version(PAYLOAD_VERSION);
+        encoder.set_doorStatus((records[i].flags & FLAG_DOOR_STATUS) != 0);
+        encoder.set_catchDetect((records[i].flags & FLAG_CATCH_DETECT) != 0);
+        encoder.set_trapDisplacement((records[i].flags & FLAG_TRAP_DISPLACEMENT) != 0);
+        encoder.set_batteryStatus(80);
+        encoder.set_unixTime(records[i].time);
+        encoder.encodeInto(frames.data() + i * SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE);
+        batch.id[i] = records[i].id;
+        batch.flags[i] = records[i].flags;
+        batch.unixTime[i] = records[i].time;
+    }
+
+    transitionExtractor defaults;
+    std::vector<trapTransition> events;
+    printTestResult("  default transitions", 2, static_cast<int>(defaults.process(frames.data(), frames.size(), events)));
+    const bool closed = events.size() == 2 && events[0].id == 5 && events[0].kind == transitionKind::doorClosed &&
+                        events[0].unixTime == 120 && events[0].previousSince == 100 && events[0].previousLast == 110 &&
+                        events[0].index == 3;
+    const bool caught = events.size() == 2 && events[1].kind == transitionKind::catchDetected &&
+                        events[1].unixTime == 130 && events[1].previousSince == 100 && events[1].previousLast == 120;
+    printTestResult("  door closed", 1, closed);
+    printTestResult("  catch detected", 1, caught);
+    printTestResult("  traps", 2, static_cast<int>(defaults.get_traps()));
+    printTestResult("  late records", 1, static_cast<int>(defaults.get_lateRecords()));
+
+    // All kinds, from decoded rows: the same events plus door opened, catch cleared and displacement cleared
+    transitionExtractor all(ALL_TRANSITIONS, 1);
+    std::vector<trapTransition> allEvents;
+    printTestResult("  all transitions", 5, static_cast<int>(all.process(batch, allEvents)));
+    const bool opened = allEvents.size() == 5 && allEvents[2].kind == transitionKind::doorOpened &&
+                        allEvents[2].previousSince == 120 && allEvents[3].kind == transitionKind::catchCleared &&
+                        allEvents[3].previousSince == 130 && allEvents[4].kind == transitionKind::displacementCleared &&
+                        allEvents[4].id == 9 && allEvents[4].previousSince == 105;
+    printTestResult("  cleared flags", 1, opened);
+    printTestResult("  name", 1, strcmp(transitionName(transitionKind::displaced), "displaced") == 0);
+
+    // Frames of another version are skipped
+    frames[PAYLOAD_VERSION_INDEX] = 7;
+    transitionExtractor skipping;
+    events.clear();
+    skipping.process(frames.data(), frames.size(), events);
+    printTestResult("  rejected frames", 1, static_cast<int>(skipping.get_rejectedFrames()));
+
+    // Against a full decode of a generated fleet, with a table that has to grow
+    fleetConfig config = defaultFleetConfig();
+    config.traps = 300;
+    config.doorEventsPerDay = 500.0;
+    config.catchEventsPerDay = 100.0;
+    config.displacementEventsPerDay = 50.0;
+    fleetGenerator fleet(config);
+    payloadBatch generated;
+    std::vector<fleetUplink> uplinks;
+    fleet.next(SIZE_MAX, 3600 * 1000, generated, uplinks);
+    std::vector<uint8_t> fleetFrames(generated.size() * SENSOR_PAYLOAD_SIZE);
+    payloadEncoder::encodeBatch(generated, fleetFrames.data(), fleetFrames.size());
+    transitionExtractor fromFrames(ALL_TRANSITIONS, 4);
+    transitionExtractor fromRows(ALL_TRANSITIONS, 4);
+    std::vector<trapTransition> frameEvents;
+    std::vector<trapTransition> rowEvents;
+    fromFrames.process(fleetFrames.data(), fleetFrames.size(), frameEvents);
+    fromRows.process(generated, rowEvents);
+    size_t changes = 0;
+    std::vector<int> lastFlags(config.traps, -1);
+    for (size_t i = 0; i < generated.size(); i++)
+    {
+        const uint32_t trap = generated.id[i] - config.firstId;
+        if (lastFlags[trap] >= 0)
+        {
+            changes += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(lastFlags[trap] ^ generated.flags[i])));
+        }
+        lastFlags[trap] = generated.flags[i];
+    }
+    bool same = frameEvents.size() == rowEvents.size();
+    for (size_t i = 0; same && i < frameEvents.size(); i++)
+    {
+        same = frameEvents[i].id == rowEvents[i].id && frameEvents[i].kind == rowEvents[i].kind &&
+               frameEvents[i].unixTime == rowEvents[i].unixTime && frameEvents[i].previousSince == rowEvents[i].previousSince;
+    }
+    printTestResult("  fleet transitions", static_cast<int>(changes), static_cast<int>(frameEvents.size()));
+    printTestResult("  frames match rows", 1, same && changes > 0);
+    printTestResult("  fleet traps", static_cast<int>(config.traps), static_cast<int>(fromFrames.get_traps()));
+}
+
+void test18()
+{
+    cout << endl
+         << "Test 18 results (Battery trend)" << endl;
+
+    // Trap 1 drains 2 % per day, trap 2 drains 0.5 % per day, trap 3 is always full;
+    // hourly records for 20 days, battery reported as whole percents
+    batteryTrendTracker tracker(batteryTrendConfig(), 1);
+    const uint32_t start = 1700000000;
+    for (uint32_t hour = 0; hour <= 20 * 24; hour++)
+    {
+        const double days = hour / 24.0;
+        const uint32_t time = start + hour * 3600;
+        tracker.update(1, static_cast<uint8_t>(std::lround(90.0 - 2.0 * days)), time);
+        tracker.update(2, static_cast<uint8_t>(std::lround(95.0 - 0.5 * days)), time);
+        tracker.update(3, 100, time);
+    }
+    batteryForecast f;
+    const bool found = tracker.forecast(1, f);
+    printTestResult("  forecast", 1, found && f.valid && f.samples == 20 * 24 + 1);
+    printTestResult("  slope", 1, f.slopePerDay > -2.05 && f.slopePerDay < -1.95);
+    printTestResult("  level", 1, f.level > 49.5 && f.level < 50.5);
+    printTestResult("  days to empty", 1, f.daysToEmpty > 24.0 && f.daysToEmpty < 26.0);
+    tracker.forecast(3, f);
+    printTestResult("  not draining", 1, f.valid && std::isinf(f.daysToEmpty));
+    printTestResult("  unknown trap", 0, tracker.forecast(4, f));
+
+    std::vector<batteryForecast> due;
+    printTestResult("  ranking size", 2, static_cast<int>(tracker.dueForService(2, due)));
+    printTestResult("  ranking order", 1, due.size() == 2 && due[0].id == 1 && due[1].id == 2);
+
+    // A new battery restarts the fit; late records from the old battery are ignored
+    for (uint32_t hour = 0; hour <= 5 * 24; hour++)
+    {
+        tracker.update(1, static_cast<uint8_t>(std::lround(100.0 - 1.0 * hour / 24.0)), start + (21 * 24 + hour) * 3600);
+    }
+    tracker.update(1, 49, start + 20 * 24 * 3600 + 1800);
+    tracker.update(1, 98, start + 22 * 24 * 3600 + 1800);
+    tracker.forecast(1, f);
+    printTestResult("  replacements", 1, static_cast<int>(tracker.get_replacements()));
+    printTestResult("  slope after swap", 1, f.valid && f.slopePerDay > -1.1 && f.slopePerDay < -0.9);
+    batteryTrendTracker fresh;
+    fresh.update(9, 80, start);
+    fresh.update(9, 79, start + 600);
+    fresh.update(9, 79, start + 1200);
+    printTestResult("  too short", 0, fresh.forecast(9, f) && f.valid);
+
+    // Generated fleet: the fitted slope follows the configured drain
+    fleetConfig config = defaultFleetConfig();
+    config.traps = 20;
+    config.batteryDrainPerDay = 4.0;
+    fleetGenerator fleet(config);
+    payloadBatch batch;
+    std::vector<fleetUplink> uplinks;
+    batteryTrendTracker fleetTracker;
+    for (int day = 0; day < 4; day++)
+    {
+        batch.clear();
+        uplinks.clear();
+        fleet.next(SIZE_MAX, static_cast<uint64_t>(day + 1) * 86400000, batch, uplinks);
+        fleetTracker.update(batch);
+    }
+    fleetTracker.dueForService(config.traps, due);
+    bool slopes = due.size() == config.traps;
+    for (const batteryForecast &d : due)
+    {
+        slopes = slopes && d.slopePerDay > -4.2 && d.slopePerDay < -3.8;
+    }
+    printTestResult("  fleet slopes", 1, slopes);
+}
+
+void test19()
+{
+    cout << endl
+         << "Test 19 results (Uplink deduplication)" << endl;
+
+    uplinkRecord base;
+    snprintf(base.deviceId, sizeof(base.deviceId), "trap-0042");
+    snprintf(base.gatewayId, sizeof(base.gatewayId), "gw-a");
+    base.devEui = 0x70B3D57ED0000042ULL;
+    base.gatewayEui = 0xB827EBFFFE00000AULL;
+    base.receivedMs = 1700000000000ULL;
+    base.devAddr = 0x26000042;
+    base.fcnt = 17;
+    base.frequency = 868100000;
+    base.rssi = -110;
+    base.snr = -3.5f;
+    base.port = 1;
+    base.sf = 9;
+    base.gateways = 1;
+    for (size_t i = 0; i < sizeof(base.frame); i++)
+    {
+        base.frame[i] = static_cast<uint8_t>(i + 1);
+    }
+
+    // Text round trip
+    std::string text;
+    appendTtnUplink(base, text);
+    ttnUplink parsed;
+    uplinkRecord back;
+    const bool roundTrip = parseTtnUplink(std::string_view(text).substr(0, text.size() - 1), parsed) == ttnMessage::uplink &&
+                           uplinkRecordFromTtn(parsed, back) && back.devEui == base.devEui && back.fcnt == 17 &&
+                           back.receivedMs == base.receivedMs && back.rssi == -110 && back.snr == -3.5f &&
+                           back.devAddr == base.devAddr && back.frequency == base.frequency && back.sf == 9 &&
+                           strcmp(back.deviceId, "trap-0042") == 0 && strcmp(back.gatewayId, "gw-a") == 0 &&
+                           back.gatewayEui == base.gatewayEui && memcmp(back.frame, base.frame, sizeof(base.frame)) == 0;
+    printTestResult("  text round trip", 1, roundTrip);
+    printTestResult("  time in ms", 1, ttnTimeToUnixMs("2023-11-14T22:13:20.25Z") == 1700000000250ULL);
+
+    // Three copies within the hold time, then a late copy, then the same key after it is forgotten
+    dedupConfig config;
+    config.holdMs = 2000;
+    config.rememberMs = 10000;
+    uplinkDeduplicator dedup(config);
+    std::vector<uplinkRecord> out;
+    uplinkRecord copy = base;
+    const bool first = dedup.offer(copy, out);
+    copy.receivedMs += 300;
+    copy.rssi = -80;
+    copy.gatewayEui = 0xB827EBFFFE00000BULL;
+    const bool second = dedup.offer(copy, out);
+    copy.receivedMs += 300;
+    copy.rssi = -95;
+    copy.gateways = 2;
+    dedup.offer(copy, out);
+    printTestResult("  first copy new", 1, first && !second);
+    printTestResult("  held", 0, static_cast<int>(out.size()));
+    copy = base;
+    copy.fcnt = 18;
+    copy.receivedMs = base.receivedMs + 2500; // moves time past the hold time of fcnt 17
+    dedup.offer(copy, out);
+    const bool merged = out.size() == 1 && out[0].fcnt == 17 && out[0].rssi == -80 && out[0].gateways == 4 &&
+                        out[0].gatewayEui == 0xB827EBFFFE00000BULL && out[0].receivedMs == base.receivedMs;
+    printTestResult("  merged copy", 1, merged);
+    copy = base;
+    copy.receivedMs = base.receivedMs + 3000;
+    printTestResult("  late copy", 0, dedup.offer(copy, out));
+    copy.receivedMs = base.receivedMs + 20000;
+    printTestResult("  forgotten key", 1, dedup.offer(copy, out));
+    dedup.flush(out);
+    printTestResult("  released", 3, static_cast<int>(out.size()));
+    printTestResult("  late count", 1, static_cast<int>(dedup.get_stats().late));
+
+    // Bounded memory: a ring of 4 entries releases the oldest uplink early
+    config.capacity = 4;
+    uplinkDeduplicator small(config);
+    out.clear();
+    for (uint32_t n = 0; n < 10; n++)
+    {
+        copy = base;
+        copy.fcnt = n;
+        small.offer(copy, out);
+    }
+    small.flush(out);
+    bool order = out.size() == 10;
+    for (size_t i = 0; order && i < out.size(); i++)
+    {
+        order = out[i].fcnt == i;
+    }
+    printTestResult("  evicted", 6, static_cast<int>(small.get_stats().evicted));
+    printTestResult("  eviction order", 1, order);
+
+    // Generated fleet with 1-3 copies per uplink, a few hundred ms apart and out of order:
+    // with and without Bloom filter, exactly one uplink per generated uplink, best rssi kept
+    fleetConfig fleetSettings = defaultFleetConfig();
+    fleetSettings.traps = 60;
+    fleetGenerator fleet(fleetSettings);
+    payloadBatch batch;
+    std::vector<fleetUplink> uplinks;
+    fleet.next(SIZE_MAX, 600 * 1000, batch, uplinks);
+    std::vector<uint8_t> frames(batch.size() * SENSOR_PAYLOAD_SIZE);
+    payloadEncoder::encodeBatch(batch, frames.data(), frames.size());
+    std::string stream;
+    appendFleetUplinks(inputFormat::ttn, fleetSettings, frames.data(), uplinks, stream);
+    std::vector<uplinkRecord> copies;
+    size_t start = 0;
+    uint32_t seed = 5;
+    while (start < stream.size())
+    {
+        const size_t end = stream.find('\n', start);
+        uplinkRecordFromTtn((parseTtnUplink(std::string_view(stream).substr(start, end - start), parsed), parsed), back);
+        start = end + 1;
+        seed = seed * 1103515245 + 12345;
+        for (uint32_t c = 0; c <= (seed >> 16) % 3; c++)
+        {
+            uplinkRecord extra = back;
+            extra.receivedMs += c * 150;
+            extra.rssi = static_cast<int16_t>(back.rssi - 5 * static_cast<int>(c));
+            copies.push_back(extra);
+        }
+    }
+    for (size_t i = 1; i + 1 < copies.size(); i += 7)
+    {
+        std::swap(copies[i], copies[i + 1]);
+    }
+    bool exact = true;
+    for (size_t bloomBits : {static_cast<size_t>(0), static_cast<size_t>(1 << 16)})
+    {
+        dedupConfig settings;
+        settings.bloomBits = bloomBits;
+        uplinkDeduplicator d(settings);
+        out.clear();
+        for (const uplinkRecord &r : copies)
+        {
+            d.offer(r, out);
+        }
+        d.flush(out);
+        exact = exact && out.size() == uplinks.size() && d.get_stats().evicted == 0 && d.get_stats().late == 0;
+        // Released in order of the first copy, so compare sorted by (trap, fcnt)
+        std::vector<std::pair<uint64_t, int16_t>> expected;
+        std::vector<std::pair<uint64_t, int16_t>> got;
+        for (size_t i = 0; exact && i < out.size(); i++)
+        {
+            expected.emplace_back(static_cast<uint64_t>(fleetSettings.firstId + uplinks[i].trap) << 32 | uplinks[i].fcnt, uplinks[i].rssi);
+            got.emplace_back((out[i].devEui & 0x0FFFFFFFULL) << 32 | out[i].fcnt, out[i].rssi);
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(got.begin(), got.end());
+        exact = exact && expected == got;
+        if (bloomBits != 0)
+        {
+            printTestResult("  bloom skips", 1, d.get_stats().bloomNew > uplinks.size() / 2);
+        }
+    }
+    printTestResult("  fleet dedup", 1, exact && copies.size() > uplinks.size());
+}
+
+void test20()
+{
+    cout << endl
+         << "Test 20 results (Reorder buffer and merge)" << endl;
+
+    // Reference stream: a generated fleet, sorted by payload time, trap id and frame counter
+    fleetConfig fleetSettings = defaultFleetConfig();
+    fleetSettings.traps = 300;
+    fleetGenerator fleet(fleetSettings);
+    payloadBatch batch;
+    std::vector<fleetUplink> uplinks;
+    fleet.next(SIZE_MAX, 1800 * 1000, batch, uplinks);
+    std::vector<uint8_t> frames(batch.size() * SENSOR_PAYLOAD_SIZE);
+    payloadEncoder::encodeBatch(batch, frames.data(), frames.size());
+    std::vector<archiveRecord> sorted;
+    for (size_t i = 0; i < uplinks.size(); i++)
+    {
+        const uint8_t *frame = frames.data() + i * SENSOR_PAYLOAD_SIZE;
+        uplinkMeta meta = uplinkMetaOf(frame, nullptr);
+        meta.fcnt = uplinks[i].fcnt;
+        sorted.push_back(makeArchiveRecord(frame, meta));
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), uplinkBefore);
+    const auto sameFrames = [](const std::vector<archiveRecord> &a, const std::vector<archiveRecord> &b)
+    {
+        bool same = a.size() == b.size();
+        for (size_t i = 0; same && i < a.size(); i++)
+        {
+            same = memcmp(a[i].frame, b[i].frame, SENSOR_PAYLOAD_SIZE) == 0;
+        }
+        return same;
+    };
+
+    // Arrival delayed by up to 29 s per uplink
+    std::vector<std::pair<uint64_t, size_t>> arrival;
+    uint32_t seed = 11;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        arrival.emplace_back(static_cast<uint64_t>(sorted[i].unixTime()) * 1000 + (seed >> 8) % 29000, i);
+    }
+    std::sort(arrival.begin(), arrival.end());
+    size_t displaced = 0;
+    for (size_t i = 0; i < arrival.size(); i++)
+    {
+        displaced += arrival[i].second != i ? 1 : 0;
+    }
+
+    // A 30 s window restores the order exactly; a 5 s window cannot and passes the stragglers on
+    std::vector<archiveRecord> out;
+    reorderConfig settings;
+    settings.windowSeconds = 30;
+    reorderBuffer wide(settings);
+    for (const auto &a : arrival)
+    {
+        wide.push(sorted[a.second], out);
+    }
+    const size_t beforeFlush = out.size();
+    wide.flush(out);
+    printTestResult("  shuffled", 1, displaced > sorted.size() / 2);
+    printTestResult("  streaming", 1, beforeFlush > sorted.size() / 2);
+    printTestResult("  30 s order", 1, sameFrames(out, sorted));
+    printTestResult("  30 s late", 0, static_cast<int>(wide.get_stats().late));
+
+    settings.windowSeconds = 5;
+    reorderBuffer narrow(settings);
+    out.clear();
+    for (const auto &a : arrival)
+    {
+        narrow.push(sorted[a.second], out);
+    }
+    narrow.flush(out);
+    size_t backwards = 0;
+    for (size_t i = 1; i < out.size(); i++)
+    {
+        backwards += out[i].unixTime() < out[i - 1].unixTime() ? 1 : 0;
+    }
+    // Every step back in the output lands on a late record
+    printTestResult("  5 s count", 1, out.size() == sorted.size() && narrow.get_stats().released == sorted.size());
+    printTestResult("  5 s late", 1, backwards > 0 && backwards <= narrow.get_stats().late);
+
+    // A full buffer releases its earliest record early
+    settings.windowSeconds = 3600;
+    settings.capacity = 100;
+    reorderBuffer full(settings);
+    out.clear();
+    for (const auto &a : arrival)
+    {
+        full.push(sorted[a.second], out);
+    }
+    // Records behind an early release are late; none leave through the window
+    printTestResult("  held", 100, static_cast<int>(full.get_stats().maxHeld));
+    printTestResult("  forced", 1, full.get_stats().forced > 0 &&
+                                       full.get_stats().forced + full.get_stats().late + 100 == sorted.size());
+
+    // Merge of three ordered inputs split by trap: in memory, raw file and archive segment
+    std::vector<archiveRecord> parts[3];
+    for (const archiveRecord &record : sorted)
+    {
+        parts[record.id() % 3].push_back(record);
+    }
+    FILE *raw = tmpfile();
+    char path[] = "/tmp/payloadCoderMergeXXXXXX";
+    const int fd = mkstemp(path);
+    if (raw == nullptr || fd < 0)
+    {
+        printTestResult("  temporary files", 1, 0);
+        return;
+    }
+    close(fd);
+    for (const archiveRecord &record : parts[1])
+    {
+        fwrite(record.frame, 1, SENSOR_PAYLOAD_SIZE, raw);
+    }
+    rewind(raw);
+    segmentWriter writer;
+    bool written = writer.create(path);
+    for (const archiveRecord &record : parts[2])
+    {
+        written = written && writer.append(record);
+    }
+    written = writer.close() && written;
+
+    out.clear();
+    uplinkMerger merger;
+    merger.add(parts[0].data(), parts[0].size());
+    merger.add(raw, inputFormat::raw);
+    const bool added = merger.add(path, inputFormat::raw);
+    std::vector<archiveRecord> step;
+    while (merger.next(step, 1000) != 0)
+    {
+        out.insert(out.end(), step.begin(), step.end());
+        step.clear();
+    }
+    printTestResult("  inputs", 1, written && added && merger.inputs() == 3);
+    printTestResult("  merge order", 1, sameFrames(out, sorted));
+    printTestResult("  unsorted", 0, static_cast<int>(merger.get_unsorted()));
+    fclose(raw);
+    unlink(path);
+
+    // Records going backwards within an input are counted
+    std::vector<archiveRecord> bad(parts[0].begin(), parts[0].begin() + 10);
+    size_t swapAt = 0;
+    while (swapAt + 2 < bad.size() && bad[swapAt].unixTime() == bad[swapAt + 1].unixTime())
+    {
+        swapAt++;
+    }
+    std::swap(bad[swapAt], bad[swapAt + 1]);
+    uplinkMerger check;
+    check.add(bad.data(), bad.size());
+    check.add(parts[1].data(), 10);
+    step.clear();
+    printTestResult("  count", 20, static_cast<int>(check.next(step, SIZE_MAX)));
+    printTestResult("  backwards", 1, static_cast<int>(check.get_unsorted()));
+}
+
+void test21()
+{
+    cout << endl
+         << "Test 21 results (Bulk load files)" << endl;
+
+    char directory[] = "/tmp/payloadCoderBulkXXXXXX";
+    if (mkdtemp(directory) == nullptr)
+    {
+        printTestResult("  mkdtemp", 1, 0);
+        return;
+    }
+    const std::string dir = directory;
+    const auto readFile = [](const std::string &path)
+    {
+        std::string text;
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file != nullptr)
+        {
+            char chunk[4096];
+            size_t n = 0;
+            while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            {
+                text.append(chunk, n);
+            }
+            fclose(file);
+        }
+        return text;
+    };
+
+    // Three frames, the middle one with an unknown version, and the TTN messages they came from
+    payloadEncoder encoder;
+    uint8_t frames[3 * SENSOR_PAYLOAD_SIZE];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        encoder.set_id(40 + i);
+        encoder.set_version(1);
+        encoder.set_doorStatus(i == 0);
+        encoder.set_catchDetect(i == 2);
+        encoder.set_trapDisplacement(false);
+        encoder.set_batteryStatus(static_cast<uint8_t>(90 - i));
+        encoder.set_unixTime(1700000000 + i);
+        encoder.composePayload();
+        memcpy(frames + i * SENSOR_PAYLOAD_SIZE, encoder.getPayload(), SENSOR_PAYLOAD_SIZE);
+    }
+    frames[SENSOR_PAYLOAD_SIZE + PAYLOAD_VERSION_INDEX] = 0x7F;
+    std::vector<ttnUplink> uplinks(3);
+    uplinks[0].deviceId = "trap-40";
+    uplinks[0].devEui = "70B3D57ED0000028";
+    uplinks[0].devAddr = "26000028";
+    uplinks[0].receivedAt = "2023-11-14T22:13:20.5Z";
+    uplinks[0].fcnt = 12;
+    uplinks[0].port = 1;
+    uplinks[0].frequency = 868100000;
+    uplinks[0].sf = 9;
+    uplinks[2] = uplinks[0];
+    uplinks[2].deviceId = "odd\tname\\";
+    uplinks[2].frequency = 867000000;
+    payloadBatch batch;
+    payloadDecoder::decodeBatch(frames, sizeof(frames), batch);
+
+    bulkLoadConfig config;
+    config.directory = dir;
+    config.prefix = "test";
+    config.maxRows = 2;
+    std::vector<bulkLoadFile> completed;
+    {
+        bulkLoadWriter writer(config);
+        const bool ok = writer.write(batch, uplinks) && writer.write(batch, std::vector<ttnUplink>()) && writer.close();
+        writer.takeCompleted(completed);
+        printTestResult("  rows", 4, static_cast<int>(writer.get_rows()));
+        printTestResult("  write", 1, ok);
+    }
+    printTestResult("  files", 2, static_cast<int>(completed.size()));
+    const std::string first = readFile(dir + "/test-000001.tsv");
+    const std::string second = readFile(dir + "/test-000002.tsv");
+    printTestResult("  ttn row", 1, first.compare(0, std::string::npos,
+                                                 "TTNV3\t2023-11-14 22:13:20\ttrap-40\t\\N\t70B3D57ED0000028\t12\t1\t26000028\t868.1\t9\t90\t0\t1\t0\t40\t1700000000\t1\n"
+                                                 "TTNV3\t2023-11-14 22:13:20\todd\\tname\\\\\t\\N\t70B3D57ED0000028\t12\t1\t26000028\t867\t9\t88\t1\t0\t0\t42\t1700000002\t1\n") == 0);
+    printTestResult("  plain row", 1, second.compare(0, std::string::npos,
+                                                  "TTNV3\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t90\t0\t1\t0\t40\t1700000000\t1\n"
+                                                  "TTNV3\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t\\N\t88\t1\t0\t0\t42\t1700000002\t1\n") == 0);
+    printTestResult("  manifest", 1, readFile(dir + "/test.manifest") ==
+                                         "test-000001.tsv\t2\t" + std::to_string(first.size()) + "\t1700000000\t1700000002\n"
+                                         "test-000002.tsv\t2\t" + std::to_string(second.size()) + "\t1700000000\t1700000002\n");
+    printTestResult("  no part files", 1, access((dir + "/test-000001.tsv.part").c_str(), F_OK) != 0);
+
+    // A new writer continues the numbering instead of overwriting
+    {
+        bulkLoadWriter writer(config);
+        writer.write(batch, uplinks);
+        writer.close();
+        completed.clear();
+        writer.takeCompleted(completed);
+    }
+    printTestResult("  restart", 1, completed.size() == 1 && completed[0].path == dir + "/test-000003.tsv" &&
+                                        readFile(dir + "/test-000001.tsv") == first);
+    printTestResult("  statement", 1, bulkLoadStatement("/data/it's.tsv") ==
+                                          std::string("LOAD DATA LOCAL INFILE '/data/it\\'s.tsv' INTO TABLE muskrattrap CHARACTER SET utf8mb4 "
+                                                      "FIELDS TERMINATED BY '\\t' LINES TERMINATED BY '\\n' (") +
+                                              BULK_LOAD_COLUMNS + ");\n");
+
+    for (const char *name : {"test-000001.tsv", "test-000002.tsv", "test-000003.tsv", "test.manifest"})
+    {
+        unlink((dir + "/" + name).c_str());
+    }
+    rmdir(directory);
+}
+
+void test22()
+{
+    cout << endl
+         << "Test 22 results (Arrow IPC file)" << endl;
+
+    // 1000 rows with every flag combination, written in batches of 300 rows from blocks of 128
+    payloadBatch batch;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        batch.id.push_back(100000 + i);
+        batch.version.push_back(1);
+        batch.flags.push_back(static_cast<uint8_t>(i % 8));
+        batch.battery.push_back(static_cast<uint8_t>(i % 251));
+        batch.unixTime.push_back(1700000000 + 7 * i);
+        batch.doorStatus.push_back((i >> 2) & 1);
+        batch.catchDetect.push_back((i >> 1) & 1);
+        batch.trapDisplacement.push_back(i & 1);
+    }
+    FILE *file = tmpfile();
+    if (file == nullptr)
+    {
+        printTestResult("  tmpfile", 1, 0);
+        return;
+    }
+    arrowWriter writer(file, 300);
+    payloadBatch block;
+    for (size_t first = 0; first < batch.size(); first += 128)
+    {
+        const size_t count = std::min<size_t>(128, batch.size() - first);
+        block.clear();
+        block.id.assign(batch.id.begin() + first, batch.id.begin() + first + count);
+        block.version.assign(batch.version.begin() + first, batch.version.begin() + first + count);
+        block.flags.assign(batch.flags.begin() + first, batch.flags.begin() + first + count);
+        block.battery.assign(batch.battery.begin() + first, batch.battery.begin() + first + count);
+        block.unixTime.assign(batch.unixTime.begin() + first, batch.unixTime.begin() + first + count);
+        block.doorStatus.assign(batch.doorStatus.begin() + first, batch.doorStatus.begin() + first + count);
+        block.catchDetect.assign(batch.catchDetect.begin() + first, batch.catchDetect.begin() + first + count);
+        block.trapDisplacement.assign(batch.trapDisplacement.begin() + first, batch.trapDisplacement.begin() + first + count);
+        writer.write(block);
+    }
+    printTestResult("  close", 1, writer.close());
+    printTestResult("  rows", 1000, static_cast<int>(writer.get_rows()));
+    printTestResult("  batches", 4, static_cast<int>(writer.get_batches()));
+
+    std::vector<uint8_t> bytes(static_cast<size_t>(ftell(file)));
+    rewind(file);
+    const bool read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    fclose(file);
+    const auto u16 = [&](size_t at)
+    { return static_cast<size_t>(bytes[at] | bytes[at + 1] << 8); };
+    const auto u32 = [&](size_t at)
+    { return static_cast<size_t>(bytes[at] | bytes[at + 1] << 8 | bytes[at + 2] << 16 | static_cast<uint32_t>(bytes[at + 3]) << 24); };
+    const bool magic = read && bytes.size() > 64 && memcmp(bytes.data(), "ARROW1\0\0", 8) == 0 &&
+                       memcmp(bytes.data() + bytes.size() - 6, "ARROW1", 6) == 0 && u32(8) == 0xFFFFFFFF;
+    printTestResult("  magic", 1, magic);
+    if (!magic)
+    {
+        return;
+    }
+
+    // Footer (FlatBuffers): root table, field 3 = record batch blocks {offset, metaDataLength, bodyLength}
+    const size_t footer = bytes.size() - 10 - u32(bytes.size() - 10);
+    const size_t table = footer + u32(footer);
+    const size_t vtable = table - u32(table);
+    const size_t blocksField = table + u16(vtable + 4 + 2 * 3);
+    const size_t blocks = blocksField + u32(blocksField);
+    printTestResult("  footer blocks", 4, static_cast<int>(u32(blocks)));
+
+    // Walk the bodies: seven columns of two buffers, each starting on a 64-byte boundary
+    bool columns = true;
+    bool aligned = true;
+    size_t row = 0;
+    for (size_t b = 0; b < u32(blocks) && b < 4; b++)
+    {
+        const size_t entry = blocks + 4 + 24 * b; // struct Block {offset, metaDataLength, padding, bodyLength}
+        const size_t body = u32(entry) + u32(entry + 8);
+        const size_t rows = b < 3 ? 300 : 100;
+        aligned = aligned && u32(u32(entry)) == 0xFFFFFFFF && body % 64 == 0;
+        const size_t sizes[] = {4 * rows, rows, (rows + 7) / 8, (rows + 7) / 8, (rows + 7) / 8, rows, 4 * rows};
+        size_t at = body;
+        size_t column[7];
+        for (size_t c = 0; c < 7; c++)
+        {
+            column[c] = at;
+            at += (sizes[c] + 63) / 64 * 64;
+        }
+        for (size_t i = 0; columns && i < rows; i++, row++)
+        {
+            columns = u32(column[0] + 4 * i) == batch.id[row] && bytes[column[1] + i] == 1 &&
+                      ((bytes[column[2] + i / 8] >> (i % 8)) & 1) == batch.doorStatus[row] &&
+                      ((bytes[column[3] + i / 8] >> (i % 8)) & 1) == batch.catchDetect[row] &&
+                      ((bytes[column[4] + i / 8] >> (i % 8)) & 1) == batch.trapDisplacement[row] &&
+                      bytes[column[5] + i] == batch.battery[row] && u32(column[6] + 4 * i) == batch.unixTime[row];
+        }
+    }
+    printTestResult("  aligned bodies", 1, aligned);
+    printTestResult("  columns", 1, columns && row == 1000);
+}
+
+void test23()
+{
+    cout << endl
+         << "Test 23 results (Webhook server)" << endl;
+
+    // Server on a free loopback port with two event loops; the sink collects the decoded ids
+    std::mutex lock;
+    std::vector<uint64_t> received;
+    webhookConfig config;
+    config.address = "127.0.0.1";
+    config.port = 0;
+    config.threads = 2;
+    webhookServer server(config, [&](unsigned, const payloadBatch &batch, const std::vector<uplinkRecord> &uplinks)
+                         {
+                             std::lock_guard<std::mutex> guard(lock);
+                             for (size_t row = 0; row < batch.size() && row < uplinks.size(); row++)
+                             {
+                                 received.push_back(static_cast<uint64_t>(batch.id[row]) << 32 | uplinks[row].fcnt);
+                             }
+                         });
+    const bool started = server.start();
+    printTestResult("  start", 1, started);
+    if (!started)
+    {
+        return;
+    }
+
+    // 2000 generated uplinks, 10 bodies that are not JSON and 10 messages without an uplink
+    fleetConfig fleet = defaultFleetConfig();
+    fleet.traps = 50;
+    fleetGenerator generator(fleet);
+    payloadBatch generated;
+    std::vector<fleetUplink> uplinks;
+    generator.next(2000, UINT64_MAX, generated, uplinks);
+    std::vector<uint8_t> frames(generated.size() * SENSOR_PAYLOAD_SIZE);
+    payloadEncoder::encodeBatch(generated, frames.data(), frames.size());
+    std::string text;
+    appendFleetUplinks(inputFormat::ttn, fleet, frames.data(), uplinks, text);
+    std::vector<std::string_view> messages;
+    for (size_t begin = 0, end = 0; (end = text.find('\n', begin)) != std::string::npos; begin = end + 1)
+    {
+        messages.emplace_back(text.data() + begin, end - begin);
+        if (messages.size() % 200 == 0)
+        {
+            messages.emplace_back("not json");
+            messages.emplace_back("{\"end_device_ids\":{\"device_id\":\"trap\"},\"join_accept\":{}}");
+        }
+    }
+    std::vector<uint64_t> expected;
+    for (size_t i = 0; i < generated.size(); i++)
+    {
+        expected.push_back(static_cast<uint64_t>(generated.id[i]) << 32 | uplinks[i].fcnt);
+    }
+
+    webhookLoadConfig load;
+    load.port = server.get_port();
+    load.connections = 8;
+    load.depth = 16;
+    webhookLoadResult result;
+    printTestResult("  load run", 1, runWebhookLoad(load, messages, result));
+    printTestResult("  responses", 2020, static_cast<int>(result.responses));
+    printTestResult("  ok responses", 2010, static_cast<int>(result.ok));
+
+    // Single requests on a plain socket: closing health check, 100-continue, chunked body
+    const auto exchange = [](uint16_t port, const std::vector<std::string> &parts)
+    {
+        std::string reply;
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return reply;
+        }
+        char chunk[512];
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (send(fd, parts[i].data(), parts[i].size(), MSG_NOSIGNAL) != static_cast<ssize_t>(parts[i].size()))
+            {
+                break;
+            }
+            // Wait for the interim response before the next part, and for the close after the last
+            ssize_t n = 0;
+            while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+            {
+                reply.append(chunk, static_cast<size_t>(n));
+                if (i + 1 < parts.size() && reply.find("\r\n\r\n") != std::string::npos)
+                {
+                    break;
+                }
+            }
+        }
+        close(fd);
+        return reply;
+    };
+    const std::string health = exchange(server.get_port(), {"GET /health HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n"});
+    printTestResult("  health check", 1, health.compare(0, 12, "HTTP/1.1 200") == 0 && health.find("\r\n\r\nok\n") != std::string::npos);
+    const std::string body(messages[0]);
+    const std::string continued = exchange(server.get_port(), {"POST /uplink HTTP/1.1\r\nHost: test\r\nExpect: 100-continue\r\nConnection: close\r\n"
+                                            "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n",
+                                            body});
+    printTestResult("  100-continue", 1, continued.compare(0, 12, "HTTP/1.1 100") == 0 && continued.find("HTTP/1.1 200") != std::string::npos);
+    const std::string chunked = exchange(server.get_port(), {"POST /uplink HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n"});
+    printTestResult("  chunked", 1, chunked.compare(0, 12, "HTTP/1.1 501") == 0);
+
+    server.stop();
+    server.wait();
+    const webhookStats stats = server.get_stats();
+    printTestResult("  requests", 2023, static_cast<int>(stats.requests));
+    printTestResult("  uplinks", 2001, static_cast<int>(stats.uplinks));
+    printTestResult("  ignored", 10, static_cast<int>(stats.ignored));
+    printTestResult("  rejected", 11, static_cast<int>(stats.rejected));
+
+    // Every uplink reached the sink once (the 100-continue request repeats the first one)
+    expected.push_back(expected.front());
+    std::sort(expected.begin(), expected.end());
+    std::sort(received.begin(), received.end());
+    printTestResult("  uplinks in sink", 1, received == expected);
+
+    // A server that requires an Authorization header
+    config.authorization = "Bearer secret";
+    webhookServer flooded(config, [](unsigned, const payloadBatch &, const std::vector<uplinkRecord> &) {});
+    if (!flooded.start())
+    {
+        printTestResult("  flood start", 1, 0);
+        return;
+    }
+    const std::string allowed = exchange(flooded.get_port(), {"GET /health HTTP/1.1\r\nAuthorization: Bearer secret\r\nConnection: close\r\n\r\n"});
+    const std::string wrong = exchange(flooded.get_port(), {"GET /health HTTP/1.1\r\nAuthorization: Bearer secreT\r\nConnection: close\r\n\r\n"});
+    const std::string longer = exchange(flooded.get_port(), {"GET /health HTTP/1.1\r\nAuthorization: Bearer secrets\r\nConnection: close\r\n\r\n"});
+    printTestResult("  authorized", 1, allowed.compare(0, 12, "HTTP/1.1 200") == 0);
+    printTestResult("  unauthorized", 1, wrong.compare(0, 12, "HTTP/1.1 401") == 0 && longer.compare(0, 12, "HTTP/1.1 401") == 0);
+
+    // A client that pipelines requests but never reads the responses stops being read
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    const int small = 4096;
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(flooded.get_port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const bool connected = fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small)) == 0 &&
+                           connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0 &&
+                           fcntl(fd, F_SETFL, O_NONBLOCK) == 0;
+    std::string requests;
+    while (requests.size() < (64 << 10))
+    {
+        requests += "GET /health HTTP/1.1\r\n\r\n";
+    }
+    const size_t limit = 16 << 20;
+    size_t sent = 0;
+    for (int stalls = 0; connected && sent < limit && stalls < 100;)
+    {
+        const ssize_t n = send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+        stalls = n > 0 ? 0 : stalls + 1;
+        sent += n > 0 ? static_cast<size_t>(n) : 0;
+        if (n <= 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    flooded.stop();
+    flooded.wait();
+    printTestResult("  flood connected", 1, connected);
+    printTestResult("  flood stops reading", 1, sent < limit && flooded.get_stats().requests < sent / 27);
+}
+
+void test24()
+{
+    cout << endl
+         << "Test 24 results (Bulk reader)" << endl;
+
+    // 10000 frames and 5 stray bytes; buffers round to 4096 frames, so 3 buffers
+    char path[] = "/tmp/payloadCoderBulkReadXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        printTestResult("  mkstemp", 1, 0);
+        return;
+    }
+    std::vector<uint8_t> data(10000 * SENSOR_PAYLOAD_SIZE + 5);
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (uint8_t &byte : data)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        byte = static_cast<uint8_t>(state >> 56);
+    }
+    for (size_t i = 0; i < 10000; i++)
+    {
+        data[i * SENSOR_PAYLOAD_SIZE + PAYLOAD_VERSION_INDEX] = 1;
+    }
+    const bool written = write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    close(fd);
+
+    for (const bool uring : {true, false})
+    {
+        bulkReadConfig config;
+        config.bufferSize = 1;
+        config.buffers = 2;
+        config.uring = uring;
+        bulkReader reader(config);
+        std::vector<uint8_t> copy;
+        bool full = true;
+        size_t blocks = 0;
+        const uint8_t *block = nullptr;
+        size_t length = 0;
+        const bool opened = written && reader.open(path);
+        while (opened && reader.next(block, length))
+        {
+            full = full && (copy.size() + length == data.size() || length == reader.get_bufferSize());
+            copy.insert(copy.end(), block, block + length);
+            blocks++;
+        }
+        printTestResult(uring ? "  uring: blocks" : "  pread: blocks", 3, static_cast<int>(blocks));
+        printTestResult(uring ? "  uring: bytes" : "  pread: bytes", 1, opened && full && copy == data && !reader.failed());
+    }
+
+    // Raw frames through a frameReader: whole buffers, then the stray bytes as one rejected frame
+    {
+        bulkReadConfig config;
+        config.bufferSize = 1;
+        config.buffers = 3;
+        bulkReader source(config);
+        const bool opened = source.open(path);
+        frameReader reader(source, inputFormat::raw);
+        payloadBatch batch;
+        const uint8_t *frames = nullptr;
+        size_t length = 0;
+        std::vector<size_t> lengths;
+        while (opened && reader.next(frames, length))
+        {
+            lengths.push_back(length);
+            payloadDecoder::decodeBatch(frames, length, batch);
+        }
+        const size_t buffer = source.get_bufferSize();
+        const std::vector<size_t> expected = {buffer, buffer, 10000 * SENSOR_PAYLOAD_SIZE - 2 * buffer, 5};
+        printTestResult("  raw rows", 10000, static_cast<int>(batch.size()));
+        printTestResult("  raw rejected", 1, static_cast<int>(batch.errors.size()));
+        printTestResult("  raw blocks", 1, lengths == expected);
+    }
+
+    // Hex lines of varying length cross the buffer boundaries; one overlong line is skipped
+    std::string text;
+    for (size_t i = 0; i < 20000; i++)
+    {
+        char line[80];
+        const uint8_t *frame = data.data() + (i % 10000) * SENSOR_PAYLOAD_SIZE;
+        size_t n = 0;
+        for (size_t b = 0; b < SENSOR_PAYLOAD_SIZE; b++)
+        {
+            n += static_cast<size_t>(snprintf(line + n, sizeof(line) - n, i % 3 == 0 ? "%02X" : "%X ", frame[b]));
+        }
+        text.append(line, n);
+        text += i % 7 == 0 ? "\r\n" : "\n";
+        if (i == 12345)
+        {
+            text += std::string(100000, '0') + "\n";
+        }
+    }
+    text += "0102030401056400000000"; // no line ending at the end
+    truncate(path, 0);
+    FILE *file = fopen(path, "wb");
+    const bool textWritten = file != nullptr && fwrite(text.data(), 1, text.size(), file) == text.size();
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+    const auto readAll = [](frameReader &reader, std::vector<uint8_t> &frames)
+    {
+        const uint8_t *block = nullptr;
+        size_t length = 0;
+        while (reader.next(block, length))
+        {
+            frames.insert(frames.end(), block, block + length);
+        }
+    };
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> frames;
+    uint64_t expectedRejected = 0;
+    file = fopen(path, "rb");
+    if (textWritten && file != nullptr)
+    {
+        frameReader reader(file, inputFormat::hex, 4096);
+        readAll(reader, expected);
+        expectedRejected = reader.get_rejectedLines();
+        fclose(file);
+    }
+    bulkReadConfig config;
+    config.bufferSize = 1;
+    bulkReader source(config);
+    if (source.open(path))
+    {
+        frameReader reader(source, inputFormat::hex, 4096);
+        readAll(reader, frames);
+        printTestResult("  hex rejected", static_cast<int>(expectedRejected), static_cast<int>(reader.get_rejectedLines()));
+    }
+    printTestResult("  hex frames", 20001 * SENSOR_PAYLOAD_SIZE, static_cast<int>(frames.size()));
+    printTestResult("  hex as stdio", 1, frames == expected);
+    unlink(path);
+
+    // A TTN line split across two blocks keeps its fields while the next line is carried over
+    const std::string first = "{\"end_device_ids\":{\"dev_eui\":\"70B3D57ED0061234\"},\"received_at\":\"2023-11-14T22:13:21Z\","
+                              "\"uplink_message\":{\"frm_payload\":\"AQIDBAFWZGVT8QE=\"}}\n";
+    const std::string second = "{\"end_device_ids\":{\"dev_eui\":\"FFFFFFFFFFFFFFFF\"},\"received_at\":\"2099-01-01T00:00:00Z\","
+                               "\"uplink_message\":{\"frm_payload\":\"AQIDBAFWZGVT8QE=\"}}\n";
+    const std::string joined = first + second;
+    const size_t split = first.size() / 2;
+    frameReader lines(inputFormat::ttn, 4096);
+    const uint8_t *block = nullptr;
+    size_t length = 0;
+    lines.convert(reinterpret_cast<const uint8_t *>(joined.data()), split, true, block, length);
+    const bool converted = lines.convert(reinterpret_cast<const uint8_t *>(joined.data()) + split, first.size() - split + 40,
+                                         true, block, length);
+    printTestResult("  split ttn line", 1, converted && length == SENSOR_PAYLOAD_SIZE && lines.get_uplinks().size() == 1 &&
+                                               lines.get_uplinks()[0].devEui == "70B3D57ED0061234" &&
+                                               lines.get_uplinks()[0].receivedAt == "2023-11-14T22:13:21Z");
+
+    // A missing file is reported, with nothing written, whichever way it would have been read
+    for (const char *io : {"uring", "pread", "stdio"})
+    {
+        for (const char *output : {"csv", "arrow"})
+        {
+            int status = -1;
+            int out[2];
+            char byte = 0;
+            const pid_t child = pipe(out) == 0 ? fork() : -1;
+            if (child == 0)
+            {
+                const int devNull = open("/dev/null", O_WRONLY);
+                dup2(out[1], 1);
+                dup2(devNull, 2);
+                close(out[0]);
+                execl("/proc/self/exe", "payloadCoder", "decode", "--io", io, "--output", output, path, static_cast<char *>(nullptr));
+                _exit(127);
+            }
+            if (child > 0)
+            {
+                close(out[1]);
+                const ssize_t count = read(out[0], &byte, 1);
+                close(out[0]);
+                waitpid(child, &status, 0);
+                status = count == 0 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            }
+            printTestResult(std::string("  missing file (") + io + ", " + output + ")", 1, status);
+        }
+    }
+}
+
+void test25()
+{
+    cout << endl
+         << "Test 25 results (Shard pipeline)" << endl;
+
+    // Ring between two threads: rounded capacity, full and empty, order
+    spscRing<uint32_t> small(5);
+    size_t accepted = 0;
+    while (small.tryPush(static_cast<uint32_t>(accepted)))
+    {
+        accepted++;
+    }
+    printTestResult("  ring capacity", 8, static_cast<int>(small.capacity()));
+    printTestResult("  ring full", 8, static_cast<int>(accepted));
+    spscRing<uint32_t> ring(4);
+    const uint32_t count = 200000;
+    std::thread feeder([&ring, count]()
+                       {
+                           for (uint32_t i = 0; i < count; i++)
+                           {
+                               while (!ring.tryPush(i))
+                               {
+                                   std::this_thread::yield();
+                               }
+                           } });
+    uint32_t expected = 0;
+    bool inOrder = true;
+    while (expected < count)
+    {
+        uint32_t value = 0;
+        if (ring.tryPop(value))
+        {
+            inOrder = inOrder && value == expected;
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    feeder.join();
+    printTestResult("  ring order", 1, inOrder && ring.empty());
+
+    // Two producers with their own traps, three shards, batches of 7 rows, two batches in flight;
+    // the battery column carries the trap, unixTime counts the records of each trap from 1
+    shardConfig config;
+    config.shards = 3;
+    config.producers = 2;
+    config.batchRows = 7;
+    config.ringBatches = 2;
+    std::vector<std::vector<uint32_t>> lastSeen(3, std::vector<uint32_t>(200, 0));
+    std::vector<uint64_t> received(3, 0);
+    std::vector<uint64_t> sent(2, 0);
+    std::vector<int> correct(3, 1);
+    shardPipeline pipeline(config, [&](unsigned shard, const payloadBatch &batch)
+                           {
+                               for (size_t i = 0; i < batch.size(); i++)
+                               {
+                                   correct[shard] = correct[shard] && shardPipeline::shardOf(batch.id[i], 3) == shard &&
+                                                    batch.unixTime[i] == lastSeen[shard][batch.id[i]] + 1 &&
+                                                    batch.battery[i] == static_cast<uint8_t>(batch.id[i]);
+                                   lastSeen[shard][batch.id[i]] = batch.unixTime[i];
+                               }
+                               received[shard] += batch.size();
+                           });
+    auto produce = [&pipeline, &sent](unsigned producer)
+    {
+        std::vector<uint32_t> records(200, 0);
+        payloadBatch batch;
+        for (uint32_t round = 0; round < 500; round++)
+        {
+            batch.clear();
+            for (uint32_t trap = producer * 100; trap < producer * 100 + 100; trap += 1 + round % 3)
+            {
+                batch.resize(batch.size() + 1);
+                batch.id.back() = trap;
+                batch.battery.back() = static_cast<uint8_t>(trap);
+                batch.unixTime.back() = ++records[trap];
+            }
+            sent[producer] += batch.size();
+            pipeline.push(producer, batch);
+        }
+        pipeline.flush(producer);
+    };
+    std::thread second(produce, 1);
+    produce(0);
+    second.join();
+    pipeline.close();
+    uint64_t counted = 0;
+    for (const shardStats &stats : pipeline.get_stats())
+    {
+        counted += stats.rows;
+    }
+    printTestResult("  rows", static_cast<int>(sent[0] + sent[1]), static_cast<int>(received[0] + received[1] + received[2]));
+    printTestResult("  stats rows", static_cast<int>(sent[0] + sent[1]), static_cast<int>(counted));
+    printTestResult("  shard and order", 1, correct[0] && correct[1] && correct[2] && received[0] > 0 && received[1] > 0 && received[2] > 0);
+
+    // Battery fits on four shards rank the traps like one tracker: 200 traps with hourly records
+    // for 5 days, each draining at its own rate, sent in blocks of 500 rows
+    batteryTrendTracker single;
+    std::vector<std::unique_ptr<batteryTrendTracker>> trackers;
+    shardConfig batteryConfig;
+    batteryConfig.shards = 4;
+    batteryConfig.batchRows = 64;
+    shardPipeline batteryPipeline(batteryConfig, [&trackers](unsigned shard, const payloadBatch &batch)
+                                  { trackers[shard]->update(batch); });
+    for (unsigned s = 0; s < batteryPipeline.get_shards(); s++)
+    {
+        trackers.emplace_back(new batteryTrendTracker());
+    }
+    payloadBatch batch;
+    for (uint32_t hour = 0; hour < 5 * 24; hour++)
+    {
+        for (uint32_t trap = 0; trap < 200; trap++)
+        {
+            batch.resize(batch.size() + 1);
+            batch.id.back() = 5000 + trap * 7;
+            batch.battery.back() = static_cast<uint8_t>(100 - (hour * (1 + trap % 13)) / 48);
+            batch.unixTime.back() = 1700000000 + hour * 3600 + trap;
+            if (batch.size() == 500)
+            {
+                single.update(batch);
+                batteryPipeline.push(0, batch);
+                batch.clear();
+            }
+        }
+    }
+    single.update(batch);
+    batteryPipeline.push(0, batch);
+    batteryPipeline.flush(0);
+    batteryPipeline.close();
+    std::vector<batteryForecast> expectedDue;
+    single.dueForService(25, expectedDue);
+    std::vector<batteryForecast> due;
+    std::vector<batteryForecast> part;
+    size_t traps = 0;
+    for (const std::unique_ptr<batteryTrendTracker> &tracker : trackers)
+    {
+        tracker->dueForService(25, part);
+        due.insert(due.end(), part.begin(), part.end());
+        traps += tracker->get_traps();
+    }
+    std::sort(due.begin(), due.end(), [](const batteryForecast &a, const batteryForecast &b)
+              { return a.daysToEmpty != b.daysToEmpty ? a.daysToEmpty < b.daysToEmpty : a.id < b.id; });
+    due.resize(std::min<size_t>(25, due.size()));
+    bool sameDue = due.size() == expectedDue.size() && due.size() == 25;
+    for (size_t i = 0; sameDue && i < due.size(); i++)
+    {
+        sameDue = due[i].id == expectedDue[i].id && due[i].slopePerDay == expectedDue[i].slopePerDay &&
+                  due[i].daysToEmpty == expectedDue[i].daysToEmpty;
+    }
+    printTestResult("  battery traps", 200, static_cast<int>(traps));
+    printTestResult("  battery ranking", 1, sameDue);
+}
+
+/**
+ * @brief Test case for the batch arena.
+ */
+void test26()
+{
+    cout << endl
+         << "Test 26 results (Batch arena)" << endl;
+
+    // Alignment, growth past the first block, and one merged block after reset()
+    trackingResource upstream;
+    batchArena arena(256, &upstream);
+    bool aligned = true;
+    for (size_t alignment : {1, 2, 8, 16, 64})
+    {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(arena.allocate(3, alignment));
+        aligned = aligned && address % alignment == 0;
+    }
+    aligned = aligned && arena.allocate(1000, 8) != nullptr;
+    printTestResult("  aligned", 1, aligned);
+    printTestResult("  grown", 2, static_cast<int>(arena.get_blocks()));
+    const size_t capacity = arena.get_capacity();
+    arena.reset();
+    printTestResult("  reset used", 0, static_cast<int>(arena.get_used()));
+    const uint64_t allocations = upstream.get_allocations();
+    for (int round = 0; round < 10; round++)
+    {
+        for (size_t alignment : {1, 2, 8, 16, 64})
+        {
+            aligned = aligned && arena.allocate(3, alignment) != nullptr;
+        }
+        aligned = aligned && arena.allocate(1000, 8) != nullptr;
+        arena.reset();
+    }
+    printTestResult("  reused", 1, aligned);
+    printTestResult("  merged blocks", 1, static_cast<int>(arena.get_blocks()));
+    printTestResult("  merged capacity", static_cast<int>(capacity), static_cast<int>(arena.get_capacity()));
+    printTestResult("  upstream allocations", static_cast<int>(allocations + 1), static_cast<int>(upstream.get_allocations()));
+
+    // A batch on the arena decodes like one on the heap
+    uint8_t frames[100 * SENSOR_PAYLOAD_SIZE];
+    payloadEncoder encoder;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        encoder.set_id(1000 + i);
+        encoder.set_batteryStatus(static_cast<uint8_t>(i));
+        encoder.set_version(PAYLOAD_VERSION);
+        encoder.set_unixTime(1700000000 + i);
+        encoder.encodeInto(frames + i * SENSOR_PAYLOAD_SIZE, SENSOR_PAYLOAD_SIZE);
+    }
+    payloadBatch heap;
+    payloadDecoder::decodeBatch(frames, sizeof(frames), heap);
+    bool same = false;
+    {
+        payloadBatch batch(&arena);
+        payloadDecoder::decodeBatch(frames, sizeof(frames), batch);
+        same = batch.id == heap.id && batch.battery == heap.battery && batch.unixTime == heap.unixTime &&
+               batch.id.get_allocator().resource() == &arena;
+    }
+    arena.reset();
+    printTestResult("  arena batch", 1, same);
+
+    // Streaming 40 small chunks takes the arena block once, and writes what the heap version writes
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    FILE *reference = tmpfile();
+    if (in == nullptr || out == nullptr || reference == nullptr)
+    {
+        printTestResult("  tmpfile", 1, 0);
+        return;
+    }
+    for (int i = 0; i < 40; i++)
+    {
+        fwrite(frames, 1, sizeof(frames), in);
+    }
+    rewind(in);
+    streamStats stats;
+    frameReader plain(in, inputFormat::raw, sizeof(frames));
+    const bool plainOk = streamDecode(plain, reference, outputFormat::csv, stats);
+
+    rewind(in);
+    trackingResource readMemory;
+    trackingResource decodeMemory;
+    trackingResource formatMemory;
+    streamMemory memory;
+    memory.input = &readMemory;
+    memory.batches = &decodeMemory;
+    memory.output = &formatMemory;
+    frameReader tracked(in, inputFormat::raw, sizeof(frames), &readMemory);
+    const bool trackedOk = streamDecode(tracked, out, outputFormat::csv, stats, nullptr, memory);
+    printTestResult("  stream ok", 1, plainOk && trackedOk);
+    printTestResult("  rows", 4000, static_cast<int>(stats.rows));
+    printTestResult("  batch allocations", 1, static_cast<int>(decodeMemory.get_allocations()));
+    printTestResult("  batch bytes", 1, stats.batchBytes >= 100 * sizeof(uint32_t) && stats.batchBytes < 100 * 64);
+    printTestResult("  tracked input", 1, readMemory.get_allocations() > 0 && formatMemory.get_allocations() > 0);
+
+    std::vector<char> expected(1 << 20);
+    std::vector<char> written(1 << 20);
+    rewind(reference);
+    rewind(out);
+    const size_t expectedLength = fread(expected.data(), 1, expected.size(), reference);
+    const size_t writtenLength = fread(written.data(), 1, written.size(), out);
+    printTestResult("  same output", 1, expectedLength > 0 && expectedLength == writtenLength && expected == written);
+    fclose(in);
+    fclose(out);
+    fclose(reference);
+}
+
+/// \brief test27: push a trace entry per round, then add two numbers one round later
+static task<int> addLater(int a, int b)
+{
+    co_await asyncExecutor::yield();
+    co_return a + b;
+}
+
+/// \brief test27: three rounds of trace entries, then the result of a nested task
+static task<void> traceRounds(std::vector<int> *trace, int id)
+{
+    for (int round = 0; round < 3; round++)
+    {
+        trace->push_back(id * 10 + round);
+        co_await asyncExecutor::yield();
+    }
+    trace->push_back(co_await addLater(id, 100));
+}
+
+/// \brief test27: write `text` in pieces of `piece` bytes, one per round, then close `fd`
+static task<void> feedPieces(int fd, std::string text, size_t piece)
+{
+    for (size_t pos = 0; pos < text.size(); pos += piece)
+    {
+        co_await writeAll(fd, text.data() + pos, std::min(piece, text.size() - pos));
+        co_await asyncExecutor::yield();
+    }
+    close(fd);
+}
+
+/// \brief test27: decode a source into a sink, adding up rows and ids
+static task<void> decodeInto(std::unique_ptr<asyncSource> source, asyncSink *sink, std::atomic<uint64_t> *rows,
+                             std::atomic<uint64_t> *ids)
+{
+    payloadBatch batch;
+    while (co_await source->nextBatch(batch))
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            *ids += batch.id[i];
+        }
+        *rows += batch.size();
+        co_await sink->write(batch);
+    }
+    co_await sink->flush();
+}
+
+/// \brief test27: write `batches` copies of a batch through a sink, then close the sink's descriptor
+static task<void> writeBatches(asyncSink *sink, const payloadBatch *batch, int batches, int fd)
+{
+    for (int i = 0; i < batches; i++)
+    {
+        co_await sink->write(*batch);
+    }
+    co_await sink->flush();
+    close(fd);
+}
+
+/// \brief test27: stop the executor once the other coroutines had two rounds
+static task<void> stopLater(asyncExecutor *executor)
+{
+    co_await asyncExecutor::yield();
+    co_await asyncExecutor::yield();
+    executor->stop();
+}
+
+/// \brief test27: read a descriptor to the end, counting the bytes
+static task<void> countBytes(int fd, uint64_t *bytes)
+{
+    std::vector<char> buffer(4096);
+    ssize_t count = 0;
+    while ((count = co_await readSome(fd, buffer.data(), buffer.size())) > 0)
+    {
+        *bytes += static_cast<uint64_t>(count);
+    }
+    close(fd);
+}
+
+/// \brief test27: accept `connections` connections and decode each in its own flow
+static task<void> acceptFlows(asyncExecutor *executor, asyncListener *listener, int connections, asyncSink *sink,
+                              std::atomic<uint64_t> *rows, std::atomic<uint64_t> *ids)
+{
+    for (int i = 0; i < connections; i++)
+    {
+        const int fd = co_await listener->accept();
+        std::unique_ptr<asyncSource> source(new asyncSource(inputFormat::raw));
+        if (fd < 0 || !source->open(fd))
+        {
+            co_return;
+        }
+        executor->spawn(decodeInto(std::move(source), sink, rows, ids));
+    }
+}
+
+/// \brief test27: connect to a local port without blocking and send `text`
+static task<void> sendTo(uint16_t port, std::string text)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 && errno == EINPROGRESS)
+    {
+        co_await asyncExecutor::writable(fd);
+    }
+    co_await writeAll(fd, text.data(), text.size());
+    close(fd);
+}
+
+/**
+ * @brief Test case for the coroutine executor and the async ingest API.
+ */
+void test27()
+{
+    cout << endl
+         << "Test 27 results (Async ingest)" << endl;
+
+    // Two coroutines on one loop take turns at every yield; nested tasks return their value
+    std::vector<int> trace;
+    asyncExecutor single(1);
+    single.spawn(traceRounds(&trace, 1));
+    single.spawn(traceRounds(&trace, 2));
+    const bool ran = single.run();
+    printTestResult("  run", 1, ran);
+    printTestResult("  turns", 1, trace == std::vector<int>{10, 20, 11, 21, 12, 22, 101, 102});
+    printTestResult("  finished", 2, static_cast<int>(single.get_stats().finished));
+
+    // Frames: 20 per connection, the id counts the frames
+    payloadEncoder encoder;
+    encoder.set_version(PAYLOAD_VERSION);
+    std::vector<uint8_t> raw;
+    std::string hex;
+    uint64_t expectedIds = 0;
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        uint8_t frame[SENSOR_PAYLOAD_SIZE];
+        char text[2 * SENSOR_PAYLOAD_SIZE];
+        encoder.set_id(1000 + i);
+        encoder.set_unixTime(1700000000 + i);
+        encoder.encodeInto(frame, SENSOR_PAYLOAD_SIZE);
+        raw.insert(raw.end(), frame, frame + SENSOR_PAYLOAD_SIZE);
+        binaryToHex(frame, SENSOR_PAYLOAD_SIZE, text);
+        hex.append(text, sizeof(text)).append("\n");
+        expectedIds += 1000 + i;
+    }
+
+    // 500 socket pairs on two loops: hex lines sent 16 bytes at a time, decoded into one sink
+    FILE *out = tmpfile();
+    if (out == nullptr)
+    {
+        printTestResult("  tmpfile", 1, 0);
+        return;
+    }
+    std::atomic<uint64_t> rows(0);
+    std::atomic<uint64_t> ids(0);
+    {
+        asyncExecutor executor(2);
+        asyncSink sink(fileno(out), outputFormat::csv);
+        bool opened = true;
+        for (int i = 0; i < 500 && opened; i++)
+        {
+            int pair[2];
+            opened = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair) == 0;
+            std::unique_ptr<asyncSource> source(new asyncSource(inputFormat::hex, 4096));
+            opened = opened && source->open(pair[0]);
+            if (opened)
+            {
+                executor.spawn(static_cast<unsigned>(i), feedPieces(pair[1], hex, 16));
+                executor.spawn(static_cast<unsigned>(i), decodeInto(std::move(source), &sink, &rows, &ids));
+            }
+        }
+        printTestResult("  socket pairs", 1, opened && executor.run());
+        printTestResult("  flows", 1000, static_cast<int>(executor.get_stats().finished));
+        printTestResult("  waits", 1, executor.get_stats().waits > 0);
+    }
+    printTestResult("  rows", 500 * 20, static_cast<int>(rows.load()));
+    printTestResult("  ids", 1, ids.load() == 500 * expectedIds);
+    rewind(out);
+    int lines = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), out) != nullptr)
+    {
+        lines++;
+    }
+    fclose(out);
+    printTestResult("  csv lines", 500 * 20 + 1, lines);
+
+    // A sink on a full pipe waits for the reader; every byte arrives
+    payloadBatch many;
+    for (int i = 0; i < 50; i++)
+    {
+        payloadDecoder::decodeBatch(raw.data(), raw.size(), many);
+    }
+    int pipeFds[2];
+    uint64_t piped = 0;
+    if (pipe2(pipeFds, O_NONBLOCK) == 0)
+    {
+        asyncExecutor executor(1);
+        asyncSink sink(pipeFds[1], outputFormat::binary, 4096);
+        executor.spawn(writeBatches(&sink, &many, 100, pipeFds[1]));
+        executor.spawn(countBytes(pipeFds[0], &piped));
+        executor.run();
+        printTestResult("  pipe waits", 1, executor.get_stats().waits > 0);
+        printTestResult("  sink bytes", 1, sink.get_bytes() == 100 * 1000 * BINARY_RECORD_SIZE && !sink.failed());
+    }
+    printTestResult("  piped bytes", 1, piped == 100 * 1000 * BINARY_RECORD_SIZE);
+
+    // Stopping the executor while a write waits on a full pipe: finish() writes the rest
+    piped = 0;
+    bool finished = false;
+    if (pipe2(pipeFds, O_NONBLOCK) == 0)
+    {
+        asyncSink sink(pipeFds[1], outputFormat::binary);
+        {
+            asyncExecutor executor(1);
+            executor.spawn(writeBatches(&sink, &many, 100, -1));
+            executor.spawn(stopLater(&executor));
+            executor.run();
+        }
+        std::thread reader([&]()
+                           {
+                               std::vector<char> buffer(4096);
+                               ssize_t count = 0;
+                               pollfd wait{pipeFds[0], POLLIN, 0};
+                               while (poll(&wait, 1, -1) >= 0 && (count = read(pipeFds[0], buffer.data(), buffer.size())) != 0)
+                               {
+                                   piped += count > 0 ? static_cast<uint64_t>(count) : 0;
+                               }
+                           });
+        finished = sink.finish();
+        close(pipeFds[1]);
+        reader.join();
+        close(pipeFds[0]);
+        finished = finished && piped == sink.get_bytes();
+    }
+    printTestResult("  finish after stop", 1, finished && piped > 0 && piped % (1000 * BINARY_RECORD_SIZE) == 0);
+
+    // A file through the bulk reader, and raw frames over TCP from three clients
+    char path[] = "/tmp/payloadCoderAsyncXXXXXX";
+    const int fd = mkstemp(path);
+    bool written = fd >= 0;
+    for (int i = 0; written && i < 100; i++)
+    {
+        written = write(fd, raw.data(), raw.size()) == static_cast<ssize_t>(raw.size());
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    rows = 0;
+    ids = 0;
+    {
+        asyncExecutor executor(1);
+        const int devNull = open("/dev/null", O_WRONLY);
+        asyncSink sink(devNull, outputFormat::binary);
+        std::unique_ptr<asyncSource> file(new asyncSource(inputFormat::raw));
+        asyncListener listener;
+        const bool ready = written && file->open(path) && listener.listen("127.0.0.1", 0);
+        if (ready)
+        {
+            executor.spawn(decodeInto(std::move(file), &sink, &rows, &ids));
+            executor.spawn(acceptFlows(&executor, &listener, 3, &sink, &rows, &ids));
+            for (int i = 0; i < 3; i++)
+            {
+                executor.spawn(sendTo(listener.get_port(), std::string(raw.begin(), raw.end())));
+            }
+            executor.run();
+        }
+        printTestResult("  file and tcp", 1, ready && !sink.failed());
+        close(devNull);
+    }
+    unlink(path);
+    printTestResult("  file and tcp rows", 103 * 20, static_cast<int>(rows.load()));
+    printTestResult("  file and tcp ids", 1, ids.load() == 103 * expectedIds);
+}
+
+void test28()
+{
+    cout << endl
+         << "Test 28 results (Compact payload)" << endl;
+
+    // Trap 0x01020304: door closed, trap displaced, battery 100, time 1700000001 (low 14 bits: 12545)
+    payloadEncoder encoder;
+    encoder.set_id(0x01020304);
+    encoder.set_version(PAYLOAD_VERSION_COMPACT);
+    encoder.set_doorStatus(true);
+    encoder.set_catchDetect(false);
+    encoder.set_trapDisplacement(true);
+    encoder.set_batteryStatus(100);
+    encoder.set_unixTime(1700000001);
+    uint8_t compact[SENSOR_PAYLOAD_SIZE];
+    const uint8_t size = encoder.encodeInto(compact, sizeof(compact));
+    const uint8_t expected[] = {0x01, 0x02, 0x03, 0x04, 0x02, 0xB9, 0x31, 0x01};
+    printTestResult("  compact size", 8, size);
+    printTestResult("  compact bytes", 1, size == sizeof(expected) && memcmp(compact, expected, sizeof(expected)) == 0);
+    printTestResult("  capacity too small", 0, encoder.encodeInto(compact, 7));
+
+    payloadDecoder decoder;
+    decoder.decodePayload(compact, size);
+    printTestResult("  decoded fields", 1, decoder.get_id() == 0x01020304 && decoder.get_version() == PAYLOAD_VERSION_COMPACT &&
+                                               decoder.get_doorStatus() && !decoder.get_catchDetect() &&
+                                               decoder.get_trapDisplacement() && decoder.get_batteryStatus() == 100);
+    printTestResult("  decoded time bits", 12545, static_cast<int>(decoder.get_unixTime()));
+
+    // The battery field holds 7 bits; larger values saturate
+    encoder.set_batteryStatus(200);
+    encoder.encodeInto(compact, sizeof(compact));
+    decoder.decodePayload(compact, size);
+    printTestResult("  battery saturates", 127, decoder.get_batteryStatus());
+    encoder.set_batteryStatus(100);
+    encoder.encodeInto(compact, sizeof(compact));
+
+    // The full time is the match nearest to the receive time, also with the node clock ahead
+    printTestResult("  expand late", 1, payloadExpandTime(12545, 14, 1700000001 + 30) == 1700000001u);
+    printTestResult("  expand early", 1, payloadExpandTime(12545, 14, 1700000001 - 30) == 1700000001u);
+    printTestResult("  expand 2 h old", 1, payloadExpandTime(12545, 14, 1700000001 + 7200) == 1700000001u);
+    printTestResult("  expand across period", 1, payloadExpandTime(16380, 14, 16384 * 5 + 3) == 16384u * 5 - 4);
+    printTestResult("  expand full time", 1, payloadExpandTime(1700000001, 32, 5) == 1700000001u);
+
+    // Widening gives the bytes of the same uplink encoded in the full layout
+    uint8_t full[SENSOR_PAYLOAD_SIZE];
+    uint8_t wide[SENSOR_PAYLOAD_SIZE];
+    uint8_t copy[SENSOR_PAYLOAD_SIZE];
+    encoder.set_version(PAYLOAD_VERSION);
+    encoder.encodeInto(full, sizeof(full));
+    printTestResult("  widened", 1, payloadDecoder::widenFrame(compact, size, 1700000100, wide) && memcmp(wide, full, SENSOR_PAYLOAD_SIZE) == 0);
+    printTestResult("  full frame copied", 1, payloadDecoder::widenFrame(full, SENSOR_PAYLOAD_SIZE, 0, copy) && memcmp(copy, full, SENSOR_PAYLOAD_SIZE) == 0);
+    printTestResult("  wrong size", 0, payloadDecoder::widenFrame(compact, 9, 1700000100, wide) || payloadDecoder::widenFrame(full, size, 1700000100, wide));
+    memcpy(copy, compact, size);
+    copy[PAYLOAD_VERSION_INDEX] = 200;
+    printTestResult("  unknown version", 0, payloadDecoder::widenFrame(copy, size, 1700000100, wide));
+
+    // Separate frames of both layouts decode in one call
+    const uint8_t *frames[] = {full, compact};
+    const size_t sizes[] = {SENSOR_PAYLOAD_SIZE, size};
+    payloadBatch mixed;
+    printTestResult("  mixed rows", 2, static_cast<int>(payloadDecoder::decodeBatch(frames, sizes, 2, mixed)));
+    printTestResult("  mixed versions", 1, mixed.size() == 2 && mixed.version[0] == PAYLOAD_VERSION && mixed.version[1] == PAYLOAD_VERSION_COMPACT &&
+                                               mixed.unixTime[0] == 1700000001u && mixed.unixTime[1] == 12545u && mixed.battery[1] == 100);
+
+    // Text lines of both layouts: plain hex, separated hex, base64 and a line of 9 bytes
+    char fullHex[2 * SENSOR_PAYLOAD_SIZE];
+    char compactHex[2 * SENSOR_PAYLOAD_SIZE];
+    binaryToHex(full, SENSOR_PAYLOAD_SIZE, fullHex);
+    binaryToHex(compact, size, compactHex);
+    const std::string hexLines = std::string(fullHex, sizeof(fullHex)) + "\n" + std::string(compactHex, 2 * size) + "\n" +
+                                 "1 2 3 4 2 B9 31 1\n" + std::string(compactHex, 2 * size) + "00\n";
+    FILE *file = tmpfile();
+    fwrite(hexLines.data(), 1, hexLines.size(), file);
+    rewind(file);
+    frameReader hexReader(file, inputFormat::hex);
+    hexReader.set_receivedAt(1700000100);
+    const uint8_t *block = nullptr;
+    size_t length = 0;
+    payloadBatch batch;
+    const bool hexRead = hexReader.next(block, length);
+    payloadDecoder::decodeBatch(block, length, batch);
+    fclose(file);
+    bool sameRows = hexRead && batch.size() == 3;
+    for (size_t i = 0; sameRows && i < batch.size(); i++)
+    {
+        sameRows = batch.id[i] == 0x01020304 && batch.version[i] == PAYLOAD_VERSION && batch.unixTime[i] == 1700000001u &&
+                   batch.battery[i] == 100 && batch.flags[i] == (FLAG_DOOR_STATUS | FLAG_TRAP_DISPLACEMENT);
+    }
+    printTestResult("  hex rows", 1, sameRows);
+    printTestResult("  hex rejected lines", 1, static_cast<int>(hexReader.get_rejectedLines()));
+
+    const std::string base64Lines = "AQIDBAK5MQE=\n";
+    file = tmpfile();
+    fwrite(base64Lines.data(), 1, base64Lines.size(), file);
+    rewind(file);
+    frameReader base64Reader(file, inputFormat::base64);
+    base64Reader.set_receivedAt(1700000100);
+    const bool base64Read = base64Reader.next(block, length);
+    fclose(file);
+    printTestResult("  base64 line", 1, base64Read && length == SENSOR_PAYLOAD_SIZE && memcmp(block, full, SENSOR_PAYLOAD_SIZE) == 0);
+
+    // Without a receive time the compact line cannot be completed and is rejected
+    file = tmpfile();
+    fwrite(base64Lines.data(), 1, base64Lines.size(), file);
+    rewind(file);
+    frameReader unknownReader(file, inputFormat::base64);
+    const bool unknownRead = unknownReader.next(block, length);
+    fclose(file);
+    printTestResult("  no receive time", 1, (!unknownRead || length == 0) && unknownReader.get_rejectedLines() == 1);
+
+    // TTN uplinks are widened with received_at; without it the time cannot be completed
+    ttnUplink uplink;
+    const bool parsed = parseTtnUplink("{\"received_at\":\"2023-11-14T22:15:00Z\",\"uplink_message\":{\"f_cnt\":7,"
+                                       "\"frm_payload\":\"AQIDBAK5MQE=\"}}",
+                                       uplink) == ttnMessage::uplink;
+    printTestResult("  ttn frame", 1, parsed && ttnUplinkFrame(uplink, wide) && memcmp(wide, full, SENSOR_PAYLOAD_SIZE) == 0);
+    uplink.receivedAt = {};
+    printTestResult("  ttn without received_at", 0, ttnUplinkFrame(uplink, wide));
+}
@@ -19,6 +19,236 @@ void test02();
  */
 void test03();
 
+/**
+ * @brief Test case for payloadDecoder::decodeBatch().
+ *
+ * This test encodes a series of frames into one contiguous buffer, corrupts the version of
+ * one frame and appends a partial frame. It checks that the valid frames land in the
+ * structure-of-arrays columns in input order and that both bad frames are reported as errors.
+ */
+void test04();
+
+/**
+ * @brief Test case for the SIMD batch decode kernels.
+ *
+ * This test decodes the same pseudo-random frames (with some unknown versions mixed in)
+ * with every kernel the CPU supports and compares all columns and errors with the scalar kernel.
+ */
+void test05();
+
+/**
+ * @brief Test case for payloadEncoder::encodeInto() and payloadEncoder::encodeBatch().
+ *
+ * This test checks that encodeInto() writes the same bytes as composePayload() into a dirty
+ * caller buffer, rejects a buffer that is too small, and that encodeBatch() output decodes
+ * back to the original batch.
+ */
+void test06();
+
+/**
+ * @brief Test case for the compile-time payload schema in payloadSchema.h.
+ *
+ * This test checks the field offsets computed from payloadLayoutV1 and compares the bytes
+ * produced by payloadEncoder with a hand-written reference frame, then decodes that frame.
+ */
+void test07();
+
+/**
+ * @brief Test case for the streaming decode command.
+ *
+ * This test checks the hex and base64 converters, decodes hex lines (with separators, a bad
+ * line, an unknown version and a CRLF line ending) to CSV through streamDecode(), and reads raw
+ * frames with a chunk size that splits frames across reads.
+ */
+void test08();
+
+/**
+ * @brief Test case for archive segments.
+ *
+ * This test writes interleaved frames of three traps to a segment, checks the footer index
+ * (counts, min/max time, arrival order), rebuilds one trap's history, and reads the same segment
+ * again without its footer.
+ */
+void test09();
+
+/**
+ * @brief Test case for the parallel decode pipeline.
+ *
+ * This test decodes the same frames with payloadDecoder::decodeBatch() and with a 4 worker
+ * parallelDecoder using small chunks, and checks that rows, errors and formatted output match
+ * and come out in input order.
+ */
+void test10();
+
+/**
+ * @brief Test case for the SIMD hex converters.
+ *
+ * This test encodes random bytes of every length from 0 to 300 with every hex implementation
+ * the CPU supports, compares the text with the scalar implementation, decodes it back from lower
+ * case and checks that a single invalid character is always rejected.
+ */
+void test11();
+
+/**
+ * @brief Test case for the SIMD base64 decoders.
+ *
+ * This test decodes padded frames, batches of frames and long texts with every base64
+ * implementation the CPU supports, checks every possible character in every position of a
+ * frame against the scalar implementation and reads a TTN-style dump with mixed lines.
+ */
+void test12();
+
+/**
+ * @brief Test case for the TTN v3 uplink parser.
+ *
+ * This test parses a complete TTN v3 uplink with two gateways, checks every extracted field and
+ * the decoded frame, checks join accepts and broken messages, and reads a newline-delimited
+ * stream through frameReader.
+ */
+void test13();
+
+/**
+ * @brief Test case for the version-dispatched decoder table.
+ *
+ * This test checks that the table has a decoder for every version with a layout and none for
+ * the others, that the table decoders match the schema codec, and that separately stored frames
+ * are rejected by version and by size through the table.
+ */
+void test14();
+
+/**
+ * @brief Test case for the fleet traffic generator.
+ *
+ * This test checks that a seed always gives the same traffic, that generated uplinks follow the
+ * firmware's send rules (duty cycle, heartbeats, frame counters), and that the frames read back
+ * through frameReader in every output format, TTN JSON included.
+ */
+void test15();
+
+/**
+ * @brief Test case for the fleet state table.
+ *
+ * This test checks that the table keeps the latest record per trap and ignores late ones, that
+ * it tracks when the flags last changed, that it accepts decoder records and batches, and that
+ * readers running next to two writers never see a torn state.
+ */
+void test16();
+
+/**
+ * @brief Test case for the transition extractor.
+ *
+ * This test checks the reported transitions and their previous-state times for a small record
+ * sequence with a late record, the kind filter, skipping of other versions, and that raw frames
+ * and decoded rows of a generated fleet give the same transitions as a full comparison.
+ */
+void test17();
+
+/**
+ * @brief Test case for the battery trend tracker.
+ *
+ * This test checks the fitted slope, level and days to empty for steadily draining traps, the
+ * service ranking, the restart of the fit after a battery swap, that a short history gives no
+ * forecast, and that the fit follows the drain of a generated fleet.
+ */
+void test18();
+
+/**
+ * @brief Test case for the uplink deduplicator.
+ *
+ * This test checks the text round trip of uplink records, merging of copies within the hold
+ * time (best rssi kept, gateway counts added), dropping of late copies, early release when the
+ * ring is full, and that a generated fleet with extra copies comes out exactly once per uplink
+ * with and without the Bloom filter.
+ */
+void test19();
+
+/**
+ * @brief Test case for the reorder buffer and the merge of ordered inputs.
+ *
+ * This test delays the uplinks of a generated fleet by up to 29 s and checks that a 30 s window
+ * restores the exact order, that a shorter window passes stragglers on as late, and that a full
+ * buffer releases early. It then merges the fleet split over an in-memory input, a raw file and
+ * an archive segment, and checks the order and the count of records going backwards.
+ */
+void test20();
+
+/**
+ * @brief Test case for the bulk load writer.
+ *
+ * This test writes rows with and without TTN metadata (including a rejected frame and text that
+ * needs escaping), and checks the TSV lines, the rotation after maxRows, the manifest, that a
+ * new writer continues the file numbering and the LOAD DATA statement.
+ */
+void test21();
+
+/**
+ * @brief Test case for the Arrow IPC writer.
+ *
+ * This test writes rows in blocks that do not match the batch size, then reads the file back
+ * through the footer: the magic, the number of record batches, the 64-byte alignment of each
+ * body and the integer and bit-packed boolean columns of every row.
+ */
+void test22();
+
+/**
+ * @brief Test case for the webhook server.
+ *
+ * This test starts a server with two event loops on a free loopback port and posts generated
+ * TTN uplinks, bodies that are not JSON and messages without an uplink through the load
+ * generator. It checks the responses, the counters and that every uplink reached the sink once,
+ * and sends a health check, a request with 100-continue and a chunked request on plain sockets.
+ */
+void test23();
+
+/**
+ * @brief Test case for the bulk reader.
+ *
+ * This test reads a file through io_uring and through pread with small buffers and compares the
+ * bytes, decodes raw frames handed out in place, and reads hex lines that cross buffer
+ * boundaries (with an overlong line and a last line without line ending) with the same result
+ * as the stdio reader.
+ */
+void test24();
+
+/**
+ * @brief Test case for the shard pipeline.
+ *
+ * This test passes a counter through an SPSC ring between two threads, pushes rows from two
+ * producers into three shards with tiny batches and rings and checks that every row reaches the
+ * shard of its id in order, and checks that battery fits spread over shards rank the traps due
+ * for service exactly as one tracker does.
+ */
+void test25();
+
+/**
+ * @brief Test case for the batch arena.
+ *
+ * This test checks the alignment of arena allocations, that reset() merges the blocks into one
+ * so that repeated batches take nothing more from upstream, that a payloadBatch on the arena
+ * decodes like one on the heap, and that streaming many chunks through streamDecode() takes the
+ * arena block once and writes the same records.
+ */
+void test26();
+
+/**
+ * @brief Test case for the coroutine executor and the async ingest API.
+ *
+ * This test checks that coroutines on one loop take turns at every yield and get the values of
+ * nested tasks, decodes hex lines sent in 16-byte pieces over 500 socket pairs on two loops into
+ * one shared sink, writes through a sink into a full pipe, and decodes a file and three TCP
+ * connections accepted by a listener coroutine.
+ */
+void test27();
+
+/**
+ * @brief Test case for the compact (version 2) payload.
+ *
+ * This test checks the 8-byte layout bit by bit, the saturation of the 7-bit battery field, how
+ * the full time is restored from the receive time, widening to the full layout, and that hex,
+ * base64 and TTN input holding compact frames decode like the same uplinks in the full layout.
+ */
+void test28();
+
 void printTestResult(const std::string& type, int input, int result);
 
 #endif // unitTest_H
@@ -0,0 +1,221 @@
+#include "uplinkDedup.h"
+
+namespace
+{
+    const uint64_t EMPTY = ~0ULL; ///< Free index slot
+
+    /// @brief Hash of (devEui, fcnt) (murmur3 finaliser).
+    inline uint64_t keyOf(const uplinkRecord &record)
+    {
+        uint64_t h = record.devEui ^ (static_cast<uint64_t>(record.fcnt) * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /// @brief Smallest power of two that is at least `n`.
+    inline size_t powerOfTwo(size_t n)
+    {
+        size_t p = 1;
+        while (p < n)
+        {
+            p <<= 1;
+        }
+        return p;
+    }
+}
+
+uplinkDeduplicator::uplinkDeduplicator(const dedupConfig &config)
+    : _config(config), _ring(config.capacity > 0 ? config.capacity : 1), _head(0), _release(0), _tail(0),
+      _index(powerOfTwo(2 * _ring.size()), EMPTY), _bloom(), _bloomStartMs(0), _nowMs(0), _stats()
+{
+    if (config.bloomBits > 0)
+    {
+        const size_t words = powerOfTwo((config.bloomBits + 63) / 64);
+        _bloom[0].assign(words, 0);
+        _bloom[1].assign(words, 0);
+    }
+}
+
+size_t uplinkDeduplicator::findSlot(uint64_t key, const uplinkRecord &record, bool compare) const
+{
+    const size_t mask = _index.size() - 1;
+    const uint64_t tag = key >> 32;
+    size_t slot = static_cast<size_t>(key) & mask;
+    while (_index[slot] != EMPTY)
+    {
+        if (compare && _index[slot] >> 32 == tag)
+        {
+            const entry &e = _ring[static_cast<uint32_t>(_index[slot])];
+            if (e.record.devEui == record.devEui && e.record.fcnt == record.fcnt)
+            {
+                return slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void uplinkDeduplicator::dropHead()
+{
+    const uint32_t position = static_cast<uint32_t>(_head % _ring.size());
+    const size_t mask = _index.size() - 1;
+    size_t slot = static_cast<size_t>(_ring[position].key) & mask;
+    while (static_cast<uint32_t>(_index[slot]) != position || _index[slot] == EMPTY)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    // Backward-shift deletion keeps every remaining key reachable from its home slot
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask;
+    while (_index[next] != EMPTY)
+    {
+        const size_t home = static_cast<size_t>(_ring[static_cast<uint32_t>(_index[next])].key) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            _index[hole] = _index[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    _index[hole] = EMPTY;
+    _head++;
+}
+
+void uplinkDeduplicator::expire(std::vector<uplinkRecord> &out)
+{
+    const size_t size = _ring.size();
+    while (_release < _tail && _ring[_release % size].firstMs + _config.holdMs <= _nowMs)
+    {
+        entry &e = _ring[_release % size];
+        e.released = true;
+        out.push_back(e.record);
+        _stats.released++;
+        _release++;
+    }
+    while (_head < _release && _ring[_head % size].firstMs + _config.rememberMs <= _nowMs)
+    {
+        dropHead();
+    }
+}
+
+bool uplinkDeduplicator::bloomMayContain(uint64_t key) const
+{
+    const size_t mask = _bloom[0].size() * 64 - 1;
+    const uint64_t h2 = (key >> 32) | 1;
+    bool current = true;
+    bool previous = true;
+    for (uint64_t i = 0; i < 3; i++)
+    {
+        const size_t bit = static_cast<size_t>(key + i * h2) & mask;
+        current = current && (_bloom[0][bit / 64] >> (bit % 64) & 1);
+        previous = previous && (_bloom[1][bit / 64] >> (bit % 64) & 1);
+    }
+    return current || previous;
+}
+
+void uplinkDeduplicator::bloomAdd(uint64_t key)
+{
+    const size_t mask = _bloom[0].size() * 64 - 1;
+    const uint64_t h2 = (key >> 32) | 1;
+    for (uint64_t i = 0; i < 3; i++)
+    {
+        const size_t bit = static_cast<size_t>(key + i * h2) & mask;
+        _bloom[0][bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool uplinkDeduplicator::offer(const uplinkRecord &record, std::vector<uplinkRecord> &out)
+{
+    _stats.copies++;
+    const uint64_t receivedMs = record.receivedMs != 0 ? record.receivedMs : _nowMs;
+    if (receivedMs > _nowMs)
+    {
+        _nowMs = receivedMs;
+        expire(out);
+    }
+
+    const bool bloom = !_bloom[0].empty();
+    if (bloom && _nowMs - _bloomStartMs >= _config.rememberMs)
+    {
+        // Keys are remembered for at most rememberMs, so two generations cover all of them
+        _bloom[1].swap(_bloom[0]);
+        _bloom[0].assign(_bloom[0].size(), 0);
+        _bloomStartMs = _nowMs;
+    }
+
+    const uint64_t key = keyOf(record);
+    const bool known = !bloom || bloomMayContain(key);
+    if (bloom && !known)
+    {
+        _stats.bloomNew++;
+    }
+    size_t slot = findSlot(key, record, known);
+    if (_index[slot] != EMPTY)
+    {
+        entry &e = _ring[static_cast<uint32_t>(_index[slot])];
+        if (e.released)
+        {
+            _stats.late++;
+            return false;
+        }
+        const unsigned gateways = static_cast<unsigned>(e.record.gateways) + (record.gateways != 0 ? record.gateways : 1);
+        if (record.rssi > e.record.rssi)
+        {
+            const uint64_t firstReceived = e.record.receivedMs;
+            e.record = record;
+            e.record.receivedMs = firstReceived;
+        }
+        e.record.gateways = static_cast<uint8_t>(gateways < 255 ? gateways : 255);
+        _stats.merged++;
+        return false;
+    }
+
+    if (_tail - _head == _ring.size())
+    {
+        // Ring full: release the oldest uplink early if it is still held, then forget it
+        if (_release == _head)
+        {
+            entry &oldest = _ring[_head % _ring.size()];
+            oldest.released = true;
+            out.push_back(oldest.record);
+            _stats.released++;
+            _stats.evicted++;
+            _release++;
+        }
+        dropHead();
+        slot = findSlot(key, record, false);
+    }
+    const uint32_t position = static_cast<uint32_t>(_tail % _ring.size());
+    entry &e = _ring[position];
+    e.record = record;
+    e.record.receivedMs = receivedMs;
+    e.record.gateways = record.gateways != 0 ? record.gateways : 1;
+    e.key = key;
+    e.firstMs = receivedMs;
+    e.released = false;
+    _index[slot] = (key >> 32) << 32 | position;
+    _tail++;
+    if (bloom)
+    {
+        bloomAdd(key);
+    }
+    return true;
+}
+
+void uplinkDeduplicator::flush(std::vector<uplinkRecord> &out)
+{
+    while (_release < _tail)
+    {
+        entry &e = _ring[_release % _ring.size()];
+        e.released = true;
+        out.push_back(e.record);
+        _stats.released++;
+        _release++;
+    }
+}
@@ -0,0 +1,113 @@
+/**
+ * @file uplinkDedup.h
+ * @brief Suppression of duplicate uplinks received through several gateways or networks.
+ *
+ * An uplink heard by several gateways reaches the server once per network or integration that
+ * forwards it, all with the same DevEUI and frame counter. The deduplicator holds the first copy
+ * of each (devEui, fcnt) for `holdMs`, merges later copies into it (keeping the frame and radio
+ * metadata of the copy with the best rssi and adding up the gateway counts) and then releases
+ * one uplink. The key is remembered for `rememberMs` after the first copy, so stragglers are
+ * dropped instead of stored twice.
+ *
+ * Memory is bounded: keys live in a ring of `capacity` entries in arrival order, indexed by an
+ * open-addressing hash table. Entries leave the ring when they expire; if the ring is full, the
+ * oldest entry is released early. An optional Bloom filter, in two generations that rotate every
+ * `rememberMs`, recognises most new keys so that their insert skips the key comparisons.
+ *
+ * Time comes from the uplinks themselves (received_at), so a replayed dump deduplicates the same
+ * way as a live stream.
+ *
+ * Usage: create one uplinkDeduplicator, call offer() for every uplink and flush() at the end.
+ */
+
+#ifndef UPLINKDEDUP_H
+#define UPLINKDEDUP_H
+
+#include <stdint.h> // uint8_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <vector>
+
+#include "ttnUplink.h" // uplinkRecord
+
+/// \brief settings of the deduplicator
+struct dedupConfig
+{
+    uint32_t holdMs = 2000;      ///< Time a new uplink waits for copies before it is released
+    uint32_t rememberMs = 60000; ///< Time a key is remembered, to drop late copies
+    size_t capacity = 1 << 16;   ///< Maximum number of keys held or remembered
+    size_t bloomBits = 0;        ///< Bits per Bloom filter generation (0: no Bloom filter)
+};
+
+/// \brief counters of the deduplicator
+struct dedupStats
+{
+    uint64_t copies = 0;   ///< Uplinks offered
+    uint64_t released = 0; ///< Uplinks released
+    uint64_t merged = 0;   ///< Copies merged into a held uplink
+    uint64_t late = 0;     ///< Copies dropped because their uplink was already released
+    uint64_t evicted = 0;  ///< Uplinks released early because the ring was full
+    uint64_t bloomNew = 0; ///< New keys recognised by the Bloom filter without comparing keys
+};
+
+/// \brief time-windowed duplicate suppression keyed on (devEui, fcnt)
+class uplinkDeduplicator
+{
+private:
+    /// \brief held or remembered uplink
+    struct entry
+    {
+        uplinkRecord record = {}; ///< Best copy so far, gateway counts merged
+        uint64_t key = 0;         ///< Hash of (devEui, fcnt)
+        uint64_t firstMs = 0;     ///< Receive time of the first copy
+        bool released = false;    ///< True once the uplink has been released
+    };
+
+    dedupConfig _config;             ///< Settings
+    std::vector<entry> _ring;        ///< Entries in arrival order, `capacity` long
+    uint64_t _head;                  ///< Sequence number of the oldest entry
+    uint64_t _release;               ///< Sequence number of the oldest entry not yet released
+    uint64_t _tail;                  ///< Sequence number of the next entry
+    std::vector<uint64_t> _index;    ///< Hash table: key >> 32 in the high half, ring position in the low half
+    std::vector<uint64_t> _bloom[2]; ///< Bloom filter generations: current and previous
+    uint64_t _bloomStartMs;          ///< Time the current generation started
+    uint64_t _nowMs;                 ///< Latest receive time seen
+    dedupStats _stats;               ///< Counters
+
+    /// \brief index slot holding the entry for `record`, or the free slot where it would go
+    /// \param key hash of the record's (devEui, fcnt)
+    /// \param record copy to look up
+    /// \param compare false to skip looking at occupied slots (the key is known to be new)
+    size_t findSlot(uint64_t key, const uplinkRecord &record, bool compare) const;
+
+    /// \brief remove the oldest entry from the index and the ring
+    void dropHead();
+
+    /// \brief release held entries older than holdMs and forget entries older than rememberMs
+    void expire(std::vector<uplinkRecord> &out);
+
+    /// \brief true if the key may be in the Bloom filter
+    bool bloomMayContain(uint64_t key) const;
+
+    /// \brief add a key to the current Bloom filter generation
+    void bloomAdd(uint64_t key);
+
+public:
+    /// \brief constructor
+    /// \param config settings
+    explicit uplinkDeduplicator(const dedupConfig &config = dedupConfig());
+
+    /// \brief offer one received copy
+    /// \param record copy of an uplink; receivedMs 0 counts as the latest time seen
+    /// \param out receives the uplinks released because time moved on (in arrival order of their first copy)
+    /// \return true if this is the first copy of its uplink
+    bool offer(const uplinkRecord &record, std::vector<uplinkRecord> &out);
+
+    /// \brief release all held uplinks (at the end of the input)
+    /// \param out receives the uplinks, in arrival order of their first copy
+    void flush(std::vector<uplinkRecord> &out);
+
+    /// \brief counters
+    const dedupStats &get_stats() const { return _stats; }
+};
+
+#endif // UPLINKDEDUP_H
@@ -0,0 +1,253 @@
+#include "uplinkOrder.h"
+
+#include <algorithm> // std::make_heap, std::push_heap, std::pop_heap, std::max
+
+namespace
+{
+    /// @brief Order key of a record without the frame counter: unixTime << 32 | id.
+    inline uint64_t orderOf(const archiveRecord &record)
+    {
+        return static_cast<uint64_t>(record.unixTime()) << 32 | record.id();
+    }
+
+    /// @brief Number of records a reader input converts per block.
+    const size_t MERGE_BLOCK_SIZE = 64 * 1024;
+
+    /// @brief Heap order of waiting records: true if `a` comes after `b`, so the earliest is on top.
+    template <typename entry>
+    inline bool laterEntry(const entry &a, const entry &b)
+    {
+        if (a.order != b.order)
+        {
+            return a.order > b.order;
+        }
+        if (a.record.fcnt != b.record.fcnt)
+        {
+            return a.record.fcnt > b.record.fcnt;
+        }
+        return a.sequence > b.sequence;
+    }
+}
+
+bool uplinkBefore(const archiveRecord &a, const archiveRecord &b)
+{
+    const uint64_t orderA = orderOf(a);
+    const uint64_t orderB = orderOf(b);
+    return orderA != orderB ? orderA < orderB : a.fcnt < b.fcnt;
+}
+
+reorderBuffer::reorderBuffer(const reorderConfig &config)
+    : _config(config), _heap(), _sequence(0), _newest(0), _last(), _released(false), _stats()
+{
+    if (_config.capacity == 0)
+    {
+        _config.capacity = 1;
+    }
+}
+
+void reorderBuffer::pop(std::vector<archiveRecord> &out)
+{
+    std::pop_heap(_heap.begin(), _heap.end(), laterEntry<entry>);
+    _last = _heap.back();
+    _released = true;
+    _heap.pop_back();
+    out.push_back(_last.record);
+    _stats.released++;
+}
+
+void reorderBuffer::push(const archiveRecord &record, std::vector<archiveRecord> &out)
+{
+    _stats.records++;
+    entry e;
+    e.record = record;
+    e.order = orderOf(record);
+    e.sequence = _sequence++;
+
+    /** Too late to be put in place: pass it on now rather than hold back everything after it. */
+    if (_released && record.unixTime() < _last.record.unixTime())
+    {
+        out.push_back(record);
+        _stats.late++;
+        _stats.released++;
+        return;
+    }
+
+    _heap.push_back(e);
+    std::push_heap(_heap.begin(), _heap.end(), laterEntry<entry>);
+    const uint32_t time = static_cast<uint32_t>(e.order >> 32);
+    _newest = std::max(_newest, time);
+
+    while (!_heap.empty() && static_cast<uint64_t>(_heap.front().order >> 32) + _config.windowSeconds < _newest)
+    {
+        pop(out);
+    }
+    while (_heap.size() > _config.capacity)
+    {
+        pop(out);
+        _stats.forced++;
+    }
+    _stats.maxHeld = std::max(_stats.maxHeld, _heap.size());
+}
+
+void reorderBuffer::flush(std::vector<archiveRecord> &out)
+{
+    while (!_heap.empty())
+    {
+        pop(out);
+    }
+}
+
+uplinkMerger::uplinkMerger() : _sources(), _heap(), _started(false), _records(0), _unsorted(0), _failed(false)
+{
+}
+
+uplinkMerger::~uplinkMerger()
+{
+    for (const std::unique_ptr<source> &input : _sources)
+    {
+        if (input->ownsFile)
+        {
+            fclose(input->file);
+        }
+    }
+}
+
+bool uplinkMerger::add(const char *path, inputFormat format)
+{
+    std::unique_ptr<segmentReader> segment(new segmentReader());
+    if (segment->open(path))
+    {
+        std::unique_ptr<source> input(new source());
+        input->next = segment->records();
+        input->end = segment->records() + segment->size();
+        input->segment = std::move(segment);
+        _sources.push_back(std::move(input));
+        return true;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    add(file, format);
+    _sources.back()->ownsFile = true;
+    return true;
+}
+
+void uplinkMerger::add(FILE *file, inputFormat format)
+{
+    std::unique_ptr<source> input(new source());
+    input->file = file;
+    input->reader.reset(new frameReader(file, format, MERGE_BLOCK_SIZE * SENSOR_PAYLOAD_SIZE));
+    _sources.push_back(std::move(input));
+}
+
+void uplinkMerger::add(const archiveRecord *records, size_t count)
+{
+    std::unique_ptr<source> input(new source());
+    input->next = records;
+    input->end = records + count;
+    _sources.push_back(std::move(input));
+}
+
+bool uplinkMerger::refill(source &input)
+{
+    if (input.reader == nullptr)
+    {
+        return false;
+    }
+    const uint8_t *frames = nullptr;
+    size_t length = 0;
+    input.block.clear();
+    while (input.block.empty() && input.reader->next(frames, length))
+    {
+        appendArchiveRecords(frames, length, input.reader->get_uplinks(), input.block);
+    }
+    _failed = _failed || input.reader->failed();
+    input.next = input.block.data();
+    input.end = input.block.data() + input.block.size();
+    return !input.block.empty();
+}
+
+bool uplinkMerger::later(size_t a, size_t b) const
+{
+    const archiveRecord &recordA = *_sources[a]->next;
+    const archiveRecord &recordB = *_sources[b]->next;
+    if (uplinkBefore(recordB, recordA))
+    {
+        return true;
+    }
+    /** Equal keys come out in the order the inputs were added. */
+    return !uplinkBefore(recordA, recordB) && a > b;
+}
+
+size_t uplinkMerger::next(std::vector<archiveRecord> &out, size_t max)
+{
+    const auto later = [this](size_t a, size_t b)
+    { return this->later(a, b); };
+
+    if (!_started)
+    {
+        _started = true;
+        for (size_t i = 0; i < _sources.size(); i++)
+        {
+            if (_sources[i]->next != _sources[i]->end || refill(*_sources[i]))
+            {
+                _heap.push_back(i);
+            }
+        }
+        std::make_heap(_heap.begin(), _heap.end(), later);
+    }
+
+    size_t count = 0;
+    while (count < max && !_heap.empty())
+    {
+        std::pop_heap(_heap.begin(), _heap.end(), later);
+        const size_t index = _heap.back();
+        source &input = *_sources[index];
+
+        /** Take records from this input while it stays ahead of the others: no heap work for runs. */
+        const size_t rival = _heap.size() > 1 ? _heap.front() : index;
+        do
+        {
+            const archiveRecord &record = *input.next++;
+            out.push_back(record);
+            count++;
+            if (input.next == input.end)
+            {
+                const archiveRecord previous = record;
+                if (!refill(input))
+                {
+                    break;
+                }
+                _unsorted += input.next->unixTime() < previous.unixTime() ? 1 : 0;
+            }
+            else if (input.next->unixTime() < record.unixTime())
+            {
+                _unsorted++;
+            }
+        } while (count < max && (rival == index || !later(index, rival)));
+
+        if (input.next == input.end)
+        {
+            _heap.pop_back();
+        }
+        else
+        {
+            std::push_heap(_heap.begin(), _heap.end(), later);
+        }
+    }
+    _records += count;
+    return count;
+}
+
+uint64_t uplinkMerger::get_rejectedLines() const
+{
+    uint64_t lines = 0;
+    for (const std::unique_ptr<source> &input : _sources)
+    {
+        lines += input->reader != nullptr ? input->reader->get_rejectedLines() : 0;
+    }
+    return lines;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file uplinkOrder.h
+ * @brief Putting uplinks back in time order: a bounded reorder buffer and a k-way merge of sorted inputs.
+ *
+ * Both stages order archive records (a frame with its receive metadata) by payload unixTime,
+ * then trap id, then frame counter. Within one trap this is the order in which the node sent
+ * the frames; the frame counter only decides between frames sent in the same second.
+ *
+ * reorderBuffer repairs a stream that is almost in order, such as uplinks that reached the
+ * server through several gateways or networks. It holds records in a heap until the newest
+ * payload time seen is more than `windowSeconds` past them, so a record is delayed by at most the
+ * window (plus the second it was sent in). A record older than one already released cannot be put
+ * back in place; it is passed on at once and counted as late. If more than `capacity` records are
+ * waiting, the earliest is released early.
+ *
+ * uplinkMerger combines inputs that are each already in time order (daily exports, the logs of
+ * several collectors, archive segments) into one ordered stream in a single pass. It keeps one
+ * block per input and a heap of the inputs keyed on their next record, so memory does not
+ * depend on the size of the inputs. Records of one input keep their order; records whose
+ * payload time goes backwards within their input are counted as unsorted. Put a reorderBuffer
+ * behind the merger if the inputs are only roughly in order.
+ *
+ * Usage: call reorderBuffer::push() for every record and flush() at the end; or add() every
+ * input to an uplinkMerger and call next() until it returns 0.
+ */
+
+#ifndef UPLINKORDER_H
+#define UPLINKORDER_H
+
+#include <stdint.h> // uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+#include <memory>
+#include <vector>
+
+#include "archiveSegment.h"
+#include "frameReader.h"
+
+/// \brief true if record `a` comes before record `b` (payload unixTime, trap id, frame counter)
+bool uplinkBefore(const archiveRecord &a, const archiveRecord &b);
+
+/// \brief settings of the reorder buffer
+struct reorderConfig
+{
+    uint32_t windowSeconds = 60; ///< Time a record waits for earlier records (payload time)
+    size_t capacity = 1 << 20;   ///< Maximum number of waiting records
+};
+
+/// \brief counters of the reorder buffer
+struct reorderStats
+{
+    uint64_t records = 0;  ///< Records pushed
+    uint64_t released = 0; ///< Records released, including late ones
+    uint64_t late = 0;     ///< Records passed on at once because a later record was already released
+    uint64_t forced = 0;   ///< Records released before their window because the buffer was full
+    size_t maxHeld = 0;    ///< Largest number of waiting records
+};
+
+/// \brief bounded-latency reordering of an almost ordered stream
+class reorderBuffer
+{
+private:
+    /// \brief waiting record
+    struct entry
+    {
+        archiveRecord record = {}; ///< The record
+        uint64_t order = 0;        ///< unixTime << 32 | id
+        uint64_t sequence = 0;     ///< Arrival number, keeps equal keys in arrival order
+    };
+
+    reorderConfig _config;     ///< Settings
+    std::vector<entry> _heap;  ///< Waiting records, earliest on top
+    uint64_t _sequence;        ///< Arrival number of the next record
+    uint32_t _newest;          ///< Latest payload time seen
+    entry _last;               ///< Last record released in order
+    bool _released;            ///< True once a record has been released in order
+    reorderStats _stats;       ///< Counters
+
+    /// \brief move the earliest waiting record to `out`
+    void pop(std::vector<archiveRecord> &out);
+
+public:
+    /// \brief constructor
+    /// \param config settings
+    explicit reorderBuffer(const reorderConfig &config = reorderConfig());
+
+    /// \brief add one record
+    /// \param record uplink and receive metadata
+    /// \param out receives the records whose window has passed, in order
+    void push(const archiveRecord &record, std::vector<archiveRecord> &out);
+
+    /// \brief release all waiting records (at the end of the input)
+    /// \param out receives the records, in order
+    void flush(std::vector<archiveRecord> &out);
+
+    /// \brief number of waiting records
+    size_t size() const { return _heap.size(); }
+
+    /// \brief counters
+    const reorderStats &get_stats() const { return _stats; }
+};
+
+/// \brief single-pass merge of several ordered inputs
+class uplinkMerger
+{
+private:
+    /// \brief one input and its current block
+    struct source
+    {
+        std::unique_ptr<segmentReader> segment = {}; ///< Archive segment, or nullptr
+        std::unique_ptr<frameReader> reader = {};    ///< Frame reader, or nullptr
+        FILE *file = nullptr;                        ///< File of the reader
+        bool ownsFile = false;                       ///< True if the merger opened (and closes) the file
+        std::vector<archiveRecord> block = {};       ///< Records converted from the reader's last block
+        const archiveRecord *next = nullptr;         ///< Next record
+        const archiveRecord *end = nullptr;          ///< End of the current block
+    };
+
+    std::vector<std::unique_ptr<source>> _sources; ///< Inputs in the order they were added
+    std::vector<size_t> _heap;                     ///< Inputs with records left, the one with the earliest record on top
+    bool _started;                                 ///< True once next() was called
+    uint64_t _records;                             ///< Records returned
+    uint64_t _unsorted;                            ///< Records with an earlier payload time than the previous record of their input
+    bool _failed;                                  ///< A read error occurred
+
+    /// \brief load the next block of a reader input
+    /// \return false if the input is exhausted
+    bool refill(source &input);
+
+    /// \brief true if input `a` should come after input `b`
+    bool later(size_t a, size_t b) const;
+
+public:
+    uplinkMerger();                                         ///< Constructor
+    ~uplinkMerger();                                        ///< Destructor, closes the files it opened
+    uplinkMerger(const uplinkMerger &) = delete;            ///< Copy constructor disabled
+    uplinkMerger &operator=(const uplinkMerger &) = delete; ///< Assignment operator disabled
+
+    /// \brief add a file: an archive segment (recognised by its magic) or frames in `format`
+    /// \param path file name
+    /// \param format format of the file if it is not a segment
+    /// \return false if the file cannot be opened
+    bool add(const char *path, inputFormat format);
+
+    /// \brief add an open file or stdin; the merger does not close it
+    /// \param file input file
+    /// \param format format of the frames
+    void add(FILE *file, inputFormat format);
+
+    /// \brief add records held in memory; they must stay valid until the merge is done
+    /// \param records ordered records
+    /// \param count number of records
+    void add(const archiveRecord *records, size_t count);
+
+    /// \brief take the next records of the merged stream
+    /// \param out receives the records, in order
+    /// \param max maximum number of records to append
+    /// \return number of records appended; 0 when all inputs are exhausted
+    size_t next(std::vector<archiveRecord> &out, size_t max);
+
+    /// \brief number of inputs
+    size_t inputs() const { return _sources.size(); }
+
+    /// \brief number of records returned
+    uint64_t get_records() const { return _records; }
+
+    /// \brief number of records with an earlier payload time than the previous record of their input
+    uint64_t get_unsorted() const { return _unsorted; }
+
+    /// \brief number of text lines that did not hold exactly one frame, over all inputs
+    uint64_t get_rejectedLines() const;
+
+    /// \brief true if reading an input failed
+    bool failed() const { return _failed; }
+};
+
+#endif // UPLINKORDER_H
@@ -0,0 +1,873 @@
+#include "webhookServer.h"
+#include "decoder.h"
+
+#include <algorithm> // std::min
+#include <chrono>    // std::chrono::steady_clock
+#include <errno.h>   // errno
+#include <string.h>  // memcpy, memmove
+
+#ifdef __linux__
+#include <arpa/inet.h>   // inet_pton
+#include <netinet/in.h>  // sockaddr_in
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <sys/epoll.h>   // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/eventfd.h> // eventfd
+#include <sys/socket.h>  // socket, bind, listen, accept4
+#include <unistd.h>      // read, write, close
+#endif
+
+namespace
+{
+    const size_t MAX_HEADER = 8 << 10;  ///< Longest accepted request line plus headers
+    const size_t READ_SIZE = 16 << 10;  ///< Initial receive buffer per connection
+    const size_t MAX_UNSENT = 64 << 10; ///< Unsent response bytes above which a connection is not read
+    const int MAX_EVENTS = 256;         ///< Events taken per epoll_wait (one round)
+
+    /// @brief Case-insensitive comparison of a header name with a lower-case name.
+    inline bool sameName(std::string_view name, std::string_view lower)
+    {
+        if (name.size() != lower.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            const char c = name[i] >= 'A' && name[i] <= 'Z' ? static_cast<char>(name[i] + 32) : name[i];
+            if (c != lower[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Compare a received secret with the expected one in time that does not depend on where they differ.
+    inline bool sameSecret(std::string_view received, std::string_view expected)
+    {
+        if (received.size() != expected.size())
+        {
+            return false;
+        }
+        unsigned char difference = 0;
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            difference |= static_cast<unsigned char>(received[i] ^ expected[i]);
+        }
+        return difference == 0;
+    }
+
+    /// @brief Value of a decimal header; false if it is empty, not a number or absurdly large.
+    inline bool parseLength(std::string_view text, size_t &value)
+    {
+        value = 0;
+        if (text.empty() || text.size() > 12)
+        {
+            return false;
+        }
+        for (const char c : text)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            value = value * 10 + static_cast<size_t>(c - '0');
+        }
+        return true;
+    }
+
+    /// @brief Header block of one HTTP message, as found by scanHeaders().
+    struct httpHead
+    {
+        std::string_view startLine = {};     ///< Request line or status line
+        std::string_view authorization = {}; ///< Authorization header value
+        size_t contentLength = 0;            ///< Content-Length (0 if missing)
+        bool lengthValid = true;             ///< Content-Length absent or a number
+        bool chunked = false;                ///< A Transfer-Encoding header is present
+        bool close = false;                  ///< Connection: close
+        bool keepAlive = false;              ///< Connection: keep-alive
+        bool expectContinue = false;         ///< Expect: 100-continue
+    };
+
+    /// @brief Split a header block (without the final empty line) into the fields used here.
+    void scanHeaders(std::string_view text, httpHead &head)
+    {
+        size_t end = text.find("\r\n");
+        head.startLine = text.substr(0, end);
+        while (end != std::string_view::npos)
+        {
+            const size_t start = end + 2;
+            end = text.find("\r\n", start);
+            const std::string_view line = text.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+            const size_t colon = line.find(':');
+            if (colon == std::string_view::npos)
+            {
+                continue;
+            }
+            const std::string_view name = line.substr(0, colon);
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+            {
+                value.remove_prefix(1);
+            }
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+            {
+                value.remove_suffix(1);
+            }
+            if (sameName(name, "content-length"))
+            {
+                head.lengthValid = parseLength(value, head.contentLength);
+            }
+            else if (sameName(name, "transfer-encoding"))
+            {
+                head.chunked = true;
+            }
+            else if (sameName(name, "connection"))
+            {
+                head.close = sameName(value, "close");
+                head.keepAlive = sameName(value, "keep-alive");
+            }
+            else if (sameName(name, "expect"))
+            {
+                head.expectContinue = sameName(value, "100-continue");
+            }
+            else if (sameName(name, "authorization"))
+            {
+                head.authorization = value;
+            }
+        }
+    }
+
+    /// @brief Append a response without body (or with the health check body).
+    void appendResponse(std::string &out, int status, bool keepAlive)
+    {
+        if (status == 200 && keepAlive)
+        {
+            out += "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"; // the common case, no formatting
+            return;
+        }
+        const char *reason = status == 200   ? "OK"
+                             : status == 400 ? "Bad Request"
+                             : status == 401 ? "Unauthorized"
+                             : status == 405 ? "Method Not Allowed"
+                             : status == 413 ? "Payload Too Large"
+                             : status == 431 ? "Request Header Fields Too Large"
+                                             : "Not Implemented";
+        char text[128];
+        const int length = snprintf(text, sizeof(text), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n%s\r\n", status, reason,
+                                    keepAlive ? "" : "Connection: close\r\n");
+        out.append(text, static_cast<size_t>(length));
+    }
+
+    /// @brief Seconds on the steady clock.
+    inline uint64_t nowSeconds()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+}
+
+/// @brief State of one event loop; only its own thread touches it while it runs.
+struct webhookServer::loop
+{
+    /// @brief One client connection.
+    struct connection
+    {
+        int fd = -1;               ///< Socket
+        std::vector<char> in = {}; ///< Received bytes not yet parsed
+        size_t used = 0;           ///< Bytes of `in` in use
+        std::string out = {};      ///< Responses not yet sent
+        size_t sent = 0;           ///< Bytes of `out` already sent
+        uint64_t active = 0;       ///< Time of the last received bytes (nowSeconds())
+        bool closing = false;      ///< Close once `out` is sent
+        bool continued = false;    ///< 100 Continue sent for the pending request
+        bool writing = false;      ///< Waiting for EPOLLOUT
+        bool paused = false;       ///< EPOLLIN dropped while more than MAX_UNSENT bytes wait to be sent
+        bool dirty = false;        ///< Listed in `flush`
+    };
+
+    unsigned index = 0;                                        ///< Number of the loop
+    int listenFd = -1;                                         ///< Listening socket (SO_REUSEPORT)
+    int epollFd = -1;                                          ///< epoll instance
+    std::vector<std::unique_ptr<connection>> connections = {}; ///< Connections by file descriptor
+    std::vector<connection *> flush = {};                      ///< Connections to write or close at the end of the round
+    std::vector<uint8_t> frames = {};                          ///< Frames received in this round
+    std::vector<uplinkRecord> records = {};                    ///< Uplinks of `frames`
+    payloadBatch batch = {};                                   ///< Decoded frames of this round
+    webhookStats stats = {};                                   ///< Counters
+};
+
+#ifdef __linux__
+
+namespace
+{
+    /// @brief Handle the complete requests in the receive buffer of a connection.
+    void parseRequests(webhookServer::loop &state, webhookServer::loop::connection &c, const webhookConfig &config)
+    {
+        size_t position = 0;
+        while (!c.closing && position < c.used)
+        {
+            const std::string_view pending(c.in.data() + position, c.used - position);
+            const size_t blank = pending.substr(0, MAX_HEADER).find("\r\n\r\n");
+            if (blank == std::string_view::npos)
+            {
+                if (pending.size() >= MAX_HEADER)
+                {
+                    appendResponse(c.out, 431, false);
+                    c.closing = true;
+                    state.stats.rejected++;
+                }
+                break;
+            }
+            httpHead head;
+            scanHeaders(pending.substr(0, blank), head);
+            const bool http10 = head.startLine.size() >= 8 && head.startLine.substr(head.startLine.size() - 8) == "HTTP/1.0";
+            const bool keepAlive = !head.close && (!http10 || head.keepAlive);
+            const size_t bodyStart = blank + 4;
+
+            int status = 200;
+            if (head.chunked)
+            {
+                status = 501;
+            }
+            else if (!head.lengthValid)
+            {
+                status = 400;
+            }
+            else if (head.contentLength > config.maxBody)
+            {
+                status = 413;
+            }
+            if (status != 200)
+            {
+                appendResponse(c.out, status, false);
+                c.closing = true;
+                state.stats.requests++;
+                state.stats.rejected++;
+                break;
+            }
+            if (pending.size() - bodyStart < head.contentLength)
+            {
+                if (head.expectContinue && !c.continued)
+                {
+                    c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                    c.continued = true;
+                }
+                break;
+            }
+            c.continued = false;
+
+            /** The body is parsed where it was received; only the uplink fields are copied out. */
+            const std::string_view body = pending.substr(bodyStart, head.contentLength);
+            if (!config.authorization.empty() && !sameSecret(head.authorization, config.authorization))
+            {
+                status = 401;
+            }
+            else if (head.startLine.compare(0, 5, "POST ") == 0)
+            {
+                ttnUplink uplink;
+                const ttnMessage kind = parseTtnUplink(body, uplink);
+                if (kind == ttnMessage::malformed)
+                {
+                    status = 400;
+                }
+                else
+                {
+                    state.records.emplace_back();
+                    if (kind == ttnMessage::uplink && uplinkRecordFromTtn(uplink, state.records.back()))
+                    {
+                        state.frames.insert(state.frames.end(), state.records.back().frame,
+                                            state.records.back().frame + sizeof(state.records.back().frame));
+                    }
+                    else
+                    {
+                        state.records.pop_back();
+                        state.stats.ignored++;
+                    }
+                }
+            }
+            else if (head.startLine.compare(0, 4, "GET ") != 0)
+            {
+                status = 405;
+            }
+
+            if (status == 200 && head.startLine.compare(0, 4, "GET ") == 0)
+            {
+                c.out += keepAlive ? "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 3\r\n\r\nok\n"
+                                   : "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 3\r\nConnection: close\r\n\r\nok\n";
+            }
+            else
+            {
+                appendResponse(c.out, status, keepAlive);
+            }
+            state.stats.requests++;
+            state.stats.rejected += status != 200;
+            c.closing = !keepAlive;
+            position += bodyStart + head.contentLength;
+        }
+        if (position > 0)
+        {
+            memmove(c.in.data(), c.in.data() + position, c.used - position);
+            c.used -= position;
+        }
+    }
+
+    /// @brief Add a connection to the list of connections to write or close this round.
+    inline void markDirty(webhookServer::loop &state, webhookServer::loop::connection &c)
+    {
+        if (!c.dirty)
+        {
+            c.dirty = true;
+            state.flush.push_back(&c);
+        }
+    }
+
+    /// @brief Read what a connection has received and handle its requests.
+    void readConnection(webhookServer::loop &state, webhookServer::loop::connection &c, const webhookConfig &config, uint64_t now)
+    {
+        const size_t limit = MAX_HEADER + config.maxBody;
+        while (!c.closing && c.out.size() - c.sent <= MAX_UNSENT)
+        {
+            if (c.used == c.in.size())
+            {
+                if (c.in.size() >= limit)
+                {
+                    break; // parseRequests() answered 413 or 431 already, or will once the body is complete
+                }
+                c.in.resize(std::min(limit, 2 * c.in.size()));
+            }
+            const size_t space = c.in.size() - c.used;
+            const ssize_t n = read(c.fd, c.in.data() + c.used, space);
+            if (n > 0)
+            {
+                c.used += static_cast<size_t>(n);
+                c.active = now;
+                parseRequests(state, c, config);
+                if (static_cast<size_t>(n) < space)
+                {
+                    break; // drained; epoll reports the next bytes
+                }
+            }
+            else if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                c.closing = c.closing || n == 0 || (errno != EAGAIN);
+                break;
+            }
+        }
+        if (!c.out.empty() || c.closing)
+        {
+            markDirty(state, c);
+        }
+    }
+
+    /// @brief Send the pending responses of a connection; close it when it is done.
+    void writeConnection(webhookServer::loop &state, webhookServer::loop::connection &c)
+    {
+        c.dirty = false;
+        while (c.sent < c.out.size())
+        {
+            const ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                c.sent += static_cast<size_t>(n);
+            }
+            else if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (n < 0 && (errno == EAGAIN))
+            {
+                /** A client that sends requests but does not read the responses is not read either. */
+                const bool pause = c.out.size() - c.sent > MAX_UNSENT;
+                if (!c.writing || pause != c.paused)
+                {
+                    epoll_event event{};
+                    event.events = pause ? EPOLLOUT : EPOLLIN | EPOLLOUT;
+                    event.data.fd = c.fd;
+                    epoll_ctl(state.epollFd, EPOLL_CTL_MOD, c.fd, &event);
+                    c.writing = true;
+                    c.paused = pause;
+                }
+                return;
+            }
+            else
+            {
+                c.closing = true;
+                c.out.clear();
+                c.sent = 0;
+                break;
+            }
+        }
+        c.out.clear();
+        c.sent = 0;
+        if (c.closing)
+        {
+            const int fd = c.fd;
+            close(fd); // also removes it from the epoll set
+            state.connections[static_cast<size_t>(fd)].reset();
+            return;
+        }
+        if (c.writing)
+        {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = c.fd;
+            epoll_ctl(state.epollFd, EPOLL_CTL_MOD, c.fd, &event);
+            c.writing = false;
+            c.paused = false;
+        }
+    }
+
+    /// @brief Accept all pending connections of a listening socket.
+    void acceptConnections(webhookServer::loop &state, uint64_t now)
+    {
+        for (;;)
+        {
+            const int fd = accept4(state.listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                return; // EAGAIN, or out of file descriptors until connections close
+            }
+            const int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(state.epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+            {
+                close(fd);
+                continue;
+            }
+            if (state.connections.size() <= static_cast<size_t>(fd))
+            {
+                state.connections.resize(static_cast<size_t>(fd) + 1);
+            }
+            state.connections[static_cast<size_t>(fd)].reset(new webhookServer::loop::connection());
+            webhookServer::loop::connection &c = *state.connections[static_cast<size_t>(fd)];
+            c.fd = fd;
+            c.in.resize(READ_SIZE);
+            c.active = now;
+            state.stats.connections++;
+        }
+    }
+}
+
+webhookServer::webhookServer(const webhookConfig &config, webhookSink sink)
+    : _config(config), _sink(std::move(sink)), _loops(), _threads(), _stopFd(-1), _port(config.port)
+{
+    if (_config.threads == 0)
+    {
+        _config.threads = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+    }
+}
+
+webhookServer::~webhookServer()
+{
+    stop();
+    wait();
+    if (_stopFd >= 0)
+    {
+        close(_stopFd);
+    }
+}
+
+bool webhookServer::start()
+{
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    if (!_threads.empty() || inet_pton(AF_INET, _config.address.c_str(), &address.sin_addr) != 1)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    if (_stopFd < 0)
+    {
+        _stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    /** Every loop binds its own socket; with port 0 the later sockets take the port the first one got. */
+    bool ok = _stopFd >= 0;
+    for (unsigned i = 0; ok && i < _config.threads; i++)
+    {
+        _loops.emplace_back(new loop());
+        loop &state = *_loops.back();
+        state.index = i;
+        state.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+        const int one = 1;
+        address.sin_port = htons(_port);
+        ok = state.listenFd >= 0 && state.epollFd >= 0 &&
+             setsockopt(state.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+             setsockopt(state.listenFd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == 0 &&
+             bind(state.listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0 &&
+             listen(state.listenFd, SOMAXCONN) == 0;
+        if (ok && i == 0)
+        {
+            socklen_t length = sizeof(address);
+            ok = getsockname(state.listenFd, reinterpret_cast<sockaddr *>(&address), &length) == 0;
+            _port = ntohs(address.sin_port);
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = state.listenFd;
+        ok = ok && epoll_ctl(state.epollFd, EPOLL_CTL_ADD, state.listenFd, &event) == 0;
+        event.data.fd = _stopFd;
+        ok = ok && epoll_ctl(state.epollFd, EPOLL_CTL_ADD, _stopFd, &event) == 0;
+    }
+    if (!ok)
+    {
+        const int error = errno;
+        wait();
+        errno = error;
+        return false;
+    }
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        _threads.emplace_back(&webhookServer::run, this, std::ref(*state));
+    }
+    return true;
+}
+
+void webhookServer::stop()
+{
+    if (_stopFd >= 0)
+    {
+        /** Only write(): safe in a signal handler. The eventfd stays readable, so every loop sees it. */
+        const uint64_t one = 1;
+        const ssize_t written = write(_stopFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void webhookServer::wait()
+{
+    for (std::thread &thread : _threads)
+    {
+        thread.join();
+    }
+    _threads.clear();
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        for (const std::unique_ptr<loop::connection> &c : state->connections)
+        {
+            if (c)
+            {
+                close(c->fd);
+            }
+        }
+        state->connections.clear();
+        if (state->listenFd >= 0)
+        {
+            close(state->listenFd);
+            state->listenFd = -1;
+        }
+        if (state->epollFd >= 0)
+        {
+            close(state->epollFd);
+            state->epollFd = -1;
+        }
+    }
+}
+
+void webhookServer::run(loop &state)
+{
+    epoll_event events[MAX_EVENTS];
+    uint64_t lastSweep = nowSeconds();
+    bool running = true;
+    while (running)
+    {
+        const int count = epoll_wait(state.epollFd, events, MAX_EVENTS, 1000);
+        const uint64_t now = nowSeconds();
+        for (int i = 0; i < count; i++)
+        {
+            const int fd = events[i].data.fd;
+            if (fd == _stopFd)
+            {
+                running = false;
+            }
+            else if (fd == state.listenFd)
+            {
+                acceptConnections(state, now);
+            }
+            else if (static_cast<size_t>(fd) < state.connections.size() && state.connections[static_cast<size_t>(fd)])
+            {
+                loop::connection &c = *state.connections[static_cast<size_t>(fd)];
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    c.closing = true;
+                    c.out.clear();
+                    c.sent = 0;
+                    markDirty(state, c);
+                    continue;
+                }
+                if (events[i].events & EPOLLIN)
+                {
+                    readConnection(state, c, _config, now);
+                }
+                if (events[i].events & EPOLLOUT)
+                {
+                    c.active = now; // the client reads its responses
+                    markDirty(state, c);
+                }
+            }
+        }
+
+        /** One decode and one sink call for everything this round received; answer only after that. */
+        if (!state.records.empty())
+        {
+            state.batch.clear();
+            payloadDecoder::decodeBatch(state.frames.data(), state.frames.size(), state.batch);
+            _sink(state.index, state.batch, state.records);
+            state.stats.batches++;
+            state.stats.uplinks += state.records.size();
+            state.frames.clear();
+            state.records.clear();
+        }
+        for (loop::connection *c : state.flush)
+        {
+            writeConnection(state, *c);
+        }
+        state.flush.clear();
+
+        if (now != lastSweep)
+        {
+            lastSweep = now;
+            for (const std::unique_ptr<loop::connection> &c : state.connections)
+            {
+                if (c && (c->out.empty() || c->writing) && c->active + _config.idleSeconds < now)
+                {
+                    /** Also drop clients that stopped reading their responses. */
+                    c->closing = true;
+                    c->out.clear();
+                    c->sent = 0;
+                    writeConnection(state, *c);
+                }
+            }
+        }
+    }
+}
+
+webhookStats webhookServer::get_stats() const
+{
+    webhookStats total;
+    for (const std::unique_ptr<loop> &state : _loops)
+    {
+        total.connections += state->stats.connections;
+        total.requests += state->stats.requests;
+        total.uplinks += state->stats.uplinks;
+        total.ignored += state->stats.ignored;
+        total.rejected += state->stats.rejected;
+        total.batches += state->stats.batches;
+    }
+    return total;
+}
+
+bool runWebhookLoad(const webhookLoadConfig &config, const std::vector<std::string_view> &messages, webhookLoadResult &result)
+{
+    result = webhookLoadResult();
+    const uint64_t total = config.requests != 0 ? config.requests : messages.size();
+    if (messages.empty() || total == 0)
+    {
+        return true;
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.address.c_str(), &address.sin_addr) != 1)
+    {
+        return false;
+    }
+
+    /** All requests are formatted once; sending one is a copy into the connection's buffer. */
+    std::string requests;
+    std::vector<size_t> offsets(1, 0);
+    for (const std::string_view message : messages)
+    {
+        char head[256];
+        const int length = snprintf(head, sizeof(head), "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+                                    config.path.c_str(), config.address.c_str(), message.size());
+        requests.append(head, static_cast<size_t>(std::max(0, std::min(length, static_cast<int>(sizeof(head)) - 1))));
+        requests.append(message.data(), message.size());
+        offsets.push_back(requests.size());
+    }
+
+    struct client
+    {
+        int fd = -1;
+        std::string out = {};
+        size_t sent = 0;
+        std::vector<char> in = std::vector<char>(READ_SIZE);
+        size_t used = 0;
+        uint64_t inFlight = 0;
+    };
+    const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<client> clients(std::max(1u, config.connections));
+    uint64_t issued = 0;
+    bool ok = epollFd >= 0;
+    const auto refill = [&](client &c)
+    {
+        while (c.inFlight < std::max(1u, config.depth) && issued < total)
+        {
+            const size_t message = static_cast<size_t>(issued % messages.size());
+            c.out.append(requests, offsets[message], offsets[message + 1] - offsets[message]);
+            c.inFlight++;
+            issued++;
+        }
+    };
+    const auto send = [&](client &c)
+    {
+        while (c.sent < c.out.size())
+        {
+            const ssize_t n = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                return n < 0 && (errno == EAGAIN || errno == EINTR);
+            }
+            c.sent += static_cast<size_t>(n);
+        }
+        c.out.clear();
+        c.sent = 0;
+        return true;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; ok && i < clients.size(); i++)
+    {
+        client &c = clients[i];
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        const int one = 1;
+        ok = c.fd >= 0 && setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0 &&
+             (connect(c.fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0 || errno == EINPROGRESS);
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.u64 = i;
+        ok = ok && epoll_ctl(epollFd, EPOLL_CTL_ADD, c.fd, &event) == 0;
+        refill(c);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (ok && result.responses < total)
+    {
+        const int count = epoll_wait(epollFd, events, MAX_EVENTS, 5000);
+        if (count <= 0)
+        {
+            ok = count < 0 && errno == EINTR; // a silent server for 5 s ends the run
+            continue;
+        }
+        for (int e = 0; ok && e < count; e++)
+        {
+            client &c = clients[events[e].data.u64];
+            if (events[e].events & (EPOLLERR | EPOLLHUP))
+            {
+                ok = false;
+                break;
+            }
+            if (events[e].events & EPOLLIN)
+            {
+                const ssize_t n = read(c.fd, c.in.data() + c.used, c.in.size() - c.used);
+                if (n <= 0)
+                {
+                    ok = n < 0 && (errno == EAGAIN || errno == EINTR);
+                    continue;
+                }
+                c.used += static_cast<size_t>(n);
+
+                /** Responses: status line, headers, Content-Length bytes of body. */
+                size_t position = 0;
+                for (;;)
+                {
+                    const std::string_view pending(c.in.data() + position, c.used - position);
+                    const size_t blank = pending.find("\r\n\r\n");
+                    if (blank == std::string_view::npos)
+                    {
+                        break;
+                    }
+                    httpHead head;
+                    scanHeaders(pending.substr(0, blank), head);
+                    if (pending.size() - blank - 4 < head.contentLength)
+                    {
+                        break;
+                    }
+                    position += blank + 4 + head.contentLength;
+                    if (head.startLine.compare(0, 12, "HTTP/1.1 100") == 0)
+                    {
+                        continue;
+                    }
+                    result.responses++;
+                    result.ok += head.startLine.size() > 9 && head.startLine[9] == '2';
+                    c.inFlight--;
+                }
+                memmove(c.in.data(), c.in.data() + position, c.used - position);
+                c.used -= position;
+                if (c.used == c.in.size())
+                {
+                    c.in.resize(2 * c.in.size());
+                }
+                refill(c);
+            }
+            ok = ok && send(c);
+        }
+    }
+    result.requests = issued;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const client &c : clients)
+    {
+        if (c.fd >= 0)
+        {
+            close(c.fd);
+        }
+    }
+    if (epollFd >= 0)
+    {
+        close(epollFd);
+    }
+    return ok && result.responses == total;
+}
+
+#else // no epoll: the server cannot start
+
+webhookServer::webhookServer(const webhookConfig &config, webhookSink sink)
+    : _config(config), _sink(std::move(sink)), _loops(), _threads(), _stopFd(-1), _port(config.port)
+{
+}
+
+webhookServer::~webhookServer()
+{
+}
+
+bool webhookServer::start()
+{
+    errno = ENOSYS;
+    return false;
+}
+
+void webhookServer::stop()
+{
+}
+
+void webhookServer::wait()
+{
+}
+
+void webhookServer::run(loop &)
+{
+}
+
+webhookStats webhookServer::get_stats() const
+{
+    return webhookStats();
+}
+
+bool runWebhookLoad(const webhookLoadConfig &, const std::vector<std::string_view> &, webhookLoadResult &result)
+{
+    result = webhookLoadResult();
+    return false;
+}
+
+#endif // __linux__
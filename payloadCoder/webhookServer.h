@@ -0,0 +1,151 @@
+/**
+ * @file webhookServer.h
+ * @brief HTTP/1.1 server that receives TTN v3 uplink webhooks and decodes them in batches.
+ *
+ * The TTN webhook integration POSTs one JSON uplink per request. Instead of Node-RED, this
+ * server takes those requests directly: one event loop per core, each with its own epoll
+ * instance and its own listening socket on the same port (SO_REUSEPORT), so the kernel spreads
+ * new connections over the loops and the loops share nothing. Connections are kept alive and
+ * requests may be pipelined. While more than 64 KiB of responses wait to be sent, the server
+ * stops reading the connection, so a client that does not read its responses cannot make the
+ * server buffer them without limit; after `idleSeconds` without progress it is closed.
+ *
+ * Requests are parsed in the connection's receive buffer: the request line and headers are
+ * scanned in place and the body is handed to parseTtnUplink() as a view, without copies. Each
+ * uplink is copied once, into an uplinkRecord. All uplinks that arrive in one round of the event
+ * loop (one epoll_wait) are decoded together with payloadDecoder::decodeBatch() and handed to
+ * the sink in one call. The responses of that round are sent only after the sink returned, so a
+ * 200 means the sink has the uplink.
+ *
+ * Responses:
+ * - POST with a TTN uplink: 200. Uplinks whose frm_payload is not one frame are counted as
+ *   ignored and also get 200, so that TTN does not retry them.
+ * - POST with another TTN message (join accept, ...): 200, counted as ignored.
+ * - POST with a body that is not a JSON object: 400.
+ * - GET: 200 with "ok" (health check). Other methods: 405.
+ * - Missing or wrong Authorization header (if `authorization` is set): 401.
+ * - Chunked bodies: 501; bodies over `maxBody`: 413; headers over 8 KiB: 431. These close the
+ *   connection.
+ *
+ * The load generator (runWebhookLoad) posts prepared messages over a number of keep-alive
+ * connections, with several pipelined requests on each, and reads the responses back.
+ *
+ * The server uses epoll and is only available on Linux; elsewhere start() fails.
+ *
+ * Usage: create a webhookServer with a sink, call start(), and stop() and wait() to shut down.
+ */
+
+#ifndef WEBHOOKSERVER_H
+#define WEBHOOKSERVER_H
+
+#include <stdint.h> // uint16_t, uint32_t and uint64_t type
+#include <stddef.h> // size_t
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "payloadBatch.h"
+#include "ttnUplink.h" // uplinkRecord
+
+/// \brief settings of the webhook server
+struct webhookConfig
+{
+    std::string address = "0.0.0.0"; ///< IPv4 address to listen on
+    uint16_t port = 8080;             ///< TCP port (0: any free port, see get_port())
+    unsigned threads = 0;             ///< Event loops (0: one per hardware thread)
+    std::string authorization = {};   ///< Required Authorization header value (empty: none)
+    size_t maxBody = 64 << 10;        ///< Largest accepted request body in bytes
+    unsigned idleSeconds = 60;        ///< Idle keep-alive connections, and clients not reading responses, are closed after this time
+};
+
+/// \brief counters of the webhook server, summed over the event loops
+struct webhookStats
+{
+    uint64_t connections = 0; ///< Connections accepted
+    uint64_t requests = 0;    ///< Requests answered
+    uint64_t uplinks = 0;     ///< Uplinks handed to the sink
+    uint64_t ignored = 0;     ///< Valid messages without a usable frame
+    uint64_t rejected = 0;    ///< Requests answered with a 4xx or 5xx status
+    uint64_t batches = 0;     ///< Calls of the sink
+};
+
+/// \brief receives the uplinks of one event loop round
+/// Called on the thread of event loop `loop`; loops call it concurrently.
+/// `uplinks` has one entry per frame passed to the decoder, so the indices in `batch.errors`
+/// refer to it; rows of `batch` skip the rejected frames.
+using webhookSink = std::function<void(unsigned loop, const payloadBatch &batch, const std::vector<uplinkRecord> &uplinks)>;
+
+/// \brief TTN webhook receiver with one epoll event loop per thread
+class webhookServer
+{
+public:
+    struct loop; ///< State of one event loop (defined in webhookServer.cpp)
+
+private:
+    webhookConfig _config;                     ///< Settings
+    webhookSink _sink;                         ///< Receiver of the decoded uplinks
+    std::vector<std::unique_ptr<loop>> _loops; ///< Event loops
+    std::vector<std::thread> _threads;         ///< Threads running the event loops
+    int _stopFd;                               ///< eventfd that wakes all loops to stop, -1 if not started
+    uint16_t _port;                            ///< Port the loops listen on
+
+    /// \brief run one event loop until stop()
+    void run(loop &state);
+
+public:
+    /// \brief constructor; nothing is opened until start()
+    /// \param config settings
+    /// \param sink receiver of the decoded uplinks
+    webhookServer(const webhookConfig &config, webhookSink sink);
+    ~webhookServer();                                         ///< Destructor, stops the loops
+    webhookServer(const webhookServer &) = delete;            ///< Copy constructor disabled
+    webhookServer &operator=(const webhookServer &) = delete; ///< Assignment operator disabled
+
+    /// \brief open the listening sockets and start the event loops
+    /// \return false if a socket cannot be opened or bound (the reason is in errno)
+    bool start();
+
+    /// \brief ask all loops to stop; safe to call from a signal handler
+    void stop();
+
+    /// \brief wait until all loops stopped and close the listening sockets
+    void wait();
+
+    /// \brief port the server listens on, after start()
+    uint16_t get_port() const { return _port; }
+
+    /// \brief counters, summed over the loops; call after wait()
+    webhookStats get_stats() const;
+};
+
+/// \brief settings of the load generator
+struct webhookLoadConfig
+{
+    std::string address = "127.0.0.1"; ///< IPv4 address of the server
+    uint16_t port = 8080;               ///< TCP port of the server
+    std::string path = "/uplink";       ///< Request target
+    unsigned connections = 16;          ///< Keep-alive connections
+    unsigned depth = 8;                 ///< Requests in flight per connection (pipelining)
+    uint64_t requests = 0;              ///< Requests to send (0: each message once)
+};
+
+/// \brief result of a load run
+struct webhookLoadResult
+{
+    uint64_t requests = 0;  ///< Requests sent
+    uint64_t responses = 0; ///< Responses received
+    uint64_t ok = 0;        ///< Responses with a 2xx status
+    double seconds = 0.0;   ///< Duration of the run
+};
+
+/// \brief post messages to a webhook server and read the responses
+/// \param config settings
+/// \param messages request bodies, sent in turn (round robin when `requests` is larger)
+/// \param result receives the counters
+/// \return false if connecting failed or a connection was closed before all its responses arrived
+bool runWebhookLoad(const webhookLoadConfig &config, const std::vector<std::string_view> &messages, webhookLoadResult &result);
+
+#endif // WEBHOOKSERVER_H
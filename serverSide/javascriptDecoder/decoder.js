@@ -9,6 +9,29 @@ function decodeUplink(input) {
     // Decode 'version' from the 5th byte
     // The 'version' is a single byte indicating the version of the payload
     data.version = bytes[4];
+
+    // Version 2 is the 8-byte bit-packed layout (see nodeCode/payloadSchema.h):
+    // door, catch and displacement bits, a 7-bit battery and the low 14 bits of 'unixTime'
+    if (data.version === 2 && bytes.length === 8) {
+      data.doorStatus = (bytes[5] & 0x80) !== 0;
+      data.catchDetect = (bytes[5] & 0x40) !== 0;
+      data.trapDisplacement = (bytes[5] & 0x20) !== 0;
+      data.batteryStatus = ((bytes[5] & 0x1F) << 2) | (bytes[6] >> 6);
+
+      // Restore the full time: the time with these low bits nearest to the receive time
+      var period = 16384;
+      var low = ((bytes[6] & 0x3F) << 8) | bytes[7];
+      var received = Math.floor((input.recvTime ? input.recvTime.getTime() : Date.now()) / 1000);
+      var ahead = (((low - received) % period) + period) % period;
+      data.unixTime = ahead < period / 2 ? received + ahead : received + ahead - period;
+
+      return {
+        data: {
+          data: data,
+          raw: input.bytes
+        }
+      };
+    }
     
     // Decode 'doorStatus', 'catchDetect', and 'trapDisplacement' from the 6th byte
     // 'doorStatus' is the least significant bit (bit 0)